@@ -0,0 +1,18 @@
+#pragma once
+
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// Number of heap allocations made through operator new in the whole process so far. Linking
+// AllocationCounter.cpp replaces the global operator new and delete with malloc-based versions
+// that add one relaxed atomic increment. Take the difference around a block of code to check
+// that it does not allocate.
+size_t allocationCount();
+
+// The same, counting only the calling thread's allocations, so that other threads' work does not
+// show up in the difference
+size_t threadAllocationCount();
+
+#endif // ALLOCATION_COUNTER_H
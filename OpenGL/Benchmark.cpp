@@ -0,0 +1,2906 @@
+#include "Benchmark.h"
+#include "EnvironmentBaker.h"
+#include "FramePacer.h"
+#include "GeometryArena.h"
+#include "InstanceBatch.h"
+#include "JobSystem.h"
+#include "MaterialTable.h"
+#include "MipmapBuilder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
+#include "ModelLoader.h"
+#include "OcclusionBuffer.h"
+#include "Profiler.h"
+#include "QuantizedVertex.h"
+#include "RenderQueue.h"
+#include "SceneBvh.h"
+#include "ShaderCache.h"
+#include "ShaderPermutations.h"
+#include "StreamBuffer.h"
+#include "stb_image.h"
+#include "TaskGraph.h"
+#include "TextureCache.h"
+#include "TextureCompression.h"
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <thread>
+
+namespace {
+
+typedef std::chrono::high_resolution_clock BenchmarkClock;
+
+double secondsSince(BenchmarkClock::time_point start) {
+    return std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+}
+
+// Smooth gradients plus texel noise, a rough stand-in for photographic textures
+std::vector<unsigned char> syntheticImage(int width, int height) {
+    std::vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4);
+    unsigned int seed = 12345;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            unsigned char* texel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+            seed = seed * 1103515245u + 12345u;
+            int noise = static_cast<int>((seed >> 16) % 17) - 8;
+            float u = static_cast<float>(x) / width;
+            float v = static_cast<float>(y) / height;
+            int values[4] = {
+                static_cast<int>(128.0f + 100.0f * std::sin(u * 31.0f)),
+                static_cast<int>(128.0f + 100.0f * std::cos(v * 17.0f + u * 5.0f)),
+                static_cast<int>(255.0f * u * v),
+                static_cast<int>(255.0f * (0.5f + 0.5f * std::sin((u + v) * 9.0f)))
+            };
+            for (int c = 0; c < 4; ++c)
+                texel[c] = static_cast<unsigned char>(std::min(255, std::max(0, values[c] + noise)));
+        }
+    }
+    return rgba;
+}
+
+// bc [image path]: encode throughput and PSNR of every block format at both quality levels
+int benchmarkBlockCompression(const std::vector<std::string>& args) {
+    int width = 1024, height = 1024;
+    std::vector<unsigned char> rgba;
+    if (!args.empty()) {
+        int channels;
+        unsigned char* pixels = stbi_load(args[0].c_str(), &width, &height, &channels, 4);
+        if (!pixels) {
+            std::cerr << "Failed to load benchmark image: " << args[0] << std::endl;
+            return 1;
+        }
+        rgba.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(pixels);
+    }
+    else {
+        rgba = syntheticImage(width, height);
+    }
+
+    const BlockFormat formats[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC5 };
+    const char* formatNames[] = { "BC1", "BC3", "BC5" };
+    const CompressionQuality qualities[] = { CompressionQuality::Fast, CompressionQuality::High };
+    const char* qualityNames[] = { "fast", "high" };
+
+    std::cout << "Block compression, " << width << "x" << height << std::endl;
+    std::vector<unsigned char> decoded(rgba.size());
+    for (int f = 0; f < 3; ++f) {
+        std::vector<unsigned char> blocks(compressedImageSize(formats[f], width, height));
+        for (int q = 0; q < 2; ++q) {
+            const int repetitions = 3;
+            BenchmarkClock::time_point start = BenchmarkClock::now();
+            for (int i = 0; i < repetitions; ++i)
+                compressImage(formats[f], qualities[q], rgba.data(), width, height, blocks.data());
+            double seconds = secondsSince(start) / repetitions;
+
+            decompressImage(formats[f], blocks.data(), width, height, decoded.data());
+            double psnr = computePSNR(formats[f], rgba.data(), decoded.data(), width, height);
+            double megapixels = static_cast<double>(width) * height / 1.0e6;
+
+            std::cout << "  " << formatNames[f] << " " << qualityNames[q]
+                      << std::fixed << std::setprecision(1)
+                      << "  " << megapixels / seconds << " MP/s"
+                      << std::setprecision(2) << "  PSNR " << psnr << " dB" << std::endl;
+        }
+    }
+    return 0;
+}
+
+// mips [image path]: SIMD mip chain generation against the scalar reference for every filter
+int benchmarkMipmaps(const std::vector<std::string>& args) {
+    int width = 2048, height = 2048;
+    std::vector<unsigned char> rgba;
+    if (!args.empty()) {
+        int channels;
+        unsigned char* pixels = stbi_load(args[0].c_str(), &width, &height, &channels, 4);
+        if (!pixels) {
+            std::cerr << "Failed to load benchmark image: " << args[0] << std::endl;
+            return 1;
+        }
+        rgba.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(pixels);
+    }
+    else {
+        rgba = syntheticImage(width, height);
+    }
+
+    const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser };
+    const char* filterNames[] = { "box", "kaiser" };
+
+    std::cout << "Mip chain generation, " << width << "x" << height << " RGBA" << std::endl;
+    for (int f = 0; f < 2; ++f) {
+        for (int srgb = 0; srgb < 2; ++srgb) {
+            MipmapSettings settings;
+            settings.filter = filters[f];
+            settings.srgb = srgb != 0;
+
+            const int repetitions = 3;
+            TextureImage simd, reference;
+            BenchmarkClock::time_point start = BenchmarkClock::now();
+            for (int i = 0; i < repetitions; ++i)
+                buildMipChain(rgba.data(), width, height, 4, settings, simd);
+            double simdSeconds = secondsSince(start) / repetitions;
+
+            start = BenchmarkClock::now();
+            for (int i = 0; i < repetitions; ++i)
+                buildMipChainReference(rgba.data(), width, height, 4, settings, reference);
+            double referenceSeconds = secondsSince(start) / repetitions;
+
+            // Both paths must agree to within rounding
+            int maxDifference = 0;
+            for (size_t i = 0; i < simd.storage.size(); ++i)
+                maxDifference = std::max(maxDifference, std::abs(simd.storage[i] - reference.storage[i]));
+
+            std::cout << "  " << filterNames[f] << (srgb ? " srgb  " : " linear")
+                      << std::fixed << std::setprecision(2)
+                      << "  simd " << simdSeconds * 1000.0 << " ms"
+                      << "  scalar " << referenceSeconds * 1000.0 << " ms"
+                      << "  speedup " << referenceSeconds / simdSeconds << "x"
+                      << "  max diff " << maxDifference << " (" << simd.mips.size() << " levels)" << std::endl;
+        }
+    }
+    return 0;
+}
+
+// env [face size]: environment bake time on six synthetic faces, plus an SH check on a uniform sky
+int benchmarkEnvironment(const std::vector<std::string>& args) {
+    int size = args.empty() ? 512 : std::atoi(args[0].c_str());
+    if (size <= 0) {
+        std::cerr << "Invalid face size: " << args[0] << std::endl;
+        return 1;
+    }
+
+    std::vector<unsigned char> face = syntheticImage(size, size);
+    std::vector<const unsigned char*> faces(6, face.data());
+
+    EnvironmentMap environment;
+    const int repetitions = 3;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (int i = 0; i < repetitions; ++i)
+        bakeEnvironmentFromPixels(faces, size, 4, environment);
+    double seconds = secondsSince(start) / repetitions;
+
+    std::cout << "Environment bake, 6x" << size << "x" << size << " on " << JobSystem::shared().size() << " threads"
+              << std::fixed << std::setprecision(2)
+              << ": " << seconds * 1000.0 << " ms (" << environment.faceSize << " px radiance, "
+              << environment.mipCount << " levels)" << std::endl;
+
+    // A uniform white sky must give irradiance / pi = 1 in every direction
+    std::vector<unsigned char> white(static_cast<size_t>(size) * size * 4, 255);
+    std::vector<const unsigned char*> whiteFaces(6, white.data());
+    bakeEnvironmentFromPixels(whiteFaces, size, 4, environment);
+    const float normals[3][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } };
+    float maxError = 0.0f;
+    for (int n = 0; n < 3; ++n) {
+        float irradiance[3];
+        evaluateIrradiance(environment, normals[n], irradiance);
+        for (int c = 0; c < 3; ++c)
+            maxError = std::max(maxError, std::fabs(irradiance[c] - 1.0f));
+    }
+    std::cout << "  uniform sky SH error " << std::setprecision(4) << maxError << std::endl;
+    return 0;
+}
+
+// mesh [model path]: Assimp import against a warm .lgeo mesh cache load (CPU side only)
+int benchmarkMeshCache(const std::vector<std::string>& args) {
+    std::string path = args.empty() ? "media/models/plane.fbx" : args[0];
+
+    ModelData imported;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    if (!ModelLoader::importModel(path, imported)) {
+        std::cerr << "Failed to import benchmark model: " << path << std::endl;
+        return 1;
+    }
+    double importSeconds = secondsSince(start);
+
+    if (!writeMeshCache(path, imported))
+        return 1;
+
+    const int repetitions = 10;
+    ModelData cached;
+    start = BenchmarkClock::now();
+    for (int i = 0; i < repetitions; ++i) {
+        if (!loadMeshCache(path, cached)) {
+            std::cerr << "Failed to load mesh cache entry for: " << path << std::endl;
+            return 1;
+        }
+    }
+    double cacheSeconds = secondsSince(start) / repetitions;
+
+    // The cached arrays must be exactly what Assimp produced
+    size_t vertices = 0, indices = 0;
+    bool identical = cached.meshes.size() == imported.meshes.size();
+    for (size_t i = 0; identical && i < imported.meshes.size(); ++i) {
+        const MeshData& a = imported.meshes[i];
+        const MeshData& b = cached.meshes[i];
+        identical = a.vertexCount == b.vertexCount && a.indexCount == b.indexCount
+            && a.textures.size() == b.textures.size()
+            && std::memcmp(a.vertices, b.vertices, a.vertexCount * sizeof(Vertex)) == 0
+            && std::memcmp(a.indices, b.indices, a.indexCount * sizeof(unsigned int)) == 0;
+        vertices += a.vertexCount;
+        indices += a.indexCount;
+    }
+
+    std::cout << "Mesh load, " << path << ": " << imported.meshes.size() << " meshes, "
+              << vertices << " vertices, " << indices << " indices, "
+              << JobSystem::shared().size() << " conversion threads" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "  assimp " << importSeconds * 1000.0 << " ms" << std::endl
+              << "  cache  " << cacheSeconds * 1000.0 << " ms"
+              << std::setprecision(1) << "  (" << importSeconds / cacheSeconds << "x)"
+              << (identical ? "" : "  MISMATCH") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// Triangles as their corner attributes, sorted, for checking that a reorder kept every triangle
+std::vector<std::vector<float>> sortedTriangles(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+    const size_t floatsPerVertex = sizeof(Vertex) / sizeof(float);
+    std::vector<std::vector<float>> triangles(indices.size() / 3);
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        for (int c = 0; c < 3; ++c) {
+            const float* components = reinterpret_cast<const float*>(&vertices[indices[t * 3 + c]]);
+            triangles[t].insert(triangles[t].end(), components, components + floatsPerVertex);
+        }
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+// meshopt [model path]: ACMR/ATVR after each optimization stage. Without a model it uses a
+// 256x256 grid exported the worst way: unwelded, triangles shuffled.
+int benchmarkMeshOptimizer(const std::vector<std::string>& args) {
+    std::vector<std::vector<Vertex>> meshVertices;
+    std::vector<std::vector<unsigned int>> meshIndices;
+    std::string name;
+    if (!args.empty()) {
+        ModelData model;
+        if (!ModelLoader::importModel(args[0], model)) {
+            std::cerr << "Failed to import benchmark model: " << args[0] << std::endl;
+            return 1;
+        }
+        for (MeshData& mesh : model.meshes) {
+            meshVertices.push_back(std::move(mesh.vertexStorage));
+            meshIndices.push_back(std::move(mesh.indexStorage));
+        }
+        name = args[0];
+    }
+    else {
+        const int size = 256;
+        std::vector<unsigned int> triangleOrder(size * size * 2);
+        for (size_t t = 0; t < triangleOrder.size(); ++t)
+            triangleOrder[t] = static_cast<unsigned int>(t);
+        unsigned int seed = 12345;
+        for (size_t t = triangleOrder.size() - 1; t > 0; --t) {
+            seed = seed * 1103515245u + 12345u;
+            std::swap(triangleOrder[t], triangleOrder[(seed >> 8) % (t + 1)]);
+        }
+
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        for (unsigned int triangle : triangleOrder) {
+            int quad = triangle / 2, x = quad % size, y = quad / size;
+            const int corners[2][3][2] = { { { 0, 0 }, { 1, 0 }, { 1, 1 } }, { { 0, 0 }, { 1, 1 }, { 0, 1 } } };
+            for (int c = 0; c < 3; ++c) {
+                Vertex vertex;
+                float u = static_cast<float>(x + corners[triangle % 2][c][0]) / size;
+                float v = static_cast<float>(y + corners[triangle % 2][c][1]) / size;
+                vertex.Position = glm::vec3(u * 100.0f, std::sin(u * 20.0f) * std::cos(v * 15.0f) * 3.0f, v * 100.0f);
+                vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+                vertex.TexCoords = glm::vec2(u * 8.0f, v * 8.0f);
+                vertex.LightMapTexCoords = glm::vec2(u, v);
+                indices.push_back(static_cast<unsigned int>(vertices.size()));
+                vertices.push_back(vertex);
+            }
+        }
+        meshVertices.push_back(std::move(vertices));
+        meshIndices.push_back(std::move(indices));
+        name = "synthetic 256x256 grid";
+    }
+
+    const char* stageNames[] = { "input", "weld", "vertex cache", "overdraw", "vertex fetch" };
+    const int stageCount = 5;
+    double misses[stageCount] = {}, transformedVertices[stageCount] = {}, seconds[stageCount] = {};
+    size_t triangles = 0, shortIndexMeshes = 0;
+    bool preserved = true;
+    for (size_t m = 0; m < meshVertices.size(); ++m) {
+        std::vector<Vertex>& vertices = meshVertices[m];
+        std::vector<unsigned int>& indices = meshIndices[m];
+        if (indices.size() % 3 != 0)
+            continue;
+        std::vector<std::vector<float>> original = sortedTriangles(vertices, indices);
+        size_t meshTriangles = indices.size() / 3;
+        triangles += meshTriangles;
+
+        for (int stage = 0; stage < stageCount; ++stage) {
+            BenchmarkClock::time_point start = BenchmarkClock::now();
+            switch (stage) {
+            case 1: weldVertices(vertices, indices); break;
+            case 2: optimizeVertexCache(indices.data(), indices.size(), vertices.size()); break;
+            case 3: optimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size()); break;
+            case 4: optimizeVertexFetch(vertices, indices); break;
+            default: break;
+            }
+            seconds[stage] += secondsSince(start);
+            VertexCacheStats stats = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+            misses[stage] += static_cast<double>(stats.acmr) * meshTriangles;
+            transformedVertices[stage] += stats.acmr > 0.0f ? static_cast<double>(stats.acmr) * meshTriangles / stats.atvr : 0.0;
+        }
+
+        preserved = preserved && sortedTriangles(vertices, indices) == original;
+        shortIndexMeshes += canUseShortIndices(vertices.size());
+    }
+
+    std::cout << "Mesh optimization, " << name << ": " << meshVertices.size() << " meshes, " << triangles << " triangles, "
+              << shortIndexMeshes << " with 16-bit indices" << std::endl;
+    for (int stage = 0; stage < stageCount; ++stage) {
+        std::cout << "  " << std::left << std::setw(13) << stageNames[stage] << std::right << std::fixed << std::setprecision(3)
+                  << "ACMR " << (triangles ? misses[stage] / triangles : 0.0)
+                  << "  ATVR " << (transformedVertices[stage] > 0.0 ? misses[stage] / transformedVertices[stage] : 0.0)
+                  << std::setprecision(1) << "  " << seconds[stage] * 1000.0 << " ms" << std::endl;
+    }
+    if (!preserved)
+        std::cout << "  MISMATCH: the optimized meshes do not contain the same triangles" << std::endl;
+    return preserved ? 0 : 1;
+}
+
+// Total length of the edges that only one triangle uses, matching vertices by position so that UV
+// and lightmap seams count as closed. A simplifier that tears a seam open makes it grow.
+double openEdgeLength(const std::vector<Vertex>& vertices, const unsigned int* indices, size_t indexCount) {
+    std::map<std::vector<float>, unsigned int> positionIds;
+    std::vector<unsigned int> ids(vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        std::vector<float> key = { vertices[v].Position.x + 0.0f, vertices[v].Position.y + 0.0f, vertices[v].Position.z + 0.0f };
+        ids[v] = positionIds.insert(std::make_pair(key, static_cast<unsigned int>(positionIds.size()))).first->second;
+    }
+
+    std::map<std::pair<unsigned int, unsigned int>, std::pair<int, double>> edges;
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        for (int e = 0; e < 3; ++e) {
+            unsigned int a = indices[i + e], b = indices[i + (e + 1) % 3];
+            std::pair<unsigned int, unsigned int> key(std::min(ids[a], ids[b]), std::max(ids[a], ids[b]));
+            std::pair<int, double>& edge = edges[key];
+            ++edge.first;
+            edge.second = glm::length(vertices[a].Position - vertices[b].Position);
+        }
+    }
+
+    double length = 0.0;
+    for (const auto& edge : edges) {
+        if (edge.second.first == 1)
+            length += edge.second.second;
+    }
+    return length;
+}
+
+// Unit sphere in four lightmap charts: a UV seam and four lightmap seams, and locked pole fans
+void seamedSphere(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const int longitudes = 256, latitudes = 128, charts = 4, chartWidth = longitudes / charts;
+    for (int chart = 0; chart < charts; ++chart) {
+        unsigned int first = static_cast<unsigned int>(vertices.size());
+        for (int i = 0; i <= chartWidth; ++i) {
+            for (int j = 0; j <= latitudes; ++j) {
+                float u = static_cast<float>(chart * chartWidth + i) / longitudes;
+                float v = static_cast<float>(j) / latitudes;
+                float theta = u * 6.28318531f, phi = v * 3.14159265f;
+                Vertex vertex;
+                vertex.Position = glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+                vertex.Normal = vertex.Position;
+                vertex.TexCoords = glm::vec2(u, v);
+                vertex.LightMapTexCoords = glm::vec2((chart % 2 + static_cast<float>(i) / chartWidth) * 0.5f, (chart / 2 + v) * 0.5f);
+                vertices.push_back(vertex);
+            }
+        }
+        for (int i = 0; i < chartWidth; ++i) {
+            for (int j = 0; j < latitudes; ++j) {
+                unsigned int a = first + i * (latitudes + 1) + j, b = a + latitudes + 1;
+                if (j > 0) {
+                    unsigned int triangle[3] = { a, b, a + 1 };
+                    indices.insert(indices.end(), triangle, triangle + 3);
+                }
+                if (j < latitudes - 1) {
+                    unsigned int triangle[3] = { a + 1, b, b + 1 };
+                    indices.insert(indices.end(), triangle, triangle + 3);
+                }
+            }
+        }
+    }
+}
+
+// lod [model path]: LOD chain triangle counts, errors and build time. Without a model it uses a
+// unit sphere split into four lightmap charts, so it has a UV seam and four lightmap seams, and
+// also measures how far each LOD actually strays from the sphere: no further than its error plus
+// LOD 0's own distance from the sphere.
+int benchmarkLod(const std::vector<std::string>& args) {
+    std::vector<std::vector<Vertex>> meshVertices;
+    std::vector<std::vector<unsigned int>> meshIndices;
+    std::string name;
+    bool sphere = args.empty();
+    if (!sphere) {
+        ModelData model;
+        if (!ModelLoader::importModel(args[0], model)) {
+            std::cerr << "Failed to import benchmark model: " << args[0] << std::endl;
+            return 1;
+        }
+        for (MeshData& mesh : model.meshes) {
+            optimizeMesh(mesh.vertexStorage, mesh.indexStorage);
+            meshVertices.push_back(std::move(mesh.vertexStorage));
+            meshIndices.push_back(std::move(mesh.indexStorage));
+        }
+        name = args[0];
+    }
+    else {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        seamedSphere(vertices, indices);
+        meshVertices.push_back(std::move(vertices));
+        meshIndices.push_back(std::move(indices));
+        name = "seamed unit sphere";
+    }
+
+    bool intact = true;
+    for (size_t m = 0; m < meshVertices.size(); ++m) {
+        const std::vector<Vertex>& vertices = meshVertices[m];
+        std::vector<unsigned int>& indices = meshIndices[m];
+        if (indices.size() % 3 != 0)
+            continue;
+
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        std::vector<MeshLod> lods = buildLodChain(vertices, indices);
+        double seconds = secondsSince(start);
+
+        std::cout << "LOD chain, " << name << " mesh " << m << ": " << lods.size() << " levels in "
+                  << std::fixed << std::setprecision(1) << seconds * 1000.0 << " ms" << std::endl;
+        double baseOpenLength = openEdgeLength(vertices, indices.data(), lods[0].indexCount);
+        float extent = meshExtent(vertices.data(), vertices.size());
+        double baseDeviation = 0.0;
+        for (size_t l = 0; l < lods.size(); ++l) {
+            const unsigned int* lodIndices = &indices[lods[l].indexOffset];
+            double openLength = openEdgeLength(vertices, lodIndices, lods[l].indexCount);
+            bool torn = openLength > baseOpenLength * 1.001 + extent * 1e-4;
+            intact = intact && !torn;
+
+            std::cout << "  LOD " << l << "  " << std::setw(7) << lods[l].indexCount / 3 << " triangles ("
+                      << std::setprecision(1) << std::setw(5) << 100.0 * lods[l].indexCount / lods[0].indexCount << "%)"
+                      << std::scientific << std::setprecision(2) << "  error " << lods[l].error;
+            if (sphere) {
+                // Largest distance from the unit sphere over the triangle centers and edge midpoints,
+                // relative to the extent like the reported error
+                double deviation = 0.0;
+                for (size_t i = 0; i < lods[l].indexCount; i += 3) {
+                    const glm::vec3& a = vertices[lodIndices[i]].Position;
+                    const glm::vec3& b = vertices[lodIndices[i + 1]].Position;
+                    const glm::vec3& c = vertices[lodIndices[i + 2]].Position;
+                    const glm::vec3 samples[4] = { (a + b + c) / 3.0f, (a + b) * 0.5f, (b + c) * 0.5f, (a + c) * 0.5f };
+                    for (const glm::vec3& sample : samples)
+                        deviation = std::max(deviation, std::fabs(1.0 - glm::length(sample)) / extent);
+                }
+                if (l == 0)
+                    baseDeviation = deviation;
+                bool underestimated = deviation > lods[l].error + baseDeviation * 1.001;
+                intact = intact && !underestimated;
+                std::cout << "  measured " << deviation << (underestimated ? "  ERROR UNDERESTIMATED" : "");
+            }
+            std::cout << std::fixed << (torn ? "  TORN SEAM OR BORDER" : "") << std::endl;
+        }
+    }
+    return intact ? 0 : 1;
+}
+
+struct ClusterScene {
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<glm::mat4> views; // Camera views to cull from
+    std::vector<glm::vec3> cameraPositions;
+};
+
+// Views from eye around a full turn, each pitched down a little
+void addOrbitViews(ClusterScene& scene, const glm::vec3& eye, const glm::vec3& target, int count) {
+    for (int i = 0; i < count; ++i) {
+        float angle = 6.28318531f * i / count;
+        glm::vec3 position = eye, lookAt = target;
+        if (eye == target) {
+            lookAt = eye + glm::vec3(std::cos(angle), -0.2f, std::sin(angle)); // Look around from one spot
+        }
+        else {
+            glm::vec3 offset = eye - target;
+            float radius = glm::length(glm::vec3(offset.x, 0.0f, offset.z));
+            position = target + glm::vec3(std::cos(angle) * radius, offset.y, std::sin(angle) * radius); // Circle the target
+        }
+        scene.views.push_back(glm::lookAt(position, lookAt, glm::vec3(0.0f, 1.0f, 0.0f)));
+        scene.cameraPositions.push_back(position);
+    }
+}
+
+// cluster [model path]: meshlet build time and per-view frustum and backface cone culling on a
+// hilly terrain seen from the ground and a sphere seen from outside, or orbiting a model. Every
+// culled meshlet is checked against its triangles.
+int benchmarkClusters(const std::vector<std::string>& args) {
+    const int viewCount = 16;
+    std::vector<ClusterScene> scenes;
+    if (!args.empty()) {
+        ModelData model;
+        if (!ModelLoader::importModel(args[0], model)) {
+            std::cerr << "Failed to import benchmark model: " << args[0] << std::endl;
+            return 1;
+        }
+        for (MeshData& mesh : model.meshes) {
+            ClusterScene scene;
+            scene.name = args[0];
+            scene.vertices = std::move(mesh.vertexStorage);
+            scene.indices = std::move(mesh.indexStorage);
+            if (scene.vertices.empty())
+                continue;
+            glm::vec3 lo = scene.vertices[0].Position, hi = lo;
+            for (const Vertex& vertex : scene.vertices) {
+                lo = glm::min(lo, vertex.Position);
+                hi = glm::max(hi, vertex.Position);
+            }
+            glm::vec3 center = (lo + hi) * 0.5f;
+            float radius = glm::length(hi - lo) * 0.5f;
+            addOrbitViews(scene, center + glm::vec3(radius * 1.5f, radius * 0.5f, 0.0f), center, viewCount);
+            scenes.push_back(std::move(scene));
+        }
+    }
+    else {
+        ClusterScene terrain;
+        terrain.name = "terrain 512x512";
+        const int size = 512;
+        const float spacing = 2.0f;
+        for (int z = 0; z <= size; ++z) {
+            for (int x = 0; x <= size; ++x) {
+                Vertex vertex;
+                float wx = x * spacing, wz = z * spacing;
+                vertex.Position = glm::vec3(wx, 40.0f * std::sin(wx * 0.02f) * std::cos(wz * 0.015f) + 15.0f * std::sin(wx * 0.07f + wz * 0.05f), wz);
+                vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+                vertex.TexCoords = glm::vec2(x * 0.25f, z * 0.25f);
+                vertex.LightMapTexCoords = glm::vec2(static_cast<float>(x) / size, static_cast<float>(z) / size);
+                terrain.vertices.push_back(vertex);
+            }
+        }
+        for (int z = 0; z < size; ++z) {
+            for (int x = 0; x < size; ++x) {
+                unsigned int a = z * (size + 1) + x, b = a + size + 1;
+                unsigned int quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+                terrain.indices.insert(terrain.indices.end(), quad, quad + 6);
+            }
+        }
+        glm::vec3 eye(size * spacing * 0.5f, 60.0f, size * spacing * 0.5f);
+        addOrbitViews(terrain, eye, eye, viewCount);
+        scenes.push_back(std::move(terrain));
+
+        ClusterScene sphere;
+        sphere.name = "seamed unit sphere";
+        seamedSphere(sphere.vertices, sphere.indices);
+        addOrbitViews(sphere, glm::vec3(3.0f, 1.0f, 0.0f), glm::vec3(0.0f), viewCount);
+        scenes.push_back(std::move(sphere));
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 5000.0f);
+    bool conservative = true;
+    for (ClusterScene& scene : scenes) {
+        if (scene.indices.size() % 3 != 0)
+            continue;
+        optimizeMesh(scene.vertices, scene.indices);
+
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        std::vector<Meshlet> meshlets = buildMeshlets(scene.vertices.data(), scene.vertices.size(), scene.indices.data(), 0, scene.indices.size());
+        double buildSeconds = secondsSince(start);
+
+        size_t triangles = scene.indices.size() / 3;
+        std::cout << "Cluster culling, " << scene.name << ": " << triangles << " triangles, " << meshlets.size() << " meshlets of "
+                  << std::fixed << std::setprecision(1) << static_cast<double>(triangles) / std::max<size_t>(meshlets.size(), 1)
+                  << " triangles on average, built in " << buildSeconds * 1000.0 << " ms" << std::endl;
+
+        ClusterCullStats total;
+        size_t drawnIndices = 0;
+        double cullSeconds = 0.0;
+        std::vector<IndexRange> ranges;
+        for (size_t v = 0; v < scene.views.size(); ++v) {
+            Frustum frustum = extractFrustum(projection * scene.views[v]);
+            const glm::vec3& camera = scene.cameraPositions[v];
+            ranges.clear();
+            start = BenchmarkClock::now();
+            cullMeshlets(meshlets.data(), meshlets.size(), frustum, camera, ranges, total);
+            cullSeconds += secondsSince(start);
+            for (const IndexRange& range : ranges)
+                drawnIndices += range.count;
+
+            // Ground truth: every triangle of a frustum-culled meshlet lies behind one plane, and every
+            // triangle of a backface-culled one faces away from the camera
+            for (const Meshlet& meshlet : meshlets) {
+                bool inFrustum = intersectsSphere(frustum, meshlet.center, meshlet.radius);
+                bool backfacing = backfaceCulled(meshlet, camera);
+                if (inFrustum && !backfacing)
+                    continue;
+                for (uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; i += 3) {
+                    const glm::vec3& p0 = scene.vertices[scene.indices[i]].Position;
+                    const glm::vec3& p1 = scene.vertices[scene.indices[i + 1]].Position;
+                    const glm::vec3& p2 = scene.vertices[scene.indices[i + 2]].Position;
+                    if (!inFrustum) {
+                        bool outside = false;
+                        for (const glm::vec4& plane : frustum.planes) {
+                            glm::vec3 normal(plane);
+                            outside = outside || (glm::dot(normal, p0) + plane.w < 0.0f && glm::dot(normal, p1) + plane.w < 0.0f
+                                && glm::dot(normal, p2) + plane.w < 0.0f);
+                        }
+                        conservative = conservative && outside;
+                    }
+                    else {
+                        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                        conservative = conservative && glm::dot(p0 - camera, normal) >= -1e-4f * glm::length(normal) * glm::length(p0 - camera);
+                    }
+                }
+            }
+        }
+
+        double views = static_cast<double>(scene.views.size());
+        std::cout << "  per view: " << std::setprecision(1)
+                  << 100.0 * total.frustumCulled / total.tested << "% frustum culled, "
+                  << 100.0 * total.backfaceCulled / total.tested << "% backface culled, "
+                  << total.ranges / views << " draw ranges, "
+                  << 100.0 * drawnIndices / (scene.indices.size() * views) << "% of triangles drawn, "
+                  << std::setprecision(2) << cullSeconds / views * 1.0e6 << " us" << std::endl;
+    }
+
+    if (!conservative)
+        std::cout << "  MISMATCH: a culled meshlet had a visible triangle" << std::endl;
+    return conservative ? 0 : 1;
+}
+
+// bvh [object count]: BVH build and per-frame frustum culling against a brute-force box test, for
+// 10K, 100K and 1M random boxes unless a count is given. Results must match the brute force.
+int benchmarkBvh(const std::vector<std::string>& args) {
+    std::vector<size_t> counts = { 10000, 100000, 1000000 };
+    if (!args.empty()) {
+        counts.assign(1, static_cast<size_t>(std::atol(args[0].c_str())));
+        if (counts[0] == 0) {
+            std::cerr << "Invalid object count: " << args[0] << std::endl;
+            return 1;
+        }
+    }
+
+    unsigned int seed = 12345;
+    auto random = [&seed](float lo, float hi) {
+        seed = seed * 1103515245u + 12345u;
+        return lo + (hi - lo) * static_cast<float>((seed >> 8) & 0xFFFFFF) / 16777215.0f;
+    };
+
+    const int viewCount = 64;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    bool identical = true;
+    for (size_t count : counts) {
+        // Boxes of 1 to 20 units at a constant density, so the visible count grows with the world
+        float worldSize = 4000.0f * std::cbrt(static_cast<float>(count) / 1000000.0f);
+        std::vector<AABB> bounds(count);
+        for (AABB& box : bounds) {
+            glm::vec3 center(random(0.0f, worldSize), random(0.0f, worldSize), random(0.0f, worldSize));
+            glm::vec3 extent(random(0.5f, 10.0f), random(0.5f, 10.0f), random(0.5f, 10.0f));
+            box.min = center - extent;
+            box.max = center + extent;
+        }
+
+        SceneBvh bvh;
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        bvh.build(bounds);
+        double buildSeconds = secondsSince(start);
+
+        BvhCullStats stats;
+        double bvhSeconds = 0.0, bruteSeconds = 0.0;
+        std::vector<uint32_t> visible, expected;
+        for (int v = 0; v < viewCount; ++v) {
+            glm::vec3 eye(random(0.0f, worldSize), random(0.0f, worldSize), random(0.0f, worldSize));
+            glm::vec3 direction(random(-1.0f, 1.0f), random(-0.5f, 0.5f), random(-1.0f, 1.0f));
+            Frustum frustum = extractFrustum(projection * glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+            visible.clear();
+            start = BenchmarkClock::now();
+            bvh.cull(frustum, visible, stats);
+            bvhSeconds += secondsSince(start);
+
+            expected.clear();
+            start = BenchmarkClock::now();
+            for (size_t i = 0; i < count; ++i) {
+                if (intersectsBox(frustum, bounds[i]))
+                    expected.push_back(static_cast<uint32_t>(i));
+            }
+            bruteSeconds += secondsSince(start);
+
+            std::sort(visible.begin(), visible.end());
+            identical = identical && visible == expected;
+        }
+
+        std::cout << "BVH culling, " << count << " objects: " << bvh.nodeCount() << " nodes built in "
+                  << std::fixed << std::setprecision(1) << buildSeconds * 1000.0 << " ms" << std::endl
+                  << "  per frame: " << static_cast<double>(stats.visible) / viewCount << " visible, "
+                  << static_cast<double>(stats.culled) / viewCount << " culled, "
+                  << static_cast<double>(stats.nodesTested) / viewCount << " nodes tested" << std::endl
+                  << std::setprecision(3)
+                  << "  bvh    " << bvhSeconds / viewCount * 1000.0 << " ms" << std::endl
+                  << "  brute  " << bruteSeconds / viewCount * 1000.0 << " ms"
+                  << std::setprecision(1) << "  (" << bruteSeconds / bvhSeconds << "x)" << std::endl;
+    }
+
+    if (!identical)
+        std::cout << "  MISMATCH: the BVH and the brute-force test disagree" << std::endl;
+    return identical ? 0 : 1;
+}
+
+// Where the ray enters the box, 0 if it starts inside; false if it misses
+bool rayEntersBox(const glm::vec3& origin, const glm::vec3& direction, const AABB& box, float& entry) {
+    float nearest = 0.0f, farthest = FLT_MAX;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (direction[axis] == 0.0f) {
+            if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis])
+                return false;
+            continue;
+        }
+        float t0 = (box.min[axis] - origin[axis]) / direction[axis];
+        float t1 = (box.max[axis] - origin[axis]) / direction[axis];
+        nearest = std::max(nearest, std::min(t0, t1));
+        farthest = std::min(farthest, std::max(t0, t1));
+    }
+    entry = nearest;
+    return nearest <= farthest;
+}
+
+// occlusion [views]: masked occlusion buffer on a city block of box buildings over a ground
+// plane, with small boxes in the streets. The occluders are rasterized and the boxes tested every
+// view, then checked against ray-cast visibility at every pixel center: no truly visible box may
+// be culled.
+int benchmarkOcclusion(const std::vector<std::string>& args) {
+    int viewCount = args.empty() ? 16 : std::atoi(args[0].c_str());
+    if (viewCount <= 0) {
+        std::cerr << "Invalid view count: " << args[0] << std::endl;
+        return 1;
+    }
+
+    unsigned int seed = 2024;
+    auto random = [&seed](float lo, float hi) {
+        seed = seed * 1103515245u + 12345u;
+        return lo + (hi - lo) * static_cast<float>((seed >> 8) & 0xFFFFFF) / 16777215.0f;
+    };
+
+    // 24x24 buildings with 4 unit streets between them; both the occluder meshes and the ray
+    // caster use their boxes
+    const int blocks = 24;
+    const float pitch = 12.0f, street = 4.0f, ground = blocks * pitch;
+    std::vector<AABB> buildings;
+    for (int z = 0; z < blocks; ++z) {
+        for (int x = 0; x < blocks; ++x) {
+            glm::vec3 corner(x * pitch + street, 0.0f, z * pitch + street);
+            AABB building = { corner, corner + glm::vec3(pitch - street, random(4.0f, 30.0f), pitch - street) };
+            buildings.push_back(building);
+        }
+    }
+    std::vector<OccluderMesh> occluders;
+    for (const AABB& building : buildings) {
+        OccluderMesh mesh;
+        for (int corner = 0; corner < 8; ++corner)
+            mesh.positions.push_back(glm::vec3((corner & 1) ? building.max.x : building.min.x, (corner & 2) ? building.max.y : building.min.y, (corner & 4) ? building.max.z : building.min.z));
+        const uint32_t faces[6][4] = { { 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 } };
+        for (const uint32_t* face : faces) {
+            uint32_t quad[6] = { face[0], face[1], face[2], face[0], face[2], face[3] };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+        occluders.push_back(mesh);
+    }
+    OccluderMesh groundMesh;
+    groundMesh.positions = { glm::vec3(-ground, 0.0f, -ground), glm::vec3(2.0f * ground, 0.0f, -ground),
+                             glm::vec3(2.0f * ground, 0.0f, 2.0f * ground), glm::vec3(-ground, 0.0f, 2.0f * ground) };
+    groundMesh.indices = { 0, 1, 2, 0, 2, 3 };
+
+    // Small boxes anywhere on the ground, some inside buildings
+    std::vector<AABB> objects(20000);
+    for (AABB& object : objects) {
+        glm::vec3 base(random(0.0f, ground), random(0.0f, 2.0f), random(0.0f, ground));
+        object.min = base;
+        object.max = base + glm::vec3(random(0.2f, 2.0f), random(0.2f, 2.0f), random(0.2f, 2.0f));
+    }
+
+    OcclusionBuffer buffer(320, 180);
+    const int width = buffer.width(), height = buffer.height();
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), static_cast<float>(width) / height, 0.1f, 500.0f);
+    OcclusionStats stats;
+    size_t inFrustum = 0, hidden = 0, falseCulls = 0;
+    std::vector<float> occluderDistance(static_cast<size_t>(width) * height);
+    std::vector<uint32_t> candidates;
+    std::vector<char> culled(objects.size());
+    for (int v = 0; v < viewCount; ++v) {
+        // Eye height in a street, looking along it or across a crossing
+        glm::vec3 eye(std::floor(random(1.0f, static_cast<float>(blocks))) * pitch + street * 0.5f, 1.7f, random(0.0f, ground));
+        if (v & 1)
+            eye = glm::vec3(random(0.0f, ground), 1.7f, std::floor(random(1.0f, static_cast<float>(blocks))) * pitch + street * 0.5f);
+        float angle = random(0.0f, 6.2831853f);
+        glm::vec3 forward(std::cos(angle), random(-0.1f, 0.1f), std::sin(angle));
+        glm::mat4 viewProjection = projection * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum = extractFrustum(viewProjection);
+
+        candidates.clear();
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (intersectsBox(frustum, objects[i]))
+                candidates.push_back(static_cast<uint32_t>(i));
+        }
+        inFrustum += candidates.size();
+
+        buffer.clear();
+        buffer.addOccluder(groundMesh, viewProjection);
+        for (size_t i = 0; i < occluders.size(); ++i) {
+            if (intersectsBox(frustum, buildings[i]))
+                buffer.addOccluder(occluders[i], viewProjection);
+        }
+        buffer.rasterize(stats);
+        std::vector<uint32_t> visible = candidates;
+        buffer.removeOccluded(objects, viewProjection, visible, stats);
+        for (uint32_t index : candidates)
+            culled[index] = 1;
+        for (uint32_t index : visible)
+            culled[index] = 0;
+
+        // Ground truth: the nearest occluder along the ray through every pixel center
+        glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+        auto rayDirection = [&](int x, int y) {
+            glm::vec4 far = inverseViewProjection * glm::vec4((x + 0.5f) / width * 2.0f - 1.0f, (y + 0.5f) / height * 2.0f - 1.0f, 1.0f, 1.0f);
+            return glm::vec3(far) / far.w - eye;
+        };
+        JobSystem::shared().parallelFor(static_cast<unsigned int>(height), [&](unsigned int y) {
+            for (int x = 0; x < width; ++x) {
+                glm::vec3 direction = rayDirection(x, static_cast<int>(y));
+                float nearest = FLT_MAX, entry;
+                if (direction.y < 0.0f)
+                    nearest = -eye.y / direction.y;
+                for (const AABB& building : buildings) {
+                    if (rayEntersBox(eye, direction, building, entry))
+                        nearest = std::min(nearest, entry);
+                }
+                occluderDistance[y * width + x] = nearest;
+            }
+        });
+
+        // A box is visible if some pixel center's ray reaches it before any occluder
+        for (uint32_t index : candidates) {
+            const AABB& object = objects[index];
+            float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+            bool behind = false;
+            for (int corner = 0; corner < 8; ++corner) {
+                glm::vec4 clip = viewProjection * glm::vec4((corner & 1) ? object.max.x : object.min.x, (corner & 2) ? object.max.y : object.min.y, (corner & 4) ? object.max.z : object.min.z, 1.0f);
+                if (clip.w < 1e-5f) {
+                    behind = true;
+                    break;
+                }
+                minX = std::min(minX, (clip.x / clip.w * 0.5f + 0.5f) * width);
+                maxX = std::max(maxX, (clip.x / clip.w * 0.5f + 0.5f) * width);
+                minY = std::min(minY, (clip.y / clip.w * 0.5f + 0.5f) * height);
+                maxY = std::max(maxY, (clip.y / clip.w * 0.5f + 0.5f) * height);
+            }
+            bool seen = behind;
+            int left = static_cast<int>(std::floor(std::max(minX, 0.0f))), right = static_cast<int>(std::floor(std::min(maxX, width - 1.0f)));
+            int bottom = static_cast<int>(std::floor(std::max(minY, 0.0f))), top = static_cast<int>(std::floor(std::min(maxY, height - 1.0f)));
+            for (int y = bottom; !seen && y <= top; ++y) {
+                for (int x = left; !seen && x <= right; ++x) {
+                    float entry;
+                    seen = rayEntersBox(eye, rayDirection(x, y), object, entry) && entry < occluderDistance[y * width + x];
+                }
+            }
+            if (!seen)
+                ++hidden;
+            else if (culled[index])
+                ++falseCulls;
+        }
+    }
+
+    std::cout << "Occlusion buffer " << width << "x" << height << ", " << buildings.size() << " buildings, "
+              << objects.size() << " boxes, " << viewCount << " street views" << std::endl
+              << std::fixed << std::setprecision(1)
+              << "  per view: " << static_cast<double>(stats.occluderTriangles) / viewCount << " occluder triangles, "
+              << static_cast<double>(inFrustum) / viewCount << " boxes in the frustum" << std::endl
+              << "  culled " << static_cast<double>(stats.occluded) / viewCount << ", truly hidden "
+              << static_cast<double>(hidden) / viewCount << " ("
+              << (hidden > 0 ? 100.0 * stats.occluded / hidden : 100.0) << "% found), "
+              << falseCulls << " visible boxes culled" << std::endl
+              << std::setprecision(3)
+              << "  rasterize " << stats.rasterizeMilliseconds / viewCount << " ms, test "
+              << stats.testMilliseconds / viewCount << " ms per view on " << JobSystem::shared().size() << " threads" << std::endl;
+
+    if (falseCulls > 0)
+        std::cout << "  FAILED: the occlusion buffer culled visible boxes" << std::endl;
+    return falseCulls > 0 ? 1 : 0;
+}
+
+// queue [draws]: state changes of a frame's draws in submission order against the sorted
+// render queue, and the radix sort against std::sort. Meshes are drawn four times each and share
+// 64 materials of 1-3 textures over 4 programs, submitted in random order.
+int benchmarkRenderQueue(const std::vector<std::string>& args) {
+    size_t packetCount = args.empty() ? 20000 : static_cast<size_t>(std::atol(args[0].c_str()));
+    if (packetCount == 0) {
+        std::cerr << "Invalid packet count: " << args[0] << std::endl;
+        return 1;
+    }
+
+    unsigned int seed = 7;
+    auto random = [&seed](unsigned int count) {
+        seed = seed * 1103515245u + 12345u;
+        return ((seed >> 8) & 0xFFFFFF) % count;
+    };
+
+    struct Material {
+        GLuint program;
+        std::vector<TextureBinding> textures;
+    };
+    std::vector<Material> materials(64);
+    for (Material& material : materials) {
+        material.program = 1 + random(4);
+        unsigned int textureCount = 1 + random(3);
+        for (unsigned int t = 0; t < textureCount; ++t) {
+            TextureBinding binding;
+            binding.texture = 1 + random(200);
+            binding.sampler.location = static_cast<GLint>(t);
+            material.textures.push_back(binding);
+        }
+    }
+    size_t meshCount = std::max<size_t>(1, packetCount / 4);
+    std::vector<unsigned int> meshMaterials(meshCount);
+    for (unsigned int& material : meshMaterials)
+        material = random(static_cast<unsigned int>(materials.size()));
+
+    // Submission order is shuffled, as from a spatial structure
+    std::vector<uint32_t> meshOrder(packetCount);
+    for (size_t i = 0; i < packetCount; ++i)
+        meshOrder[i] = static_cast<uint32_t>(i % meshCount);
+    for (size_t i = packetCount; i > 1; --i)
+        std::swap(meshOrder[i - 1], meshOrder[random(static_cast<unsigned int>(i))]);
+
+    RenderQueue queue;
+    queue.reserve(packetCount, packetCount * 3);
+    size_t textureBindings = 0;
+    for (uint32_t mesh : meshOrder) {
+        const Material& material = materials[meshMaterials[mesh]];
+        DrawPacket packet = {};
+        packet.program = material.program;
+        packet.vertexArray = 1 + mesh;
+        packet.indexType = GL_UNSIGNED_SHORT;
+        packet.count = 3;
+        queue.submit(packet, material.textures.data(), material.textures.size(), static_cast<float>(random(100000)) * 0.01f);
+        textureBindings += material.textures.size();
+    }
+
+    RenderQueueStats submitted;
+    queue.simulate(submitted);
+
+    // The same keys through std::sort, for timing and as the reference order
+    std::vector<uint64_t> keys(queue.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        keys[i] = queue.key(i);
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    std::sort(keys.begin(), keys.end());
+    double stdSortSeconds = secondsSince(start);
+
+    start = BenchmarkClock::now();
+    queue.sort();
+    double radixSeconds = secondsSince(start);
+    RenderQueueStats sorted;
+    queue.simulate(sorted);
+
+    bool ordered = true;
+    for (size_t i = 0; i < keys.size(); ++i)
+        ordered = ordered && queue.key(i) == keys[i];
+
+    std::cout << "Render queue, " << packetCount << " draws of " << meshCount << " meshes, " << materials.size() << " materials" << std::endl
+              << "  per-draw binds        " << packetCount << " programs, " << textureBindings << " textures, " << packetCount << " vertex arrays" << std::endl
+              << "  submission order      " << submitted.programChanges << " programs, " << submitted.textureChanges << " textures, "
+              << submitted.samplerChanges << " samplers, " << submitted.vertexArrayChanges << " vertex arrays" << std::endl
+              << "  sorted                " << sorted.programChanges << " programs, " << sorted.textureChanges << " textures, "
+              << sorted.samplerChanges << " samplers, " << sorted.vertexArrayChanges << " vertex arrays" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "  radix sort " << radixSeconds * 1000.0 << " ms, std::sort " << stdSortSeconds * 1000.0 << " ms" << std::endl;
+
+    if (!ordered)
+        std::cout << "  FAILED: the radix sort order differs from std::sort" << std::endl;
+    return ordered ? 0 : 1;
+}
+
+// Hidden window with a GL 4.3 core context for the benchmarks that need the GPU; null on failure
+GLFWwindow* createBenchmarkContext() {
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return nullptr;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "Benchmark", NULL, NULL);
+    if (!window) {
+        std::cerr << "Failed to create a GL 4.3 context" << std::endl;
+        glfwTerminate();
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return nullptr;
+    }
+    return window;
+}
+
+void destroyBenchmarkContext(GLFWwindow* window) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
+
+// Color and depth attachments to render a benchmark frame into
+struct BenchmarkTarget {
+    GLuint framebuffer = 0, color = 0, depth = 0;
+    int width = 0, height = 0;
+
+    void create(int targetWidth, int targetHeight) {
+        width = targetWidth;
+        height = targetHeight;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &color);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        glViewport(0, 0, width, height);
+    }
+
+    std::vector<unsigned char> read() const {
+        std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        return pixels;
+    }
+
+    void release() {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depth);
+    }
+};
+
+// Per-mesh and indirect shaders of the arena benchmark: the same shading, with the model matrix
+// from a uniform or from the draw's DrawData
+const char* const ARENA_FRAGMENT_SHADER = R"(#version 430 core
+in vec3 worldNormal;
+out vec4 fragColor;
+uniform sampler2D diffuse;
+void main() {
+    fragColor = vec4(texture(diffuse, vec2(0.5)).rgb * (0.5 + 0.5 * normalize(worldNormal).y), 1.0);
+}
+)";
+
+const char* const ARENA_UNIFORM_VERTEX_SHADER = R"(#version 430 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+uniform mat4 viewProjection;
+uniform mat4 model;
+out vec3 worldNormal;
+void main() {
+    worldNormal = mat3(model) * normal;
+    gl_Position = viewProjection * (model * vec4(position, 1.0));
+}
+)";
+
+const char* const ARENA_INDIRECT_VERTEX_SHADER = R"(#version 430 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 4) in uint drawId;
+struct DrawData { mat4 model; uint material; };
+layout(std430, binding = 1) readonly buffer DrawDataBuffer { DrawData draws[]; };
+uniform mat4 viewProjection;
+out vec3 worldNormal;
+void main() {
+    mat4 model = draws[drawId].model;
+    worldNormal = mat3(model) * normal;
+    gl_Position = viewProjection * (model * vec4(position, 1.0));
+}
+)";
+
+// Grid of n x n quads with a bump, n from 1 to 12 so the arena allocations vary in size
+void bumpTile(unsigned int n, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    for (unsigned int j = 0; j <= n; ++j) {
+        for (unsigned int i = 0; i <= n; ++i) {
+            float u = static_cast<float>(i) / n, v = static_cast<float>(j) / n;
+            float height = 0.3f * std::sin(u * 3.14159265f) * std::sin(v * 3.14159265f);
+            glm::vec3 normal(-0.3f * 3.14159265f * std::cos(u * 3.14159265f) * std::sin(v * 3.14159265f), 1.0f,
+                             -0.3f * 3.14159265f * std::sin(u * 3.14159265f) * std::cos(v * 3.14159265f));
+            Vertex vertex;
+            vertex.Position = glm::vec3(u - 0.5f, height, v - 0.5f);
+            vertex.Normal = glm::normalize(normal);
+            vertex.TexCoords = glm::vec2(u, v);
+            vertex.LightMapTexCoords = glm::vec2(u, v);
+            vertices.push_back(vertex);
+        }
+    }
+    for (unsigned int j = 0; j < n; ++j) {
+        for (unsigned int i = 0; i < n; ++i) {
+            unsigned int a = j * (n + 1) + i, b = a + n + 1;
+            unsigned int quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+// arena [mesh count]: a grid of meshes drawn one glDrawElements per mesh from separate buffers,
+// with glDrawElementsBaseVertex from the shared arena, and with one glMultiDrawElementsIndirect
+// per material. All three images must match. Half the meshes are then freed and reloaded to
+// check that the allocator reuses their space.
+int benchmarkArena(const std::vector<std::string>& args) {
+    size_t meshCount = args.empty() ? 4096 : static_cast<size_t>(std::atol(args[0].c_str()));
+    if (meshCount == 0) {
+        std::cerr << "Invalid mesh count: " << args[0] << std::endl;
+        return 1;
+    }
+    const int materialCount = 8, frames = 10;
+
+    GLFWwindow* window = createBenchmarkContext();
+    if (!window)
+        return 1;
+    if (!GeometryArena::isSupported()) {
+        std::cerr << "Multi-draw indirect and shader storage buffers are not supported" << std::endl;
+        destroyBenchmarkContext(window);
+        return 1;
+    }
+
+    // Meshes of random size on a square grid, each with a random turn and material
+    unsigned int seed = 12345;
+    auto random = [&seed](unsigned int range) {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 8) % range;
+    };
+    size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(meshCount))));
+    std::vector<std::vector<Vertex>> meshVertices(meshCount);
+    std::vector<std::vector<unsigned int>> meshIndices(meshCount);
+    std::vector<GeometryArrays> arrays(meshCount);
+    std::vector<glm::mat4> models(meshCount);
+    std::vector<uint32_t> materials(meshCount);
+    size_t vertexTotal = 0, indexTotal = 0;
+    for (size_t i = 0; i < meshCount; ++i) {
+        bumpTile(1 + random(12), meshVertices[i], meshIndices[i]);
+        GeometryArrays meshArrays = { meshVertices[i].data(), meshVertices[i].size(), meshIndices[i].data(), meshIndices[i].size(), nullptr, 0, nullptr, 0 };
+        arrays[i] = meshArrays;
+        glm::vec3 position(static_cast<float>(i % side) - side * 0.5f, 0.0f, static_cast<float>(i / side) - side * 0.5f);
+        models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), position), glm::radians(static_cast<float>(random(360))), glm::vec3(0.0f, 1.0f, 0.0f));
+        models[i] = glm::scale(models[i], glm::vec3(0.7f));
+        materials[i] = random(materialCount);
+        vertexTotal += meshVertices[i].size();
+        indexTotal += meshIndices[i].size();
+    }
+
+    // One 1x1 texture per material
+    GLuint textures[materialCount];
+    glGenTextures(materialCount, textures);
+    for (int m = 0; m < materialCount; ++m) {
+        unsigned char texel[4] = { static_cast<unsigned char>(60 + 25 * m), static_cast<unsigned char>(255 - 30 * m),
+                                   static_cast<unsigned char>(40 * (m % 4) + 80), 255 };
+        glBindTexture(GL_TEXTURE_2D, textures[m]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    Shader uniformShader = Shader::fromSource(ARENA_UNIFORM_VERTEX_SHADER, ARENA_FRAGMENT_SHADER);
+    Shader indirectShader = Shader::fromSource(ARENA_INDIRECT_VERTEX_SHADER, ARENA_FRAGMENT_SHADER);
+    if (!uniformShader.isSuccessfullyCompiled() || !indirectShader.isSuccessfullyCompiled() || !indirectShader.hasStorageBlock("DrawDataBuffer")) {
+        destroyBenchmarkContext(window);
+        return 1;
+    }
+    UniformHandle uniformModel = uniformShader.uniform("model");
+    float extent = static_cast<float>(side);
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, extent * 4.0f)
+        * glm::lookAt(glm::vec3(0.0f, extent * 0.6f, extent * 0.9f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    uniformShader.use();
+    uniformShader.set(uniformShader.uniform("viewProjection"), viewProjection);
+    uniformShader.set(uniformShader.uniform("diffuse"), 0);
+    indirectShader.use();
+    indirectShader.set(indirectShader.uniform("viewProjection"), viewProjection);
+    indirectShader.set(indirectShader.uniform("diffuse"), 0);
+
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    std::vector<LevelGeometry> separate = LevelGeometry::createBatch(arrays);
+    glFinish();
+    double separateUpload = secondsSince(start);
+
+    // Start small so that the upload exercises growing the buffers
+    GeometryArena arena;
+    arena.create(VertexFormat::Standard, 1024, 4096);
+    start = BenchmarkClock::now();
+    std::vector<LevelGeometry> shared = LevelGeometry::createBatch(arrays, VertexFormat::Standard, &arena);
+    glFinish();
+    double arenaUpload = secondsSince(start);
+
+    BenchmarkTarget target;
+    target.create(512, 512);
+    glEnable(GL_DEPTH_TEST);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Draws every mesh with its own call, binding the material's texture when it changes
+    auto drawEach = [&](std::vector<LevelGeometry>& geometries) {
+        GLuint bound = 0;
+        for (size_t i = 0; i < geometries.size(); ++i) {
+            if (textures[materials[i]] != bound) {
+                bound = textures[materials[i]];
+                glBindTexture(GL_TEXTURE_2D, bound);
+            }
+            uniformShader.use();
+            uniformShader.set(uniformModel, models[i]);
+            geometries[i].Draw(uniformShader);
+        }
+    };
+    std::function<void(uint32_t)> bindMaterial = [&](uint32_t material) {
+        glBindTexture(GL_TEXTURE_2D, textures[material]);
+    };
+    ArenaDrawStats indirectStats;
+    StreamBuffer stream;
+    stream.create(meshCount * 128);
+    auto drawIndirect = [&]() {
+        stream.beginFrame();
+        indirectShader.use();
+        arena.clearDraws();
+        for (size_t i = 0; i < shared.size(); ++i)
+            shared[i].addIndirectDraws(models[i], materials[i]);
+        arena.flush(stream, bindMaterial, indirectStats);
+        stream.endFrame();
+    };
+
+    // Frame time in milliseconds over several frames, after one warm-up frame; the image of the last
+    std::vector<unsigned char> image;
+    auto timeFrames = [&](const std::function<void()>& draw) {
+        double seconds = 0.0;
+        for (int frame = 0; frame <= frames; ++frame) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glFinish();
+            BenchmarkClock::time_point frameStart = BenchmarkClock::now();
+            draw();
+            glFinish();
+            if (frame > 0)
+                seconds += secondsSince(frameStart);
+        }
+        image = target.read();
+        return seconds * 1000.0 / frames;
+    };
+
+    double separateMilliseconds = timeFrames([&]() { drawEach(separate); });
+    std::vector<unsigned char> separateImage = image;
+    double baseVertexMilliseconds = timeFrames([&]() { drawEach(shared); });
+    std::vector<unsigned char> baseVertexImage = image;
+    double indirectMilliseconds = timeFrames(drawIndirect);
+    std::vector<unsigned char> indirectImage = image;
+    size_t indirectCalls = indirectStats.drawCalls / (frames + 1);
+
+    // Free every other mesh and load them again; with the same sizes in the same order, first fit
+    // puts each back in its own hole
+    uint32_t vertexCapacity = arena.vertexSpace().capacity(), indexCapacity = arena.indexSpace().capacity();
+    uint32_t vertexFree = arena.vertexSpace().freeSize(), indexFree = arena.indexSpace().freeSize();
+    std::vector<GeometryArrays> reloaded;
+    for (size_t i = 0; i < meshCount; i += 2) {
+        shared[i].release();
+        reloaded.push_back(arrays[i]);
+    }
+    size_t holes = arena.vertexSpace().fragmentCount();
+    std::vector<LevelGeometry> reloadedGeometries = LevelGeometry::createBatch(reloaded, VertexFormat::Standard, &arena);
+    for (size_t i = 0; i < reloadedGeometries.size(); ++i)
+        shared[i * 2] = std::move(reloadedGeometries[i]);
+    bool reused = arena.vertexSpace().capacity() == vertexCapacity && arena.indexSpace().capacity() == indexCapacity
+        && arena.vertexSpace().freeSize() == vertexFree && arena.indexSpace().freeSize() == indexFree;
+    timeFrames(drawIndirect);
+    std::vector<unsigned char> reloadedImage = image;
+
+    size_t covered = 0;
+    for (size_t i = 0; i < separateImage.size(); i += 4)
+        covered += separateImage[i + 3] != 0;
+    bool baseVertexMatches = baseVertexImage == separateImage;
+    bool indirectMatches = indirectImage == separateImage;
+    bool reloadedMatches = reloadedImage == separateImage;
+
+    std::cout << "Geometry arena, " << meshCount << " meshes, " << vertexTotal << " vertices, " << indexTotal / 3 << " triangles, "
+              << materialCount << " materials, " << covered * 100 / (separateImage.size() / 4) << "% of pixels covered" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "  upload                separate buffers " << separateUpload * 1000.0 << " ms, arena " << arenaUpload * 1000.0 << " ms" << std::endl
+              << "  separate buffers      " << meshCount << " draw calls, " << separateMilliseconds << " ms per frame" << std::endl
+              << "  arena, base vertex    " << meshCount << " draw calls, " << baseVertexMilliseconds << " ms per frame" << std::endl
+              << "  arena, indirect       " << indirectCalls << " draw calls, " << indirectMilliseconds << " ms per frame" << std::endl
+              << "  allocator             " << arena.vertexSpace().capacity() << " vertices, " << arena.indexSpace().capacity() << " indices, "
+              << holes << " holes after freeing half, " << arena.vertexSpace().fragmentCount() << " free ranges after reloading" << std::endl;
+
+    bool passed = baseVertexMatches && indirectMatches && reloadedMatches && reused && indirectCalls <= static_cast<size_t>(materialCount);
+    if (!baseVertexMatches)
+        std::cout << "  FAILED: the base vertex image differs from separate buffers" << std::endl;
+    if (!indirectMatches)
+        std::cout << "  FAILED: the indirect image differs from separate buffers" << std::endl;
+    if (!reloadedMatches)
+        std::cout << "  FAILED: the image after reloading differs" << std::endl;
+    if (!reused)
+        std::cout << "  FAILED: reloaded meshes did not reuse the freed space" << std::endl;
+
+    for (LevelGeometry& geometry : separate)
+        geometry.release();
+    for (LevelGeometry& geometry : shared)
+        geometry.release();
+    arena.release();
+    stream.release();
+    glDeleteTextures(materialCount, textures);
+    glDeleteProgram(uniformShader.Program);
+    glDeleteProgram(indirectShader.Program);
+    target.release();
+    destroyBenchmarkContext(window);
+    return passed ? 0 : 1;
+}
+
+// stream [object count]: moving objects whose transforms reach the GPU through one
+// glUniformMatrix4fv per object, or through a StreamBuffer feeding indirect draws: persistently
+// mapped with one region and with three, and with glBufferSubData; and with a stream recreated
+// every frame just large enough for the draw data, so that it grows between the draw data and
+// the commands. The last frame's images must match.
+int benchmarkStream(const std::vector<std::string>& args) {
+    size_t objectCount = args.empty() ? 20000 : static_cast<size_t>(std::atol(args[0].c_str()));
+    if (objectCount == 0) {
+        std::cerr << "Invalid object count: " << args[0] << std::endl;
+        return 1;
+    }
+    const int frames = 60;
+
+    GLFWwindow* window = createBenchmarkContext();
+    if (!window)
+        return 1;
+    if (!GeometryArena::isSupported()) {
+        std::cerr << "Multi-draw indirect and shader storage buffers are not supported" << std::endl;
+        destroyBenchmarkContext(window);
+        return 1;
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    bumpTile(1, vertices, indices);
+    GeometryArrays tile = { vertices.data(), vertices.size(), indices.data(), indices.size(), nullptr, 0, nullptr, 0 };
+    GeometryArena arena;
+    arena.create(VertexFormat::Standard, static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(indices.size()));
+    std::vector<LevelGeometry> objects = LevelGeometry::createBatch(std::vector<GeometryArrays>(objectCount, tile), VertexFormat::Standard, &arena);
+
+    GLuint texture;
+    unsigned char texel[4] = { 200, 150, 90, 255 };
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    Shader uniformShader = Shader::fromSource(ARENA_UNIFORM_VERTEX_SHADER, ARENA_FRAGMENT_SHADER);
+    Shader indirectShader = Shader::fromSource(ARENA_INDIRECT_VERTEX_SHADER, ARENA_FRAGMENT_SHADER);
+    if (!uniformShader.isSuccessfullyCompiled() || !indirectShader.isSuccessfullyCompiled()) {
+        destroyBenchmarkContext(window);
+        return 1;
+    }
+    UniformHandle uniformModel = uniformShader.uniform("model");
+    float extent = std::sqrt(static_cast<float>(objectCount));
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, extent * 4.0f)
+        * glm::lookAt(glm::vec3(0.0f, extent, extent * 0.5f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    uniformShader.use();
+    uniformShader.set(uniformShader.uniform("viewProjection"), viewProjection);
+    indirectShader.use();
+    indirectShader.set(indirectShader.uniform("viewProjection"), viewProjection);
+
+    BenchmarkTarget target;
+    target.create(256, 256);
+    glEnable(GL_DEPTH_TEST);
+
+    // Objects orbit the origin at their own radius and speed
+    std::vector<glm::mat4> models(objectCount);
+    auto animate = [&](int frame) {
+        for (size_t i = 0; i < objectCount; ++i) {
+            float radius = extent * 0.5f * static_cast<float>(i + 1) / objectCount;
+            float angle = frame * 0.01f * (1.0f + static_cast<float>(i % 7)) + static_cast<float>(i);
+            models[i] = glm::translate(glm::mat4(1.0f), glm::vec3(std::cos(angle) * radius, 0.0f, std::sin(angle) * radius));
+            models[i] = glm::rotate(models[i], angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+    };
+
+    // CPU milliseconds per frame to animate and submit, with the GPU left to run behind; the image
+    // of the last frame
+    std::vector<unsigned char> image;
+    auto run = [&](const std::function<void()>& draw) {
+        glFinish();
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            animate(frame);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            draw();
+        }
+        double milliseconds = secondsSince(start) * 1000.0 / frames;
+        glFinish();
+        image = target.read();
+        return milliseconds;
+    };
+
+    double uniformMilliseconds = run([&]() {
+        for (size_t i = 0; i < objectCount; ++i) {
+            uniformShader.use();
+            uniformShader.set(uniformModel, models[i]);
+            objects[i].Draw(uniformShader);
+        }
+    });
+    std::vector<unsigned char> reference = image;
+
+    struct Variant {
+        const char* name;
+        int regions;
+        bool persistent;
+        bool grows;
+    };
+    const Variant variants[] = {
+        { "mapped, 1 region ", 1, true, false },
+        { "mapped, 3 regions", 3, true, false },
+        { "glBufferSubData  ", 3, false, false },
+        { "mapped, grows    ", 3, true, true },
+        { "SubData, grows   ", 3, false, true },
+    };
+    std::function<void(uint32_t)> bindMaterial = [](uint32_t) {};
+    bool passed = true;
+
+    std::cout << "Stream buffer, " << objectCount << " moving objects, " << frames << " frames" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "  uniform per object    " << uniformMilliseconds << " ms per frame" << std::endl;
+    for (const Variant& variant : variants) {
+        if (variant.persistent && !StreamBuffer::isPersistentSupported())
+            continue;
+        StreamBuffer stream;
+        size_t frameSize = objectCount * (variant.grows ? sizeof(DrawData) : sizeof(DrawData) + 20);
+        stream.create(frameSize, variant.regions, variant.persistent);
+        ArenaDrawStats drawStats;
+        size_t grows = 0;
+        double milliseconds = run([&]() {
+            if (variant.grows) {
+                grows += stream.stats().grows;
+                stream.release();
+                stream.create(frameSize, variant.regions, variant.persistent);
+            }
+            stream.beginFrame();
+            indirectShader.use();
+            arena.clearDraws();
+            for (size_t i = 0; i < objectCount; ++i)
+                objects[i].addIndirectDraws(models[i], 0);
+            arena.flush(stream, bindMaterial, drawStats);
+            stream.endFrame();
+        });
+        const StreamBufferStats& stats = stream.stats();
+        grows += stats.grows;
+        bool matches = image == reference && (grows == frames) == variant.grows;
+        passed = passed && matches;
+        std::cout << "  " << variant.name << "     " << milliseconds << " ms per frame, " << stats.stalls << " stalls ("
+                  << stats.stallMilliseconds << " ms), " << stats.bytesAllocated / stats.frames << " bytes per frame, "
+                  << stats.paddingBytes / stats.frames << " padding, " << stats.unusedBytes / stats.frames << " unused, "
+                  << grows << " grows" << std::endl;
+        if (!matches)
+            std::cout << "  FAILED: the image differs from per-object uniforms, or the buffer did not grow as expected" << std::endl;
+        stream.release();
+    }
+
+    for (LevelGeometry& object : objects)
+        object.release();
+    arena.release();
+    glDeleteTextures(1, &texture);
+    glDeleteProgram(uniformShader.Program);
+    glDeleteProgram(indirectShader.Program);
+    target.release();
+    destroyBenchmarkContext(window);
+    return passed ? 0 : 1;
+}
+
+// Per-object and instanced shaders of the instancing benchmark: the same shading, with the model
+// matrix and tint from uniforms or from the instance stream. The tint is flat so that both give
+// bit-identical colors.
+const char* const INSTANCE_FRAGMENT_SHADER = R"(#version 330 core
+in vec3 worldNormal;
+flat in vec4 tint;
+out vec4 fragColor;
+void main() {
+    fragColor = vec4(tint.rgb * (0.5 + 0.5 * normalize(worldNormal).y), 1.0);
+}
+)";
+
+const char* const INSTANCE_UNIFORM_VERTEX_SHADER = R"(#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+uniform mat4 viewProjection;
+uniform mat4 model;
+uniform vec4 parameters;
+out vec3 worldNormal;
+flat out vec4 tint;
+void main() {
+    worldNormal = mat3(model) * normal;
+    tint = parameters;
+    gl_Position = viewProjection * (model * vec4(position, 1.0));
+}
+)";
+
+const char* const INSTANCE_VERTEX_SHADER = R"(#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 5) in mat4 instanceModel;
+layout(location = 9) in vec4 instanceParameters;
+uniform mat4 viewProjection;
+out vec3 worldNormal;
+flat out vec4 tint;
+void main() {
+    worldNormal = mat3(instanceModel) * normal;
+    tint = instanceParameters;
+    gl_Position = viewProjection * (instanceModel * vec4(position, 1.0));
+}
+)";
+
+// instancing [instance count]: copies of one mesh scattered over a field, drawn with the
+// per-object loop of the render loop (sphere test, model and tint uniforms, Draw) and with an
+// InstanceBatch (SSE cull and compaction, one instanced draw). Both images must match, and the
+// SSE cull must keep the same instances as the scalar test.
+int benchmarkInstancing(const std::vector<std::string>& args) {
+    size_t instanceCount = args.empty() ? 10000 : static_cast<size_t>(std::atol(args[0].c_str()));
+    if (instanceCount == 0) {
+        std::cerr << "Invalid instance count: " << args[0] << std::endl;
+        return 1;
+    }
+    const int frames = 30;
+
+    GLFWwindow* window = createBenchmarkContext();
+    if (!window)
+        return 1;
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    bumpTile(4, vertices, indices);
+    std::vector<LevelGeometry> meshes = LevelGeometry::createBatch(std::vector<GeometryArrays>(1, GeometryArrays{
+        vertices.data(), vertices.size(), indices.data(), indices.size(), nullptr, 0, nullptr, 0 }));
+    LevelGeometry& mesh = meshes[0];
+
+    // A jittered grid, so no two instances overlap and the draw order cannot change the image
+    unsigned int seed = 12345;
+    auto random = [&seed](float lo, float hi) {
+        seed = seed * 1103515245u + 12345u;
+        return lo + (hi - lo) * static_cast<float>((seed >> 8) & 0xFFFFFF) / 16777215.0f;
+    };
+    size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(instanceCount))));
+    std::vector<InstanceData> instances(instanceCount);
+    for (size_t i = 0; i < instanceCount; ++i) {
+        glm::vec3 position(static_cast<float>(i % side) * 2.0f - side + random(-0.3f, 0.3f), 0.0f,
+                           static_cast<float>(i / side) * 2.0f - side + random(-0.3f, 0.3f));
+        instances[i].model = glm::rotate(glm::translate(glm::mat4(1.0f), position), random(0.0f, 6.2831853f), glm::vec3(0.0f, 1.0f, 0.0f));
+        instances[i].model = glm::scale(instances[i].model, glm::vec3(random(0.6f, 1.2f)));
+        instances[i].parameters = glm::vec4(random(0.2f, 1.0f), random(0.2f, 1.0f), random(0.2f, 1.0f), 1.0f);
+    }
+
+    Shader uniformShader = Shader::fromSource(INSTANCE_UNIFORM_VERTEX_SHADER, INSTANCE_FRAGMENT_SHADER);
+    Shader instanceShader = Shader::fromSource(INSTANCE_VERTEX_SHADER, INSTANCE_FRAGMENT_SHADER);
+    if (!uniformShader.isSuccessfullyCompiled() || !instanceShader.isSuccessfullyCompiled()) {
+        destroyBenchmarkContext(window);
+        return 1;
+    }
+    UniformHandle uniformModel = uniformShader.uniform("model");
+    UniformHandle uniformParameters = uniformShader.uniform("parameters");
+
+    // From inside the field looking across it, so about half the instances are culled
+    float extent = static_cast<float>(side);
+    glm::vec3 eye(0.0f, extent * 0.15f, extent * 0.5f);
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, extent * 3.0f)
+        * glm::lookAt(eye, glm::vec3(0.0f, 0.0f, -extent * 0.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = extractFrustum(viewProjection);
+    uniformShader.use();
+    uniformShader.set(uniformShader.uniform("viewProjection"), viewProjection);
+    instanceShader.use();
+    instanceShader.set(instanceShader.uniform("viewProjection"), viewProjection);
+
+    BenchmarkTarget target;
+    target.create(512, 512);
+    glEnable(GL_DEPTH_TEST);
+
+    // CPU milliseconds per frame with the GPU left to run behind, and the last frame's image
+    std::vector<unsigned char> image;
+    auto run = [&](const std::function<void()>& draw) {
+        glFinish();
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            draw();
+        }
+        double milliseconds = secondsSince(start) * 1000.0 / frames;
+        glFinish();
+        image = target.read();
+        return milliseconds;
+    };
+
+    size_t loopDraws = 0;
+    double loopMilliseconds = run([&]() {
+        loopDraws = 0;
+        for (const InstanceData& instance : instances) {
+            glm::vec3 center = glm::vec3(instance.model * glm::vec4(mesh.sphereCenter(), 1.0f));
+            float scale = glm::length(glm::vec3(instance.model[0]));
+            if (!intersectsSphere(frustum, center, mesh.sphereRadius() * scale))
+                continue;
+            uniformShader.use();
+            uniformShader.set(uniformModel, instance.model * mesh.positionTransform());
+            uniformShader.set(uniformParameters, instance.parameters);
+            mesh.Draw(uniformShader);
+            ++loopDraws;
+        }
+    });
+    std::vector<unsigned char> loopImage = image;
+
+    StreamBuffer stream;
+    stream.create(instanceCount * sizeof(InstanceData));
+    InstanceBatch batch;
+    batch.create(mesh);
+    InstanceCullStats cullStats;
+    double instancedMilliseconds = run([&]() {
+        stream.beginFrame();
+        batch.update(stream, instances.data(), instances.size(), frustum, cullStats);
+        instanceShader.use();
+        batch.draw(instanceShader);
+        stream.endFrame();
+    });
+    std::vector<unsigned char> instancedImage = image;
+
+    // The culling alone: SSE against one scalar sphere test per instance
+    std::vector<uint32_t> visible(instanceCount), scalarVisible;
+    const int cullRepeats = 100;
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    size_t visibleCount = 0;
+    for (int repeat = 0; repeat < cullRepeats; ++repeat)
+        visibleCount = cullInstances(instances.data(), instances.size(), mesh.sphereCenter(), mesh.sphereRadius(), frustum, visible.data());
+    double simdCullSeconds = secondsSince(start) / cullRepeats;
+    start = BenchmarkClock::now();
+    for (int repeat = 0; repeat < cullRepeats; ++repeat) {
+        scalarVisible.clear();
+        for (size_t i = 0; i < instanceCount; ++i) {
+            const glm::mat4& model = instances[i].model;
+            float scale = std::sqrt(std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                                             std::max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])), glm::dot(glm::vec3(model[2]), glm::vec3(model[2])))));
+            if (intersectsSphere(frustum, glm::vec3(model * glm::vec4(mesh.sphereCenter(), 1.0f)), mesh.sphereRadius() * scale))
+                scalarVisible.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    double scalarCullSeconds = secondsSince(start) / cullRepeats;
+
+    bool sameVisible = visibleCount == scalarVisible.size() && std::equal(scalarVisible.begin(), scalarVisible.end(), visible.begin());
+    bool imagesMatch = loopImage == instancedImage;
+
+    std::cout << "Instancing, " << instanceCount << " instances of " << indices.size() / 3 << " triangles, "
+              << batch.instanceCount() << " visible" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "  per-object loop       " << loopDraws << " draw calls, " << loopMilliseconds << " ms per frame" << std::endl
+              << "  instance batch        1 draw call, " << instancedMilliseconds << " ms per frame" << std::endl
+              << "  culling               SSE " << simdCullSeconds * 1000.0 << " ms, scalar " << scalarCullSeconds * 1000.0 << " ms" << std::endl;
+    if (!sameVisible)
+        std::cout << "  FAILED: the SSE cull kept different instances than the scalar test" << std::endl;
+    if (!imagesMatch)
+        std::cout << "  FAILED: the instanced image differs from the per-object loop" << std::endl;
+
+    batch.release();
+    stream.release();
+    mesh.release();
+    glDeleteProgram(uniformShader.Program);
+    glDeleteProgram(instanceShader.Program);
+    target.release();
+    destroyBenchmarkContext(window);
+    return sameVisible && imagesMatch ? 0 : 1;
+}
+
+// Indirect vertex shader of the materials benchmark, and the fragment body shared by per-draw
+// binds and the material table: a diffuse texture times a lightmap in slots 0 and 1
+const char* const MATERIAL_VERTEX_SHADER = R"(#version 430 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texCoords;
+layout(location = 3) in vec2 lightMapTexCoords;
+layout(location = 4) in uint drawId;
+struct DrawData { mat4 model; uint material; };
+layout(std430, binding = 1) readonly buffer DrawDataBuffer { DrawData draws[]; };
+uniform mat4 viewProjection;
+out vec3 worldNormal;
+out vec2 uv;
+out vec2 lightmapUv;
+flat out uint material;
+void main() {
+    mat4 model = draws[drawId].model;
+    worldNormal = mat3(model) * normal;
+    uv = texCoords * 3.0;
+    lightmapUv = lightMapTexCoords;
+    material = draws[drawId].material;
+    gl_Position = viewProjection * (model * vec4(position, 1.0));
+}
+)";
+
+const char* const MATERIAL_BOUND_FRAGMENT_SHADER = R"(#version 430 core
+uniform sampler2D diffuse;
+uniform sampler2D lightmap;
+vec4 sampleMaterial(uint material, int slot, vec2 uv) {
+    return slot == 0 ? texture(diffuse, uv) : texture(lightmap, uv);
+}
+)";
+
+const char* const MATERIAL_FRAGMENT_BODY = R"(
+in vec3 worldNormal;
+in vec2 uv;
+in vec2 lightmapUv;
+flat in uint material;
+out vec4 fragColor;
+void main() {
+    vec3 color = sampleMaterial(material, 0, uv).rgb * sampleMaterial(material, 1, lightmapUv).rgb;
+    fragColor = vec4(color * (0.5 + 0.5 * normalize(worldNormal).y), 1.0);
+}
+)";
+
+// materials [mesh count]: arena meshes over 96 materials with diffuse textures of three sizes
+// and a shared lightmap, drawn with one glMultiDrawElementsIndirect per material and its texture
+// binds, then with every draw in one call through a MaterialTable: texture arrays, and bindless
+// handles when the driver has them. The images must match.
+int benchmarkMaterials(const std::vector<std::string>& args) {
+    size_t meshCount = args.empty() ? 4096 : static_cast<size_t>(std::atol(args[0].c_str()));
+    if (meshCount == 0) {
+        std::cerr << "Invalid mesh count: " << args[0] << std::endl;
+        return 1;
+    }
+    const int materialCount = 96, frames = 10;
+
+    GLFWwindow* window = createBenchmarkContext();
+    if (!window)
+        return 1;
+    if (!GeometryArena::isSupported() || !MaterialTable::isArraySupported()) {
+        std::cerr << "Multi-draw indirect, shader storage buffers and texture copies are not supported" << std::endl;
+        destroyBenchmarkContext(window);
+        return 1;
+    }
+
+    unsigned int seed = 54321;
+    auto random = [&seed](unsigned int range) {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 8) % range;
+    };
+    size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(meshCount))));
+    std::vector<std::vector<Vertex>> meshVertices(meshCount);
+    std::vector<std::vector<unsigned int>> meshIndices(meshCount);
+    std::vector<GeometryArrays> arrays(meshCount);
+    std::vector<glm::mat4> models(meshCount);
+    std::vector<uint32_t> materials(meshCount);
+    for (size_t i = 0; i < meshCount; ++i) {
+        bumpTile(1 + random(8), meshVertices[i], meshIndices[i]);
+        GeometryArrays meshArrays = { meshVertices[i].data(), meshVertices[i].size(), meshIndices[i].data(), meshIndices[i].size(), nullptr, 0, nullptr, 0 };
+        arrays[i] = meshArrays;
+        glm::vec3 position(static_cast<float>(i % side) - side * 0.5f, 0.0f, static_cast<float>(i / side) - side * 0.5f);
+        models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), position), glm::radians(static_cast<float>(random(360))), glm::vec3(0.0f, 1.0f, 0.0f));
+        models[i] = glm::scale(models[i], glm::vec3(0.9f));
+        materials[i] = random(materialCount);
+    }
+
+    // Checkered diffuse textures of 16, 32 and 64 texels with full mip chains, half with
+    // immutable storage, and one lightmap
+    auto checker = [](int size, int cells, const unsigned char a[3], const unsigned char b[3]) {
+        std::vector<unsigned char> texels(static_cast<size_t>(size) * size * 4);
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                const unsigned char* color = ((x * cells / size) + (y * cells / size)) % 2 ? a : b;
+                unsigned char* texel = &texels[(static_cast<size_t>(y) * size + x) * 4];
+                texel[0] = static_cast<unsigned char>(color[0] + x % 7);
+                texel[1] = color[1];
+                texel[2] = static_cast<unsigned char>(color[2] + y % 5);
+                texel[3] = 255;
+            }
+        }
+        return texels;
+    };
+    std::vector<GLuint> textures(materialCount + 1);
+    glGenTextures(materialCount + 1, textures.data());
+    size_t textureBytes = 0;
+    for (int t = 0; t <= materialCount; ++t) {
+        int size = t == materialCount ? 64 : 16 << (t % 3);
+        unsigned char a[3] = { static_cast<unsigned char>(random(200)), static_cast<unsigned char>(random(200)), static_cast<unsigned char>(random(200)) };
+        unsigned char b[3] = { static_cast<unsigned char>(40 + random(200)), static_cast<unsigned char>(40 + random(200)), static_cast<unsigned char>(40 + random(200)) };
+        std::vector<unsigned char> texels = checker(size, t == materialCount ? 2 : 4, a, b);
+        glBindTexture(GL_TEXTURE_2D, textures[t]);
+        if (t % 2) {
+            int levels = 1;
+            while ((size >> levels) > 0)
+                ++levels;
+            glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, size, size);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+        }
+        else {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+        }
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        textureBytes += texels.size() * 4 / 3;
+    }
+    GLuint lightmap = textures[materialCount];
+
+    GeometryArena arena;
+    arena.create(VertexFormat::Standard, 64 * 1024, 256 * 1024);
+    std::vector<LevelGeometry> geometries = LevelGeometry::createBatch(arrays, VertexFormat::Standard, &arena);
+
+    float extent = static_cast<float>(side);
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, extent * 4.0f)
+        * glm::lookAt(glm::vec3(0.0f, extent * 0.3f, extent * 0.8f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    std::vector<Shader> shaders;
+    auto buildShader = [&](const std::string& fragmentHead) {
+        std::string fragment = fragmentHead + MATERIAL_FRAGMENT_BODY;
+        Shader shader = Shader::fromSource(MATERIAL_VERTEX_SHADER, fragment.c_str());
+        if (shader.isSuccessfullyCompiled()) {
+            shader.use();
+            shader.set(shader.uniform("viewProjection"), viewProjection);
+        }
+        shaders.push_back(shader);
+        return shader;
+    };
+    Shader boundShader = buildShader(MATERIAL_BOUND_FRAGMENT_SHADER);
+    boundShader.set(boundShader.uniform("diffuse"), 0);
+    boundShader.set(boundShader.uniform("lightmap"), 1);
+
+    // The table's material indices follow the order of addMaterial(), which here is the
+    // benchmark's own order
+    MaterialTable arrayTable, bindlessTable;
+    auto fillTable = [&](MaterialTable& table) {
+        for (int m = 0; m < materialCount; ++m) {
+            std::array<GLuint, MATERIAL_TEXTURE_SLOTS> slots = {};
+            slots[MATERIAL_SLOT_DIFFUSE] = textures[m];
+            slots[MATERIAL_SLOT_LIGHTMAP] = lightmap;
+            table.addMaterial(slots);
+        }
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        bool uploaded = table.upload();
+        glFinish();
+        return uploaded ? secondsSince(start) : -1.0;
+    };
+    arrayTable.create(false);
+    double arrayUpload = fillTable(arrayTable);
+    Shader arrayShader = buildShader(std::string("#version 430 core\n") + arrayTable.glsl());
+    arrayTable.setSamplers(arrayShader);
+    bool bindless = bindlessTable.create(true) == MaterialTextureMode::Bindless;
+    double bindlessUpload = bindless ? fillTable(bindlessTable) : 0.0;
+    Shader bindlessShader = bindless ? buildShader(std::string("#version 430 core\n") + bindlessTable.glsl()) : boundShader;
+    bool compiled = true;
+    for (const Shader& shader : shaders)
+        compiled = compiled && shader.isSuccessfullyCompiled();
+    if (arrayUpload < 0.0 || bindlessUpload < 0.0 || !compiled) {
+        for (const Shader& shader : shaders)
+            glDeleteProgram(shader.Program);
+        for (LevelGeometry& geometry : geometries)
+            geometry.release();
+        arena.release();
+        arrayTable.release();
+        bindlessTable.release();
+        glDeleteTextures(materialCount + 1, textures.data());
+        destroyBenchmarkContext(window);
+        return 1;
+    }
+
+    BenchmarkTarget target;
+    target.create(512, 512);
+    glEnable(GL_DEPTH_TEST);
+    StreamBuffer stream;
+    stream.create(meshCount * 128);
+
+    size_t textureBinds = 0;
+    std::function<void(uint32_t)> bindMaterial = [&](uint32_t material) {
+        glBindTexture(GL_TEXTURE_2D, textures[material]);
+        ++textureBinds;
+    };
+    std::function<void(uint32_t)> noMaterialBinds;
+    ArenaDrawStats drawStats;
+    auto drawFrame = [&](Shader& shader, const std::function<void(uint32_t)>& bind) {
+        stream.beginFrame();
+        shader.use();
+        arena.clearDraws();
+        for (size_t i = 0; i < geometries.size(); ++i)
+            geometries[i].addIndirectDraws(models[i], materials[i]);
+        arena.flush(stream, bind, drawStats);
+        stream.endFrame();
+    };
+
+    std::vector<unsigned char> image;
+    auto timeFrames = [&](const std::function<void()>& draw) {
+        drawStats = ArenaDrawStats();
+        textureBinds = 0;
+        double seconds = 0.0;
+        for (int frame = 0; frame <= frames; ++frame) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glFinish();
+            BenchmarkClock::time_point frameStart = BenchmarkClock::now();
+            draw();
+            glFinish();
+            if (frame > 0)
+                seconds += secondsSince(frameStart);
+        }
+        image = target.read();
+        return seconds * 1000.0 / frames;
+    };
+
+    double boundMilliseconds = timeFrames([&]() {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, lightmap);
+        glActiveTexture(GL_TEXTURE0);
+        drawFrame(boundShader, bindMaterial);
+    });
+    std::vector<unsigned char> boundImage = image;
+    size_t boundCalls = drawStats.drawCalls / (frames + 1), boundBinds = textureBinds / (frames + 1);
+    double arrayMilliseconds = timeFrames([&]() {
+        arrayTable.bind();
+        drawFrame(arrayShader, noMaterialBinds);
+    });
+    std::vector<unsigned char> arrayImage = image;
+    size_t arrayCalls = drawStats.drawCalls / (frames + 1);
+    double bindlessMilliseconds = 0.0;
+    std::vector<unsigned char> bindlessImage = boundImage;
+    if (bindless) {
+        bindlessMilliseconds = timeFrames([&]() {
+            bindlessTable.bind();
+            drawFrame(bindlessShader, noMaterialBinds);
+        });
+        bindlessImage = image;
+    }
+
+    size_t covered = 0;
+    for (size_t i = 0; i < boundImage.size(); i += 4)
+        covered += boundImage[i + 3] != 0;
+    bool arrayMatches = arrayImage == boundImage;
+    bool bindlessMatches = bindlessImage == boundImage;
+
+    std::cout << "Material table, " << meshCount << " meshes, " << materialCount << " materials, "
+              << textureBytes / 1024 << " KB of textures, " << covered * 100 / (boundImage.size() / 4) << "% of pixels covered" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "  per-material binds    " << boundCalls << " draw calls, " << boundBinds << " texture binds, " << boundMilliseconds << " ms per frame" << std::endl
+              << "  texture arrays        " << arrayCalls << " draw calls, " << arrayTable.pageCount() << " pages bound (" << arrayTable.pageBytes() / 1024 << " KB), " << arrayMilliseconds
+              << " ms per frame, built in " << arrayUpload * 1000.0 << " ms" << std::endl;
+    if (bindless)
+        std::cout << "  bindless              1 draw call, " << bindlessMilliseconds << " ms per frame, built in " << bindlessUpload * 1000.0 << " ms" << std::endl;
+    else
+        std::cout << "  bindless              not supported" << std::endl;
+
+    bool passed = arrayMatches && bindlessMatches && arrayCalls == 1;
+    if (!arrayMatches)
+        std::cout << "  FAILED: the texture array image differs from per-material binds" << std::endl;
+    if (!bindlessMatches)
+        std::cout << "  FAILED: the bindless image differs from per-material binds" << std::endl;
+
+    for (const Shader& shader : shaders)
+        glDeleteProgram(shader.Program);
+    for (LevelGeometry& geometry : geometries)
+        geometry.release();
+    arena.release();
+    arrayTable.release();
+    bindlessTable.release();
+    stream.release();
+    glDeleteTextures(materialCount + 1, textures.data());
+    target.release();
+    destroyBenchmarkContext(window);
+    return passed ? 0 : 1;
+}
+
+// Program variants of the shaders benchmark: a full-screen triangle whose color comes from a loop
+// long enough for the compiler to have real work, different in every variant
+std::string benchmarkVertexShader(size_t variant) {
+    return "#version 330 core\n#define VARIANT " + std::to_string(variant) + "\n" + R"(
+out vec2 uv;
+void main() {
+    vec2 corner = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    uv = corner * 0.5 + 0.5 + float(VARIANT) * 0.001;
+    gl_Position = vec4(corner, 0.0, 1.0);
+}
+)";
+}
+
+std::string benchmarkFragmentShader(size_t variant) {
+    return "#version 330 core\n#define VARIANT " + std::to_string(variant) + "\n" + R"(
+in vec2 uv;
+out vec4 fragColor;
+uniform float scale;
+vec3 wave(vec3 p, int i) {
+    return sin(p * (1.3 + float(i) * 0.17) + vec3(float(VARIANT % 7), float(i), 0.5)) * 0.5 + 0.5;
+}
+void main() {
+    vec3 color = vec3(uv, float(VARIANT % 13) / 13.0);
+    for (int i = 0; i < 12; ++i) {
+        color = mix(color, wave(color * scale + vec3(uv, 0.0), i), 0.3);
+        color += cross(color, vec3(0.1, 0.2, 0.3)) * 0.05;
+        color = fract(color * 1.7 + dot(color, vec3(0.3, 0.6, 0.1)));
+    }
+    fragColor = vec4(color, 1.0);
+}
+)";
+}
+
+// shaders [program count]: builds the programs one by one as the Shader constructor does, as one
+// batch compiled on the driver's threads, then cold and warm through the program binary cache.
+// Every cached program must render what its freshly compiled one does.
+int benchmarkShaders(const std::vector<std::string>& args) {
+    size_t programCount = args.empty() ? 32 : static_cast<size_t>(std::atol(args[0].c_str()));
+    if (programCount == 0) {
+        std::cerr << "Invalid program count: " << args[0] << std::endl;
+        return 1;
+    }
+
+    GLFWwindow* window = createBenchmarkContext();
+    if (!window)
+        return 1;
+    // Every build but the warm one gets new variants, so the driver's own cache of compiled
+    // shaders cannot help it
+    auto addVariants = [&](ShaderBatch& batch, size_t firstVariant) {
+        for (size_t i = 0; i < programCount; ++i)
+            batch.addSource(benchmarkVertexShader(firstVariant + i), benchmarkFragmentShader(firstVariant + i));
+    };
+    auto takeShaders = [&](ShaderBatch& batch, std::vector<Shader>& shaders) {
+        batch.start();
+        ShaderBuildStats stats = batch.finish();
+        for (size_t i = 0; i < programCount; ++i)
+            shaders.push_back(batch.shader(i));
+        return stats;
+    };
+
+    // The Shader constructor's way: compile, link and check each program before the next
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    std::vector<Shader> serialShaders;
+    for (size_t i = 0; i < programCount; ++i)
+        serialShaders.push_back(Shader::fromSource(benchmarkVertexShader(i).c_str(), benchmarkFragmentShader(i).c_str()));
+    double serialMilliseconds = secondsSince(start) * 1000.0;
+
+    ShaderBatch parallelBatch("");
+    addVariants(parallelBatch, programCount);
+    std::vector<Shader> parallelShaders;
+    ShaderBuildStats parallelStats = takeShaders(parallelBatch, parallelShaders);
+
+    // Cold, after removing any entries a failed run left behind, then warm with the same sources
+    const std::string cacheDirectory = "cache/benchmark/shaders/";
+    bool caching = ShaderBatch::isBinaryCacheSupported();
+    ShaderBatch coldBatch(cacheDirectory);
+    addVariants(coldBatch, programCount * 2);
+    for (size_t i = 0; i < programCount; ++i)
+        std::remove(coldBatch.cacheEntry(i).c_str());
+    std::vector<Shader> coldShaders;
+    ShaderBuildStats coldStats = takeShaders(coldBatch, coldShaders);
+    ShaderBatch warmBatch(cacheDirectory);
+    addVariants(warmBatch, programCount * 2);
+    std::vector<Shader> warmShaders;
+    ShaderBuildStats warmStats = takeShaders(warmBatch, warmShaders);
+
+    // Each cached program against its compiled original
+    BenchmarkTarget target;
+    target.create(64, 64);
+    GLuint vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    auto render = [&](Shader& shader) {
+        shader.use();
+        shader.set(shader.uniform("scale"), 2.5f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        return target.read();
+    };
+    size_t linked = 0, mismatches = 0;
+    for (size_t i = 0; i < programCount; ++i) {
+        bool allLinked = serialShaders[i].isSuccessfullyCompiled() && parallelShaders[i].isSuccessfullyCompiled()
+            && coldShaders[i].isSuccessfullyCompiled() && warmShaders[i].isSuccessfullyCompiled();
+        if (!allLinked)
+            continue;
+        ++linked;
+        if (render(coldShaders[i]) != render(warmShaders[i]))
+            ++mismatches;
+    }
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vertexArray);
+
+    std::cout << "Shader builds, " << programCount << " programs" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "  one by one            " << serialMilliseconds << " ms" << std::endl
+              << "  batch                 " << parallelStats.milliseconds << " ms" << (parallelStats.parallel ? ", parallel compile" : ", no parallel compile extension") << std::endl;
+    if (caching)
+        std::cout << "  cold binary cache     " << coldStats.milliseconds << " ms, " << coldStats.compiled << " compiled, " << coldStats.binaryBytes / 1024 << " KB written" << std::endl
+                  << "  warm binary cache     " << warmStats.milliseconds << " ms, " << warmStats.cacheHits << " from the cache" << std::endl;
+    else
+        std::cout << "  binary cache          not supported" << std::endl;
+
+    bool passed = linked == programCount && mismatches == 0 && (!caching || warmStats.cacheHits == programCount);
+    if (linked != programCount)
+        std::cout << "  FAILED: " << programCount - linked << " programs did not link" << std::endl;
+    if (mismatches > 0)
+        std::cout << "  FAILED: " << mismatches << " cached programs render differently" << std::endl;
+    if (caching && warmStats.cacheHits != programCount)
+        std::cout << "  FAILED: only " << warmStats.cacheHits << " programs came from the cache" << std::endl;
+
+    for (size_t i = 0; i < programCount; ++i) {
+        glDeleteProgram(serialShaders[i].Program);
+        glDeleteProgram(parallelShaders[i].Program);
+        glDeleteProgram(coldShaders[i].Program);
+        glDeleteProgram(warmShaders[i].Program);
+        std::remove(coldBatch.cacheEntry(i).c_str());
+    }
+    target.release();
+    destroyBenchmarkContext(window);
+    return passed ? 0 : 1;
+}
+
+// Shared source of the permutations benchmark: a full-screen triangle with every feature behind
+// #ifdef, and the same shading with the fragment features chosen by a uniform at run time
+const char* const PERMUTATION_VERTEX_SHADER = R"(#version 330 core
+layout(location = 5) in mat4 instanceModel;
+uniform mat4 model;
+uniform mat4 positionDecode;
+out vec2 uv;
+void main() {
+    vec2 corner = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    uv = corner * 0.5 + 0.5;
+    vec4 position = vec4(corner, 0.0, 1.0);
+#ifdef FEATURE_QUANTIZED
+    position = positionDecode * position;
+#endif
+#ifdef FEATURE_INSTANCING
+    gl_Position = instanceModel * position;
+#else
+    gl_Position = model * position;
+#endif
+}
+)";
+
+const char* const PERMUTATION_FRAGMENT_SHADER = R"(#version 330 core
+in vec2 uv;
+out vec4 fragColor;
+uniform sampler2D texture_diffuse1;
+uniform sampler2D lightMapTexture;
+vec3 shade(vec3 color) {
+    for (int i = 0; i < 8; ++i)
+        color = color * 0.9 + 0.1 * sin(color * 3.0 + float(i));
+    return color;
+}
+void main() {
+    vec3 color = vec3(0.8);
+#ifdef FEATURE_DIFFUSE
+    vec4 diffuse = texture(texture_diffuse1, uv * 4.0);
+#ifdef FEATURE_ALPHA_TEST
+    if (diffuse.a < 0.5)
+        discard;
+#endif
+    color *= diffuse.rgb;
+#endif
+#ifdef FEATURE_LIGHTMAP
+    color *= texture(lightMapTexture, uv).rgb * 2.0;
+#endif
+    fragColor = vec4(shade(color), 1.0);
+}
+)";
+
+const char* const BRANCHING_FRAGMENT_SHADER = R"(#version 330 core
+in vec2 uv;
+out vec4 fragColor;
+uniform sampler2D texture_diffuse1;
+uniform sampler2D lightMapTexture;
+uniform int features;
+vec3 shade(vec3 color) {
+    for (int i = 0; i < 8; ++i)
+        color = color * 0.9 + 0.1 * sin(color * 3.0 + float(i));
+    return color;
+}
+void main() {
+    vec3 color = vec3(0.8);
+    if ((features & 1) != 0) {
+        vec4 diffuse = texture(texture_diffuse1, uv * 4.0);
+        if ((features & 4) != 0 && diffuse.a < 0.5)
+            discard;
+        color *= diffuse.rgb;
+    }
+    if ((features & 2) != 0)
+        color *= texture(lightMapTexture, uv).rgb * 2.0;
+    fragColor = vec4(shade(color), 1.0);
+}
+)";
+
+// permutations [draws]: all 32 feature permutations of one source precompiled in the background,
+// then each fragment-side permutation against one program branching on a features uniform: the
+// images must match, and the frame time is compared over the given number of full-screen draws.
+// A permutation that was not precompiled must be reported as exactly one hitch.
+int benchmarkPermutations(const std::vector<std::string>& args) {
+    int draws = args.empty() ? 200 : std::atoi(args[0].c_str());
+    if (draws <= 0) {
+        std::cerr << "Invalid draw count: " << args[0] << std::endl;
+        return 1;
+    }
+    const uint32_t permutationCount = 1u << SHADER_FEATURE_COUNT;
+    const int frames = 5;
+
+    GLFWwindow* window = createBenchmarkContext();
+    if (!window)
+        return 1;
+
+    // Precompile everything and keep "rendering frames" until the background work is done; no
+    // directory cache, so this is the cold cost
+    ShaderPermutations permutations;
+    permutations.loadSource(PERMUTATION_VERTEX_SHADER, PERMUTATION_FRAGMENT_SHADER);
+    std::vector<uint32_t> keys;
+    for (uint32_t key = 0; key < permutationCount; ++key)
+        keys.push_back(key);
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    permutations.precompile(keys);
+    double submitMilliseconds = secondsSince(start) * 1000.0;
+    size_t waitFrames = 0;
+    while (permutations.isPending()) {
+        permutations.update();
+        ++waitFrames;
+        std::this_thread::yield();
+    }
+    double precompileMilliseconds = secondsSince(start) * 1000.0;
+    size_t linked = 0;
+    for (uint32_t key = 0; key < permutationCount; ++key)
+        linked += permutations.get(key).isSuccessfullyCompiled();
+    size_t precompileHitches = permutations.hitches().size();
+
+    Shader branching = Shader::fromSource(PERMUTATION_VERTEX_SHADER, BRANCHING_FRAGMENT_SHADER);
+    if (linked != permutationCount || !branching.isSuccessfullyCompiled()) {
+        std::cout << "  FAILED: " << permutationCount - linked << " permutations did not link" << std::endl;
+        permutations.release();
+        glDeleteProgram(branching.Program);
+        destroyBenchmarkContext(window);
+        return 1;
+    }
+
+    // A checkered diffuse texture with holes for the alpha test, and a smooth lightmap
+    GLuint textures[2];
+    glGenTextures(2, textures);
+    std::vector<unsigned char> diffuse(32 * 32 * 4), lightmap(16 * 16 * 4);
+    for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            unsigned char* texel = &diffuse[(y * 32 + x) * 4];
+            texel[0] = static_cast<unsigned char>(x * 8);
+            texel[1] = static_cast<unsigned char>(255 - y * 8);
+            texel[2] = 160;
+            texel[3] = ((x / 4 + y / 4) % 3) ? 255 : 0;
+        }
+    }
+    for (int i = 0; i < 16 * 16; ++i) {
+        lightmap[i * 4] = static_cast<unsigned char>(100 + (i % 16) * 8);
+        lightmap[i * 4 + 1] = static_cast<unsigned char>(100 + (i / 16) * 8);
+        lightmap[i * 4 + 2] = 120;
+        lightmap[i * 4 + 3] = 255;
+    }
+    glBindTexture(GL_TEXTURE_2D, textures[0]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 32, 32, 0, GL_RGBA, GL_UNSIGNED_BYTE, diffuse.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, textures[1]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 16, 16, 0, GL_RGBA, GL_UNSIGNED_BYTE, lightmap.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glActiveTexture(GL_TEXTURE0);
+
+    BenchmarkTarget target;
+    target.create(256, 256);
+    GLuint vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    auto prepare = [](Shader& shader) {
+        shader.use();
+        shader.set(shader.uniform("model"), glm::mat4(1.0f));
+        shader.set(shader.uniform("texture_diffuse1"), 0);
+        shader.set(shader.uniform("lightMapTexture"), 1);
+    };
+    std::vector<unsigned char> image;
+    auto timeFrames = [&](int drawCount) {
+        double seconds = 0.0;
+        for (int frame = 0; frame <= frames; ++frame) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            glFinish();
+            BenchmarkClock::time_point frameStart = BenchmarkClock::now();
+            for (int i = 0; i < drawCount; ++i)
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            glFinish();
+            if (frame > 0)
+                seconds += secondsSince(frameStart);
+        }
+        image = target.read();
+        return seconds * 1000.0 / frames;
+    };
+
+    // The fragment features, specialized against branching
+    const uint32_t fragmentFeatures = SHADER_FEATURE_DIFFUSE | SHADER_FEATURE_LIGHTMAP | SHADER_FEATURE_ALPHA_TEST;
+    UniformHandle featuresUniform = branching.uniform("features");
+    size_t mismatches = 0;
+    for (uint32_t key = 0; key <= fragmentFeatures; ++key) {
+        if (key & ~fragmentFeatures)
+            continue;
+        prepare(permutations.get(key));
+        timeFrames(1);
+        std::vector<unsigned char> specializedImage = image;
+        prepare(branching);
+        branching.set(featuresUniform, static_cast<int>(key));
+        timeFrames(1);
+        if (image != specializedImage) {
+            std::cout << "  FAILED: permutation " << shaderFeatureNames(key) << " differs from the branching program" << std::endl;
+            ++mismatches;
+        }
+    }
+    prepare(permutations.get(fragmentFeatures));
+    double specializedMilliseconds = timeFrames(draws);
+    prepare(branching);
+    branching.set(featuresUniform, static_cast<int>(fragmentFeatures));
+    double branchingMilliseconds = timeFrames(draws);
+
+    // One permutation left out of the precompile: the first frame that asks for it hitches
+    ShaderPermutations partial;
+    partial.loadSource(PERMUTATION_VERTEX_SHADER, PERMUTATION_FRAGMENT_SHADER);
+    partial.precompile({ SHADER_FEATURE_DIFFUSE, SHADER_FEATURE_DIFFUSE | SHADER_FEATURE_LIGHTMAP });
+    while (partial.isPending())
+        partial.update();
+    std::vector<uint32_t> frameKeys = { SHADER_FEATURE_DIFFUSE, SHADER_FEATURE_DIFFUSE | SHADER_FEATURE_LIGHTMAP, SHADER_FEATURE_LIGHTMAP };
+    for (int frame = 0; frame < 3; ++frame) {
+        partial.update();
+        for (uint32_t key : frameKeys)
+            partial.get(key);
+    }
+    bool hitchReported = partial.hitches().size() == 1 && partial.hitches()[0].key == SHADER_FEATURE_LIGHTMAP;
+
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vertexArray);
+
+    std::cout << "Shader permutations, " << permutationCount << " permutations of " << SHADER_FEATURE_COUNT << " features" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "  precompile            " << submitMilliseconds << " ms to submit, " << precompileMilliseconds << " ms until all were ready, "
+              << waitFrames << " updates, " << precompileHitches << " hitches" << std::endl
+              << "  specialized           " << specializedMilliseconds << " ms for " << draws << " full-screen draws" << std::endl
+              << "  branching             " << branchingMilliseconds << " ms for " << draws << " full-screen draws" << std::endl
+              << "  hitch report          " << partial.hitches().size() << " mid-frame compiles, "
+              << (partial.hitches().empty() ? 0.0 : partial.hitches()[0].milliseconds) << " ms for " << shaderFeatureNames(SHADER_FEATURE_LIGHTMAP) << std::endl;
+
+    bool passed = mismatches == 0 && precompileHitches == 0 && hitchReported;
+    if (precompileHitches != 0)
+        std::cout << "  FAILED: precompiled permutations hitched" << std::endl;
+    if (!hitchReported)
+        std::cout << "  FAILED: the permutation compiled mid-frame was not reported" << std::endl;
+
+    permutations.release();
+    partial.release();
+    glDeleteProgram(branching.Program);
+    glDeleteTextures(2, textures);
+    target.release();
+    destroyBenchmarkContext(window);
+    return passed ? 0 : 1;
+}
+
+// Quicksort that hands the left part of every partition to the job system and waits for it
+void parallelQuicksort(JobSystem& jobs, uint32_t* data, size_t count) {
+    const size_t serialCount = 16384;
+    if (count <= serialCount) {
+        std::sort(data, data + count);
+        return;
+    }
+    uint32_t a = data[0], b = data[count / 2], c = data[count - 1];
+    uint32_t pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+    uint32_t* less = std::partition(data, data + count, [pivot](uint32_t value) { return value < pivot; });
+    uint32_t* greater = std::partition(less, data + count, [pivot](uint32_t value) { return value == pivot; });
+
+    JobCounter counter;
+    size_t leftCount = static_cast<size_t>(less - data);
+    auto left = [&jobs, data, leftCount]() { parallelQuicksort(jobs, data, leftCount); };
+    jobs.run(left, counter);
+    parallelQuicksort(jobs, greater, static_cast<size_t>(data + count - greater));
+    jobs.wait(counter);
+}
+
+// Work of one element of the jobs benchmark reduction, enough arithmetic to be compute bound
+double reductionTerm(uint32_t i) {
+    double x = 1.0 + i * 1e-4;
+    return std::sqrt(x) * std::sin(x) + std::log(x);
+}
+
+// jobs [max threads]: CPU-only workloads on a JobSystem of 1 to N threads (the caller plus N - 1
+// workers): a fine-grained parallelFor reduction, a recursive quicksort of jobs waiting on jobs,
+// and coarse per-mesh optimization and LOD building. Every result must match the single-threaded
+// one, and a frame-shaped TaskGraph must keep its order and its main-thread tasks.
+int benchmarkJobs(const std::vector<std::string>& args) {
+    int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+    int maxThreads = args.empty() ? std::max(hardwareThreads, 1) : std::atoi(args[0].c_str());
+    if (maxThreads <= 0) {
+        std::cerr << "Invalid thread count: " << args[0] << std::endl;
+        return 1;
+    }
+    const uint32_t chunkCount = 4096, chunkSize = 2048;
+    const size_t sortCount = 1 << 22;
+    const unsigned int meshCount = 48;
+    const int repeats = 3, graphRuns = 200;
+
+    // Single-threaded references
+    double expectedSum = 0.0;
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+        double partial = 0.0;
+        for (uint32_t i = chunk * chunkSize; i < (chunk + 1) * chunkSize; ++i)
+            partial += reductionTerm(i);
+        expectedSum += partial;
+    }
+    std::vector<uint32_t> unsorted(sortCount);
+    unsigned int seed = 12345;
+    for (uint32_t& value : unsorted) {
+        seed = seed * 1103515245u + 12345u;
+        value = seed >> 4; // Some duplicates
+    }
+    std::vector<uint32_t> expectedSorted = unsorted;
+    std::sort(expectedSorted.begin(), expectedSorted.end());
+    // Tiles of 16 to 63 quads a side, so the jobs differ in size
+    std::vector<std::vector<Vertex>> tileVertices(meshCount);
+    std::vector<std::vector<unsigned int>> tileIndices(meshCount);
+    for (unsigned int m = 0; m < meshCount; ++m)
+        bumpTile(16 + (m * 29) % 48, tileVertices[m], tileIndices[m]);
+    std::vector<std::vector<unsigned int>> expectedIndices = tileIndices;
+    std::vector<size_t> expectedLods(meshCount);
+    for (unsigned int m = 0; m < meshCount; ++m) {
+        std::vector<Vertex> vertices = tileVertices[m];
+        optimizeMesh(vertices, expectedIndices[m]);
+        expectedLods[m] = buildLodChain(vertices, expectedIndices[m]).size();
+    }
+
+    std::cout << "Job system scaling, 1 to " << maxThreads << " threads (" << hardwareThreads << " hardware threads): " << chunkCount << "x" << chunkSize
+              << " reduction, " << sortCount << " key sort, " << meshCount << " meshes" << std::endl
+              << "  threads   reduce ms  speedup   sort ms  speedup   meshes ms  speedup   graph us   steals" << std::endl;
+    double reduceBase = 0.0, sortBase = 0.0, meshBase = 0.0;
+    bool identical = true, ordered = true;
+    for (int threads = 1; threads <= maxThreads; ++threads) {
+        JobSystem jobs(threads - 1);
+        uint64_t stealsBefore = jobs.stats().steals;
+
+        double reduceSeconds = DBL_MAX;
+        std::vector<double> partials(chunkCount);
+        for (int r = 0; r < repeats; ++r) {
+            BenchmarkClock::time_point start = BenchmarkClock::now();
+            jobs.parallelFor(chunkCount, [&](uint32_t chunk) {
+                double partial = 0.0;
+                for (uint32_t i = chunk * chunkSize; i < (chunk + 1) * chunkSize; ++i)
+                    partial += reductionTerm(i);
+                partials[chunk] = partial;
+            });
+            double sum = 0.0;
+            for (double partial : partials)
+                sum += partial;
+            reduceSeconds = std::min(reduceSeconds, secondsSince(start));
+            identical = identical && sum == expectedSum;
+        }
+
+        double sortSeconds = DBL_MAX;
+        for (int r = 0; r < repeats; ++r) {
+            std::vector<uint32_t> keys = unsorted;
+            BenchmarkClock::time_point start = BenchmarkClock::now();
+            parallelQuicksort(jobs, keys.data(), keys.size());
+            sortSeconds = std::min(sortSeconds, secondsSince(start));
+            identical = identical && keys == expectedSorted;
+        }
+
+        double meshSeconds = DBL_MAX;
+        for (int r = 0; r < repeats; ++r) {
+            std::vector<std::vector<Vertex>> vertices = tileVertices;
+            std::vector<std::vector<unsigned int>> indices = tileIndices;
+            std::vector<size_t> lods(meshCount);
+            BenchmarkClock::time_point start = BenchmarkClock::now();
+            jobs.parallelFor(meshCount, [&](uint32_t m) {
+                optimizeMesh(vertices[m], indices[m]);
+                lods[m] = buildLodChain(vertices[m], indices[m]).size();
+            });
+            meshSeconds = std::min(meshSeconds, secondsSince(start));
+            identical = identical && indices == expectedIndices && lods == expectedLods;
+        }
+
+        // The frame's graph shape with a little work in each task; every task must start after its
+        // prerequisites end, and the main-thread ones must run on this thread
+        std::thread::id mainThread = std::this_thread::get_id();
+        std::vector<double> lodWork(256);
+        bool onMainThread = true;
+        auto spin = [](int n) {
+            volatile double x = 0.0;
+            for (int i = 0; i < n; ++i)
+                x = x + reductionTerm(static_cast<uint32_t>(i));
+        };
+        TaskGraph graph;
+        TaskGraph::TaskId input = graph.add("input", [&] { onMainThread = onMainThread && std::this_thread::get_id() == mainThread; spin(200); }, true);
+        TaskGraph::TaskId uploads = graph.add("uploads", [&] { onMainThread = onMainThread && std::this_thread::get_id() == mainThread; spin(2000); }, true);
+        TaskGraph::TaskId cull = graph.add("cull", [&] { spin(2000); });
+        TaskGraph::TaskId lod = graph.add("lod", [&] {
+            jobs.parallelFor(static_cast<uint32_t>(lodWork.size()), [&](uint32_t i) { lodWork[i] = reductionTerm(i); }, 4);
+        });
+        TaskGraph::TaskId queue = graph.add("queue", [&] { spin(1000); });
+        TaskGraph::TaskId submit = graph.add("submit", [&] { onMainThread = onMainThread && std::this_thread::get_id() == mainThread; spin(500); }, true);
+        std::vector<std::pair<TaskGraph::TaskId, TaskGraph::TaskId>> edges = {
+            { uploads, input }, { cull, input }, { lod, cull }, { queue, lod }, { queue, uploads }, { submit, queue }
+        };
+        for (const auto& edge : edges)
+            graph.depend(edge.first, edge.second);
+        BenchmarkClock::time_point start = BenchmarkClock::now();
+        for (int run = 0; run < graphRuns; ++run) {
+            graph.run(jobs);
+            for (const auto& edge : edges)
+                ordered = ordered && graph.startTime(edge.first) >= graph.endTime(edge.second);
+        }
+        double graphSeconds = secondsSince(start) / graphRuns;
+        ordered = ordered && onMainThread;
+
+        if (threads == 1) {
+            reduceBase = reduceSeconds;
+            sortBase = sortSeconds;
+            meshBase = meshSeconds;
+        }
+        std::cout << std::fixed << std::setprecision(2) << "  " << std::setw(7) << threads
+                  << std::setw(12) << reduceSeconds * 1000.0 << std::setw(8) << reduceBase / reduceSeconds << "x"
+                  << std::setw(10) << sortSeconds * 1000.0 << std::setw(8) << sortBase / sortSeconds << "x"
+                  << std::setw(12) << meshSeconds * 1000.0 << std::setw(8) << meshBase / meshSeconds << "x"
+                  << std::setw(11) << graphSeconds * 1.0e6 << std::setw(9) << jobs.stats().steals - stealsBefore << std::endl;
+    }
+
+    if (!identical)
+        std::cout << "  FAILED: a parallel result differs from the single-threaded one" << std::endl;
+    if (!ordered)
+        std::cout << "  FAILED: a task ran before its prerequisites or off the main thread" << std::endl;
+    return identical && ordered ? 0 : 1;
+}
+
+// pacing [frames]: FixedTimestep against a jittery frame clock with one long stall, which must
+// account for every second as simulated, pending or dropped and interpolate without going back;
+// then frames of a full-screen shader paced uncapped, with two frames in flight, and with one
+// frame in flight and late input, reporting frame time and input-to-GPU-done latency.
+int benchmarkPacing(const std::vector<std::string>& args) {
+    int frames = args.empty() ? 120 : std::atoi(args[0].c_str());
+    if (frames <= 0) {
+        std::cerr << "Invalid frame count: " << args[0] << std::endl;
+        return 1;
+    }
+
+    // A body moving at one unit per second, simulated at 120 Hz from frames of 2 to 30 ms
+    FixedTimestep timestep(1.0 / 120.0, 8);
+    unsigned int seed = 12345;
+    double now = 0.0, position = 0.0, previousPosition = 0.0, lastRendered = 0.0;
+    bool monotonic = true;
+    timestep.advance(now);
+    for (int frame = 0; frame < 1000; ++frame) {
+        seed = seed * 1103515245u + 12345u;
+        now += frame == 500 ? 0.5 : 0.002 + 0.028 * ((seed >> 8) & 0xFFFF) / 65535.0;
+        for (int step = timestep.advance(now); step > 0; --step) {
+            previousPosition = position;
+            position += timestep.step();
+        }
+        double rendered = previousPosition + (position - previousPosition) * timestep.alpha();
+        monotonic = monotonic && rendered >= lastRendered - 1e-9;
+        lastRendered = rendered;
+    }
+    double pending = timestep.alpha() * timestep.step();
+    double accounted = timestep.stepCount() * timestep.step() + pending + timestep.droppedSeconds();
+    bool timestepOk = monotonic && std::fabs(accounted - now) < 1e-6 && timestep.droppedSeconds() > 0.0 &&
+                      timestep.droppedSeconds() < 0.5 && std::fabs(position - timestep.stepCount() * timestep.step()) < 1e-6;
+    std::cout << "Fixed timestep, 1000 frames of 2-30 ms and one of 500 ms: " << timestep.stepCount() << " steps of "
+              << std::fixed << std::setprecision(2) << timestep.step() * 1000.0 << " ms, " << timestep.droppedSeconds() * 1000.0
+              << " ms dropped after the stall, " << (monotonic ? "monotonic" : "NOT MONOTONIC") << " interpolation" << std::endl;
+
+    GLFWwindow* window = createBenchmarkContext();
+    if (!window)
+        return 1;
+    BenchmarkTarget target;
+    target.create(512, 512);
+    GLuint vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    Shader shader = Shader::fromSource(benchmarkVertexShader(0).c_str(), benchmarkFragmentShader(0).c_str());
+    shader.use();
+    UniformHandle scale = shader.uniform("scale");
+
+    struct PacingMode {
+        const char* name;
+        int framesInFlight;
+        bool lateInput;
+    };
+    const PacingMode modes[] = { { "uncapped", 0, false }, { "2 in flight", 2, false }, { "1 in flight, late input", 1, true } };
+    bool latencyOk = true;
+    std::cout << "Frame pacing, " << frames << " frames of a 512x512 full-screen shader, uncapped swaps" << std::endl
+              << "  mode                      frame p50    p99   latency p50    p99    max   fence waits" << std::endl;
+    for (const PacingMode& mode : modes) {
+        FramePacer pacer;
+        pacer.setSwapMode(SwapMode::Uncapped);
+        pacer.setMaxFramesInFlight(mode.framesInFlight);
+        pacer.setLateInput(mode.lateInput);
+        for (int frame = 0; frame < frames; ++frame) {
+            pacer.beginFrame();
+            pacer.inputSampled();
+            shader.set(scale, 2.0f + 0.01f * frame);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            pacer.endFrame(window);
+        }
+        pacer.beginFrame(); // Closes the last frame time and retires what has finished
+        glFinish();
+        FramePacingStats stats = pacer.stats();
+        pacer.release();
+        latencyOk = latencyOk && stats.latencySamples + FramePacer::MAX_FRAMES_IN_FLIGHT >= static_cast<size_t>(frames) && stats.latencyP50 > 0.0;
+        std::cout << "  " << std::left << std::setw(26) << mode.name << std::right << std::setprecision(2)
+                  << std::setw(8) << stats.frameP50 << std::setw(7) << stats.frameP99
+                  << std::setw(13) << stats.latencyP50 << std::setw(7) << stats.latencyP99 << std::setw(7) << stats.latencyMax
+                  << std::setw(8) << stats.fenceWaits << " (" << stats.fenceWaitMilliseconds << " ms)" << std::endl;
+    }
+
+    if (!timestepOk)
+        std::cout << "  FAILED: the fixed timestep lost time or went back" << std::endl;
+    if (!latencyOk)
+        std::cout << "  FAILED: frames finished without a latency sample" << std::endl;
+
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteProgram(shader.Program);
+    target.release();
+    destroyBenchmarkContext(window);
+    return timestepOk && latencyOk ? 0 : 1;
+}
+
+#if ENABLE_PROFILER
+// profiler [frames]: cost of a CPU scope recorded from every thread of the job system, drained
+// once per frame with nothing lost; a full ring drops exactly its overflow; GPU scopes around a
+// full-screen draw read back GPU_LATENCY frames late; and the Chrome trace holds every event.
+int benchmarkProfiler(const std::vector<std::string>& args) {
+    int frames = args.empty() ? 100 : std::atoi(args[0].c_str());
+    if (frames <= 0) {
+        std::cerr << "Invalid frame count: " << args[0] << std::endl;
+        return 1;
+    }
+    Profiler& profiler = Profiler::instance();
+    JobSystem& jobs = JobSystem::shared();
+    const uint32_t jobCount = 64, scopesPerJob = 100; // Two scopes each, well under a thread's ring per frame
+    std::vector<double> results(jobCount);
+    auto work = [&results](uint32_t job, uint32_t i) {
+        results[job] += std::sqrt(static_cast<double>(job * 1000 + i));
+    };
+
+    // The same jobs without and with scopes
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        jobs.parallelFor(jobCount, [&](uint32_t job) {
+            for (uint32_t i = 0; i < scopesPerJob; ++i)
+                work(job, i);
+        });
+    }
+    double plainSeconds = secondsSince(start);
+    size_t eventsBefore = profiler.traceEventCount(), droppedBefore = profiler.droppedEvents();
+    start = BenchmarkClock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        jobs.parallelFor(jobCount, [&](uint32_t job) {
+            PROFILE_SCOPE("benchmark job");
+            for (uint32_t i = 0; i < scopesPerJob; ++i) {
+                PROFILE_SCOPE("benchmark step");
+                work(job, i);
+            }
+        });
+        PROFILE_END_FRAME();
+    }
+    double scopedSeconds = secondsSince(start);
+    size_t cpuEvents = profiler.traceEventCount() - eventsBefore;
+    size_t expectedEvents = static_cast<size_t>(frames) * jobCount * (scopesPerJob + 1);
+    bool cpuOk = cpuEvents == expectedEvents && profiler.droppedEvents() == droppedBefore;
+    double scopeNanoseconds = std::max(0.0, scopedSeconds - plainSeconds) * 1.0e9 / expectedEvents;
+
+    // One thread overflowing its ring in a single frame
+    droppedBefore = profiler.droppedEvents();
+    size_t overflowScopes = Profiler::THREAD_CAPACITY + 1000;
+    for (size_t i = 0; i < overflowScopes; ++i) {
+        PROFILE_SCOPE("benchmark overflow");
+    }
+    PROFILE_END_FRAME();
+    bool overflowOk = profiler.droppedEvents() - droppedBefore == overflowScopes - Profiler::THREAD_CAPACITY;
+
+    GLFWwindow* window = createBenchmarkContext();
+    if (!window)
+        return 1;
+    BenchmarkTarget target;
+    target.create(512, 512);
+    GLuint vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    Shader shader = Shader::fromSource(benchmarkVertexShader(0).c_str(), benchmarkFragmentShader(0).c_str());
+    shader.use();
+    shader.set(shader.uniform("scale"), 2.5f);
+
+    PROFILE_INIT_GPU();
+    eventsBefore = profiler.traceEventCount();
+    double endFrameSeconds = 0.0;
+    for (int frame = 0; frame < frames; ++frame) {
+        {
+            PROFILE_GPU_SCOPE("benchmark draw");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glFlush(); // As the swap would
+        start = BenchmarkClock::now();
+        PROFILE_END_FRAME();
+        endFrameSeconds += secondsSince(start);
+    }
+    // Only the frames GPU_LATENCY behind have been read back
+    size_t gpuEvents = profiler.traceEventCount() - eventsBefore;
+    double gpuMilliseconds = 0.0;
+    for (const ProfileScopeStats& scope : profiler.stats()) {
+        if (scope.gpu && std::strcmp(scope.name, "benchmark draw") == 0)
+            gpuMilliseconds = scope.average;
+    }
+    bool gpuOk = gpuEvents + Profiler::GPU_LATENCY == static_cast<size_t>(frames) && gpuMilliseconds > 0.0;
+    PROFILE_RELEASE_GPU();
+
+    // Every event of the run is in the trace, as a complete event
+    const std::string tracePath = "cache/benchmark/profile.json";
+    bool traceOk = PROFILE_WRITE_TRACE(tracePath);
+    std::vector<unsigned char> traceFile;
+    size_t completeEvents = 0;
+    if (traceOk && readFile(tracePath, traceFile)) {
+        std::string text(traceFile.begin(), traceFile.end());
+        for (size_t at = text.find("\"ph\":\"X\""); at != std::string::npos; at = text.find("\"ph\":\"X\"", at + 1))
+            ++completeEvents;
+    }
+    traceOk = traceOk && completeEvents == profiler.traceEventCount();
+
+    std::cout << "Profiler, " << frames << " frames on " << jobs.size() << " threads" << std::endl
+              << std::fixed << std::setprecision(1)
+              << "  CPU scopes            " << cpuEvents << " of " << expectedEvents << " recorded, " << scopeNanoseconds << " ns per scope" << std::endl
+              << "  ring overflow         " << profiler.droppedEvents() - droppedBefore << " of " << overflowScopes << " dropped" << std::endl
+              << std::setprecision(3)
+              << "  GPU scopes            " << gpuEvents << " read back " << Profiler::GPU_LATENCY << " frames late, " << gpuMilliseconds << " ms per draw, "
+              << endFrameSeconds * 1000.0 / frames << " ms per endFrame()" << std::endl
+              << "  trace                 " << completeEvents << " events in " << tracePath << std::endl;
+    PROFILE_PRINT_STATS();
+
+    if (!cpuOk)
+        std::cout << "  FAILED: CPU scopes were lost" << std::endl;
+    if (!overflowOk)
+        std::cout << "  FAILED: the overflowing ring did not drop exactly its overflow" << std::endl;
+    if (!gpuOk)
+        std::cout << "  FAILED: GPU scopes missing or empty" << std::endl;
+    if (!traceOk)
+        std::cout << "  FAILED: the trace does not hold every event" << std::endl;
+
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteProgram(shader.Program);
+    target.release();
+    destroyBenchmarkContext(window);
+    return cpuOk && overflowOk && gpuOk && traceOk ? 0 : 1;
+}
+#endif // ENABLE_PROFILER
+
+// quant [vertex count]: QuantizedVertex encode speed and worst-case error against the documented bounds
+int benchmarkQuantization(const std::vector<std::string>& args) {
+    size_t count = args.empty() ? 1000000 : static_cast<size_t>(std::atol(args[0].c_str()));
+    if (count == 0) {
+        std::cerr << "Invalid vertex count: " << args[0] << std::endl;
+        return 1;
+    }
+
+    // Random vertices: positions in an off-center box, unit normals, tiling UVs and [0, 1] lightmap UVs
+    std::vector<Vertex> vertices(count);
+    unsigned int seed = 12345;
+    auto random = [&seed](float lo, float hi) {
+        seed = seed * 1103515245u + 12345u;
+        return lo + (hi - lo) * static_cast<float>((seed >> 8) & 0xFFFFFF) / 16777215.0f;
+    };
+    for (Vertex& vertex : vertices) {
+        vertex.Position = glm::vec3(random(-250.0f, 730.0f), random(3.0f, 40.0f), random(-90.0f, 90.0f));
+        glm::vec3 normal(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f));
+        vertex.Normal = glm::length(normal) > 1e-3f ? glm::normalize(normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+        vertex.TexCoords = glm::vec2(random(-8.0f, 8.0f), random(0.0f, 1.0f));
+        vertex.LightMapTexCoords = glm::vec2(random(0.0f, 1.0f), random(0.0f, 1.0f));
+    }
+
+    std::vector<QuantizedVertex> quantized(count);
+    BenchmarkClock::time_point start = BenchmarkClock::now();
+    QuantizationBounds bounds = computeQuantizationBounds(vertices.data(), count);
+    quantizeVertices(vertices.data(), count, bounds, quantized.data());
+    double seconds = secondsSince(start);
+
+    double positionError = 0.0, normalError = 0.0, texCoordError = 0.0, lightMapError = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        const Vertex& original = vertices[i];
+        Vertex decoded = dequantizeVertex(quantized[i], bounds);
+        for (int axis = 0; axis < 3; ++axis)
+            positionError = std::max(positionError, static_cast<double>(std::fabs(decoded.Position[axis] - original.Position[axis]) / bounds.extent[axis]));
+        normalError = std::max(normalError, glm::degrees(angleBetweenNormals(decoded.Normal, original.Normal)));
+        for (int c = 0; c < 2; ++c) {
+            // Half floats keep 11 significant bits, so their error is relative to the magnitude
+            float magnitude = std::max(std::fabs(original.TexCoords[c]), 6.1e-5f);
+            texCoordError = std::max(texCoordError, static_cast<double>(std::fabs(decoded.TexCoords[c] - original.TexCoords[c]) / magnitude));
+            lightMapError = std::max(lightMapError, static_cast<double>(std::fabs(decoded.LightMapTexCoords[c] - original.LightMapTexCoords[c])));
+        }
+    }
+
+    // Bounds from QuantizedVertex.h, with slack for float rounding in the decode
+    bool positionOk = positionError <= 1.0 / 131070.0 * 1.05;
+    bool normalOk = normalError <= 0.01;
+    bool texCoordOk = texCoordError <= 1.0 / 2048.0 * 1.01;
+    bool lightMapOk = lightMapError <= 1.0 / 131070.0 * 1.05;
+
+    std::cout << "Vertex quantization, " << count << " vertices: " << sizeof(Vertex) << " -> " << sizeof(QuantizedVertex)
+              << " bytes per vertex, " << std::fixed << std::setprecision(1) << count / seconds / 1.0e6 << " M vertices/s" << std::endl
+              << std::scientific << std::setprecision(3)
+              << "  position  " << positionError << " of extent" << (positionOk ? "" : "  OUT OF BOUNDS") << std::endl
+              << "  normal    " << normalError << " degrees" << (normalOk ? "" : "  OUT OF BOUNDS") << std::endl
+              << "  texcoord  " << texCoordError << " relative" << (texCoordOk ? "" : "  OUT OF BOUNDS") << std::endl
+              << "  lightmap  " << lightMapError << (lightMapOk ? "" : "  OUT OF BOUNDS") << std::endl;
+    return positionOk && normalOk && texCoordOk && lightMapOk ? 0 : 1;
+}
+
+struct BenchmarkEntry {
+    const char* name;
+    const char* usage;
+    int (*run)(const std::vector<std::string>& args);
+};
+
+const BenchmarkEntry benchmarks[] = {
+    { "bc", "bc [image]            BC1/BC3/BC5 encode throughput and PSNR", benchmarkBlockCompression },
+    { "mips", "mips [image]          SIMD vs scalar mip chain generation, box and Kaiser, linear and sRGB", benchmarkMipmaps },
+    { "env", "env [face size]       Prefiltered radiance and SH irradiance bake time", benchmarkEnvironment },
+    { "mesh", "mesh [model]          Assimp import vs .lgeo mesh cache load", benchmarkMeshCache },
+    { "meshopt", "meshopt [model]       Weld, vertex cache, overdraw and fetch reordering, ACMR/ATVR per stage", benchmarkMeshOptimizer },
+    { "lod", "lod [model]           LOD chain triangle counts, simplification error and seam integrity", benchmarkLod },
+    { "cluster", "cluster [model]       Meshlet build and frustum/backface cone culling per view", benchmarkClusters },
+    { "bvh", "bvh [object count]    BVH frustum culling against brute force for 10K-1M boxes", benchmarkBvh },
+    { "occlusion", "occlusion [views]     Masked occlusion buffer culling against ray-cast ground truth", benchmarkOcclusion },
+    { "queue", "queue [draws]         Render queue state changes, sorted vs submission order, radix vs std::sort", benchmarkRenderQueue },
+    { "arena", "arena [mesh count]    Shared geometry arena with one multi-draw indirect call per material against per-mesh draws", benchmarkArena },
+    { "stream", "stream [object count]  Per-object uniforms against a persistently mapped, fenced ring of transforms", benchmarkStream },
+    { "instancing", "instancing [instances] One instanced draw with SSE culling against the per-object draw loop", benchmarkInstancing },
+    { "materials", "materials [mesh count] One multi-draw through a texture array or bindless material table against per-material binds", benchmarkMaterials },
+    { "shaders", "shaders [programs]    Program binary cache cold and warm, batched parallel compile against one by one", benchmarkShaders },
+    { "permutations", "permutations [draws]  Background-precompiled shader permutations against run-time feature branches, hitch reporting", benchmarkPermutations },
+    { "jobs", "jobs [max threads]    Work-stealing job system and frame task graph scaling from 1 to N threads on CPU work", benchmarkJobs },
+    { "pacing", "pacing [frames]       Fixed timestep accounting, frame time and input latency with frames-in-flight caps", benchmarkPacing },
+#if ENABLE_PROFILER
+    { "profiler", "profiler [frames]     CPU scope cost from every thread, ring overflow, GPU timestamp scopes and Chrome trace export", benchmarkProfiler },
+#endif
+    { "quant", "quant [vertex count]  Quantized vertex encode speed and error bounds", benchmarkQuantization },
+};
+
+} // namespace
+
+int runBenchmark(const std::vector<std::string>& args) {
+    if (!args.empty()) {
+        for (const BenchmarkEntry& benchmark : benchmarks) {
+            if (args[0] == benchmark.name)
+                return benchmark.run(std::vector<std::string>(args.begin() + 1, args.end()));
+        }
+        std::cerr << "Unknown benchmark: " << args[0] << std::endl;
+    }
+
+    std::cerr << "Usage: --benchmark <name> [arguments]" << std::endl;
+    for (const BenchmarkEntry& benchmark : benchmarks)
+        std::cerr << "  " << benchmark.usage << std::endl;
+    return 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+// Headless benchmarks, run before the application window is created; the GL ones make their own
+// hidden window:
+//   OpenGL.exe --benchmark <name> [arguments]
+// Returns the process exit code (non-zero if a benchmark's own checks fail).
+int runBenchmark(const std::vector<std::string>& args);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,206 @@
+#include "CacheFile.h"
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : mappedData(nullptr), mappedSize(0)
+#ifdef _WIN32
+    , fileHandle(INVALID_HANDLE_VALUE), mappingHandle(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+    : MappedFile() {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+    if (this != &other) {
+        close();
+        mappedData = other.mappedData;
+        mappedSize = other.mappedSize;
+        other.mappedData = nullptr;
+        other.mappedSize = 0;
+#ifdef _WIN32
+        fileHandle = other.fileHandle;
+        mappingHandle = other.mappingHandle;
+        other.fileHandle = INVALID_HANDLE_VALUE;
+        other.mappingHandle = NULL;
+#endif
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+#ifdef _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle == NULL) {
+        close();
+        return false;
+    }
+
+    mappedData = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!mappedData) {
+        close();
+        return false;
+    }
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps its own reference to the file
+    if (mapped == MAP_FAILED)
+        return false;
+
+    mappedData = static_cast<const unsigned char*>(mapped);
+    mappedSize = static_cast<size_t>(fileInfo.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (mappedData)
+        UnmapViewOfFile(mappedData);
+    if (mappingHandle != NULL)
+        CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+    mappingHandle = NULL;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (mappedData)
+        munmap(const_cast<unsigned char*>(mappedData), mappedSize);
+#endif
+    mappedData = nullptr;
+    mappedSize = 0;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hashString(const std::string& text, uint64_t seed) {
+    return hashBytes(text.data(), text.size(), seed);
+}
+
+std::string hashToHex(uint64_t hash) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        hex[i] = digits[hash & 0xF];
+        hash >>= 4;
+    }
+    return hex;
+}
+
+bool readFile(const std::string& path, std::vector<unsigned char>& contents) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    std::streamoff size = file.tellg();
+    if (size < 0)
+        return false;
+
+    contents.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    return size == 0 || static_cast<bool>(file.read(reinterpret_cast<char*>(contents.data()), size));
+}
+
+bool writeFileAtomically(const std::string& path, const std::vector<FileChunk>& chunks) {
+    size_t lastSlash = path.find_last_of("/\\");
+    if (lastSlash != std::string::npos && !createDirectories(path.substr(0, lastSlash)))
+        return false;
+
+    // Several loader threads may rebuild the same entry, so each writes its own temporary
+    std::string temporaryPath = path + ".tmp" + hashToHex(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        for (const FileChunk& chunk : chunks) {
+            file.write(static_cast<const char*>(chunk.data), static_cast<std::streamsize>(chunk.size));
+        }
+        if (!file) {
+            file.close();
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    if (!MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+#endif
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool createDirectories(const std::string& path) {
+    for (size_t i = 1; i <= path.size(); ++i) {
+        if (i != path.size() && path[i] != '/' && path[i] != '\\')
+            continue;
+
+        std::string directory = path.substr(0, i);
+#ifdef _WIN32
+        if (_mkdir(directory.c_str()) != 0 && errno != EEXIST)
+            return false;
+#else
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+#endif
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef CACHE_FILE_H
+#define CACHE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only memory mapping of a whole file, used to open the on-disk caches without copying
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other);
+    MappedFile& operator=(MappedFile&& other);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return mappedData != nullptr; }
+    const unsigned char* data() const { return mappedData; }
+    size_t size() const { return mappedSize; }
+
+private:
+    const unsigned char* mappedData;
+    size_t mappedSize;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
+
+// One piece of a file written by writeFileAtomically()
+struct FileChunk {
+    const void* data;
+    size_t size;
+};
+
+// 64-bit FNV-1a; pass the previous result as seed to hash several buffers in sequence
+const uint64_t HASH_SEED = 14695981039346656037ull;
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = HASH_SEED);
+uint64_t hashString(const std::string& text, uint64_t seed = HASH_SEED);
+std::string hashToHex(uint64_t hash);
+
+bool readFile(const std::string& path, std::vector<unsigned char>& contents);
+
+// Writes to a temporary file first and renames it, so readers never see a partial entry
+bool writeFileAtomically(const std::string& path, const std::vector<FileChunk>& chunks);
+
+// Creates every missing directory along a '/' separated path
+bool createDirectories(const std::string& path);
+
+#endif // CACHE_FILE_H
@@ -0,0 +1,13 @@
+#include "CameraUniforms.h"
+#include "shader.h"
+
+void streamCameraUniforms(StreamBuffer& stream, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position) {
+    StreamAllocation allocation = stream.allocate(sizeof(CameraUniforms), stream.uniformAlignment());
+    CameraUniforms& data = *static_cast<CameraUniforms*>(allocation.data);
+    data.view = view;
+    data.projection = projection;
+    data.viewProjection = projection * view;
+    data.position = glm::vec4(position, 1.0f);
+    stream.commit(allocation);
+    stream.bindRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, allocation);
+}
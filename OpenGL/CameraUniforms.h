@@ -0,0 +1,26 @@
+#pragma once
+
+#ifndef CAMERA_UNIFORMS_H
+#define CAMERA_UNIFORMS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "StreamBuffer.h"
+
+// Per-frame camera data in std140 layout. Shaders read it by declaring
+//   layout(std140) uniform Camera { mat4 view; mat4 projection; mat4 viewProjection; vec4 cameraPosition; };
+// which Shader binds to CAMERA_BLOCK_BINDING when it links.
+struct CameraUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 position; // w = 1
+};
+
+static_assert(sizeof(CameraUniforms) == 208, "CameraUniforms must match the std140 Camera block");
+
+// Writes the frame's CameraUniforms into the stream and binds that range at CAMERA_BLOCK_BINDING,
+// so the block needs no buffer of its own or glBufferSubData
+void streamCameraUniforms(StreamBuffer& stream, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position);
+
+#endif // CAMERA_UNIFORMS_H
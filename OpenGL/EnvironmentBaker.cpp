@@ -0,0 +1,582 @@
+#include "EnvironmentBaker.h"
+#include "Simd.h"
+#include "stb_image.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#if USE_SSE2
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+const char ENVIRONMENT_CACHE_MAGIC[4] = { 'E', 'N', 'V', '1' };
+const uint32_t ENVIRONMENT_CACHE_VERSION = 1;
+const char* ENVIRONMENT_CACHE_DIRECTORY = "cache/environment/";
+
+const int RADIANCE_SIZE = 128;    // Largest radiance face; sharper reflections come from the skybox itself
+const int RADIANCE_MIPS = 6;      // 128 down to 4 texels, roughness 0, 0.2, .. 1
+const int RADIANCE_SAMPLES = 128; // GGX samples per texel
+const int IRRADIANCE_SIZE = 64;   // Largest source level projected onto SH
+const int ROWS_PER_JOB = 16;
+const float PI = 3.14159265f;
+
+struct EnvironmentCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash; // Hash of all six face files' bytes
+    uint32_t faceSize;
+    uint32_t mipCount;
+    float irradianceSH[27];
+    uint32_t reserved;
+};
+
+// GL cube map face orientation: direction = major + s * sAxis + t * tAxis, s and t in [-1, 1]
+const float FACE_AXES[6][3][3] = {
+    { { 1, 0, 0 }, { 0, 0, -1 }, { 0, -1, 0 } },
+    { { -1, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 } },
+    { { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+    { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, -1 } },
+    { { 0, 0, 1 }, { 1, 0, 0 }, { 0, -1, 0 } },
+    { { 0, 0, -1 }, { -1, 0, 0 }, { 0, -1, 0 } }
+};
+
+// Source skybox in linear light. Texels are RGBA with alpha 1, so filtering a texel scaled by its
+// weight also accumulates the weight in the fourth lane.
+struct SourceCube {
+    std::vector<int> sizes;                // Per level
+    std::vector<std::vector<float>> faces; // Index level * 6 + face
+
+    int levelCount() const { return static_cast<int>(sizes.size()); }
+    const float* face(int level, int face) const { return faces[level * 6 + face].data(); }
+};
+
+// Cache of GGX samples in tangent space; they do not depend on the texel's direction
+struct TangentSample {
+    float direction[3];
+    float weight; // N.L
+    float lod;    // Source level matching the sample's solid angle
+};
+
+float srgbToLinear(unsigned char value) {
+    float c = value / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+void faceDirection(int face, float s, float t, float direction[3]) {
+    const float (*axes)[3] = FACE_AXES[face];
+    float length = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        direction[i] = axes[0][i] + s * axes[1][i] + t * axes[2][i];
+        length += direction[i] * direction[i];
+    }
+    length = 1.0f / std::sqrt(length);
+    for (int i = 0; i < 3; ++i)
+        direction[i] *= length;
+}
+
+void directionToFace(const float direction[3], int& face, float& u, float& v) {
+    float ax = std::fabs(direction[0]), ay = std::fabs(direction[1]), az = std::fabs(direction[2]);
+    float s, t, major;
+    if (ax >= ay && ax >= az) {
+        face = direction[0] > 0.0f ? 0 : 1;
+        s = direction[0] > 0.0f ? -direction[2] : direction[2];
+        t = -direction[1];
+        major = ax;
+    }
+    else if (ay >= az) {
+        face = direction[1] > 0.0f ? 2 : 3;
+        s = direction[0];
+        t = direction[1] > 0.0f ? direction[2] : -direction[2];
+        major = ay;
+    }
+    else {
+        face = direction[2] > 0.0f ? 4 : 5;
+        s = direction[2] > 0.0f ? direction[0] : -direction[0];
+        t = -direction[1];
+        major = az;
+    }
+    u = 0.5f * (s / major + 1.0f);
+    v = 0.5f * (t / major + 1.0f);
+}
+
+// Texel coordinates and weights of a bilinear fetch, clamped to the face
+struct BilinearTaps {
+    int offsets[4];
+    float fx, fy;
+};
+
+BilinearTaps bilinearTaps(int size, float u, float v) {
+    float x = u * size - 0.5f, y = v * size - 0.5f;
+    float fx = std::floor(x), fy = std::floor(y);
+    int x0 = std::min(size - 1, std::max(0, static_cast<int>(fx)));
+    int y0 = std::min(size - 1, std::max(0, static_cast<int>(fy)));
+    int x1 = std::min(size - 1, static_cast<int>(fx) + 1);
+    int y1 = std::min(size - 1, static_cast<int>(fy) + 1);
+    x1 = std::max(0, x1);
+    y1 = std::max(0, y1);
+
+    BilinearTaps taps;
+    taps.offsets[0] = (y0 * size + x0) * 4;
+    taps.offsets[1] = (y0 * size + x1) * 4;
+    taps.offsets[2] = (y1 * size + x0) * 4;
+    taps.offsets[3] = (y1 * size + x1) * 4;
+    taps.fx = x - fx;
+    taps.fy = y - fy;
+    return taps;
+}
+
+#if USE_SSE2
+__m128 sampleBilinear(const float* texels, int size, float u, float v) {
+    BilinearTaps taps = bilinearTaps(size, u, v);
+    __m128 fx = _mm_set1_ps(taps.fx), fy = _mm_set1_ps(taps.fy);
+    __m128 t00 = _mm_loadu_ps(texels + taps.offsets[0]), t10 = _mm_loadu_ps(texels + taps.offsets[1]);
+    __m128 t01 = _mm_loadu_ps(texels + taps.offsets[2]), t11 = _mm_loadu_ps(texels + taps.offsets[3]);
+    __m128 top = _mm_add_ps(t00, _mm_mul_ps(_mm_sub_ps(t10, t00), fx));
+    __m128 bottom = _mm_add_ps(t01, _mm_mul_ps(_mm_sub_ps(t11, t01), fx));
+    return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fy));
+}
+#else
+void sampleBilinear(const float* texels, int size, float u, float v, float out[4]) {
+    BilinearTaps taps = bilinearTaps(size, u, v);
+    for (int c = 0; c < 4; ++c) {
+        float top = texels[taps.offsets[0] + c] + (texels[taps.offsets[1] + c] - texels[taps.offsets[0] + c]) * taps.fx;
+        float bottom = texels[taps.offsets[2] + c] + (texels[taps.offsets[3] + c] - texels[taps.offsets[2] + c]) * taps.fx;
+        out[c] = top + (bottom - top) * taps.fy;
+    }
+}
+#endif
+
+// Adds the trilinearly filtered source in direction, scaled by weight, to sum
+void accumulateSample(const SourceCube& cube, const float direction[3], float lod, float weight, float sum[4]) {
+    int face;
+    float u, v;
+    directionToFace(direction, face, u, v);
+
+    int level0 = std::min(cube.levelCount() - 1, static_cast<int>(lod));
+    int level1 = std::min(cube.levelCount() - 1, level0 + 1);
+    float blend = level0 == level1 ? 0.0f : lod - level0;
+
+#if USE_SSE2
+    __m128 a = sampleBilinear(cube.face(level0, face), cube.sizes[level0], u, v);
+    __m128 b = sampleBilinear(cube.face(level1, face), cube.sizes[level1], u, v);
+    __m128 texel = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(blend)));
+    _mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum), _mm_mul_ps(texel, _mm_set1_ps(weight))));
+#else
+    float a[4], b[4];
+    sampleBilinear(cube.face(level0, face), cube.sizes[level0], u, v, a);
+    sampleBilinear(cube.face(level1, face), cube.sizes[level1], u, v, b);
+    for (int c = 0; c < 4; ++c)
+        sum[c] += (a[c] + (b[c] - a[c]) * blend) * weight;
+#endif
+}
+
+// Converts one decoded face to linear RGBA and box-filters its mip chain
+void prepareFace(const unsigned char* pixels, int size, int channels, int face, SourceCube& cube) {
+    float toLinear[256];
+    for (int i = 0; i < 256; ++i)
+        toLinear[i] = srgbToLinear(static_cast<unsigned char>(i));
+
+    std::vector<float>& base = cube.faces[face];
+    base.resize(static_cast<size_t>(size) * size * 4);
+    for (int i = 0; i < size * size; ++i) {
+        for (int c = 0; c < 3; ++c)
+            base[i * 4 + c] = toLinear[pixels[i * channels + c]];
+        base[i * 4 + 3] = 1.0f;
+    }
+
+    for (int level = 1; level < cube.levelCount(); ++level) {
+        int sourceSize = cube.sizes[level - 1], targetSize = cube.sizes[level];
+        const std::vector<float>& source = cube.faces[(level - 1) * 6 + face];
+        std::vector<float>& target = cube.faces[level * 6 + face];
+        target.resize(static_cast<size_t>(targetSize) * targetSize * 4);
+        for (int y = 0; y < targetSize; ++y) {
+            for (int x = 0; x < targetSize; ++x) {
+                int x0 = std::min(2 * x, sourceSize - 1), x1 = std::min(2 * x + 1, sourceSize - 1);
+                int y0 = std::min(2 * y, sourceSize - 1), y1 = std::min(2 * y + 1, sourceSize - 1);
+                for (int c = 0; c < 4; ++c) {
+                    target[(y * targetSize + x) * 4 + c] = 0.25f * (source[(y0 * sourceSize + x0) * 4 + c] + source[(y0 * sourceSize + x1) * 4 + c]
+                                                                  + source[(y1 * sourceSize + x0) * 4 + c] + source[(y1 * sourceSize + x1) * 4 + c]);
+                }
+            }
+        }
+    }
+}
+
+float radicalInverse(unsigned int bits) {
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return static_cast<float>(bits) * 2.3283064365386963e-10f;
+}
+
+// GGX importance samples around +Z with N = V = R, as in split-sum prefiltering
+std::vector<TangentSample> ggxSamples(float roughness, int sourceSize, int targetSize) {
+    std::vector<TangentSample> samples;
+    if (roughness <= 0.0f) {
+        // Mirror: a single tap at the level whose texels match the output's
+        TangentSample mirror = { { 0.0f, 0.0f, 1.0f }, 1.0f, std::max(0.0f, std::log2(static_cast<float>(sourceSize) / targetSize)) };
+        samples.push_back(mirror);
+        return samples;
+    }
+
+    float alpha = roughness * roughness;
+    float alpha2 = alpha * alpha;
+    float texelSolidAngle = 4.0f * PI / (6.0f * sourceSize * sourceSize);
+    for (int i = 0; i < RADIANCE_SAMPLES; ++i) {
+        float u1 = (i + 0.5f) / RADIANCE_SAMPLES;
+        float u2 = radicalInverse(static_cast<unsigned int>(i));
+        float phi = 2.0f * PI * u1;
+        float cosTheta = std::sqrt((1.0f - u2) / (1.0f + (alpha2 - 1.0f) * u2));
+        float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+        // Reflect V = N = +Z about the half vector
+        float h[3] = { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta };
+        TangentSample sample;
+        sample.direction[0] = 2.0f * cosTheta * h[0];
+        sample.direction[1] = 2.0f * cosTheta * h[1];
+        sample.direction[2] = 2.0f * cosTheta * cosTheta - 1.0f;
+        sample.weight = sample.direction[2];
+        if (sample.weight <= 0.0f)
+            continue;
+
+        // Filtered importance sampling: fetch from the level whose texels cover the sample's solid angle
+        float denominator = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+        float distribution = alpha2 / (PI * denominator * denominator);
+        float pdf = distribution * 0.25f;
+        float sampleSolidAngle = 1.0f / (RADIANCE_SAMPLES * pdf + 1e-6f);
+        sample.lod = std::max(0.0f, 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f);
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+// Prefilters rows [firstRow, endRow) of one face of one radiance level
+void prefilterRows(const SourceCube& cube, const std::vector<TangentSample>& samples, int size, int face, int firstRow, int endRow, float* out) {
+    for (int y = firstRow; y < endRow; ++y) {
+        for (int x = 0; x < size; ++x) {
+            float n[3];
+            faceDirection(face, 2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f, n);
+
+            // Tangent frame around the texel direction
+            float up[3] = { 0.0f, 0.0f, 1.0f };
+            if (std::fabs(n[2]) > 0.999f) {
+                up[0] = 1.0f;
+                up[2] = 0.0f;
+            }
+            float tangent[3] = { up[1] * n[2] - up[2] * n[1], up[2] * n[0] - up[0] * n[2], up[0] * n[1] - up[1] * n[0] };
+            float length = 1.0f / std::sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+            for (int i = 0; i < 3; ++i)
+                tangent[i] *= length;
+            float bitangent[3] = { n[1] * tangent[2] - n[2] * tangent[1], n[2] * tangent[0] - n[0] * tangent[2], n[0] * tangent[1] - n[1] * tangent[0] };
+
+            float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (const TangentSample& sample : samples) {
+                float direction[3];
+                for (int i = 0; i < 3; ++i)
+                    direction[i] = tangent[i] * sample.direction[0] + bitangent[i] * sample.direction[1] + n[i] * sample.direction[2];
+                accumulateSample(cube, direction, sample.lod, sample.weight, sum);
+            }
+
+            float* texel = out + (static_cast<size_t>(y) * size + x) * 3;
+            float weight = sum[3] > 0.0f ? 1.0f / sum[3] : 0.0f;
+            texel[0] = sum[0] * weight;
+            texel[1] = sum[1] * weight;
+            texel[2] = sum[2] * weight;
+        }
+    }
+}
+
+void shBasis(float x, float y, float z, float basis[9]) {
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * y;
+    basis[2] = 0.488603f * z;
+    basis[3] = 0.488603f * x;
+    basis[4] = 1.092548f * x * y;
+    basis[5] = 1.092548f * y * z;
+    basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+    basis[7] = 1.092548f * x * z;
+    basis[8] = 0.546274f * (x * x - y * y);
+}
+
+// Projects one face of the given source level onto SH, weighting texels by their solid angle
+void projectFace(const SourceCube& cube, int level, int face, float coefficients[27]) {
+    const int size = cube.sizes[level];
+    const float* texels = cube.face(level, face);
+    const float (*axes)[3] = FACE_AXES[face];
+    const float texelArea = (2.0f / size) * (2.0f / size);
+    std::fill(coefficients, coefficients + 27, 0.0f);
+
+    for (int y = 0; y < size; ++y) {
+        float t = 2.0f * (y + 0.5f) / size - 1.0f;
+        int x = 0;
+#if USE_SSE2
+        // Four texels of the row at a time, directions and colors transposed to one lane per texel
+        __m128 sums[27];
+        for (int k = 0; k < 27; ++k)
+            sums[k] = _mm_setzero_ps();
+        const __m128 step = _mm_set1_ps(2.0f / size);
+        for (; x + 4 <= size; x += 4) {
+            __m128 s = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f), _mm_set1_ps(static_cast<float>(x))), step), _mm_set1_ps(1.0f));
+            __m128 d[3];
+            for (int i = 0; i < 3; ++i)
+                d[i] = _mm_add_ps(_mm_set1_ps(axes[0][i] + t * axes[2][i]), _mm_mul_ps(s, _mm_set1_ps(axes[1][i])));
+            __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[1], d[1])), _mm_mul_ps(d[2], d[2]));
+            __m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2));
+            // Solid angle of a texel on the unit cube: area / distance^3
+            __m128 solidAngle = _mm_mul_ps(_mm_set1_ps(texelArea), _mm_mul_ps(inverseLength, _mm_mul_ps(inverseLength, inverseLength)));
+            for (int i = 0; i < 3; ++i)
+                d[i] = _mm_mul_ps(d[i], inverseLength);
+
+            __m128 r = _mm_loadu_ps(texels + (y * size + x) * 4);
+            __m128 g = _mm_loadu_ps(texels + (y * size + x + 1) * 4);
+            __m128 b = _mm_loadu_ps(texels + (y * size + x + 2) * 4);
+            __m128 a = _mm_loadu_ps(texels + (y * size + x + 3) * 4);
+            _MM_TRANSPOSE4_PS(r, g, b, a);
+            __m128 colors[3] = { _mm_mul_ps(r, solidAngle), _mm_mul_ps(g, solidAngle), _mm_mul_ps(b, solidAngle) };
+
+            __m128 basis[9];
+            basis[0] = _mm_set1_ps(0.282095f);
+            basis[1] = _mm_mul_ps(_mm_set1_ps(0.488603f), d[1]);
+            basis[2] = _mm_mul_ps(_mm_set1_ps(0.488603f), d[2]);
+            basis[3] = _mm_mul_ps(_mm_set1_ps(0.488603f), d[0]);
+            basis[4] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(d[0], d[1]));
+            basis[5] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(d[1], d[2]));
+            basis[6] = _mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(d[2], d[2])), _mm_set1_ps(1.0f)));
+            basis[7] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(d[0], d[2]));
+            basis[8] = _mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[1], d[1])));
+            for (int k = 0; k < 9; ++k) {
+                for (int c = 0; c < 3; ++c)
+                    sums[k * 3 + c] = _mm_add_ps(sums[k * 3 + c], _mm_mul_ps(basis[k], colors[c]));
+            }
+        }
+        for (int k = 0; k < 27; ++k) {
+            alignas(16) float lanes[4];
+            _mm_store_ps(lanes, sums[k]);
+            coefficients[k] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        }
+#endif
+        for (; x < size; ++x) {
+            float s = 2.0f * (x + 0.5f) / size - 1.0f;
+            float d[3];
+            for (int i = 0; i < 3; ++i)
+                d[i] = axes[0][i] + s * axes[1][i] + t * axes[2][i];
+            float inverseLength = 1.0f / std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            float solidAngle = texelArea * inverseLength * inverseLength * inverseLength;
+
+            float basis[9];
+            shBasis(d[0] * inverseLength, d[1] * inverseLength, d[2] * inverseLength, basis);
+            const float* texel = texels + (y * size + x) * 4;
+            for (int k = 0; k < 9; ++k) {
+                for (int c = 0; c < 3; ++c)
+                    coefficients[k * 3 + c] += basis[k] * texel[c] * solidAngle;
+            }
+        }
+    }
+}
+
+bool bakeSourceCube(const SourceCube& cube, EnvironmentMap& environment) {
+    int faceSize = std::min(RADIANCE_SIZE, cube.sizes[0]);
+    int mipCount = 0;
+    size_t totalFloats = 0;
+    for (int size = faceSize; size >= 1 && mipCount < RADIANCE_MIPS; size /= 2, ++mipCount)
+        totalFloats += static_cast<size_t>(size) * size * 3 * 6;
+
+    environment.faceSize = faceSize;
+    environment.mipCount = mipCount;
+    environment.mapping.close();
+    environment.storage.assign(totalFloats, 0.0f);
+    environment.faces.clear();
+    size_t offset = 0;
+    for (int level = 0; level < mipCount; ++level) {
+        int size = faceSize >> level;
+        for (int face = 0; face < 6; ++face) {
+            environment.faces.push_back(environment.storage.data() + offset);
+            offset += static_cast<size_t>(size) * size * 3;
+        }
+    }
+
+    // One job per band of rows; every level's samples are shared by all of its jobs
+    struct BandJob {
+        int level, face, firstRow, endRow;
+    };
+    std::vector<std::vector<TangentSample>> samples;
+    std::vector<BandJob> jobs;
+    for (int level = 0; level < mipCount; ++level) {
+        int size = faceSize >> level;
+        float roughness = mipCount > 1 ? static_cast<float>(level) / (mipCount - 1) : 0.0f;
+        samples.push_back(ggxSamples(roughness, cube.sizes[0], size));
+        for (int face = 0; face < 6; ++face) {
+            for (int row = 0; row < size; row += ROWS_PER_JOB) {
+                BandJob job = { level, face, row, std::min(size, row + ROWS_PER_JOB) };
+                jobs.push_back(job);
+            }
+        }
+    }
+
+    JobSystem& jobSystem = JobSystem::shared();
+    jobSystem.parallelFor(static_cast<unsigned int>(jobs.size()), [&](unsigned int index) {
+        const BandJob& job = jobs[index];
+        float* out = const_cast<float*>(environment.face(job.level, job.face));
+        prefilterRows(cube, samples[job.level], faceSize >> job.level, job.face, job.firstRow, job.endRow, out);
+    });
+
+    // Irradiance from a small source level; SH9 cannot hold more detail than that anyway
+    int shLevel = 0;
+    while (shLevel + 1 < cube.levelCount() && cube.sizes[shLevel] > IRRADIANCE_SIZE)
+        ++shLevel;
+    float faceCoefficients[6][27];
+    jobSystem.parallelFor(6, [&](unsigned int face) {
+        projectFace(cube, shLevel, static_cast<int>(face), faceCoefficients[face]);
+    });
+
+    // Convolve with the clamped cosine lobe (pi, 2pi/3, pi/4 per band) and divide by pi
+    const float bandScale[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+    for (int k = 0; k < 9; ++k) {
+        for (int c = 0; c < 3; ++c) {
+            float sum = 0.0f;
+            for (int face = 0; face < 6; ++face)
+                sum += faceCoefficients[face][k * 3 + c];
+            environment.irradianceSH[k][c] = sum * bandScale[k];
+        }
+    }
+    return true;
+}
+
+bool openCacheEntry(const std::string& cachePath, uint64_t sourceHash, EnvironmentMap& environment) {
+    MappedFile mapping;
+    if (!mapping.open(cachePath) || mapping.size() < sizeof(EnvironmentCacheHeader))
+        return false;
+
+    EnvironmentCacheHeader header;
+    std::memcpy(&header, mapping.data(), sizeof(header));
+    if (std::memcmp(header.magic, ENVIRONMENT_CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != ENVIRONMENT_CACHE_VERSION
+        || header.sourceHash != sourceHash
+        || header.faceSize == 0 || header.mipCount == 0 || header.mipCount > RADIANCE_MIPS
+        || (header.faceSize >> (header.mipCount - 1)) == 0)
+        return false;
+
+    size_t offset = sizeof(header);
+    environment.faces.clear();
+    for (uint32_t level = 0; level < header.mipCount; ++level) {
+        size_t size = header.faceSize >> level;
+        for (int face = 0; face < 6; ++face) {
+            environment.faces.push_back(reinterpret_cast<const float*>(mapping.data() + offset));
+            offset += size * size * 3 * sizeof(float);
+        }
+    }
+    if (offset > mapping.size())
+        return false; // Truncated entry
+
+    environment.faceSize = static_cast<int>(header.faceSize);
+    environment.mipCount = static_cast<int>(header.mipCount);
+    std::memcpy(environment.irradianceSH, header.irradianceSH, sizeof(environment.irradianceSH));
+    environment.storage.clear();
+    environment.mapping = std::move(mapping);
+    return true;
+}
+
+void writeCacheEntry(const std::string& cachePath, uint64_t sourceHash, const EnvironmentMap& environment) {
+    EnvironmentCacheHeader header = {};
+    std::memcpy(header.magic, ENVIRONMENT_CACHE_MAGIC, sizeof(header.magic));
+    header.version = ENVIRONMENT_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.faceSize = static_cast<uint32_t>(environment.faceSize);
+    header.mipCount = static_cast<uint32_t>(environment.mipCount);
+    std::memcpy(header.irradianceSH, environment.irradianceSH, sizeof(header.irradianceSH));
+
+    std::vector<FileChunk> chunks;
+    chunks.push_back({ &header, sizeof(header) });
+    chunks.push_back({ environment.storage.data(), environment.storage.size() * sizeof(float) });
+    if (!writeFileAtomically(cachePath, chunks))
+        std::cerr << "Failed to write environment cache entry: " << cachePath << std::endl;
+}
+
+} // namespace
+
+bool bakeEnvironmentFromPixels(const std::vector<const unsigned char*>& faces, int faceSize, int channels, EnvironmentMap& environment) {
+    if (faces.size() != 6 || faceSize <= 0 || channels < 3)
+        return false;
+
+    SourceCube cube;
+    for (int size = faceSize; ; size = std::max(1, size / 2)) {
+        cube.sizes.push_back(size);
+        if (size == 1)
+            break;
+    }
+    cube.faces.resize(cube.sizes.size() * 6);
+
+    JobSystem::shared().parallelFor(6, [&](unsigned int face) {
+        prepareFace(faces[face], faceSize, channels, static_cast<int>(face), cube);
+    });
+    return bakeSourceCube(cube, environment);
+}
+
+bool bakeEnvironment(const std::vector<std::string>& faces, EnvironmentMap& environment) {
+    PROFILE_SCOPE("bakeEnvironment");
+    if (faces.size() != 6) {
+        std::cerr << "Environment bake needs six cube faces" << std::endl;
+        return false;
+    }
+
+    std::vector<std::vector<unsigned char>> files(6);
+    uint64_t sourceHash = HASH_SEED;
+    for (size_t i = 0; i < faces.size(); ++i) {
+        if (!readFile(faces[i], files[i])) {
+            std::cerr << "Failed to read environment face: " << faces[i] << std::endl;
+            return false;
+        }
+        sourceHash = hashBytes(files[i].data(), files[i].size(), sourceHash);
+    }
+
+    std::string cachePath = ENVIRONMENT_CACHE_DIRECTORY + hashToHex(sourceHash) + ".env";
+    if (openCacheEntry(cachePath, sourceHash, environment))
+        return true;
+
+    // Decode the six faces in parallel; they must be square and share one size
+    std::vector<unsigned char*> pixels(6, nullptr);
+    int sizes[6][2];
+    JobSystem::shared().parallelFor(6, [&](unsigned int face) {
+        int channels;
+        pixels[face] = stbi_load_from_memory(files[face].data(), static_cast<int>(files[face].size()), &sizes[face][0], &sizes[face][1], &channels, 3);
+    });
+
+    bool valid = true;
+    for (int face = 0; face < 6; ++face) {
+        if (!pixels[face] || sizes[face][0] != sizes[face][1] || sizes[face][0] != sizes[0][0]) {
+            std::cerr << "Environment face is missing or not a matching square: " << faces[face] << std::endl;
+            valid = false;
+        }
+    }
+
+    bool baked = false;
+    if (valid) {
+        std::vector<const unsigned char*> facePixels(pixels.begin(), pixels.end());
+        baked = bakeEnvironmentFromPixels(facePixels, sizes[0][0], 3, environment);
+    }
+    for (unsigned char* face : pixels) {
+        if (face)
+            stbi_image_free(face);
+    }
+
+    if (baked)
+        writeCacheEntry(cachePath, sourceHash, environment);
+    return baked;
+}
+
+void evaluateIrradiance(const EnvironmentMap& environment, const float normal[3], float irradiance[3]) {
+    float basis[9];
+    shBasis(normal[0], normal[1], normal[2], basis);
+    for (int c = 0; c < 3; ++c) {
+        irradiance[c] = 0.0f;
+        for (int k = 0; k < 9; ++k)
+            irradiance[c] += basis[k] * environment.irradianceSH[k][c];
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef ENVIRONMENT_BAKER_H
+#define ENVIRONMENT_BAKER_H
+
+#include <string>
+#include <vector>
+#include "CacheFile.h"
+
+// Image-based lighting baked from a skybox: a GGX-prefiltered radiance cubemap whose level i is
+// filtered for roughness i / (mipCount - 1), plus the diffuse irradiance as 9 SH coefficients
+struct EnvironmentMap {
+    int faceSize = 0; // Radiance level 0
+    int mipCount = 0;
+    float irradianceSH[9][3]; // Convolved with the cosine lobe and divided by pi: multiply by albedo directly
+    std::vector<const float*> faces; // Linear RGB float texels, index level * 6 + face
+
+    std::vector<float> storage; // Owns the levels after a bake
+    MappedFile mapping;         // Owns the levels on a cache hit
+
+    const float* face(int level, int face) const { return faces[level * 6 + face]; }
+};
+
+// Bakes the environment of the six cube faces (GL order: +X, -X, +Y, -Y, +Z, -Z), or maps the
+// cached bake when the face images are unchanged. Runs in parallel on JobSystem::shared() and
+// waits for it.
+bool bakeEnvironment(const std::vector<std::string>& faces, EnvironmentMap& environment);
+
+// Same bake from decoded sRGB faces (square, faceSize texels wide, 3 or 4 channels), without the cache
+bool bakeEnvironmentFromPixels(const std::vector<const unsigned char*>& faces, int faceSize, int channels, EnvironmentMap& environment);
+
+// Diffuse irradiance / pi for a unit normal
+void evaluateIrradiance(const EnvironmentMap& environment, const float normal[3], float irradiance[3]);
+
+#endif // ENVIRONMENT_BAKER_H
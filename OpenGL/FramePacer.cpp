@@ -0,0 +1,172 @@
+#include "FramePacer.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Sorts the first count samples of the ring and fills the percentiles; count may exceed the ring
+void percentiles(const std::vector<float>& ring, size_t count, double& p50, double& p90, double& p99, double& max) {
+    std::vector<float> sorted(ring.begin(), ring.begin() + std::min(count, ring.size()));
+    if (sorted.empty())
+        return;
+    std::sort(sorted.begin(), sorted.end());
+    auto at = [&sorted](double fraction) {
+        return static_cast<double>(sorted[static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5)]);
+    };
+    p50 = at(0.5);
+    p90 = at(0.9);
+    p99 = at(0.99);
+    max = sorted.back();
+}
+
+} // namespace
+
+FixedTimestep::FixedTimestep(double step, int maxSteps) : stepSeconds(step), maxSteps(maxSteps) {}
+
+int FixedTimestep::advance(double now) {
+    if (lastTime < 0.0) {
+        lastTime = now;
+        return 0;
+    }
+    accumulator += now - lastTime;
+    lastTime = now;
+
+    int count = static_cast<int>(accumulator / stepSeconds);
+    if (count > maxSteps) {
+        dropped += (count - maxSteps) * stepSeconds;
+        accumulator -= (count - maxSteps) * stepSeconds;
+        count = maxSteps;
+    }
+    accumulator = std::max(0.0, accumulator - count * stepSeconds);
+    steps += count;
+    return count;
+}
+
+SwapMode FramePacer::setSwapMode(SwapMode requested) {
+    int interval = 1;
+    mode = requested;
+    if (requested == SwapMode::Uncapped) {
+        interval = 0;
+    }
+    else if (requested == SwapMode::Adaptive) {
+        // A negative interval swaps late frames at once
+        if (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+            interval = -1;
+        else
+            mode = SwapMode::VSync;
+    }
+    glfwSwapInterval(interval);
+    return mode;
+}
+
+void FramePacer::beginFrame() {
+    double now = glfwGetTime();
+    if (frameTimes.empty()) {
+        frameTimes.resize(HISTORY);
+        latencies.resize(HISTORY);
+    }
+    if (frameStart >= 0.0) {
+        frameTimes[frameCount % HISTORY] = static_cast<float>((now - frameStart) * 1000.0);
+        ++frameCount;
+    }
+    frameStart = now;
+
+    // The GL clock may drift from the CPU's; keep the offset fresh
+    if (frameCount % 1024 == 0)
+        calibrate();
+
+    while (pending > 0 && retire(false)) {
+    }
+    if (maxFramesInFlight > 0 && pending >= maxFramesInFlight) {
+        PROFILE_SCOPE("Frames in flight wait");
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        while (pending >= maxFramesInFlight)
+            retire(true);
+        ++fenceWaits;
+        fenceWaitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    if (lateInput)
+        glfwPollEvents();
+}
+
+void FramePacer::inputSampled() {
+    inputTime = glfwGetTime();
+}
+
+void FramePacer::endFrame(GLFWwindow* window) {
+    {
+        PROFILE_SCOPE("glfwSwapBuffers");
+        glfwSwapBuffers(window);
+    }
+
+    if (pending == MAX_FRAMES_IN_FLIGHT)
+        retire(true);
+    InFlight& frame = frames[(oldest + pending) % MAX_FRAMES_IN_FLIGHT];
+    if (frame.query == 0)
+        glGenQueries(1, &frame.query);
+    glQueryCounter(frame.query, GL_TIMESTAMP);
+    frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame.inputTime = inputTime;
+    ++pending;
+
+    if (!lateInput)
+        glfwPollEvents();
+}
+
+void FramePacer::release() {
+    for (InFlight& frame : frames) {
+        if (frame.fence)
+            glDeleteSync(frame.fence);
+        if (frame.query != 0)
+            glDeleteQueries(1, &frame.query);
+        frame = InFlight();
+    }
+    oldest = 0;
+    pending = 0;
+}
+
+FramePacingStats FramePacer::stats() const {
+    FramePacingStats result;
+    result.frames = frameCount;
+    percentiles(frameTimes, frameCount, result.frameP50, result.frameP90, result.frameP99, result.frameMax);
+    result.latencySamples = latencyCount;
+    percentiles(latencies, latencyCount, result.latencyP50, result.latencyP90, result.latencyP99, result.latencyMax);
+    result.fenceWaits = fenceWaits;
+    result.fenceWaitMilliseconds = fenceWaitMilliseconds;
+    return result;
+}
+
+void FramePacer::calibrate() {
+    GLint64 timestamp = 0;
+    glGetInteger64v(GL_TIMESTAMP, &timestamp);
+    gpuClockOffset = timestamp * 1.0e-9 - glfwGetTime();
+}
+
+bool FramePacer::retire(bool wait) {
+    InFlight& frame = frames[oldest];
+    GLenum result = glClientWaitSync(frame.fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        if (!wait)
+            return false;
+        do {
+            result = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        } while (result == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(frame.fence);
+    frame.fence = nullptr;
+
+    // The fence follows the query, so its result is ready
+    GLuint64 timestamp = 0;
+    glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &timestamp);
+    double latency = (timestamp * 1.0e-9 - gpuClockOffset - frame.inputTime) * 1000.0;
+    if (latency >= 0.0) {
+        latencies[latencyCount % HISTORY] = static_cast<float>(latency);
+        ++latencyCount;
+    }
+
+    oldest = (oldest + 1) % MAX_FRAMES_IN_FLIGHT;
+    --pending;
+    return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// How buffer swaps wait for the display
+enum class SwapMode {
+    VSync,    // Every swap waits for the vertical blank
+    Adaptive, // Waits for the vertical blank unless the frame is late, then tears instead of
+              // dropping to half rate; VSync where the swap_control_tear extension is missing
+    Uncapped  // Never waits
+};
+
+// Simulation at a fixed step, decoupled from the frame rate. advance() turns elapsed real time
+// into whole steps; alpha() is where the rendered moment lies between the last two simulated
+// states, for interpolating them.
+class FixedTimestep {
+public:
+    // After a long frame at most maxSteps are simulated; the rest of the time is dropped so that
+    // a slow frame cannot make the next one slower
+    explicit FixedTimestep(double step = 1.0 / 120.0, int maxSteps = 8);
+
+    // Steps to simulate for the real time now, in seconds; the first call starts the clock
+    int advance(double now);
+
+    double step() const { return stepSeconds; }
+    float alpha() const { return static_cast<float>(accumulator / stepSeconds); } // [0, 1)
+    size_t stepCount() const { return steps; }
+    double droppedSeconds() const { return dropped; }
+
+private:
+    double stepSeconds;
+    int maxSteps;
+    double accumulator = 0.0;
+    double lastTime = -1.0;
+    size_t steps = 0;
+    double dropped = 0.0;
+};
+
+// Over the last FramePacer::HISTORY frames, in milliseconds
+struct FramePacingStats {
+    size_t frames = 0;
+    double frameP50 = 0.0, frameP90 = 0.0, frameP99 = 0.0, frameMax = 0.0; // Start to start
+    // From inputSampled() to the GPU reaching the end of the frame's swap
+    size_t latencySamples = 0;
+    double latencyP50 = 0.0, latencyP90 = 0.0, latencyP99 = 0.0, latencyMax = 0.0;
+    size_t fenceWaits = 0;             // Frames that waited for the frames-in-flight cap
+    double fenceWaitMilliseconds = 0.0;
+};
+
+// Paces the render loop and measures it. Every swap is followed by a fence, to cap the frames the
+// CPU may queue ahead of the GPU, and a timestamp query, to see when the GPU finished the frame.
+// Queued frames add their length to input latency; a cap of one trades throughput for the
+// shortest delay. With late input, events are polled right before the frame samples them rather
+// than right after the previous swap. Needs a current GL context.
+//   beginFrame(); sample input; inputSampled(); build and submit; endFrame(window);
+class FramePacer {
+public:
+    static const int MAX_FRAMES_IN_FLIGHT = 4;
+    static const size_t HISTORY = 4096;
+
+    // Returns the mode applied, VSync when Adaptive is not available
+    SwapMode setSwapMode(SwapMode mode);
+    // 0 leaves it to the driver (at most MAX_FRAMES_IN_FLIGHT are tracked)
+    void setMaxFramesInFlight(int frames) { maxFramesInFlight = frames; }
+    void setLateInput(bool late) { lateInput = late; }
+
+    void beginFrame();
+    void inputSampled();
+    void endFrame(GLFWwindow* window);
+    void release();
+
+    SwapMode swapMode() const { return mode; }
+    int framesInFlight() const { return maxFramesInFlight; }
+    bool isLateInput() const { return lateInput; }
+    FramePacingStats stats() const;
+
+private:
+    struct InFlight {
+        GLsync fence;
+        GLuint query;
+        double inputTime;
+    };
+
+    SwapMode mode = SwapMode::VSync;
+    int maxFramesInFlight = 0;
+    bool lateInput = false;
+    InFlight frames[MAX_FRAMES_IN_FLIGHT] = {}; // Ring; queries are created on first use
+    int oldest = 0, pending = 0;
+    double inputTime = 0.0, frameStart = -1.0;
+    double gpuClockOffset = 0.0; // GL timestamp minus glfwGetTime(), in seconds
+    size_t frameCount = 0;
+    std::vector<float> frameTimes, latencies; // Rings of HISTORY, in milliseconds
+    size_t latencyCount = 0;
+    size_t fenceWaits = 0;
+    double fenceWaitMilliseconds = 0.0;
+
+    void calibrate();
+    // Records the oldest frame in flight once the GPU has finished it; false if it has not and
+    // wait is false
+    bool retire(bool wait);
+};
+
+#endif // FRAME_PACER_H
@@ -0,0 +1,53 @@
+#include "Frustum.h"
+#include <cmath>
+
+AABB transformBounds(const AABB& box, const glm::mat4& transform) {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+
+    glm::vec3 newCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+    glm::vec3 newExtent(0.0f);
+    for (int column = 0; column < 3; ++column) {
+        for (int row = 0; row < 3; ++row)
+            newExtent[row] += std::fabs(transform[column][row]) * extent[column];
+    }
+
+    AABB result = { newCenter - newExtent, newCenter + newExtent };
+    return result;
+}
+
+Frustum extractFrustum(const glm::mat4& viewProjection) {
+    // Row i of the matrix; glm stores columns
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    Frustum frustum;
+    for (int axis = 0; axis < 3; ++axis) {
+        frustum.planes[axis * 2] = rows[3] + rows[axis];
+        frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+    }
+    for (glm::vec4& plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+bool intersectsSphere(const Frustum& frustum, const glm::vec3& center, float radius) {
+    for (const glm::vec4& plane : frustum.planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool intersectsBox(const Frustum& frustum, const AABB& box) {
+    for (const glm::vec4& plane : frustum.planes) {
+        // The corner furthest along the plane normal
+        glm::vec3 corner(plane.x >= 0.0f ? box.max.x : box.min.x,
+                         plane.y >= 0.0f ? box.max.y : box.min.y,
+                         plane.z >= 0.0f ? box.max.z : box.min.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
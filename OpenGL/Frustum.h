@@ -0,0 +1,34 @@
+#pragma once
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// Axis-aligned bounding box
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Smallest box containing box after the transform (Arvo's method)
+AABB transformBounds(const AABB& box, const glm::mat4& transform);
+
+// View frustum as six inward-facing planes: left, right, bottom, top, near, far. Each plane is
+// (normal, distance) with a unit normal, so dot(normal, p) + distance is a signed distance.
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Planes of clip space pulled back through the matrix (Gribb/Hartmann). Pass projection * view
+// for a world-space frustum, or projection * view * model for the frustum in model space.
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+// False when the sphere is entirely outside one of the planes
+bool intersectsSphere(const Frustum& frustum, const glm::vec3& center, float radius);
+
+// False when the box is entirely outside one of the planes. Boxes that straddle two planes near a
+// frustum corner pass, as with any plane test.
+bool intersectsBox(const Frustum& frustum, const AABB& box);
+
+#endif // FRUSTUM_H
@@ -0,0 +1,244 @@
+#include "GeometryArena.h"
+#include "LevelGeometry.h"
+#include "QuantizedVertex.h"
+#include <algorithm>
+
+RangeAllocator::RangeAllocator(uint32_t capacity) : total(capacity), available(capacity) {
+    if (capacity > 0)
+        freeRanges[0] = capacity;
+}
+
+bool RangeAllocator::allocate(uint32_t size, uint32_t& offset) {
+    if (size == 0) {
+        offset = 0;
+        return true;
+    }
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->second < size)
+            continue;
+        offset = it->first;
+        uint32_t remaining = it->second - size;
+        freeRanges.erase(it);
+        if (remaining > 0)
+            freeRanges[offset + size] = remaining;
+        available -= size;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size) {
+    if (size == 0)
+        return;
+    available += size;
+
+    auto next = freeRanges.lower_bound(offset);
+    if (next != freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            // Extend the free range before
+            offset = previous->first;
+            size += previous->second;
+            freeRanges.erase(previous);
+        }
+    }
+    if (next != freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        freeRanges.erase(next);
+    }
+    freeRanges[offset] = size;
+}
+
+void RangeAllocator::grow(uint32_t newCapacity) {
+    if (newCapacity <= total)
+        return;
+    uint32_t oldCapacity = total;
+    total = newCapacity;
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+bool GeometryArena::isSupported() {
+    return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object);
+}
+
+void GeometryArena::create(VertexFormat vertexFormat, uint32_t vertexCapacity, uint32_t indexCapacity) {
+    format = vertexFormat;
+    vertexSize = format == VertexFormat::Quantized ? sizeof(QuantizedVertex) : sizeof(Vertex);
+    vertexRanges = RangeAllocator(vertexCapacity);
+    indexRanges = RangeAllocator(indexCapacity);
+
+    glGenVertexArrays(1, &VAO);
+    GLuint buffers[3];
+    glGenBuffers(3, buffers);
+    VBO = buffers[0];
+    EBO = buffers[1];
+    drawIdBuffer = buffers[2];
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * vertexSize, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    setupVertexArray();
+}
+
+void GeometryArena::release() {
+    GLuint buffers[3] = { VBO, EBO, drawIdBuffer };
+    glDeleteBuffers(3, buffers);
+    glDeleteVertexArrays(1, &VAO);
+    VAO = VBO = EBO = drawIdBuffer = 0;
+    drawCapacity = 0;
+    vertexRanges = RangeAllocator();
+    indexRanges = RangeAllocator();
+}
+
+void GeometryArena::setupVertexArray() {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (format == VertexFormat::Quantized)
+        QuantizedVertexLayout::setup();
+    else
+        StandardVertexLayout::setup();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    // The draw's index, advanced once per instance, so it starts at each command's base instance
+    glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+    glEnableVertexAttribArray(DRAW_ID_LOCATION);
+    glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), nullptr);
+    glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::growBuffer(GLuint& buffer, size_t oldBytes, size_t newBytes) {
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    buffer = grown;
+}
+
+ArenaAllocation GeometryArena::allocate(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount) {
+    ArenaAllocation allocation;
+    allocation.vertexCount = static_cast<uint32_t>(vertexCount);
+    allocation.indexCount = static_cast<uint32_t>(indexCount);
+
+    // Grow to at least double so that a run of allocations copies the buffers only a few times
+    if (!vertexRanges.allocate(allocation.vertexCount, allocation.firstVertex)) {
+        uint32_t capacity = std::max(vertexRanges.capacity() * 2, vertexRanges.capacity() + allocation.vertexCount);
+        growBuffer(VBO, vertexRanges.capacity() * vertexSize, capacity * vertexSize);
+        vertexRanges.grow(capacity);
+        vertexRanges.allocate(allocation.vertexCount, allocation.firstVertex);
+        setupVertexArray();
+    }
+    if (!indexRanges.allocate(allocation.indexCount, allocation.firstIndex)) {
+        uint32_t capacity = std::max(indexRanges.capacity() * 2, indexRanges.capacity() + allocation.indexCount);
+        growBuffer(EBO, indexRanges.capacity() * sizeof(GLuint), capacity * sizeof(GLuint));
+        indexRanges.grow(capacity);
+        indexRanges.allocate(allocation.indexCount, allocation.firstIndex);
+        setupVertexArray();
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    if (format == VertexFormat::Quantized) {
+        QuantizationBounds bounds = computeQuantizationBounds(vertices, vertexCount);
+        std::vector<QuantizedVertex> quantized(vertexCount);
+        quantizeVertices(vertices, vertexCount, bounds, quantized.data());
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.firstVertex * vertexSize, vertexCount * vertexSize, quantized.data());
+        allocation.positionDecode = positionDecodeMatrix(bounds);
+    }
+    else {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.firstVertex * vertexSize, vertexCount * vertexSize, vertices);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.firstIndex * sizeof(GLuint), indexCount * sizeof(GLuint), indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return allocation;
+}
+
+void GeometryArena::free(const ArenaAllocation& allocation) {
+    vertexRanges.free(allocation.firstVertex, allocation.vertexCount);
+    indexRanges.free(allocation.firstIndex, allocation.indexCount);
+}
+
+void GeometryArena::clearDraws() {
+    pending.clear();
+}
+
+void GeometryArena::addDraw(const ArenaAllocation& allocation, uint32_t firstIndex, uint32_t indexCount, const glm::mat4& model, uint32_t material) {
+    PendingDraw draw;
+    draw.material = material;
+    draw.command.count = indexCount;
+    draw.command.instanceCount = 1;
+    draw.command.firstIndex = allocation.firstIndex + firstIndex;
+    draw.command.baseVertex = static_cast<GLint>(allocation.firstVertex);
+    draw.command.baseInstance = 0; // Set in flush()
+    draw.model = model * allocation.positionDecode;
+    pending.push_back(draw);
+}
+
+void GeometryArena::reserveDraws(uint32_t count) {
+    if (count <= drawCapacity)
+        return;
+    drawCapacity = std::max(count, drawCapacity * 2);
+
+    // drawId i is simply i
+    std::vector<GLuint> drawIds(drawCapacity);
+    for (uint32_t i = 0; i < drawCapacity; ++i)
+        drawIds[i] = i;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, drawIdBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, drawIds.size() * sizeof(GLuint), drawIds.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GeometryArena::flush(StreamBuffer& stream, const std::function<void(uint32_t)>& bindMaterial, ArenaDrawStats& stats) {
+    if (pending.empty())
+        return;
+
+    std::sort(pending.begin(), pending.end(), [](const PendingDraw& a, const PendingDraw& b) {
+        return a.material < b.material;
+    });
+    reserveDraws(static_cast<uint32_t>(pending.size()));
+
+    // Written straight into the stream; commands need 4-byte alignment, the draw data the
+    // storage buffer offset alignment
+    StreamAllocation drawData = stream.allocate(pending.size() * sizeof(DrawData), stream.storageAlignment());
+    StreamAllocation commands = stream.allocate(pending.size() * sizeof(DrawElementsIndirectCommand), sizeof(GLuint));
+    DrawData* draws = static_cast<DrawData*>(drawData.data);
+    DrawElementsIndirectCommand* drawCommands = static_cast<DrawElementsIndirectCommand*>(commands.data);
+    for (size_t i = 0; i < pending.size(); ++i) {
+        DrawData data = {};
+        data.model = pending[i].model;
+        data.material = pending[i].material;
+        draws[i] = data;
+        drawCommands[i] = pending[i].command;
+        drawCommands[i].baseInstance = static_cast<GLuint>(i);
+    }
+    stream.commit(drawData);
+    stream.commit(commands);
+    stream.bindRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawData);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+
+    glBindVertexArray(VAO);
+    for (size_t first = 0; first < pending.size();) {
+        // Without bindMaterial the shader finds each draw's textures itself: one call for all
+        size_t end = bindMaterial ? first + 1 : pending.size();
+        while (end < pending.size() && pending[end].material == pending[first].material)
+            ++end;
+        if (bindMaterial)
+            bindMaterial(pending[first].material);
+        const void* offset = reinterpret_cast<const void*>(commands.offset + first * sizeof(DrawElementsIndirectCommand));
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, offset, static_cast<GLsizei>(end - first), 0);
+        ++stats.drawCalls;
+        first = end;
+    }
+    stats.draws += pending.size();
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
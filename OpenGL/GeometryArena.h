@@ -0,0 +1,131 @@
+#pragma once
+
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "StreamBuffer.h"
+
+struct Vertex;
+enum class VertexFormat;
+
+// First-fit allocator of [offset, offset + size) ranges in a buffer of capacity elements. Freed
+// ranges merge with their free neighbours.
+class RangeAllocator {
+public:
+    explicit RangeAllocator(uint32_t capacity = 0);
+
+    bool allocate(uint32_t size, uint32_t& offset); // False if no free range is large enough
+    void free(uint32_t offset, uint32_t size);
+    void grow(uint32_t newCapacity); // The added space becomes free
+
+    uint32_t capacity() const { return total; }
+    uint32_t freeSize() const { return available; }
+    size_t fragmentCount() const { return freeRanges.size(); }
+
+private:
+    std::map<uint32_t, uint32_t> freeRanges; // Offset -> size
+    uint32_t total;
+    uint32_t available;
+};
+
+// A mesh's share of the arena
+struct ArenaAllocation {
+    uint32_t firstVertex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    glm::mat4 positionDecode = glm::mat4(1.0f); // As LevelGeometry::positionTransform()
+};
+
+// Per-draw data in the shader storage buffer at DRAW_DATA_BINDING, std430
+struct DrawData {
+    glm::mat4 model;
+    uint32_t material;
+    uint32_t padding[3];
+};
+
+static_assert(sizeof(DrawData) == 80, "DrawData must match the std430 layout");
+
+const GLuint DRAW_DATA_BINDING = 1;
+const GLuint DRAW_ID_LOCATION = 4;
+
+struct ArenaDrawStats {
+    size_t draws = 0;      // Indirect commands
+    size_t drawCalls = 0;  // glMultiDrawElementsIndirect calls, one per material or one in all
+};
+
+// One vertex buffer and one index buffer (32-bit, relative to each mesh's first vertex) shared by
+// every mesh of a vertex format, drawn with glMultiDrawElementsIndirect: one call per material
+// instead of one per mesh. Needs GL 4.3 or ARB_multi_draw_indirect and
+// ARB_shader_storage_buffer_object. Vertex shaders find their draw's data with
+//   layout(location = 4) in uint drawId;
+//   struct DrawData { mat4 model; uint material; };
+//   layout(std430, binding = 1) readonly buffer DrawDataBuffer { DrawData draws[]; };
+// drawId is an instanced attribute that the base instance of each command sets to the draw's
+// index, so no gl_DrawID or ARB_shader_draw_parameters is needed.
+class GeometryArena {
+public:
+    static bool isSupported();
+
+    // Needs a GL context; the buffers grow as meshes are added
+    void create(VertexFormat format, uint32_t vertexCapacity, uint32_t indexCapacity);
+    void release();
+
+    // Copies the mesh into the buffers, growing them if needed
+    ArenaAllocation allocate(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+    void free(const ArenaAllocation& allocation);
+
+    GLuint vertexArray() const { return VAO; }
+    GLuint vertexBuffer() const { return VBO; } // Replaced when the arena grows
+    GLuint indexBuffer() const { return EBO; }
+    VertexFormat vertexFormat() const { return format; }
+    const RangeAllocator& vertexSpace() const { return vertexRanges; }
+    const RangeAllocator& indexSpace() const { return indexRanges; }
+
+    // Per frame: clear, add every draw, then flush. firstIndex is relative to the allocation.
+    void clearDraws();
+    void addDraw(const ArenaAllocation& allocation, uint32_t firstIndex, uint32_t indexCount, const glm::mat4& model, uint32_t material);
+
+    // Writes the draws, grouped by material, into the frame's stream and issues one
+    // glMultiDrawElementsIndirect per material, calling bindMaterial before each. With an empty
+    // bindMaterial, as when a MaterialTable resolves the textures in the shader, every draw goes
+    // in one call. The caller has the program bound.
+    void flush(StreamBuffer& stream, const std::function<void(uint32_t)>& bindMaterial, ArenaDrawStats& stats);
+
+private:
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    struct PendingDraw {
+        uint32_t material;
+        DrawElementsIndirectCommand command;
+        glm::mat4 model;
+    };
+
+    VertexFormat format;
+    size_t vertexSize = 0;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLuint drawIdBuffer = 0;
+    uint32_t drawCapacity = 0; // Entries in drawIdBuffer
+    RangeAllocator vertexRanges, indexRanges;
+
+    std::vector<PendingDraw> pending;
+
+    void growBuffer(GLuint& buffer, size_t oldBytes, size_t newBytes);
+    void setupVertexArray();
+    void reserveDraws(uint32_t count);
+};
+
+#endif // GEOMETRY_ARENA_H
@@ -0,0 +1,183 @@
+#include "InstanceBatch.h"
+#include "QuantizedVertex.h"
+#include "Simd.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// The largest axis scale of the matrix, for its bounding sphere
+float maxAxisScale(const glm::mat4& model) {
+    float scale = std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                           std::max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])), glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))));
+    return std::sqrt(scale);
+}
+
+bool instanceVisible(const InstanceData& instance, const glm::vec3& center, float radius, const Frustum& frustum) {
+    glm::vec3 worldCenter = glm::vec3(instance.model * glm::vec4(center, 1.0f));
+    return intersectsSphere(frustum, worldCenter, radius * maxAxisScale(instance.model));
+}
+
+} // namespace
+
+size_t cullInstances(const InstanceData* instances, size_t count, const glm::vec3& center, float radius, const Frustum& frustum, uint32_t* visible) {
+    size_t visibleCount = 0;
+    size_t i = 0;
+#if USE_SSE2
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; ++p) {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+    __m128 centerX = _mm_set1_ps(center.x), centerY = _mm_set1_ps(center.y), centerZ = _mm_set1_ps(center.z);
+    __m128 sphereRadius = _mm_set1_ps(radius);
+
+    for (; i + 4 <= count; i += 4) {
+        // Columns of four matrices, transposed so each register holds one component of four instances
+        __m128 columns[4][4];
+        for (int c = 0; c < 4; ++c) {
+            __m128 a = _mm_loadu_ps(&instances[i].model[c][0]);
+            __m128 b = _mm_loadu_ps(&instances[i + 1].model[c][0]);
+            __m128 d = _mm_loadu_ps(&instances[i + 2].model[c][0]);
+            __m128 e = _mm_loadu_ps(&instances[i + 3].model[c][0]);
+            _MM_TRANSPOSE4_PS(a, b, d, e);
+            columns[c][0] = a;
+            columns[c][1] = b;
+            columns[c][2] = d;
+            columns[c][3] = e;
+        }
+        __m128 worldCenter[3];
+        for (int k = 0; k < 3; ++k) {
+            worldCenter[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(columns[0][k], centerX), _mm_mul_ps(columns[1][k], centerY)),
+                                        _mm_add_ps(_mm_mul_ps(columns[2][k], centerZ), columns[3][k]));
+        }
+        __m128 scale = _mm_setzero_ps();
+        for (int c = 0; c < 3; ++c) {
+            __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(columns[c][0], columns[c][0]), _mm_mul_ps(columns[c][1], columns[c][1])),
+                                              _mm_mul_ps(columns[c][2], columns[c][2]));
+            scale = _mm_max_ps(scale, lengthSquared);
+        }
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(sphereRadius, _mm_sqrt_ps(scale)));
+
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; ++p) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], worldCenter[0]), _mm_mul_ps(planeY[p], worldCenter[1])),
+                                         _mm_add_ps(_mm_mul_ps(planeZ[p], worldCenter[2]), planeW[p]));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+        }
+        int inside = ~_mm_movemask_ps(outside) & 0xF;
+        while (inside) {
+            int lane = 0;
+            while (!(inside & (1 << lane)))
+                ++lane;
+            visible[visibleCount++] = static_cast<uint32_t>(i + lane);
+            inside &= inside - 1;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (instanceVisible(instances[i], center, radius, frustum))
+            visible[visibleCount++] = static_cast<uint32_t>(i);
+    }
+    return visibleCount;
+}
+
+void InstanceBatch::create(LevelGeometry& instanced) {
+    geometry = &instanced;
+    glGenVertexArrays(1, &VAO);
+    setupMeshStream(geometry->drawRange());
+}
+
+void InstanceBatch::release() {
+    glDeleteVertexArrays(1, &VAO);
+    VAO = 0;
+    meshVertexBuffer = meshIndexBuffer = streamBuffer = 0;
+    geometry = nullptr;
+    visibleCount = 0;
+}
+
+void InstanceBatch::setupMeshStream(const MeshDrawRange& range) {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, range.vertexBuffer);
+    if (range.format == VertexFormat::Quantized)
+        QuantizedVertexLayout::setup();
+    else
+        StandardVertexLayout::setup();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, range.indexBuffer);
+    for (GLuint column = 0; column < 4; ++column) {
+        glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+        glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + column, 1);
+    }
+    glEnableVertexAttribArray(INSTANCE_PARAMETERS_LOCATION);
+    glVertexAttribDivisor(INSTANCE_PARAMETERS_LOCATION, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    meshVertexBuffer = range.vertexBuffer;
+    meshIndexBuffer = range.indexBuffer;
+}
+
+void InstanceBatch::writeInstances(StreamBuffer& stream, const InstanceData* instances, const uint32_t* indices, size_t count) {
+    visibleCount = count;
+    if (count == 0)
+        return;
+
+    // Positions of quantized meshes are decoded by the instance matrix, as with a model uniform
+    const glm::mat4& decode = geometry->positionTransform();
+    bool decodes = decode != glm::mat4(1.0f);
+    StreamAllocation allocation = stream.allocate(count * sizeof(InstanceData), sizeof(float));
+    InstanceData* out = static_cast<InstanceData*>(allocation.data);
+    for (size_t i = 0; i < count; ++i) {
+        const InstanceData& instance = instances[indices ? indices[i] : i];
+        if (decodes) {
+            InstanceData decoded = { instance.model * decode, instance.parameters };
+            out[i] = decoded;
+        }
+        else {
+            out[i] = instance;
+        }
+    }
+    stream.commit(allocation);
+    streamBuffer = allocation.buffer;
+    streamOffset = allocation.offset;
+}
+
+void InstanceBatch::update(StreamBuffer& stream, const InstanceData* instances, size_t count, const Frustum& frustum, InstanceCullStats& stats) {
+    visible.resize(count);
+    size_t visibleInstances = cullInstances(instances, count, geometry->sphereCenter(), geometry->sphereRadius(), frustum, visible.data());
+    stats.tested += count;
+    stats.visible += visibleInstances;
+    writeInstances(stream, instances, visible.data(), visibleInstances);
+}
+
+void InstanceBatch::update(StreamBuffer& stream, const InstanceData* instances, size_t count) {
+    writeInstances(stream, instances, nullptr, count);
+}
+
+void InstanceBatch::draw(const Shader& shader) {
+    if (visibleCount == 0)
+        return;
+
+    MeshDrawRange range = geometry->drawRange();
+    if (range.vertexBuffer != meshVertexBuffer || range.indexBuffer != meshIndexBuffer)
+        setupMeshStream(range);
+    geometry->bindTextures(shader);
+
+    glBindVertexArray(VAO);
+    // The stream offset moves every frame, so the instance attributes are pointed at it per draw
+    glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+    for (GLuint column = 0; column < 4; ++column) {
+        const void* offset = reinterpret_cast<const void*>(streamOffset + offsetof(InstanceData, model) + column * sizeof(glm::vec4));
+        glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), offset);
+    }
+    glVertexAttribPointer(INSTANCE_PARAMETERS_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                          reinterpret_cast<const void*>(streamOffset + offsetof(InstanceData, parameters)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (range.baseVertex != 0)
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.count, range.indexType, range.offset, static_cast<GLsizei>(visibleCount), range.baseVertex);
+    else
+        glDrawElementsInstanced(GL_TRIANGLES, range.count, range.indexType, range.offset, static_cast<GLsizei>(visibleCount));
+    glBindVertexArray(0);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef INSTANCE_BATCH_H
+#define INSTANCE_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+#include "LevelGeometry.h"
+#include "StreamBuffer.h"
+
+// Per-instance vertex stream locations; the model matrix takes one location per column
+const GLuint INSTANCE_MODEL_LOCATION = 5;      // 5-8
+const GLuint INSTANCE_PARAMETERS_LOCATION = 9;
+
+// One instance: its model matrix and four floats for the shader (tint, wind phase, ...)
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 parameters;
+};
+
+struct InstanceCullStats {
+    size_t tested = 0;
+    size_t visible = 0;
+};
+
+// Draws one LevelGeometry many times with a single glDrawElementsInstanced. Each frame, update()
+// culls the instances' bounding spheres against the frustum four at a time, compacts the visible
+// ones and writes them into the frame's stream buffer as an instanced vertex stream. Shaders read
+//   layout(location = 5) in mat4 instanceModel;
+//   layout(location = 9) in vec4 instanceParameters;
+// instead of a model uniform. The geometry's current LOD is drawn for every instance.
+class InstanceBatch {
+public:
+    // Needs a GL context; the geometry must outlive the batch
+    void create(LevelGeometry& geometry);
+    void release();
+
+    // Writes the instances inside the frustum to the stream; call once per frame before draw()
+    void update(StreamBuffer& stream, const InstanceData* instances, size_t count, const Frustum& frustum, InstanceCullStats& stats);
+    // Writes every instance, unculled
+    void update(StreamBuffer& stream, const InstanceData* instances, size_t count);
+
+    // Binds the geometry's textures and draws the instances of the last update(). The caller has
+    // the program in use.
+    void draw(const Shader& shader);
+
+    size_t instanceCount() const { return visibleCount; }
+
+private:
+    LevelGeometry* geometry = nullptr;
+    GLuint VAO = 0;
+    GLuint meshVertexBuffer = 0; // What the vertex array points at; arena buffers change as it grows
+    GLuint meshIndexBuffer = 0;
+    GLuint streamBuffer = 0;
+    GLintptr streamOffset = 0;
+    size_t visibleCount = 0;
+    std::vector<uint32_t> visible; // Indices of the visible instances, kept to avoid reallocating
+
+    void setupMeshStream(const MeshDrawRange& range);
+    void writeInstances(StreamBuffer& stream, const InstanceData* instances, const uint32_t* indices, size_t count);
+};
+
+// Indices of the instances whose bounding spheres (center and radius in model space, scaled by
+// the largest axis of each model matrix) intersect the frustum, four at a time with SSE
+size_t cullInstances(const InstanceData* instances, size_t count, const glm::vec3& center, float radius, const Frustum& frustum, uint32_t* visible);
+
+#endif // INSTANCE_BATCH_H
@@ -0,0 +1,191 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace {
+
+// The scheduler and deque of the calling thread, set for workers; other threads use the shared deque
+thread_local JobSystem* workerSystem = nullptr;
+thread_local uint32_t workerQueue = 0;
+thread_local JobCounter* runningCounter = nullptr;
+
+} // namespace
+
+JobSystem::JobSystem(int workerCount)
+    : queuedJobs(0), sleepingWorkers(0), jobCount(0), stealCount(0), backgroundCount(0) {
+    if (workerCount < 0) {
+        int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+        if (hardwareThreads == 0)
+            hardwareThreads = 4; // hardware_concurrency() may not be computable
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    for (int i = 0; i <= workerCount; ++i)
+        queues.emplace_back(new JobQueue());
+    workers.reserve(workerCount);
+    for (int i = 0; i < workerCount; ++i)
+        workers.emplace_back(&JobSystem::workerLoop, this, static_cast<uint32_t>(i));
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+JobSystem::JobQueue& JobSystem::queueOfThisThread(uint32_t& index) {
+    index = workerSystem == this ? workerQueue : static_cast<uint32_t>(workers.size());
+    return *queues[index];
+}
+
+void JobSystem::run(const Job& job) {
+    if (job.counter)
+        job.counter->count.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t index;
+    JobQueue& queue = queueOfThisThread(index);
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tail - queue.head < QUEUE_CAPACITY) {
+            queue.jobs[queue.tail % QUEUE_CAPACITY] = job;
+            ++queue.tail;
+            queuedJobs.fetch_add(1);
+        }
+        else {
+            index = UINT32_MAX; // Full
+        }
+    }
+    if (index == UINT32_MAX) {
+        execute(job);
+        return;
+    }
+
+    // A worker going to sleep counts itself before it checks for jobs, so either it sees this
+    // job or this sees it sleeping
+    if (sleepingWorkers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        workAvailable.notify_one();
+    }
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    while (!counter.done()) {
+        if (!runOne())
+            std::this_thread::yield();
+    }
+}
+
+bool JobSystem::runOne() {
+    uint32_t index;
+    queueOfThisThread(index);
+    Job job;
+    if (!pop(index, job) && !steal(index, job))
+        return false;
+    execute(job);
+    return true;
+}
+
+void JobSystem::enqueue(std::function<void()> job) {
+    if (workers.empty()) {
+        job();
+        backgroundCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        backgroundJobs.push_back(std::move(job));
+    }
+    workAvailable.notify_one();
+}
+
+JobSystemStats JobSystem::stats() const {
+    JobSystemStats result;
+    result.jobs = jobCount.load(std::memory_order_relaxed);
+    result.steals = stealCount.load(std::memory_order_relaxed);
+    result.background = backgroundCount.load(std::memory_order_relaxed);
+    return result;
+}
+
+JobSystem& JobSystem::shared() {
+    static JobSystem system;
+    return system;
+}
+
+JobCounter* JobSystem::currentCounter() {
+    return runningCounter;
+}
+
+bool JobSystem::pop(uint32_t index, Job& job) {
+    JobQueue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.head == queue.tail)
+        return false;
+    --queue.tail;
+    job = queue.jobs[queue.tail % QUEUE_CAPACITY];
+    queuedJobs.fetch_sub(1);
+    return true;
+}
+
+bool JobSystem::steal(uint32_t thief, Job& job) {
+    if (queuedJobs.load() == 0)
+        return false;
+    // Start after the thief so that thieves spread over the victims
+    uint32_t queueCount = static_cast<uint32_t>(queues.size());
+    for (uint32_t offset = 1; offset < queueCount; ++offset) {
+        JobQueue& queue = *queues[(thief + offset) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.head == queue.tail)
+            continue;
+        job = queue.jobs[queue.head % QUEUE_CAPACITY];
+        ++queue.head;
+        queuedJobs.fetch_sub(1);
+        stealCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::execute(const Job& job) {
+    JobCounter* outerCounter = runningCounter;
+    runningCounter = job.counter;
+    job.function(job.data, job.begin, job.end);
+    runningCounter = outerCounter;
+    jobCount.fetch_add(1, std::memory_order_relaxed);
+    if (job.counter)
+        job.counter->count.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+    workerSystem = this;
+    workerQueue = index;
+    PROFILE_THREAD_NAME("Job worker");
+    for (;;) {
+        Job job;
+        if (pop(index, job) || steal(index, job)) {
+            execute(job);
+            continue;
+        }
+
+        std::function<void()> background;
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepingWorkers.fetch_add(1);
+            workAvailable.wait(lock, [this] { return stopping || queuedJobs.load() > 0 || !backgroundJobs.empty(); });
+            sleepingWorkers.fetch_sub(1);
+
+            // Pending jobs are dropped on shutdown, only the running ones finish
+            if (stopping)
+                return;
+            if (queuedJobs.load() > 0)
+                continue;
+            background = std::move(backgroundJobs.front());
+            backgroundJobs.pop_front();
+        }
+        background();
+        backgroundCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobCounter;
+
+// A unit of work: function(data, begin, end). Plain data, so scheduling a job never allocates;
+// data must stay alive until the job has run.
+struct Job {
+    void (*function)(void* data, uint32_t begin, uint32_t end);
+    void* data;
+    uint32_t begin;
+    uint32_t end;
+    JobCounter* counter; // Counted down when the job finishes; may be null
+};
+
+// Jobs of a group that have not finished yet; JobSystem::wait() runs other jobs until it is zero
+class JobCounter {
+public:
+    JobCounter() : count(0) {}
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool done() const { return count.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<uint32_t> count;
+};
+
+struct JobSystemStats {
+    uint64_t jobs = 0;       // Run from the deques
+    uint64_t steals = 0;     // Of those, taken from another thread's deque
+    uint64_t background = 0; // enqueue() jobs run
+};
+
+// Work-stealing scheduler for CPU work. Each worker owns a deque: it pushes and pops its own jobs
+// at the back, so nested work stays hot in its cache, and idle threads steal from the front of
+// the others', taking the oldest and usually largest pieces. Threads that are not workers share
+// one more deque. A thread waiting on a counter runs queued jobs instead of blocking, so jobs can
+// wait on jobs they spawn and parallelFor() works from any thread.
+//
+// enqueue() is for long background work such as image decodes. Only workers run it, and only
+// when no deque has work, so a thread waiting on frame jobs never picks up a decode.
+// Jobs must not touch GL; hand results back to the GL thread instead.
+class JobSystem {
+public:
+    // -1 = one worker per hardware thread besides the caller; 0 = the calling thread runs every
+    // job itself in wait(), and enqueue() runs at once
+    explicit JobSystem(int workerCount = -1);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Adds the job to the calling thread's deque; runs it at once if the deque is full
+    void run(const Job& job);
+
+    // Runs function() as a job counted by counter. function must stay alive until the wait.
+    template <typename Function>
+    void run(const Function& function, JobCounter& counter) {
+        Job job = { &invokeFunction<Function>, const_cast<Function*>(&function), 0, 1, &counter };
+        run(job);
+    }
+
+    // Runs queued jobs on the calling thread until counter reaches zero
+    void wait(JobCounter& counter);
+
+    // Runs one queued job on the calling thread; false if there was none. Never runs background
+    // jobs.
+    bool runOne();
+
+    // Runs body(0) .. body(count - 1) and waits for all of them. The range is split in halves on
+    // demand down to grain indices per job, so idle threads steal large pieces first.
+    template <typename Body>
+    void parallelFor(uint32_t count, const Body& body, uint32_t grain = 1) {
+        if (count == 0)
+            return;
+        ParallelFor<Body> loop = { this, &body, grain == 0 ? 1 : grain };
+        JobCounter counter;
+        Job job = { &runParallelFor<Body>, &loop, 0, count, &counter };
+        run(job);
+        wait(counter);
+    }
+
+    // Fire-and-forget background job; pending ones are dropped on shutdown
+    void enqueue(std::function<void()> job);
+
+    // Threads that run jobs: the workers and the calling thread
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    JobSystemStats stats() const;
+
+    // Process-wide scheduler shared by the loaders and the frame
+    static JobSystem& shared();
+
+private:
+    static const uint32_t QUEUE_CAPACITY = 4096;
+
+    // Ring buffer of jobs. A mutex per deque keeps owner and thieves simple; owners only contend
+    // with thieves when they are idle.
+    struct JobQueue {
+        std::mutex mutex;
+        Job jobs[QUEUE_CAPACITY];
+        uint32_t head = 0; // Oldest job, where thieves take
+        uint32_t tail = 0; // One past the newest, where the owner pushes and pops
+    };
+
+    template <typename Body>
+    struct ParallelFor {
+        JobSystem* system;
+        const Body* body;
+        uint32_t grain;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<JobQueue>> queues; // One per worker, then the shared one
+    std::atomic<uint32_t> queuedJobs;
+    std::atomic<uint32_t> sleepingWorkers;
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+    std::deque<std::function<void()>> backgroundJobs; // Guarded by sleepMutex
+    bool stopping = false;
+    std::atomic<uint64_t> jobCount, stealCount, backgroundCount;
+
+    JobQueue& queueOfThisThread(uint32_t& index);
+    bool pop(uint32_t index, Job& job);
+    bool steal(uint32_t thief, Job& job);
+    void execute(const Job& job);
+    void workerLoop(uint32_t index);
+
+    template <typename Function>
+    static void invokeFunction(void* data, uint32_t, uint32_t) {
+        (*static_cast<const Function*>(data))();
+    }
+
+    template <typename Body>
+    static void runParallelFor(void* data, uint32_t begin, uint32_t end) {
+        ParallelFor<Body>& loop = *static_cast<ParallelFor<Body>*>(data);
+        // Hand off the upper half until the piece is small enough to run; the counter is that of
+        // the running job, so parallelFor() waits for the halves too
+        while (end - begin > loop.grain) {
+            uint32_t middle = begin + (end - begin) / 2;
+            Job half = { &runParallelFor<Body>, data, middle, end, currentCounter() };
+            loop.system->run(half);
+            end = middle;
+        }
+        for (uint32_t i = begin; i < end; ++i)
+            (*loop.body)(i);
+    }
+
+    static JobCounter* currentCounter();
+};
+
+#endif // JOB_SYSTEM_H
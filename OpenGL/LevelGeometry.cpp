@@ -1,67 +1,306 @@
 #include "LevelGeometry.h"
 #include "shader.h" // Include your Shader class header
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "QuantizedVertex.h"
+#include "TextureRegistry.h"
+#include <algorithm>
+
+namespace {
+
+// A coarser LOD is only taken once its projected error is this fraction of the limit
+const float LOD_HYSTERESIS = 0.75f;
+
+// The LOD's triangles with only the positions they use
+OccluderMesh buildOccluder(const GeometryArrays& arrays, const MeshLod& lod) {
+    OccluderMesh occluder;
+    std::vector<uint32_t> remap(arrays.vertexCount, UINT32_MAX);
+    occluder.indices.reserve(lod.indexCount);
+    for (uint32_t i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; ++i) {
+        uint32_t& index = remap[arrays.indices[i]];
+        if (index == UINT32_MAX) {
+            index = static_cast<uint32_t>(occluder.positions.size());
+            occluder.positions.push_back(arrays.vertices[arrays.indices[i]].Position);
+        }
+        occluder.indices.push_back(index);
+    }
+    return occluder;
+}
+
+} // namespace
 
 LevelGeometry::LevelGeometry() {
     // Initialize with empty data or default values
 }
 
-LevelGeometry::LevelGeometry(std::vector<Vertex> vertices, std::vector<unsigned int> indices)
-    : vertices(vertices), indices(indices) {
-    // Setup mesh (VAO, VBO, EBO)
-    setupMesh();
+LevelGeometry::LevelGeometry(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+    : LevelGeometry(vertices.data(), vertices.size(), indices.data(), indices.size()) {
 }
 
-void LevelGeometry::setupMesh() {
+LevelGeometry::LevelGeometry(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount) {
+    // Setup mesh (VAO, VBO, EBO)
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
+    GeometryArrays arrays = { vertices, vertexCount, indices, indexCount, nullptr, 0, nullptr, 0 };
+    setupMesh(arrays, VertexFormat::Standard);
+}
+
+LevelGeometry::~LevelGeometry() {
+    if (VAO != 0 || arena || !textures.empty())
+        release();
+}
+
+LevelGeometry::LevelGeometry(LevelGeometry&& other)
+    : textures(std::move(other.textures)), VAO(other.VAO), VBO(other.VBO), EBO(other.EBO), arena(other.arena), allocation(other.allocation), lods(std::move(other.lods)), lod(other.lod),
+      meshlets(std::move(other.meshlets)), clustersCulled(other.clustersCulled), visibleRanges(std::move(other.visibleRanges)),
+      drawCounts(std::move(other.drawCounts)), drawOffsets(std::move(other.drawOffsets)), drawBaseVertices(std::move(other.drawBaseVertices)),
+      occluderMesh(std::move(other.occluderMesh)), samplerProgram(other.samplerProgram), textureBindings(std::move(other.textureBindings)), box(other.box), boundsCenter(other.boundsCenter), boundsRadius(other.boundsRadius), lodErrorScale(other.lodErrorScale),
+      indexType(other.indexType), vertexFormat(other.vertexFormat), positionDecode(other.positionDecode) {
+    other.VAO = other.VBO = other.EBO = 0;
+    other.arena = nullptr;
+    other.lod = 0;
+}
+
+LevelGeometry& LevelGeometry::operator=(LevelGeometry&& other) {
+    if (this != &other) {
+        if (VAO != 0 || arena || !textures.empty())
+            release();
+        textures = std::move(other.textures);
+        VAO = other.VAO;
+        VBO = other.VBO;
+        EBO = other.EBO;
+        arena = other.arena;
+        allocation = other.allocation;
+        lods = std::move(other.lods);
+        lod = other.lod;
+        meshlets = std::move(other.meshlets);
+        clustersCulled = other.clustersCulled;
+        visibleRanges = std::move(other.visibleRanges);
+        drawCounts = std::move(other.drawCounts);
+        drawOffsets = std::move(other.drawOffsets);
+        drawBaseVertices = std::move(other.drawBaseVertices);
+        occluderMesh = std::move(other.occluderMesh);
+        samplerProgram = other.samplerProgram;
+        textureBindings = std::move(other.textureBindings);
+        box = other.box;
+        boundsCenter = other.boundsCenter;
+        boundsRadius = other.boundsRadius;
+        lodErrorScale = other.lodErrorScale;
+        indexType = other.indexType;
+        vertexFormat = other.vertexFormat;
+        positionDecode = other.positionDecode;
+        other.VAO = other.VBO = other.EBO = 0;
+        other.arena = nullptr;
+        other.lod = 0;
+    }
+    return *this;
+}
+
+std::vector<LevelGeometry> LevelGeometry::createBatch(const std::vector<GeometryArrays>& meshes, VertexFormat format, GeometryArena* arena) {
+    std::vector<LevelGeometry> geometries(meshes.size());
+    if (meshes.empty())
+        return geometries;
+
+    if (arena) {
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            geometries[i].arena = arena;
+            geometries[i].setupMesh(meshes[i], arena->vertexFormat());
+        }
+        return geometries;
+    }
+
+    std::vector<GLuint> vertexArrays(meshes.size());
+    std::vector<GLuint> buffers(meshes.size() * 2);
+    glGenVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+    glGenBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        LevelGeometry& geometry = geometries[i];
+        geometry.VAO = vertexArrays[i];
+        geometry.VBO = buffers[i * 2];
+        geometry.EBO = buffers[i * 2 + 1];
+        geometry.setupMesh(meshes[i], format);
+    }
+    return geometries;
+}
+
+void LevelGeometry::setupMesh(const GeometryArrays& arrays, VertexFormat format) {
+    if (arrays.lodCount > 0) {
+        lods.assign(arrays.lods, arrays.lods + arrays.lodCount);
+    }
+    else {
+        MeshLod full = { 0, static_cast<uint32_t>(arrays.indexCount), 0.0f };
+        lods.assign(1, full);
+    }
+    lod = 0;
+    vertexFormat = format;
+    meshlets.assign(arrays.meshlets, arrays.meshlets + arrays.meshletCount);
+    clustersCulled = false;
+    // At most one range per meshlet, so drawing never reallocates
+    visibleRanges.reserve(meshlets.size());
+    drawCounts.reserve(meshlets.size());
+    drawOffsets.reserve(meshlets.size());
+
+    // A simplified LOD may bulge past the mesh and hide what the mesh leaves in view, so occluders
+    // use the full mesh
+    occluderMesh = buildOccluder(arrays, lods[0]);
+
+    // Bounding box, a bounding sphere around its center, and the scale of the LOD errors
+    if (arrays.vertexCount > 0) {
+        glm::vec3 lo = arrays.vertices[0].Position, hi = lo;
+        for (size_t i = 1; i < arrays.vertexCount; ++i) {
+            lo = glm::min(lo, arrays.vertices[i].Position);
+            hi = glm::max(hi, arrays.vertices[i].Position);
+        }
+        box.min = lo;
+        box.max = hi;
+        boundsCenter = (lo + hi) * 0.5f;
+        boundsRadius = 0.0f;
+        for (size_t i = 0; i < arrays.vertexCount; ++i)
+            boundsRadius = std::max(boundsRadius, glm::length(arrays.vertices[i].Position - boundsCenter));
+        lodErrorScale = meshExtent(arrays.vertices, arrays.vertexCount);
+    }
+
+    if (arena) {
+        // The arena's index buffer is 32-bit, relative to the allocation's first vertex
+        allocation = arena->allocate(arrays.vertices, arrays.vertexCount, arrays.indices, arrays.indexCount);
+        positionDecode = allocation.positionDecode;
+        indexType = GL_UNSIGNED_INT;
+        drawBaseVertices.reserve(meshlets.size());
+        return;
+    }
+
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    if (format == VertexFormat::Quantized) {
+        QuantizationBounds bounds = computeQuantizationBounds(arrays.vertices, arrays.vertexCount);
+        std::vector<QuantizedVertex> quantized(arrays.vertexCount);
+        quantizeVertices(arrays.vertices, arrays.vertexCount, bounds, quantized.data());
+        glBufferData(GL_ARRAY_BUFFER, quantized.size() * sizeof(QuantizedVertex), quantized.data(), GL_STATIC_DRAW);
+        QuantizedVertexLayout::setup();
+        positionDecode = positionDecodeMatrix(bounds);
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, arrays.vertexCount * sizeof(Vertex), arrays.vertices, GL_STATIC_DRAW);
+        // Positions, normals, texture coords and lightmap texture coords at locations 0-3
+        StandardVertexLayout::setup();
+        positionDecode = glm::mat4(1.0f);
+    }
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-    // Vertex positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    if (canUseShortIndices(arrays.vertexCount)) {
+        // Half the index bandwidth; every mesh under 64K vertices qualifies
+        std::vector<GLushort> shortIndices(arrays.indices, arrays.indices + arrays.indexCount);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+        indexType = GL_UNSIGNED_SHORT;
+    }
+    else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, arrays.indexCount * sizeof(unsigned int), arrays.indices, GL_STATIC_DRAW);
+        indexType = GL_UNSIGNED_INT;
+    }
 
-    // Vertex normals (if needed in shader)
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glBindVertexArray(0);
+}
 
-    // Vertex texture coords (first UV channel)
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+void LevelGeometry::selectLod(const glm::mat4& model, const LodView& view) {
+    if (lods.size() < 2)
+        return;
 
-    // Assuming LightMapTexCoords is properly set in your Vertex struct
-    glEnableVertexAttribArray(3); // Assuming location 3 for lightmap UVs
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, LightMapTexCoords));
+    // Model matrices may scale; use the largest axis scale so the estimate stays conservative
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    glm::vec3 center = glm::vec3(model * glm::vec4(boundsCenter, 1.0f));
+    float distance = glm::length(center - view.cameraPosition) - boundsRadius * scale;
+    if (distance <= 0.0f) {
+        lod = 0; // Camera inside the bounds
+        return;
+    }
 
-    glBindVertexArray(0);
+    float pixelsPerError = lodErrorScale * scale * view.pixelsPerUnit / distance;
+    while (lod > 0 && lods[lod].error * pixelsPerError > view.maxPixelError)
+        --lod;
+    while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerError <= view.maxPixelError * LOD_HYSTERESIS)
+        ++lod;
 }
 
-void LevelGeometry::Draw(Shader& shader) {
-    shader.use();
+void LevelGeometry::cullClusters(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition, ClusterCullStats& stats) {
+    visibleRanges.clear();
+    clustersCulled = lod == 0 && !meshlets.empty();
+    if (!clustersCulled)
+        return;
+
+    // Test in model space: one matrix product per mesh instead of transforming every meshlet
+    Frustum frustum = extractFrustum(viewProjection * model);
+    glm::vec3 modelCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+    cullMeshlets(meshlets.data(), meshlets.size(), frustum, modelCamera, visibleRanges, stats);
+}
 
+void LevelGeometry::updateTextureBindings(const Shader& shader) {
+    // Sampler locations are looked up once per shader; the N in texture_diffuseN counts all textures
+    if (samplerProgram != shader.Program || textureBindings.size() != textures.size()) {
+        samplerProgram = shader.Program;
+        textureBindings.resize(textures.size());
+        for (unsigned int i = 0; i < textures.size(); ++i)
+            textureBindings[i].sampler = shader.uniform((textures[i].type + std::to_string(i + 1)).c_str());
+    }
     for (unsigned int i = 0; i < textures.size(); ++i) {
-        glActiveTexture(GL_TEXTURE0 + i); // Activate proper texture unit before binding
-        // Retrieve texture number (the N in texture_diffuseN)
-        std::string number = std::to_string(i + 1); // Assuming you name them texture1, texture2, etc.
-        std::string name = textures[i].type;
+        textureBindings[i].texture = textures[i].id;
+        TextureRegistry::instance().touch(textures[i].id);
+    }
+}
+
+void LevelGeometry::buildDrawRanges() {
+    drawCounts.resize(visibleRanges.size());
+    drawOffsets.resize(visibleRanges.size());
+    for (size_t i = 0; i < visibleRanges.size(); ++i) {
+        drawCounts[i] = static_cast<GLsizei>(visibleRanges[i].count);
+        drawOffsets[i] = reinterpret_cast<const void*>((allocation.firstIndex + visibleRanges[i].offset) * indexSize());
+    }
+    if (arena)
+        drawBaseVertices.assign(visibleRanges.size(), baseVertex());
+}
+
+void LevelGeometry::bindTextures(const Shader& shader) {
+    updateTextureBindings(shader);
 
+    for (unsigned int i = 0; i < textureBindings.size(); ++i) {
+        glActiveTexture(GL_TEXTURE0 + i); // Activate proper texture unit before binding
         // Set the sampler to the correct texture unit
-        shader.setInt(name + number, i);
+        shader.set(textureBindings[i].sampler, static_cast<int>(i));
 
         // Bind the texture
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        glBindTexture(GL_TEXTURE_2D, textureBindings[i].texture);
     }
+}
+
+void LevelGeometry::Draw(Shader& shader) {
+    if (clustersCulled && visibleRanges.empty())
+        return; // Every cluster culled
+
+    shader.use();
+    bindTextures(shader);
 
     // Bind VAO (and thus VBOs and attribute configurations)
-    glBindVertexArray(VAO);
+    glBindVertexArray(vertexArray());
     // Draw mesh
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    if (clustersCulled) {
+        // The visible meshlets' index ranges in one call
+        buildDrawRanges();
+        if (arena)
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), indexType, drawOffsets.data(), static_cast<GLsizei>(drawCounts.size()),
+                                          drawBaseVertices.data());
+        else
+            glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), indexType, drawOffsets.data(), static_cast<GLsizei>(drawCounts.size()));
+    }
+    else {
+        const MeshLod& range = lods[lod];
+        const void* offset = reinterpret_cast<const void*>((allocation.firstIndex + range.indexOffset) * indexSize());
+        if (arena)
+            glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), indexType, offset, baseVertex());
+        else
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), indexType, offset);
+    }
     // Unbind VAO
     glBindVertexArray(0);
 
@@ -75,6 +314,79 @@ void LevelGeometry::Draw(Shader& shader) {
     glActiveTexture(GL_TEXTURE0);
 }
 
+void LevelGeometry::submit(RenderQueue& queue, const Shader& shader, UniformHandle modelUniform, const glm::mat4& model, float viewDepth) {
+    if (clustersCulled && visibleRanges.empty())
+        return; // Every cluster culled
+
+    DrawPacket packet = {};
+    packet.program = shader.Program;
+    packet.vertexArray = vertexArray();
+    packet.indexType = indexType;
+    if (clustersCulled) {
+        buildDrawRanges();
+        packet.counts = drawCounts.data();
+        packet.offsets = drawOffsets.data();
+        packet.baseVertices = arena ? drawBaseVertices.data() : nullptr;
+        packet.drawCount = static_cast<GLsizei>(drawCounts.size());
+    }
+    else {
+        const MeshLod& range = lods[lod];
+        packet.count = static_cast<GLsizei>(range.indexCount);
+        packet.offset = reinterpret_cast<const void*>((allocation.firstIndex + range.indexOffset) * indexSize());
+        packet.baseVertex = baseVertex();
+    }
+    packet.modelUniform = modelUniform;
+    packet.model = model;
+    queue.submit(packet, textureBindings.data(), textureBindings.size(), viewDepth);
+}
+
+MeshDrawRange LevelGeometry::drawRange() const {
+    const MeshLod& range = lods[lod];
+    MeshDrawRange drawRange;
+    drawRange.vertexBuffer = arena ? arena->vertexBuffer() : VBO;
+    drawRange.indexBuffer = arena ? arena->indexBuffer() : EBO;
+    drawRange.format = vertexFormat;
+    drawRange.indexType = indexType;
+    drawRange.count = static_cast<GLsizei>(range.indexCount);
+    drawRange.offset = reinterpret_cast<const void*>((allocation.firstIndex + range.indexOffset) * indexSize());
+    drawRange.baseVertex = baseVertex();
+    return drawRange;
+}
+
+void LevelGeometry::addIndirectDraws(const glm::mat4& model, uint32_t material) {
+    if (!arena)
+        return;
+    if (clustersCulled) {
+        for (const IndexRange& range : visibleRanges)
+            arena->addDraw(allocation, range.offset, range.count, model, material);
+    }
+    else {
+        arena->addDraw(allocation, lods[lod].indexOffset, lods[lod].indexCount, model, material);
+    }
+}
+
 void LevelGeometry::addTexture(const Texture& texture) {
     textures.push_back(texture);
+}
+
+void LevelGeometry::release() {
+    if (arena) {
+        arena->free(allocation);
+        arena = nullptr;
+        allocation = ArenaAllocation();
+    }
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
+
+    releaseTextures();
+}
+
+void LevelGeometry::releaseTextures() {
+    for (const Texture& texture : textures) {
+        TextureRegistry::instance().release(texture.id);
+    }
+    textures.clear();
+    textureBindings.clear();
 }
\ No newline at end of file
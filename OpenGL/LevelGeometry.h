@@ -3,11 +3,17 @@
 #ifndef LEVEL_GEOMETRY_H
 #define LEVEL_GEOMETRY_H
 
+#include <cstdint>
 #include <vector>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include "shader.h"
 #include "Texture.h"
+#include "GeometryArena.h"
+#include "Meshlet.h"
+#include "OcclusionBuffer.h"
+#include "RenderQueue.h"
+#include "VertexLayout.h"
 
 // Vertex structure
 struct Vertex {
@@ -17,21 +23,157 @@ struct Vertex {
     glm::vec2 LightMapTexCoords;
 };
 
-// LevelGeometry class
+typedef VertexLayout<Vertex,
+    VertexAttribute<0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position)>,
+    VertexAttribute<1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal)>,
+    VertexAttribute<2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords)>,
+    VertexAttribute<3, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, LightMapTexCoords)>> StandardVertexLayout;
+
+// Vertex format in the GL buffers. The mesh cache and loaders always work with Vertex.
+enum class VertexFormat {
+    Standard, // Vertex, 40 bytes
+    Quantized // QuantizedVertex, 20 bytes; shaders must decode octahedral normals (QuantizedVertex.h)
+};
+
+// One level of detail: a range of the mesh's index array
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error; // Largest deviation from LOD 0, relative to the largest bounding box dimension
+};
+
+// Vertex and index arrays to upload, owned by the caller. Without lods the whole index array is
+// drawn as the only LOD.
+struct GeometryArrays {
+    const Vertex* vertices;
+    size_t vertexCount;
+    const unsigned int* indices;
+    size_t indexCount;
+    const MeshLod* lods;
+    size_t lodCount;
+    const Meshlet* meshlets; // Clusters of LOD 0, optional
+    size_t meshletCount;
+};
+
+// What LOD selection needs to know about the camera
+struct LodView {
+    glm::vec3 cameraPosition;
+    float pixelsPerUnit;  // Screen pixels per world unit at distance 1: viewport height / (2 tan(fovY / 2))
+    float maxPixelError;  // Largest LOD error allowed on screen, in pixels
+};
+
+// The buffers and index range of a mesh's current LOD, for drawing it with other vertex streams
+struct MeshDrawRange {
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    VertexFormat format;
+    GLenum indexType;
+    GLsizei count;
+    const void* offset;
+    GLint baseVertex;
+};
+
+// LevelGeometry class. Owns its GL objects, so it can be moved but not copied.
 class LevelGeometry {
 public:
     LevelGeometry();
-    LevelGeometry(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
+    LevelGeometry(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+    // Uploads the arrays straight into the GL buffers; nothing is kept on the CPU
+    LevelGeometry(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+    ~LevelGeometry();
+
+    LevelGeometry(LevelGeometry&& other);
+    LevelGeometry& operator=(LevelGeometry&& other);
+    LevelGeometry(const LevelGeometry&) = delete;
+    LevelGeometry& operator=(const LevelGeometry&) = delete;
+
+    // Creates the GL objects for every mesh with one glGen* call each, then uploads them in order.
+    // With an arena the meshes are copied into its shared buffers instead, in the arena's format,
+    // and draw with its vertex array.
+    static std::vector<LevelGeometry> createBatch(const std::vector<GeometryArrays>& meshes, VertexFormat format = VertexFormat::Standard,
+                                                  GeometryArena* arena = nullptr);
+
+    // Transform from vertex positions to model space: identity for Standard, the dequantization
+    // for Quantized. Draw with model * positionTransform().
+    const glm::mat4& positionTransform() const { return positionDecode; }
+
+    // Picks the coarsest LOD whose error, projected at the mesh's distance, stays under
+    // view.maxPixelError. Coarser LODs are only taken with some margin so the choice does not
+    // flicker at a switch distance. Draw() uses the selection.
+    void selectLod(const glm::mat4& model, const LodView& view);
+    // Model-space bounding box of the vertices; transform it with transformBounds() for culling
+    const AABB& bounds() const { return box; }
+    // Model-space bounding sphere around the box center
+    const glm::vec3& sphereCenter() const { return boundsCenter; }
+    float sphereRadius() const { return boundsRadius; }
+
+    // LOD 0's triangles, kept on the CPU for the occlusion buffer; never covers more than the mesh
+    const OccluderMesh& occluder() const { return occluderMesh; }
+
+    size_t lodCount() const { return lods.size(); }
+    size_t currentLod() const { return lod; }
+
+    // Culls LOD 0's meshlets against the frustum of viewProjection * model and by their backface
+    // cones, so the following Draw() calls only submit the visible index ranges. Does nothing for
+    // coarser LODs, which are drawn whole; call it after selectLod().
+    void cullClusters(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition, ClusterCullStats& stats);
+
     void Draw(Shader& shader); // Ensure Shader class is included or declared
+
+    // Current texture names, samplers looked up once per program, and the textures marked as used.
+    // Calls GL and the texture registry, so only on the GL thread, before submit().
+    void updateTextureBindings(const Shader& shader);
+    // Queues the same draw as Draw(shader) with the model matrix in modelUniform, for
+    // RenderQueue::execute() later in the frame. viewDepth orders it among draws with the same state.
+    // Uses the bindings of the last updateTextureBindings(shader) and makes no GL calls, so it may
+    // run on any thread.
+    void submit(RenderQueue& queue, const Shader& shader, UniformHandle modelUniform, const glm::mat4& model, float viewDepth);
+    // The whole current LOD; cluster culling does not apply
+    MeshDrawRange drawRange() const;
+
+    // For meshes in an arena: adds the same ranges as Draw() to the arena's indirect draws. The
+    // arena applies positionTransform(), so model is the plain model matrix.
+    void addIndirectDraws(const glm::mat4& model, uint32_t material);
+    // Binds the textures to units 0, 1, ... with their samplers set, as Draw() does
+    void bindTextures(const Shader& shader);
+
     void addTexture(const Texture& texture);
+    size_t textureCount() const { return textures.size(); }
+    const std::vector<Texture>& textureList() const { return textures; }
+    bool inArena() const { return arena != nullptr; }
+    void release(); // Deletes the GL buffers and drops the texture references; call before the context goes away
+    // Drops the texture references alone, once draws sample copies of the textures instead
+    void releaseTextures();
 
 private:
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
     std::vector<Texture> textures; // Store textures
-    GLuint VAO, VBO, EBO;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GeometryArena* arena = nullptr; // Instead of VAO/VBO/EBO when set
+    ArenaAllocation allocation;
+    std::vector<MeshLod> lods;
+    size_t lod = 0;
+    std::vector<Meshlet> meshlets;
+    bool clustersCulled = false; // Whether visibleRanges replaces the LOD's range
+    std::vector<IndexRange> visibleRanges;
+    std::vector<GLsizei> drawCounts; // glMultiDrawElements arguments, kept to avoid reallocating
+    std::vector<const void*> drawOffsets;
+    std::vector<GLint> drawBaseVertices; // All allocation.firstVertex, for arena meshes
+    OccluderMesh occluderMesh;
+    GLuint samplerProgram = 0; // Program the textureBindings samplers were looked up in
+    std::vector<TextureBinding> textureBindings; // One per texture
+    AABB box = { glm::vec3(0.0f), glm::vec3(0.0f) };
+    glm::vec3 boundsCenter = glm::vec3(0.0f); // Bounding sphere in model space
+    float boundsRadius = 0.0f;
+    float lodErrorScale = 0.0f; // Model-space size of a relative LOD error of 1
+    GLenum indexType = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT when the mesh has at most 65536 vertices
+    VertexFormat vertexFormat = VertexFormat::Standard;
+    glm::mat4 positionDecode = glm::mat4(1.0f);
 
-    void setupMesh();
+    void setupMesh(const GeometryArrays& arrays, VertexFormat format); // Fills the already generated VAO/VBO/EBO, or the arena
+    void buildDrawRanges(); // visibleRanges as glMultiDrawElements arguments
+    size_t indexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+    GLuint vertexArray() const { return arena ? arena->vertexArray() : VAO; }
+    GLint baseVertex() const { return static_cast<GLint>(allocation.firstVertex); }
 };
 
 #endif // LEVEL_GEOMETRY_H
\ No newline at end of file
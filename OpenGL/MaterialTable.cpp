@@ -0,0 +1,286 @@
+#include "MaterialTable.h"
+#include <algorithm>
+#include <iostream>
+
+const char* const MATERIAL_BINDLESS_GLSL = R"(
+#extension GL_ARB_bindless_texture : require
+layout(std430, binding = 2) readonly buffer MaterialBuffer { uvec2 materialTextures[]; };
+vec4 sampleMaterial(uint material, int slot, vec2 uv) {
+    return texture(sampler2D(materialTextures[material * 4u + uint(slot)]), uv);
+}
+)";
+
+const char* const MATERIAL_ARRAYS_GLSL = R"(
+layout(std430, binding = 2) readonly buffer MaterialBuffer { uvec2 materialTextures[]; };
+uniform sampler2DArray materialPages[8];
+vec4 sampleMaterial(uint material, int slot, vec2 uv) {
+    uvec2 entry = materialTextures[material * 4u + uint(slot)];
+    return texture(materialPages[entry.x], vec3(uv, float(entry.y)));
+}
+)";
+
+namespace {
+
+const GLuint EMPTY_ENTRY = 0xFFFFFFFFu;
+
+GLint levelCount(GLuint texture) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    GLint immutable = 0;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+    GLint levels = 0;
+    if (immutable) {
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+        return levels;
+    }
+    GLint maxLevel = 1000;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+    GLint width = 0;
+    do {
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, levels, GL_TEXTURE_WIDTH, &width);
+    } while (width > 0 && ++levels <= maxLevel);
+    return levels;
+}
+
+// Bytes of one level of the bound GL_TEXTURE_2D
+size_t levelBytes(GLint level) {
+    GLint compressed = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+    if (compressed) {
+        GLint size = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+        return static_cast<size_t>(size);
+    }
+    const GLenum sizes[] = { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE };
+    GLint bits = 0, width = 0, height = 0;
+    for (GLenum size : sizes) {
+        GLint channelBits = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, size, &channelBits);
+        bits += channelBits;
+    }
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+    return static_cast<size_t>(width) * height * ((bits + 7) / 8);
+}
+
+} // namespace
+
+int materialSlot(const std::string& type) {
+    if (type == "texture_diffuse")
+        return MATERIAL_SLOT_DIFFUSE;
+    if (type == "texture_lightmap")
+        return MATERIAL_SLOT_LIGHTMAP;
+    if (type == "texture_normal")
+        return MATERIAL_SLOT_NORMAL;
+    if (type == "texture_specular")
+        return MATERIAL_SLOT_SPECULAR;
+    return -1;
+}
+
+bool MaterialTable::PageFormat::operator<(const PageFormat& other) const {
+    if (width != other.width)
+        return width < other.width;
+    if (height != other.height)
+        return height < other.height;
+    if (internalFormat != other.internalFormat)
+        return internalFormat < other.internalFormat;
+    return levels < other.levels;
+}
+
+bool MaterialTable::isBindlessSupported() {
+    return GLEW_ARB_bindless_texture && isArraySupported();
+}
+
+bool MaterialTable::isArraySupported() {
+    // Storage buffers, immutable storage and glCopyImageSubData
+    return GLEW_VERSION_4_3;
+}
+
+MaterialTextureMode MaterialTable::create(bool allowBindless) {
+    if (allowBindless && isBindlessSupported())
+        textureMode = MaterialTextureMode::Bindless;
+    else if (isArraySupported())
+        textureMode = MaterialTextureMode::Arrays;
+    else
+        textureMode = MaterialTextureMode::None;
+    return textureMode;
+}
+
+void MaterialTable::release() {
+    for (GLuint64 handle : residentHandles)
+        glMakeTextureHandleNonResidentARB(handle);
+    residentHandles.clear();
+    if (!pages.empty())
+        glDeleteTextures(static_cast<GLsizei>(pages.size()), pages.data());
+    pages.clear();
+    pageStorageBytes = 0;
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    materials.clear();
+    materialIndices.clear();
+}
+
+uint32_t MaterialTable::addMaterial(const MaterialTextures& textures) {
+    auto found = materialIndices.find(textures);
+    if (found != materialIndices.end())
+        return found->second;
+    uint32_t index = static_cast<uint32_t>(materials.size());
+    materials.push_back(textures);
+    materialIndices[textures] = index;
+    return index;
+}
+
+bool MaterialTable::upload() {
+    if (textureMode == MaterialTextureMode::None)
+        return false;
+
+    // Two words per slot: a handle, or a page and a layer
+    std::vector<GLuint> entries(materials.size() * MATERIAL_TEXTURE_SLOTS * 2, EMPTY_ENTRY);
+    if (textureMode == MaterialTextureMode::Bindless)
+        buildHandles(entries);
+    else if (!buildPages(entries))
+        return false;
+
+    if (buffer == 0)
+        glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(entries.size(), 2) * sizeof(GLuint), entries.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return true;
+}
+
+void MaterialTable::buildHandles(std::vector<GLuint>& entries) {
+    std::map<GLuint, GLuint64> handles;
+    for (size_t m = 0; m < materials.size(); ++m) {
+        for (int slot = 0; slot < MATERIAL_TEXTURE_SLOTS; ++slot) {
+            GLuint texture = materials[m][slot];
+            GLuint64 handle = 0;
+            if (texture != 0) {
+                auto found = handles.find(texture);
+                if (found == handles.end()) {
+                    handle = glGetTextureHandleARB(texture);
+                    glMakeTextureHandleResidentARB(handle);
+                    residentHandles.push_back(handle);
+                    handles[texture] = handle;
+                }
+                else {
+                    handle = found->second;
+                }
+            }
+            // Empty slots hold handle 0, which must not be sampled
+            size_t entry = (m * MATERIAL_TEXTURE_SLOTS + slot) * 2;
+            entries[entry] = static_cast<GLuint>(handle & 0xFFFFFFFFu);
+            entries[entry + 1] = static_cast<GLuint>(handle >> 32);
+        }
+    }
+}
+
+bool MaterialTable::buildPages(std::vector<GLuint>& entries) {
+    // Group the distinct textures by size and format
+    std::map<PageFormat, std::vector<GLuint>> classes;
+    std::map<GLuint, PageFormat> formats;
+    for (const MaterialTextures& textures : materials) {
+        for (GLuint texture : textures) {
+            if (texture == 0 || formats.count(texture))
+                continue;
+            PageFormat format;
+            format.levels = levelCount(texture);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &format.width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &format.height);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format.internalFormat);
+            formats[texture] = format;
+            classes[format].push_back(texture);
+        }
+    }
+
+    GLint maxLayers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    std::map<GLuint, std::pair<GLuint, GLuint>> locations; // Texture -> page, layer
+    for (const auto& formatClass : classes) {
+        const PageFormat& format = formatClass.first;
+        const std::vector<GLuint>& textures = formatClass.second;
+
+        // The first texture's filtering and wrapping for the whole page
+        GLint minFilter, magFilter, wrapS, wrapT;
+        glBindTexture(GL_TEXTURE_2D, textures[0]);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &minFilter);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &magFilter);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &wrapS);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &wrapT);
+
+        for (size_t first = 0; first < textures.size(); first += maxLayers) {
+            if (pages.size() == MAX_MATERIAL_PAGES) {
+                std::cerr << "Material textures need more than " << MAX_MATERIAL_PAGES << " texture array pages" << std::endl;
+                glBindTexture(GL_TEXTURE_2D, 0);
+                return false;
+            }
+            GLsizei layers = static_cast<GLsizei>(std::min<size_t>(maxLayers, textures.size() - first));
+            GLuint page;
+            glGenTextures(1, &page);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, page);
+            while (glGetError() != GL_NO_ERROR) {}
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, format.levels, format.internalFormat, format.width, format.height, layers);
+            if (glGetError() != GL_NO_ERROR) {
+                std::cerr << "Failed to allocate a material page for internal format 0x" << std::hex << format.internalFormat << std::dec << std::endl;
+                glDeleteTextures(1, &page);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                return false;
+            }
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, minFilter);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, magFilter);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrapS);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrapT);
+
+            // GPU copies of every level, compressed or not
+            for (GLsizei layer = 0; layer < layers; ++layer) {
+                GLuint texture = textures[first + layer];
+                glBindTexture(GL_TEXTURE_2D, texture);
+                for (GLint level = 0; level < format.levels; ++level) {
+                    pageStorageBytes += levelBytes(level);
+                    GLsizei width = std::max(1, format.width >> level), height = std::max(1, format.height >> level);
+                    glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0, page, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1);
+                }
+                locations[texture] = std::make_pair(static_cast<GLuint>(pages.size()), static_cast<GLuint>(layer));
+            }
+            pages.push_back(page);
+            if (glGetError() != GL_NO_ERROR) {
+                std::cerr << "Failed to copy textures into a material page" << std::endl;
+                glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                return false;
+            }
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    for (size_t m = 0; m < materials.size(); ++m) {
+        for (int slot = 0; slot < MATERIAL_TEXTURE_SLOTS; ++slot) {
+            GLuint texture = materials[m][slot];
+            if (texture == 0)
+                continue;
+            size_t entry = (m * MATERIAL_TEXTURE_SLOTS + slot) * 2;
+            entries[entry] = locations[texture].first;
+            entries[entry + 1] = locations[texture].second;
+        }
+    }
+    return true;
+}
+
+void MaterialTable::setSamplers(const Shader& shader) const {
+    if (textureMode != MaterialTextureMode::Arrays)
+        return;
+    GLint units[MAX_MATERIAL_PAGES];
+    for (int i = 0; i < MAX_MATERIAL_PAGES; ++i)
+        units[i] = MATERIAL_PAGE_UNIT + i;
+    glProgramUniform1iv(shader.Program, shader.uniform("materialPages").location, MAX_MATERIAL_PAGES, units);
+}
+
+void MaterialTable::bind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BUFFER_BINDING, buffer);
+    for (size_t i = 0; i < pages.size(); ++i) {
+        glActiveTexture(GL_TEXTURE0 + MATERIAL_PAGE_UNIT + static_cast<GLenum>(i));
+        glBindTexture(GL_TEXTURE_2D_ARRAY, pages[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
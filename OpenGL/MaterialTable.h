@@ -0,0 +1,97 @@
+#pragma once
+
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include "shader.h"
+
+// Texture slots of a material; 0 marks an empty slot
+const int MATERIAL_TEXTURE_SLOTS = 4;
+const int MATERIAL_SLOT_DIFFUSE = 0;
+const int MATERIAL_SLOT_LIGHTMAP = 1;
+const int MATERIAL_SLOT_NORMAL = 2;
+const int MATERIAL_SLOT_SPECULAR = 3;
+
+const GLuint MATERIAL_BUFFER_BINDING = 2;
+const int MAX_MATERIAL_PAGES = 8;
+const int MATERIAL_PAGE_UNIT = 8; // Array pages take texture units 8-15
+
+// Slot of a texture type such as "texture_diffuse", or -1
+int materialSlot(const std::string& type);
+
+enum class MaterialTextureMode {
+    None,     // Neither is available; bind textures per draw
+    Bindless, // ARB_bindless_texture handles in the material buffer
+    Arrays    // Textures copied into GL_TEXTURE_2D_ARRAY pages, one per size and format
+};
+
+// Shader code for each mode: the MaterialBuffer storage block and
+//   vec4 sampleMaterial(uint material, int slot, vec2 uv);
+// Include it after the #version line. material must be the same for a whole draw, as
+// DrawData.material is for each draw of a multi-draw.
+extern const char* const MATERIAL_BINDLESS_GLSL;
+extern const char* const MATERIAL_ARRAYS_GLSL;
+
+// Every material's textures in one storage buffer, so draws with different textures need no
+// binds between them and can share a multi-draw. With ARB_bindless_texture the buffer holds
+// resident texture handles; without it the textures are copied into texture array pages that
+// stay bound, and the buffer holds (page, layer) pairs. The table's copies do not follow later
+// changes to the source textures; bindless sources must not be respecified while resident.
+class MaterialTable {
+public:
+    static bool isBindlessSupported();
+    static bool isArraySupported();
+
+    // Needs a GL context; picks bindless when allowed and available, then arrays
+    MaterialTextureMode create(bool allowBindless = true);
+    void release();
+
+    // Index of the material with these textures, added if new
+    uint32_t addMaterial(const std::array<GLuint, MATERIAL_TEXTURE_SLOTS>& textures);
+
+    // Builds the pages or handles and the material buffer; false if the textures need more than
+    // MAX_MATERIAL_PAGES pages. Call after the last addMaterial().
+    bool upload();
+
+    // Points the shader's materialPages samplers at the page units (arrays mode only); the shader
+    // need not be in use
+    void setSamplers(const Shader& shader) const;
+    // Binds the buffer and the pages for the following draws
+    void bind() const;
+
+    MaterialTextureMode mode() const { return textureMode; }
+    const char* glsl() const { return textureMode == MaterialTextureMode::Bindless ? MATERIAL_BINDLESS_GLSL : MATERIAL_ARRAYS_GLSL; }
+    size_t materialCount() const { return materials.size(); }
+    size_t pageCount() const { return pages.size(); }
+    // GPU memory of the pages; copies the texture registry does not know about
+    size_t pageBytes() const { return pageStorageBytes; }
+
+private:
+    typedef std::array<GLuint, MATERIAL_TEXTURE_SLOTS> MaterialTextures;
+
+    // Size and format class of a texture array page
+    struct PageFormat {
+        GLint width, height, internalFormat, levels;
+        bool operator<(const PageFormat& other) const;
+    };
+
+    MaterialTextureMode textureMode = MaterialTextureMode::None;
+    std::vector<MaterialTextures> materials;
+    std::map<MaterialTextures, uint32_t> materialIndices;
+    std::vector<GLuint> pages;
+    size_t pageStorageBytes = 0;
+    std::vector<GLuint64> residentHandles;
+    GLuint buffer = 0;
+
+    bool buildPages(std::vector<GLuint>& entries);
+    void buildHandles(std::vector<GLuint>& entries);
+};
+
+#endif // MATERIAL_TABLE_H
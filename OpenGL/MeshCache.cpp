@@ -0,0 +1,256 @@
+#include "MeshCache.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char MESH_CACHE_MAGIC[4] = { 'L', 'G', 'E', 'O' };
+const uint32_t MESH_CACHE_VERSION = 5; // 2: meshes are optimized by optimizeMesh(), 3: LOD chains, 4: meshlets, 5: measured LOD errors
+const char* MESH_CACHE_DIRECTORY = "cache/meshes/";
+
+// On-disk layout: header, mesh records, texture binding records, LOD and meshlet records, string table, then the vertex
+// and index arrays (16-byte aligned) exactly as glBufferData takes them
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash; // Hash of the source model file's bytes
+    uint32_t vertexSize; // sizeof(Vertex) when written; a layout change invalidates the entry
+    uint32_t meshCount;
+    uint32_t bindingCount;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    uint32_t stringBytes;
+};
+
+struct MeshRecord {
+    uint64_t vertexOffset; // From the start of the file
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstBinding;
+    uint32_t bindingCount;
+    uint32_t firstLod;
+    uint32_t lodCount;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+};
+
+struct BindingRecord {
+    uint32_t typeOffset; // Into the string table
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+size_t alignData(size_t offset) {
+    return (offset + 15) & ~static_cast<size_t>(15);
+}
+
+// Whether count elements at offset lie inside a mapping of size bytes, aligned for the element
+// type; written so that a damaged offset cannot wrap the arithmetic around
+bool arrayInside(uint64_t offset, uint32_t count, size_t elementSize, size_t alignment, size_t size) {
+    uint64_t bytes = static_cast<uint64_t>(count) * elementSize;
+    return offset % alignment == 0 && offset <= size && bytes <= size - offset;
+}
+
+std::string cachePathFor(const std::string& path) {
+    return MESH_CACHE_DIRECTORY + hashToHex(hashString(path)) + ".lgeo";
+}
+
+// The source is mapped rather than read; only its hash is needed
+bool hashSourceFile(const std::string& path, uint64_t& hash) {
+    MappedFile source;
+    if (!source.open(path))
+        return false;
+    hash = hashBytes(source.data(), source.size());
+    return true;
+}
+
+} // namespace
+
+void MeshData::useStorage() {
+    vertices = vertexStorage.data();
+    vertexCount = vertexStorage.size();
+    indices = indexStorage.data();
+    indexCount = indexStorage.size();
+}
+
+bool loadMeshCache(const std::string& path, ModelData& model) {
+    uint64_t sourceHash;
+    if (!hashSourceFile(path, sourceHash))
+        return false;
+
+    MappedFile mapping;
+    if (!mapping.open(cachePathFor(path)) || mapping.size() < sizeof(MeshCacheHeader))
+        return false;
+
+    MeshCacheHeader header;
+    std::memcpy(&header, mapping.data(), sizeof(header));
+    if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != MESH_CACHE_VERSION
+        || header.sourceHash != sourceHash
+        || header.vertexSize != sizeof(Vertex))
+        return false;
+
+    size_t recordsOffset = sizeof(header);
+    size_t bindingsOffset = recordsOffset + static_cast<size_t>(header.meshCount) * sizeof(MeshRecord);
+    size_t lodsOffset = bindingsOffset + static_cast<size_t>(header.bindingCount) * sizeof(BindingRecord);
+    size_t meshletsOffset = lodsOffset + static_cast<size_t>(header.lodCount) * sizeof(MeshLod);
+    size_t stringsOffset = meshletsOffset + static_cast<size_t>(header.meshletCount) * sizeof(Meshlet);
+    if (stringsOffset + header.stringBytes > mapping.size())
+        return false; // Truncated entry
+
+    const unsigned char* base = mapping.data();
+    const char* strings = reinterpret_cast<const char*>(base + stringsOffset);
+    std::vector<MeshData> meshes(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; ++i) {
+        MeshRecord record;
+        std::memcpy(&record, base + recordsOffset + i * sizeof(MeshRecord), sizeof(record));
+        if (!arrayInside(record.vertexOffset, record.vertexCount, sizeof(Vertex), alignof(Vertex), mapping.size())
+            || !arrayInside(record.indexOffset, record.indexCount, sizeof(unsigned int), alignof(unsigned int), mapping.size())
+            || static_cast<uint64_t>(record.firstBinding) + record.bindingCount > header.bindingCount
+            || static_cast<uint64_t>(record.firstLod) + record.lodCount > header.lodCount
+            || static_cast<uint64_t>(record.firstMeshlet) + record.meshletCount > header.meshletCount)
+            return false;
+
+        MeshData& mesh = meshes[i];
+        mesh.vertices = reinterpret_cast<const Vertex*>(base + record.vertexOffset);
+        mesh.vertexCount = record.vertexCount;
+        mesh.indices = reinterpret_cast<const unsigned int*>(base + record.indexOffset);
+        mesh.indexCount = record.indexCount;
+        // Every index is read later as a vertex array subscript, so a damaged entry must not get past here
+        for (size_t index = 0; index < mesh.indexCount; ++index) {
+            if (mesh.indices[index] >= mesh.vertexCount)
+                return false;
+        }
+
+        for (uint32_t b = 0; b < record.bindingCount; ++b) {
+            BindingRecord binding;
+            std::memcpy(&binding, base + bindingsOffset + (record.firstBinding + b) * sizeof(BindingRecord), sizeof(binding));
+            if (static_cast<uint64_t>(binding.typeOffset) + binding.typeLength > header.stringBytes
+                || static_cast<uint64_t>(binding.pathOffset) + binding.pathLength > header.stringBytes)
+                return false;
+
+            MeshTextureBinding texture;
+            texture.type.assign(strings + binding.typeOffset, binding.typeLength);
+            texture.path.assign(strings + binding.pathOffset, binding.pathLength);
+            mesh.textures.push_back(texture);
+        }
+
+        mesh.lods.resize(record.lodCount);
+        if (record.lodCount > 0)
+            std::memcpy(mesh.lods.data(), base + lodsOffset + record.firstLod * sizeof(MeshLod), record.lodCount * sizeof(MeshLod));
+        for (const MeshLod& lod : mesh.lods) {
+            if (static_cast<uint64_t>(lod.indexOffset) + lod.indexCount > mesh.indexCount)
+                return false;
+        }
+
+        mesh.meshlets.resize(record.meshletCount);
+        if (record.meshletCount > 0)
+            std::memcpy(mesh.meshlets.data(), base + meshletsOffset + record.firstMeshlet * sizeof(Meshlet), record.meshletCount * sizeof(Meshlet));
+        for (const Meshlet& meshlet : mesh.meshlets) {
+            if (static_cast<uint64_t>(meshlet.indexOffset) + meshlet.indexCount > mesh.indexCount)
+                return false;
+        }
+    }
+
+    model.meshes = std::move(meshes);
+    model.mapping = std::move(mapping);
+    return true;
+}
+
+bool writeMeshCache(const std::string& path, const ModelData& model) {
+    uint64_t sourceHash;
+    if (!hashSourceFile(path, sourceHash))
+        return false;
+
+    MeshCacheHeader header = {};
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.vertexSize = sizeof(Vertex);
+    header.meshCount = static_cast<uint32_t>(model.meshes.size());
+
+    std::vector<BindingRecord> bindings;
+    std::string strings;
+    for (const MeshData& mesh : model.meshes) {
+        for (const MeshTextureBinding& texture : mesh.textures) {
+            BindingRecord binding;
+            binding.typeOffset = static_cast<uint32_t>(strings.size());
+            binding.typeLength = static_cast<uint32_t>(texture.type.size());
+            strings += texture.type;
+            binding.pathOffset = static_cast<uint32_t>(strings.size());
+            binding.pathLength = static_cast<uint32_t>(texture.path.size());
+            strings += texture.path;
+            bindings.push_back(binding);
+        }
+    }
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    for (const MeshData& mesh : model.meshes) {
+        lods.insert(lods.end(), mesh.lods.begin(), mesh.lods.end());
+        meshlets.insert(meshlets.end(), mesh.meshlets.begin(), mesh.meshlets.end());
+    }
+
+    header.bindingCount = static_cast<uint32_t>(bindings.size());
+    header.lodCount = static_cast<uint32_t>(lods.size());
+    header.meshletCount = static_cast<uint32_t>(meshlets.size());
+    header.stringBytes = static_cast<uint32_t>(strings.size());
+
+    // Lay out the arrays after the tables
+    size_t tablesSize = sizeof(header) + model.meshes.size() * sizeof(MeshRecord) + bindings.size() * sizeof(BindingRecord)
+        + lods.size() * sizeof(MeshLod) + meshlets.size() * sizeof(Meshlet) + strings.size();
+    size_t offset = tablesSize;
+    std::vector<MeshRecord> records;
+    uint32_t firstBinding = 0, firstLod = 0, firstMeshlet = 0;
+    for (const MeshData& mesh : model.meshes) {
+        MeshRecord record;
+        record.vertexCount = static_cast<uint32_t>(mesh.vertexCount);
+        record.indexCount = static_cast<uint32_t>(mesh.indexCount);
+        record.firstBinding = firstBinding;
+        record.bindingCount = static_cast<uint32_t>(mesh.textures.size());
+        firstBinding += record.bindingCount;
+        record.firstLod = firstLod;
+        record.lodCount = static_cast<uint32_t>(mesh.lods.size());
+        firstLod += record.lodCount;
+        record.firstMeshlet = firstMeshlet;
+        record.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+        firstMeshlet += record.meshletCount;
+
+        offset = alignData(offset);
+        record.vertexOffset = offset;
+        offset += mesh.vertexCount * sizeof(Vertex);
+        offset = alignData(offset);
+        record.indexOffset = offset;
+        offset += mesh.indexCount * sizeof(unsigned int);
+        records.push_back(record);
+    }
+
+    std::vector<FileChunk> chunks;
+    static const unsigned char padding[16] = {};
+    chunks.push_back({ &header, sizeof(header) });
+    chunks.push_back({ records.data(), records.size() * sizeof(MeshRecord) });
+    chunks.push_back({ bindings.data(), bindings.size() * sizeof(BindingRecord) });
+    chunks.push_back({ lods.data(), lods.size() * sizeof(MeshLod) });
+    chunks.push_back({ meshlets.data(), meshlets.size() * sizeof(Meshlet) });
+    chunks.push_back({ strings.data(), strings.size() });
+
+    offset = tablesSize;
+    for (size_t i = 0; i < model.meshes.size(); ++i) {
+        const MeshData& mesh = model.meshes[i];
+        chunks.push_back({ padding, records[i].vertexOffset - offset });
+        chunks.push_back({ mesh.vertices, mesh.vertexCount * sizeof(Vertex) });
+        offset = records[i].vertexOffset + mesh.vertexCount * sizeof(Vertex);
+        chunks.push_back({ padding, records[i].indexOffset - offset });
+        chunks.push_back({ mesh.indices, mesh.indexCount * sizeof(unsigned int) });
+        offset = records[i].indexOffset + mesh.indexCount * sizeof(unsigned int);
+    }
+
+    std::string cachePath = cachePathFor(path);
+    if (!writeFileAtomically(cachePath, chunks)) {
+        std::cerr << "Failed to write mesh cache entry: " << cachePath << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <string>
+#include <vector>
+#include "CacheFile.h"
+#include "LevelGeometry.h"
+
+// Texture a mesh's material references, resolved to a path under media/textures/
+struct MeshTextureBinding {
+    std::string type; // Sampler prefix, e.g. "texture_diffuse"
+    std::string path;
+};
+
+// CPU-side mesh ready for glBufferData. The arrays live either in the storage vectors (fresh
+// import) or in the owning ModelData's mapped cache file.
+struct MeshData {
+    const Vertex* vertices = nullptr;
+    size_t vertexCount = 0;
+    const unsigned int* indices = nullptr;
+    size_t indexCount = 0;
+    std::vector<MeshTextureBinding> textures;
+    std::vector<MeshLod> lods; // Ranges of the index array, LOD 0 first; empty means one LOD
+    std::vector<Meshlet> meshlets; // Clusters of LOD 0
+
+    std::vector<Vertex> vertexStorage;
+    std::vector<unsigned int> indexStorage;
+
+    // Points vertices/indices at the storage vectors
+    void useStorage();
+};
+
+struct ModelData {
+    std::vector<MeshData> meshes;
+    MappedFile mapping; // Owns the mesh arrays on a cache hit
+};
+
+// Maps the .lgeo cache entry for the model at path. Fails when it is missing, was written by a
+// different format version or Vertex layout, the source file has changed since, or any range or
+// index in it points outside its arrays.
+bool loadMeshCache(const std::string& path, ModelData& model);
+
+// Writes model as the .lgeo cache entry for the model at path
+bool writeMeshCache(const std::string& path, const ModelData& model);
+
+#endif // MESH_CACHE_H
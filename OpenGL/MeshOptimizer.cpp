@@ -0,0 +1,364 @@
+#include "MeshOptimizer.h"
+#include "CacheFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// FIFO cache simulation. A vertex hits while fewer than cacheSize misses happened since it was
+// last loaded; reset() empties the cache without clearing the timestamps.
+class FifoCache {
+public:
+    FifoCache(size_t vertexCount, unsigned int cacheSize)
+        : timestamps(vertexCount, 0), cacheSize(cacheSize), time(cacheSize + 1) {}
+
+    bool access(unsigned int vertex) {
+        if (time - timestamps[vertex] > cacheSize) {
+            timestamps[vertex] = time++;
+            return false;
+        }
+        return true;
+    }
+
+    void reset() {
+        time += cacheSize + 1;
+    }
+
+private:
+    std::vector<unsigned int> timestamps;
+    unsigned int cacheSize;
+    unsigned int time;
+};
+
+unsigned int triangleMisses(FifoCache& cache, const unsigned int* triangle) {
+    return !cache.access(triangle[0]) + !cache.access(triangle[1]) + !cache.access(triangle[2]);
+}
+
+// Forsyth's scoring: recently used vertices score high (the last triangle's three slightly less,
+// to avoid strips), and vertices with few triangles left score high so they get finished off
+const int FORSYTH_CACHE_SIZE = 32;
+const int FORSYTH_MAX_VALENCE = 32;
+
+struct ForsythScores {
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[FORSYTH_MAX_VALENCE + 1];
+
+    ForsythScores() {
+        for (int i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+            cache[i] = i < 3 ? 0.75f : std::pow(1.0f - static_cast<float>(i - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+        valence[0] = 0.0f;
+        for (int i = 1; i <= FORSYTH_MAX_VALENCE; ++i)
+            valence[i] = 2.0f / std::sqrt(static_cast<float>(i));
+    }
+
+    float vertex(int cachePosition, unsigned int remainingValence) const {
+        if (remainingValence == 0)
+            return -1.0f; // No triangles left to draw with it
+        float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+        return score + valence[std::min(remainingValence, static_cast<unsigned int>(FORSYTH_MAX_VALENCE))];
+    }
+};
+
+const ForsythScores& forsythScores() {
+    static const ForsythScores scores;
+    return scores;
+}
+
+// Canonical bytes of a vertex for welding: -0 becomes +0 so both hash and compare equal
+Vertex weldKey(const Vertex& vertex) {
+    Vertex key = vertex;
+    float* components = reinterpret_cast<float*>(&key);
+    for (size_t i = 0; i < sizeof(Vertex) / sizeof(float); ++i) {
+        if (components[i] == 0.0f)
+            components[i] = 0.0f;
+    }
+    return key;
+}
+
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize) {
+    VertexCacheStats stats = {};
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return stats;
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t misses = 0, referencedCount = 0;
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        unsigned int vertex = indices[i];
+        misses += !cache.access(vertex);
+        if (!referenced[vertex]) {
+            referenced[vertex] = true;
+            ++referencedCount;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / triangleCount;
+    stats.atvr = static_cast<float>(misses) / referencedCount;
+    return stats;
+}
+
+size_t weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    static_assert(sizeof(Vertex) % sizeof(float) == 0, "Vertex must be all floats");
+    if (vertices.empty())
+        return 0;
+
+    // Open addressing over the canonical vertex bytes, sized to stay at most half full
+    size_t tableSize = 1;
+    while (tableSize < vertices.size() * 2)
+        tableSize *= 2;
+    const unsigned int EMPTY = ~0u;
+    std::vector<unsigned int> table(tableSize, EMPTY);
+
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    std::vector<unsigned int> remap(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        Vertex key = weldKey(vertices[i]);
+        size_t slot = static_cast<size_t>(hashBytes(&key, sizeof(key))) & (tableSize - 1);
+        while (table[slot] != EMPTY && std::memcmp(&welded[table[slot]], &key, sizeof(key)) != 0)
+            slot = (slot + 1) & (tableSize - 1);
+
+        if (table[slot] == EMPTY) {
+            table[slot] = static_cast<unsigned int>(welded.size());
+            welded.push_back(key);
+        }
+        remap[i] = table[slot];
+    }
+
+    for (unsigned int& index : indices)
+        index = remap[index];
+    vertices.swap(welded);
+    return vertices.size();
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+    const ForsythScores& scores = forsythScores();
+
+    // Triangles using each vertex; the first valence[v] entries are the ones not yet emitted
+    std::vector<unsigned int> valence(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        ++valence[indices[i]];
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int c = 0; c < 3; ++c)
+            adjacency[fill[indices[t * 3 + c]]++] = static_cast<unsigned int>(t);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = scores.vertex(-1, valence[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    size_t bestTriangle = 0;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const unsigned int* triangle = &indices[t * 3];
+        triangleScore[t] = vertexScore[triangle[0]] + vertexScore[triangle[1]] + vertexScore[triangle[2]];
+        if (triangleScore[t] > triangleScore[bestTriangle])
+            bestTriangle = t;
+    }
+
+    std::vector<unsigned int> output(triangleCount * 3);
+    unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+    unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t cursor = 0; // Triangles before it have all been emitted
+
+    for (size_t out = 0; out < triangleCount; ++out) {
+        if (bestTriangle == triangleCount) {
+            // Dead end: nothing in the cache has triangles left, take the next unemitted one
+            while (emitted[cursor])
+                ++cursor;
+            bestTriangle = cursor;
+        }
+
+        const unsigned int* triangle = &indices[bestTriangle * 3];
+        std::copy(triangle, triangle + 3, &output[out * 3]);
+        emitted[bestTriangle] = true;
+
+        // Unlink the triangle from its vertices' live adjacency
+        for (int c = 0; c < 3; ++c) {
+            unsigned int vertex = triangle[c];
+            unsigned int* list = &adjacency[adjacencyOffsets[vertex]];
+            unsigned int* end = list + valence[vertex];
+            unsigned int* found = std::find(list, end, static_cast<unsigned int>(bestTriangle));
+            std::swap(*found, *(end - 1));
+            --valence[vertex];
+        }
+
+        // The triangle's vertices move to the front of the LRU cache
+        int newCount = 0;
+        for (int c = 0; c < 3; ++c)
+            newCache[newCount++] = triangle[c];
+        for (int i = 0; i < cacheCount; ++i) {
+            unsigned int vertex = cache[i];
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                newCache[newCount++] = vertex;
+        }
+
+        // Rescore everything that moved; up to three vertices fall out of the cache
+        for (int i = 0; i < newCount; ++i) {
+            unsigned int vertex = newCache[i];
+            int position = i < FORSYTH_CACHE_SIZE ? i : -1;
+            cachePosition[vertex] = position;
+            float score = scores.vertex(position, valence[vertex]);
+            float delta = score - vertexScore[vertex];
+            vertexScore[vertex] = score;
+            const unsigned int* list = &adjacency[adjacencyOffsets[vertex]];
+            for (unsigned int a = 0; a < valence[vertex]; ++a)
+                triangleScore[list[a]] += delta;
+        }
+
+        // The next triangle is the best one touching the cache
+        bestTriangle = triangleCount;
+        float bestScore = -1.0f;
+        cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+        for (int i = 0; i < cacheCount; ++i) {
+            unsigned int vertex = newCache[i];
+            cache[i] = vertex;
+            const unsigned int* list = &adjacency[adjacencyOffsets[vertex]];
+            for (unsigned int a = 0; a < valence[vertex]; ++a) {
+                if (triangleScore[list[a]] > bestScore) {
+                    bestScore = triangleScore[list[a]];
+                    bestTriangle = list[a];
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold) {
+    const unsigned int cacheSize = 16;
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Hard boundaries: triangles that miss on all three vertices already start from a cold cache
+    std::vector<size_t> hardStarts(1, 0);
+    FifoCache cache(vertexCount, cacheSize);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (triangleMisses(cache, &indices[t * 3]) == 3 && t > 0)
+            hardStarts.push_back(t);
+    }
+    hardStarts.push_back(triangleCount);
+
+    // Soft boundaries: split a hard cluster wherever the ACMR of the part so far, replayed from a
+    // cold cache, is within threshold of the whole cluster's
+    std::vector<size_t> clusterStarts;
+    for (size_t h = 0; h + 1 < hardStarts.size(); ++h) {
+        size_t begin = hardStarts[h], end = hardStarts[h + 1];
+        cache.reset();
+        unsigned int clusterMisses = 0;
+        for (size_t t = begin; t < end; ++t)
+            clusterMisses += triangleMisses(cache, &indices[t * 3]);
+        float limit = threshold * clusterMisses / (end - begin);
+
+        cache.reset();
+        clusterStarts.push_back(begin);
+        size_t start = begin;
+        unsigned int misses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            misses += triangleMisses(cache, &indices[t * 3]);
+            if (t + 1 < end && misses <= limit * (t + 1 - start)) {
+                clusterStarts.push_back(t + 1);
+                start = t + 1;
+                misses = 0;
+                cache.reset();
+            }
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+    size_t clusterCount = clusterStarts.size() - 1;
+
+    // Area-weighted centroid and normal of each cluster and of the whole mesh
+    std::vector<glm::vec3> centroids(clusterCount), normals(clusterCount);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; ++c) {
+        glm::vec3 weighted(0.0f), normal(0.0f), plain(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+            const glm::vec3& a = vertices[indices[t * 3]].Position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 cross = glm::cross(b - a, d - a);
+            float twiceArea = glm::length(cross);
+            glm::vec3 center = (a + b + d) / 3.0f;
+            weighted += center * twiceArea;
+            plain += center;
+            normal += cross;
+            area += twiceArea;
+        }
+        size_t triangles = clusterStarts[c + 1] - clusterStarts[c];
+        centroids[c] = area > 0.0f ? weighted / area : plain / static_cast<float>(triangles);
+        float length = glm::length(normal);
+        normals[c] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        meshCentroid += weighted;
+        meshArea += area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Clusters facing away from the center occlude the rest, so they draw first
+    std::vector<float> sortKeys(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        sortKeys[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) {
+        return sortKeys[a] > sortKeys[b];
+    });
+
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    for (size_t c : order)
+        output.insert(output.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const unsigned int UNUSED = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), UNUSED);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int& index : indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = static_cast<unsigned int>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+MeshOptimizationStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    MeshOptimizationStats stats;
+    stats.verticesBefore = stats.verticesAfter = vertices.size();
+    stats.before = stats.after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    if (indices.empty() || indices.size() % 3 != 0)
+        return stats;
+
+    weldVertices(vertices, indices);
+    optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+    optimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+    optimizeVertexFetch(vertices, indices);
+
+    stats.verticesAfter = vertices.size();
+    stats.after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    return stats;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+#include "LevelGeometry.h"
+
+// Post-transform vertex cache efficiency of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats {
+    float acmr; // Average cache misses per triangle: 3.0 is worst, about 0.5 is ideal for a grid
+    float atvr; // Average transforms per referenced vertex: 1.0 is ideal
+};
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16);
+
+// Merges bit-identical vertices (treating -0 and +0 as equal) and rewrites the indices. Returns
+// the new vertex count.
+size_t weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// Reorders triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm)
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+// Splits a cache-optimized triangle order into clusters and sorts them so outward-facing clusters
+// draw first. threshold bounds the ACMR cost of the extra cluster boundaries (1.05 = 5%).
+void optimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold = 1.05f);
+
+// Renumbers vertices in first-use order so fetches walk the vertex buffer forward, and drops
+// vertices no triangle references
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// Whether every index fits GL_UNSIGNED_SHORT
+inline bool canUseShortIndices(size_t vertexCount) {
+    return vertexCount <= 65536;
+}
+
+struct MeshOptimizationStats {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    VertexCacheStats before = {};
+    VertexCacheStats after = {};
+};
+
+// The whole pipeline: weld, vertex cache order, overdraw order, then fetch order. Index arrays
+// that are not whole triangles are left alone.
+MeshOptimizationStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+#endif // MESH_OPTIMIZER_H
@@ -0,0 +1,527 @@
+#include "MeshSimplifier.h"
+#include "CacheFile.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+const size_t LOD_MAX_COUNT = 4;        // LOD 0 plus three simplified levels
+const float LOD_MAX_ERROR = 0.02f;     // Relative to the mesh extent
+const float LOD_MIN_REDUCTION = 0.85f; // A LOD must drop at least 15% of the previous one's triangles
+const size_t LOD_MIN_TRIANGLES = 64;   // Smaller meshes are not worth simplifying
+const double BORDER_WEIGHT = 10.0;     // Weight of the planes that hold borders and seams in place
+const float MAX_NORMAL_CHANGE = 0.25f; // Cosine; collapses that turn a triangle further are rejected
+const float DEVIATION_LIMIT = LOD_MAX_ERROR * 2.0f; // Measured deviations are searched up to this
+const unsigned int NONE = ~0u;
+
+enum VertexKind : unsigned char {
+    Manifold, // Interior vertex, collapses along any edge
+    Border,   // On an open edge, collapses along it
+    Seam,     // One of two wedges at a UV or lightmap UV seam, collapses along it with its twin
+    Locked
+};
+
+// Sum of squared distances to a set of weighted planes: v'Av + 2b'v + c
+struct Quadric {
+    double a00, a11, a22, a10, a20, a21;
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+
+Quadric planeQuadric(const glm::vec3& normal, const glm::vec3& point, double weight) {
+    double a = normal.x, b = normal.y, c = normal.z;
+    double d = -(a * point.x + b * point.y + c * point.z);
+    Quadric q;
+    q.a00 = weight * a * a;
+    q.a11 = weight * b * b;
+    q.a22 = weight * c * c;
+    q.a10 = weight * a * b;
+    q.a20 = weight * a * c;
+    q.a21 = weight * b * c;
+    q.b0 = weight * a * d;
+    q.b1 = weight * b * d;
+    q.b2 = weight * c * d;
+    q.c = weight * d * d;
+    q.weight = weight;
+    return q;
+}
+
+void accumulate(Quadric& q, const Quadric& other) {
+    q.a00 += other.a00;
+    q.a11 += other.a11;
+    q.a22 += other.a22;
+    q.a10 += other.a10;
+    q.a20 += other.a20;
+    q.a21 += other.a21;
+    q.b0 += other.b0;
+    q.b1 += other.b1;
+    q.b2 += other.b2;
+    q.c += other.c;
+    q.weight += other.weight;
+}
+
+// Weighted mean squared distance from p to the quadric's planes; an estimate, not a bound
+double quadricError(const Quadric& q, const glm::vec3& p) {
+    double x = p.x, y = p.y, z = p.z;
+    double error = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+        + 2.0 * (q.a10 * x * y + q.a20 * x * z + q.a21 * y * z)
+        + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+    return q.weight > 0.0 ? std::fabs(error) / q.weight : 0.0;
+}
+
+uint64_t edgeKey(unsigned int from, unsigned int to) {
+    return (static_cast<uint64_t>(from) << 32) | to;
+}
+
+// Representative vertex of every vertex's position, and the ring of vertices sharing it
+void groupPositions(const Vertex* vertices, size_t vertexCount, std::vector<unsigned int>& group, std::vector<unsigned int>& nextWedge) {
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2)
+        tableSize *= 2;
+    std::vector<unsigned int> table(tableSize, NONE);
+
+    group.resize(vertexCount);
+    nextWedge.resize(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        glm::vec3 position = vertices[v].Position;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (position[axis] == 0.0f)
+                position[axis] = 0.0f; // -0 and +0 are the same position
+        }
+        size_t slot = static_cast<size_t>(hashBytes(&position, sizeof(position))) & (tableSize - 1);
+        while (table[slot] != NONE && vertices[table[slot]].Position != position)
+            slot = (slot + 1) & (tableSize - 1);
+
+        if (table[slot] == NONE) {
+            table[slot] = v;
+            group[v] = v;
+            nextWedge[v] = v;
+        }
+        else {
+            unsigned int first = table[slot];
+            group[v] = first;
+            nextWedge[v] = nextWedge[first];
+            nextWedge[first] = v;
+        }
+    }
+}
+
+// Squared distance from p to the triangle abc
+float triangleDistanceSquared(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    // Closest point by Voronoi region, after Ericson's Real-Time Collision Detection
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+        return glm::dot(ap, ap);
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+        return glm::dot(bp, bp);
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+        return glm::dot(cp, cp);
+
+    glm::vec3 closest;
+    float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        closest = a + ab * (d1 / (d1 - d3));
+    else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        closest = a + ac * (d2 / (d2 - d6));
+    else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+        closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    else if (va + vb + vc > 0.0f)
+        closest = a + ab * (vb / (va + vb + vc)) + ac * (vc / (va + vb + vc));
+    else
+        closest = a; // Degenerate
+    glm::vec3 offset = p - closest;
+    return glm::dot(offset, offset);
+}
+
+// Triangles binned into a uniform grid, with cells about a triangle wide; nearest triangle
+// searches widen ring by ring around the point's cell until no closer triangle can remain
+class TriangleGrid {
+public:
+    TriangleGrid(const Vertex* vertices, const unsigned int* indices, size_t indexCount, const glm::vec3& lo, const glm::vec3& hi, float radius)
+        : vertices(vertices), indices(indices), origin(lo), radius(radius) {
+        // A surface of n triangles over the extent has edges about extent / sqrt(n) long
+        glm::vec3 size = hi - lo;
+        float extent = std::max(size.x, std::max(size.y, size.z));
+        cellSize = std::max(extent / MAX_DIMENSION, extent / std::sqrt(static_cast<float>(std::max<size_t>(1, indexCount / 3))));
+        if (cellSize <= 0.0f)
+            cellSize = 1.0f;
+        for (int axis = 0; axis < 3; ++axis)
+            dimensions[axis] = std::max(1, static_cast<int>(std::ceil(size[axis] / cellSize)));
+        std::vector<unsigned int> counts(cellCount() + 1, 0);
+        forEachCell(indexCount, [&](size_t cell, unsigned int) { ++counts[cell + 1]; });
+        for (size_t cell = 0; cell < cellCount(); ++cell)
+            counts[cell + 1] += counts[cell];
+        offsets = counts;
+        triangles.resize(offsets.back());
+        forEachCell(indexCount, [&](size_t cell, unsigned int triangle) { triangles[counts[cell]++] = triangle; });
+    }
+
+    // Distance from p to the nearest triangle, or the radius when none is closer
+    float distance(const glm::vec3& p) const {
+        float best = radius * radius;
+        int center[3];
+        cellOf(p, center);
+        // Triangles outside ring k are at least k cells away
+        for (int ring = 0; ring <= dimensions[0] + dimensions[1] + dimensions[2]; ++ring) {
+            float reach = ring * cellSize;
+            if (reach * reach >= best)
+                break;
+            for (int z = std::max(0, center[2] - ring); z <= std::min(dimensions[2] - 1, center[2] + ring); ++z) {
+                for (int y = std::max(0, center[1] - ring); y <= std::min(dimensions[1] - 1, center[1] + ring); ++y) {
+                    // Inside the shell only its two x ends are new
+                    bool shell = ring == 0 || std::abs(z - center[2]) == ring || std::abs(y - center[1]) == ring;
+                    for (int x = center[0] - ring; x <= center[0] + ring; x += shell ? 1 : 2 * ring) {
+                        if (x < 0 || x >= dimensions[0])
+                            continue;
+                        size_t cell = (static_cast<size_t>(z) * dimensions[1] + y) * dimensions[0] + x;
+                        for (unsigned int t = offsets[cell]; t < offsets[cell + 1]; ++t) {
+                            const unsigned int* triangle = &indices[triangles[t] * 3];
+                            best = std::min(best, triangleDistanceSquared(p, vertices[triangle[0]].Position,
+                                                                          vertices[triangle[1]].Position, vertices[triangle[2]].Position));
+                        }
+                    }
+                }
+            }
+        }
+        return std::sqrt(best);
+    }
+
+private:
+    const Vertex* vertices;
+    const unsigned int* indices;
+    static constexpr float MAX_DIMENSION = 128.0f; // Cells along the largest axis
+    glm::vec3 origin;
+    float radius;
+    float cellSize;
+    int dimensions[3];
+    std::vector<unsigned int> offsets, triangles; // Triangles of cell i at offsets[i]..offsets[i + 1]
+
+    size_t cellCount() const { return static_cast<size_t>(dimensions[0]) * dimensions[1] * dimensions[2]; }
+
+    void cellOf(const glm::vec3& p, int cell[3]) const {
+        for (int axis = 0; axis < 3; ++axis)
+            cell[axis] = std::min(dimensions[axis] - 1, std::max(0, static_cast<int>(std::floor((p[axis] - origin[axis]) / cellSize))));
+    }
+
+    template <typename Visit>
+    void forEachCell(size_t indexCount, const Visit& visit) const {
+        for (unsigned int triangle = 0; triangle < indexCount / 3; ++triangle) {
+            const glm::vec3& a = vertices[indices[triangle * 3]].Position;
+            const glm::vec3& b = vertices[indices[triangle * 3 + 1]].Position;
+            const glm::vec3& c = vertices[indices[triangle * 3 + 2]].Position;
+            int lo[3], hi[3];
+            cellOf(glm::min(a, glm::min(b, c)), lo);
+            cellOf(glm::max(a, glm::max(b, c)), hi);
+            for (int z = lo[2]; z <= hi[2]; ++z) {
+                for (int y = lo[1]; y <= hi[1]; ++y) {
+                    for (int x = lo[0]; x <= hi[0]; ++x)
+                        visit((static_cast<size_t>(z) * dimensions[1] + y) * dimensions[0] + x, triangle);
+                }
+            }
+        }
+    }
+};
+
+// Largest distance between the surfaces of two index lists over the same vertices, relative to
+// extent and at most DEVIATION_LIMIT: from every vertex of the first to the second surface, and
+// from the second's triangle centers and edge midpoints back to the first (its corners are on it)
+float surfaceDeviation(const Vertex* vertices, size_t vertexCount, const unsigned int* full, size_t fullCount,
+                       const unsigned int* simplified, size_t simplifiedCount, float extent) {
+    glm::vec3 lo = vertices[0].Position, hi = vertices[0].Position;
+    for (size_t v = 1; v < vertexCount; ++v) {
+        lo = glm::min(lo, vertices[v].Position);
+        hi = glm::max(hi, vertices[v].Position);
+    }
+    float radius = DEVIATION_LIMIT * extent;
+    TriangleGrid fullGrid(vertices, full, fullCount, lo, hi, radius);
+    TriangleGrid simplifiedGrid(vertices, simplified, simplifiedCount, lo, hi, radius);
+
+    float deviation = 0.0f;
+    std::vector<bool> visited(vertexCount, false);
+    for (size_t i = 0; i < fullCount; ++i) {
+        if (visited[full[i]])
+            continue;
+        visited[full[i]] = true;
+        deviation = std::max(deviation, simplifiedGrid.distance(vertices[full[i]].Position));
+    }
+    for (size_t i = 0; i + 2 < simplifiedCount; i += 3) {
+        const glm::vec3& a = vertices[simplified[i]].Position;
+        const glm::vec3& b = vertices[simplified[i + 1]].Position;
+        const glm::vec3& c = vertices[simplified[i + 2]].Position;
+        const glm::vec3 samples[4] = { (a + b + c) / 3.0f, (a + b) * 0.5f, (b + c) * 0.5f, (a + c) * 0.5f };
+        for (const glm::vec3& sample : samples)
+            deviation = std::max(deviation, fullGrid.distance(sample));
+    }
+    return deviation / extent;
+}
+
+} // namespace
+
+float meshExtent(const Vertex* vertices, size_t vertexCount) {
+    if (vertexCount == 0)
+        return 0.0f;
+    glm::vec3 lo = vertices[0].Position, hi = vertices[0].Position;
+    for (size_t i = 1; i < vertexCount; ++i) {
+        lo = glm::min(lo, vertices[i].Position);
+        hi = glm::max(hi, vertices[i].Position);
+    }
+    glm::vec3 size = hi - lo;
+    return std::max(size.x, std::max(size.y, size.z));
+}
+
+float simplifyMesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+                   size_t targetIndexCount, float targetError, std::vector<unsigned int>& result) {
+    result.assign(indices, indices + indexCount - indexCount % 3);
+    float extent = meshExtent(vertices, vertexCount);
+    if (result.size() <= targetIndexCount || extent <= 0.0f)
+        return 0.0f;
+
+    // Work in a unit-sized space so errors come out relative to the extent
+    std::vector<glm::vec3> positions(vertexCount);
+    glm::vec3 origin = vertices[0].Position;
+    for (size_t v = 0; v < vertexCount; ++v)
+        positions[v] = (vertices[v].Position - origin) / extent;
+
+    std::vector<unsigned int> group, nextWedge;
+    groupPositions(vertices, vertexCount, group, nextWedge);
+
+    // Open edges: directed edges with no opposite. Each border or seam vertex has one leaving and
+    // one arriving.
+    std::vector<uint64_t> edges;
+    edges.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (int e = 0; e < 3; ++e)
+            edges.push_back(edgeKey(result[i + e], result[i + (e + 1) % 3]));
+    }
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<unsigned int> openOut(vertexCount, NONE), openIn(vertexCount, NONE);
+    std::vector<unsigned char> openOutCount(vertexCount, 0), openInCount(vertexCount, 0);
+    std::vector<Quadric> quadrics(vertexCount, Quadric());
+    for (size_t i = 0; i < result.size(); i += 3) {
+        const glm::vec3& p0 = positions[result[i]];
+        glm::vec3 normal = glm::cross(positions[result[i + 1]] - p0, positions[result[i + 2]] - p0);
+        float twiceArea = glm::length(normal);
+        if (twiceArea > 0.0f)
+            normal /= twiceArea;
+
+        Quadric face = planeQuadric(normal, p0, twiceArea * 0.5);
+        for (int e = 0; e < 3; ++e)
+            accumulate(quadrics[group[result[i + e]]], face);
+
+        for (int e = 0; e < 3; ++e) {
+            unsigned int a = result[i + e], b = result[i + (e + 1) % 3];
+            if (std::binary_search(edges.begin(), edges.end(), edgeKey(b, a)))
+                continue;
+            openOut[a] = b;
+            openOutCount[a] = static_cast<unsigned char>(std::min(openOutCount[a] + 1, 2));
+            openIn[b] = a;
+            openInCount[b] = static_cast<unsigned char>(std::min(openInCount[b] + 1, 2));
+
+            // A plane through the edge, perpendicular to the triangle, keeps the edge in place
+            glm::vec3 edge = positions[b] - positions[a];
+            glm::vec3 side = glm::cross(edge, normal);
+            float sideLength = glm::length(side);
+            if (sideLength > 0.0f) {
+                Quadric border = planeQuadric(side / sideLength, positions[a], glm::dot(edge, edge) * BORDER_WEIGHT);
+                accumulate(quadrics[group[a]], border);
+                accumulate(quadrics[group[b]], border);
+            }
+        }
+    }
+
+    std::vector<unsigned char> kind(vertexCount, Locked);
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        unsigned int twin = nextWedge[v];
+        if (twin == v) {
+            if (openOutCount[v] == 0 && openInCount[v] == 0)
+                kind[v] = Manifold;
+            else if (openOutCount[v] == 1 && openInCount[v] == 1 && group[openOut[v]] != group[openIn[v]])
+                kind[v] = Border; // Both open edges ending at one position would be the end of a seam
+        }
+        else if (nextWedge[twin] == v) {
+            // Two wedges: a seam when each one's open edges continue along the other's
+            if (openOutCount[v] == 1 && openInCount[v] == 1 && openOutCount[twin] == 1 && openInCount[twin] == 1
+                && group[openOut[v]] == group[openIn[twin]] && group[openIn[v]] == group[openOut[twin]])
+                kind[v] = Seam;
+        }
+    }
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        float cost;
+    };
+
+    double maxCost = static_cast<double>(targetError) * targetError;
+    double worstCost = 0.0;
+    size_t triangleCount = result.size() / 3;
+    size_t targetTriangles = targetIndexCount / 3;
+    std::vector<unsigned int> collapse(vertexCount);
+    std::vector<bool> locked(vertexCount);
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1), adjacency;
+    std::vector<Collapse> candidates;
+
+    while (triangleCount > targetTriangles) {
+        // Triangles around each position
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (unsigned int index : result)
+            ++adjacencyOffsets[group[index] + 1];
+        for (size_t v = 0; v < vertexCount; ++v)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i)
+            adjacency[fill[group[result[i]]]++] = static_cast<unsigned int>(i / 3);
+
+        // Every allowed collapse along a triangle edge, cheapest first
+        candidates.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int e = 0; e < 6; ++e) {
+                unsigned int from = result[i + e % 3];
+                unsigned int to = result[i + (e % 3 + (e < 3 ? 1 : 2)) % 3];
+                bool allowed = kind[from] == Manifold
+                    || ((kind[from] == Border || kind[from] == Seam) && (openOut[from] == to || openIn[from] == to));
+                if (allowed) {
+                    Collapse candidate = { from, to, static_cast<float>(quadricError(quadrics[group[from]], positions[to])) };
+                    candidates.push_back(candidate);
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost;
+        });
+
+        for (unsigned int v = 0; v < vertexCount; ++v)
+            collapse[v] = v;
+        std::fill(locked.begin(), locked.end(), false);
+
+        size_t collapses = 0;
+        for (const Collapse& candidate : candidates) {
+            if (triangleCount <= targetTriangles || candidate.cost > maxCost)
+                break;
+            unsigned int from = candidate.from, to = candidate.to;
+            unsigned int fromGroup = group[from], toGroup = group[to];
+            if (locked[fromGroup] || locked[toGroup])
+                continue; // Changed earlier in this pass; its candidates are stale
+
+            unsigned int twin = NONE, twinTo = NONE;
+            if (kind[from] == Seam) {
+                twin = nextWedge[from];
+                twinTo = openOut[from] == to ? openIn[twin] : openOut[twin];
+            }
+
+            // Reject collapses that flip or sharply turn a remaining triangle
+            size_t removed = 0;
+            bool valid = true;
+            for (unsigned int a = adjacencyOffsets[fromGroup]; valid && a < adjacencyOffsets[fromGroup + 1]; ++a) {
+                const unsigned int* triangle = &result[adjacency[a] * 3];
+                unsigned int corners[3];
+                bool touchesTarget = false;
+                for (int c = 0; c < 3; ++c) {
+                    corners[c] = collapse[triangle[c]];
+                    touchesTarget = touchesTarget || group[corners[c]] == toGroup;
+                }
+                if (touchesTarget) {
+                    ++removed;
+                    continue;
+                }
+
+                glm::vec3 before[3], after[3];
+                for (int c = 0; c < 3; ++c) {
+                    before[c] = positions[corners[c]];
+                    after[c] = group[corners[c]] == fromGroup ? positions[to] : before[c];
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                valid = glm::dot(normalBefore, normalAfter) > MAX_NORMAL_CHANGE * glm::length(normalBefore) * glm::length(normalAfter);
+            }
+            if (!valid || (kind[from] == Seam && twinTo == NONE))
+                continue;
+
+            // Keep the open edge chains linked past the removed vertex
+            unsigned int pair[2][2] = { { from, to }, { twin, twinTo } };
+            for (int p = 0; p < (twin == NONE ? 1 : 2); ++p) {
+                unsigned int v = pair[p][0], target = pair[p][1];
+                collapse[v] = target;
+                if (kind[v] == Manifold)
+                    continue;
+                if (openOut[v] == target) {
+                    openIn[target] = openIn[v];
+                    if (openIn[v] != NONE)
+                        openOut[openIn[v]] = target;
+                }
+                else {
+                    openOut[target] = openOut[v];
+                    if (openOut[v] != NONE)
+                        openIn[openOut[v]] = target;
+                }
+            }
+
+            locked[fromGroup] = locked[toGroup] = true;
+            accumulate(quadrics[toGroup], quadrics[fromGroup]);
+            worstCost = std::max(worstCost, static_cast<double>(candidate.cost));
+            triangleCount -= std::min(removed, triangleCount);
+            ++collapses;
+        }
+
+        if (collapses == 0)
+            break;
+
+        // Apply the pass and drop the triangles that collapsed
+        size_t kept = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            unsigned int a = collapse[result[i]], b = collapse[result[i + 1]], c = collapse[result[i + 2]];
+            if (group[a] == group[b] || group[b] == group[c] || group[a] == group[c])
+                continue;
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        result.resize(kept);
+        triangleCount = kept / 3;
+    }
+
+    return static_cast<float>(std::sqrt(worstCost));
+}
+
+std::vector<MeshLod> buildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    MeshLod full = { 0, static_cast<uint32_t>(indices.size()), 0.0f };
+    std::vector<MeshLod> lods(1, full);
+    if (indices.size() % 3 != 0 || indices.size() / 3 < LOD_MIN_TRIANGLES)
+        return lods;
+
+    // The quadrics only estimate the error, as an area-weighted mean; each LOD stores the
+    // deviation measured against LOD 0, and LODs too far off to measure are dropped
+    float extent = meshExtent(vertices.data(), vertices.size());
+    std::vector<unsigned int> current(indices), simplified;
+    float error = 0.0f;
+    while (lods.size() < LOD_MAX_COUNT && error < LOD_MAX_ERROR) {
+        size_t target = current.size() / 6 * 3;
+        simplifyMesh(vertices.data(), vertices.size(), current.data(), current.size(), target, LOD_MAX_ERROR - error, simplified);
+        if (simplified.empty() || simplified.size() > current.size() * LOD_MIN_REDUCTION)
+            break;
+        float lodError = surfaceDeviation(vertices.data(), vertices.size(), indices.data(), full.indexCount,
+                                          simplified.data(), simplified.size(), extent);
+        if (lodError >= DEVIATION_LIMIT)
+            break;
+
+        optimizeVertexCache(simplified.data(), simplified.size(), vertices.size());
+        error = std::max(error, lodError);
+
+        MeshLod lod = { static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), error };
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        lods.push_back(lod);
+        current.swap(simplified);
+    }
+    return lods;
+}
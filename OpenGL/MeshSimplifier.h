@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <vector>
+#include "LevelGeometry.h"
+
+// Quadric error metric edge-collapse simplifier. Vertices only ever collapse onto other existing
+// vertices, so every LOD indexes the original vertex buffer.
+//
+// Seams are where vertices share a position but differ in UV or lightmap UV. A seam vertex only
+// collapses along its seam, together with its twin on the other side, so charts never tear open.
+// Open borders likewise only collapse along the border. Vertices where more than two wedges meet
+// or the topology is unclear are never moved.
+//
+// Collapses until the result has at most targetIndexCount indices or the next collapse would
+// exceed targetError. Errors are distances relative to the largest bounding box dimension; the
+// returned value is the largest error of any collapse made, as estimated by the quadrics. That is
+// an area-weighted mean distance to the merged planes, so single points may stray further.
+float simplifyMesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+                   size_t targetIndexCount, float targetError, std::vector<unsigned int>& result);
+
+// Largest dimension of the vertices' bounding box; simplifier errors are relative to it
+float meshExtent(const Vertex* vertices, size_t vertexCount);
+
+// Builds LOD 1.. from the full mesh in indices (LOD 0), halving the triangle count each step while
+// the error stays small and the reduction is worthwhile. The LOD index ranges are appended to
+// indices, each in vertex cache order; the returned list starts with LOD 0. Each LOD's error is
+// the largest distance between its surface and LOD 0's, measured rather than estimated, so it
+// can be used as a bound.
+std::vector<MeshLod> buildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+#endif // MESH_SIMPLIFIER_H
@@ -0,0 +1,127 @@
+#include "Meshlet.h"
+#include "LevelGeometry.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Bounding sphere and backface cone of the triangles in indices[begin, end)
+void computeMeshletBounds(const Vertex* vertices, const unsigned int* indices, size_t begin, size_t end, Meshlet& meshlet) {
+    glm::vec3 lo = vertices[indices[begin]].Position, hi = lo;
+    for (size_t i = begin; i < end; ++i) {
+        lo = glm::min(lo, vertices[indices[i]].Position);
+        hi = glm::max(hi, vertices[indices[i]].Position);
+    }
+    meshlet.center = (lo + hi) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (size_t i = begin; i < end; ++i)
+        meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].Position - meshlet.center));
+
+    // The cone axis is the mean triangle normal; its spread is the least aligned normal
+    std::vector<glm::vec3> corners, normals; // First corner and unit normal of each non-degenerate triangle
+    corners.reserve((end - begin) / 3);
+    normals.reserve((end - begin) / 3);
+    glm::vec3 axis(0.0f);
+    for (size_t i = begin; i < end; i += 3) {
+        const glm::vec3& p0 = vertices[indices[i]].Position;
+        glm::vec3 normal = glm::cross(vertices[indices[i + 1]].Position - p0, vertices[indices[i + 2]].Position - p0);
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            corners.push_back(p0);
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneApex = meshlet.center;
+    meshlet.coneCutoff = 2.0f;
+    float axisLength = glm::length(axis);
+    if (axisLength == 0.0f)
+        return;
+    axis /= axisLength;
+
+    float minAlignment = 1.0f;
+    for (const glm::vec3& normal : normals)
+        minAlignment = std::min(minAlignment, glm::dot(axis, normal));
+    if (minAlignment <= 0.1f)
+        return; // Wider than about 84 degrees; it would almost never cull
+
+    // Move the apex back along the axis until it lies behind every triangle's plane, so a camera
+    // inside the cone is behind all of them
+    float apexDistance = 0.0f;
+    for (size_t t = 0; t < normals.size(); ++t)
+        apexDistance = std::max(apexDistance, glm::dot(meshlet.center - corners[t], normals[t]) / glm::dot(axis, normals[t]));
+
+    meshlet.coneAxis = axis;
+    meshlet.coneApex = meshlet.center - axis * apexDistance;
+    meshlet.coneCutoff = std::sqrt(1.0f - minAlignment * minAlignment);
+}
+
+} // namespace
+
+std::vector<Meshlet> buildMeshlets(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexOffset, size_t indexCount) {
+    std::vector<Meshlet> meshlets;
+    std::vector<unsigned int> lastMeshlet(vertexCount, ~0u); // Meshlet that last counted each vertex
+    size_t begin = indexOffset, end = indexOffset + indexCount - indexCount % 3;
+    size_t start = begin, uniqueVertices = 0;
+    unsigned int current = 0;
+
+    for (size_t i = begin; i <= end; i += 3) {
+        size_t added = 0;
+        if (i < end) {
+            for (int c = 0; c < 3; ++c)
+                added += lastMeshlet[indices[i + c]] != current;
+        }
+
+        bool full = uniqueVertices + added > MESHLET_MAX_VERTICES || (i - start) / 3 == MESHLET_MAX_TRIANGLES;
+        if ((i == end || full) && i > start) {
+            Meshlet meshlet;
+            meshlet.indexOffset = static_cast<uint32_t>(start);
+            meshlet.indexCount = static_cast<uint32_t>(i - start);
+            computeMeshletBounds(vertices, indices, start, i, meshlet);
+            meshlets.push_back(meshlet);
+
+            start = i;
+            uniqueVertices = 0;
+            ++current;
+        }
+
+        if (i < end) {
+            for (int c = 0; c < 3; ++c) {
+                unsigned int vertex = indices[i + c];
+                if (lastMeshlet[vertex] != current) {
+                    lastMeshlet[vertex] = current;
+                    ++uniqueVertices;
+                }
+            }
+        }
+    }
+    return meshlets;
+}
+
+void cullMeshlets(const Meshlet* meshlets, size_t count, const Frustum& frustum, const glm::vec3& cameraPosition,
+                  std::vector<IndexRange>& ranges, ClusterCullStats& stats) {
+    size_t firstRange = ranges.size();
+    for (size_t i = 0; i < count; ++i) {
+        const Meshlet& meshlet = meshlets[i];
+        ++stats.tested;
+        if (!intersectsSphere(frustum, meshlet.center, meshlet.radius)) {
+            ++stats.frustumCulled;
+            continue;
+        }
+        if (backfaceCulled(meshlet, cameraPosition)) {
+            ++stats.backfaceCulled;
+            continue;
+        }
+
+        if (ranges.size() > firstRange && ranges.back().offset + ranges.back().count == meshlet.indexOffset) {
+            ranges.back().count += meshlet.indexCount;
+        }
+        else {
+            IndexRange range = { meshlet.indexOffset, meshlet.indexCount };
+            ranges.push_back(range);
+        }
+    }
+    stats.ranges += ranges.size() - firstRange;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+struct Vertex;
+
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+// A run of consecutive triangles in a mesh's index array, culled as a unit. The bounds are in
+// model space.
+struct Meshlet {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    glm::vec3 center; // Bounding sphere
+    float radius;
+    glm::vec3 coneApex; // Every triangle faces away from a camera inside the backface cone
+    float coneCutoff;   // Sine of the cone's half angle; above 1 when the triangles spread too far to cull
+    glm::vec3 coneAxis;
+};
+
+// Splits indices[indexOffset, indexOffset + indexCount) into meshlets of at most
+// MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles, in index order, so feed it
+// an index array that is already in vertex cache order
+std::vector<Meshlet> buildMeshlets(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexOffset, size_t indexCount);
+
+// A range of the index array to draw
+struct IndexRange {
+    uint32_t offset;
+    uint32_t count;
+};
+
+struct ClusterCullStats {
+    size_t tested = 0;
+    size_t frustumCulled = 0;
+    size_t backfaceCulled = 0;
+    size_t ranges = 0; // Index ranges left to draw after merging neighbouring visible meshlets
+};
+
+// Whether a camera at cameraPosition sees none of the meshlet's triangles from the front
+inline bool backfaceCulled(const Meshlet& meshlet, const glm::vec3& cameraPosition) {
+    glm::vec3 toApex = meshlet.coneApex - cameraPosition;
+    return glm::dot(toApex, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toApex);
+}
+
+// Tests the meshlets against the frustum and their backface cones and appends the visible ones to
+// ranges, merging consecutive meshlets into one range. frustum and cameraPosition must be in the
+// meshlets' model space; the cone test also assumes the model matrix scales uniformly.
+void cullMeshlets(const Meshlet* meshlets, size_t count, const Frustum& frustum, const glm::vec3& cameraPosition,
+                  std::vector<IndexRange>& ranges, ClusterCullStats& stats);
+
+#endif // MESHLET_H
@@ -0,0 +1,390 @@
+#include "MipmapBuilder.h"
+#include "Simd.h"
+#include "TextureCache.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const int MAX_MIP_LEVELS = 16;
+const int KAISER_TAPS = 8; // Source texels per output texel for a 2:1 reduction
+
+std::atomic<int> currentSettings(static_cast<int>(MipFilter::Box) | (1 << 8));
+
+// sRGB transfer tables. The inverse table is indexed by linear * 65535 so dark values keep full precision.
+struct ColorTables {
+    float toLinear[256];
+    unsigned char toSrgb[65536];
+
+    ColorTables() {
+        for (int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < 65536; ++i) {
+            float l = i / 65535.0f;
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            toSrgb[i] = static_cast<unsigned char>(std::min(255.0f, c * 255.0f + 0.5f));
+        }
+    }
+};
+
+const ColorTables& colorTables() {
+    static ColorTables tables;
+    return tables;
+}
+
+// Kaiser-windowed sinc sampled at the eight source texel centers around an output texel
+struct KaiserWeights {
+    float weights[KAISER_TAPS];
+
+    KaiserWeights() {
+        const float alpha = 4.0f;
+        float sum = 0.0f;
+        for (int t = 0; t < KAISER_TAPS; ++t) {
+            float distance = t - 3.5f; // In source texels from the output texel's center
+            float x = distance * 0.5f; // Cutoff at the destination Nyquist frequency
+            float sinc = std::fabs(x) < 1e-6f ? 1.0f : std::sin(3.14159265f * x) / (3.14159265f * x);
+            float ratio = distance / 4.0f;
+            float window = besselI0(alpha * std::sqrt(std::max(0.0f, 1.0f - ratio * ratio))) / besselI0(alpha);
+            weights[t] = sinc * window;
+            sum += weights[t];
+        }
+        for (int t = 0; t < KAISER_TAPS; ++t)
+            weights[t] /= sum;
+    }
+
+    static float besselI0(float x) {
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 16; ++k) {
+            term *= (x / (2.0f * k)) * (x / (2.0f * k));
+            sum += term;
+        }
+        return sum;
+    }
+};
+
+const KaiserWeights& kaiserWeights() {
+    static KaiserWeights weights;
+    return weights;
+}
+
+int wrap(int i, int size) {
+    i %= size;
+    return i < 0 ? i + size : i;
+}
+
+bool isColorChannel(int c, int channels, bool srgb) {
+    // One- and two-channel textures are data (masks, normals), never sRGB
+    return srgb && channels >= 3 && c < 3;
+}
+
+// Expands one row of 8-bit texels into RGBA floats, linearized if requested
+void loadRow(const unsigned char* row, int width, int channels, bool srgb, float* out) {
+    const ColorTables& tables = colorTables();
+    for (int x = 0; x < width; ++x) {
+        const unsigned char* texel = row + x * channels;
+        float* target = out + x * 4;
+        for (int c = 0; c < 4; ++c) {
+            if (c >= channels)
+                target[c] = c == 3 ? 1.0f : 0.0f;
+            else if (isColorChannel(c, channels, srgb))
+                target[c] = tables.toLinear[texel[c]];
+            else
+                target[c] = texel[c] * (1.0f / 255.0f);
+        }
+    }
+}
+
+// The filter kernels, in a vectorized and a scalar flavor
+struct FilterKernels {
+    void (*loadRow)(const unsigned char* row, int width, int channels, bool srgb, float* out);
+    void (*boxRow)(const float* a, const float* b, int sourceWidth, int width, float* out);
+    void (*kaiserRow)(const float* source, int sourceWidth, int width, float* out);
+    void (*kaiserColumn)(const float* const* rows, int width, float* out);
+    void (*storeRow)(const float* in, int width, int channels, bool srgb, unsigned char* row);
+};
+
+void boxRowScalar(const float* a, const float* b, int sourceWidth, int width, float* out) {
+    for (int x = 0; x < width; ++x) {
+        int x0 = std::min(2 * x, sourceWidth - 1) * 4;
+        int x1 = std::min(2 * x + 1, sourceWidth - 1) * 4;
+        for (int c = 0; c < 4; ++c)
+            out[x * 4 + c] = ((a[x0 + c] + a[x1 + c]) + (b[x0 + c] + b[x1 + c])) * 0.25f;
+    }
+}
+
+void kaiserRowScalar(const float* source, int sourceWidth, int width, float* out) {
+    const float* weights = kaiserWeights().weights;
+    for (int x = 0; x < width; ++x) {
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int t = 0; t < KAISER_TAPS; ++t) {
+            const float* texel = source + wrap(2 * x - 3 + t, sourceWidth) * 4;
+            for (int c = 0; c < 4; ++c)
+                sum[c] += texel[c] * weights[t];
+        }
+        for (int c = 0; c < 4; ++c)
+            out[x * 4 + c] = sum[c];
+    }
+}
+
+void kaiserColumnScalar(const float* const* rows, int width, float* out) {
+    const float* weights = kaiserWeights().weights;
+    for (int i = 0; i < width * 4; ++i) {
+        float sum = 0.0f;
+        for (int t = 0; t < KAISER_TAPS; ++t)
+            sum += rows[t][i] * weights[t];
+        out[i] = sum;
+    }
+}
+
+void storeRowScalar(const float* in, int width, int channels, bool srgb, unsigned char* row) {
+    const ColorTables& tables = colorTables();
+    for (int x = 0; x < width; ++x) {
+        for (int c = 0; c < channels; ++c) {
+            float value = std::min(1.0f, std::max(0.0f, in[x * 4 + c]));
+            if (isColorChannel(c, channels, srgb))
+                row[x * channels + c] = tables.toSrgb[static_cast<int>(value * 65535.0f + 0.5f)];
+            else
+                row[x * channels + c] = static_cast<unsigned char>(value * 255.0f + 0.5f);
+        }
+    }
+}
+
+#if USE_SSE2
+// One RGBA float texel per SSE register
+
+void loadRowSimd(const unsigned char* row, int width, int channels, bool srgb, float* out) {
+    if (channels != 4) {
+        loadRow(row, width, channels, srgb, out);
+        return;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+    if (srgb) {
+        const float* toLinear = colorTables().toLinear;
+        for (int x = 0; x < width; ++x) {
+            const unsigned char* texel = row + x * 4;
+            _mm_storeu_ps(out + x * 4, _mm_set_ps(texel[3] * (1.0f / 255.0f), toLinear[texel[2]], toLinear[texel[1]], toLinear[texel[0]]));
+        }
+        return;
+    }
+
+    for (int x = 0; x < width; ++x) {
+        int packed;
+        std::memcpy(&packed, row + x * 4, sizeof(packed));
+        __m128i widened = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+        _mm_storeu_ps(out + x * 4, _mm_mul_ps(_mm_cvtepi32_ps(widened), scale));
+    }
+}
+
+void boxRowSimd(const float* a, const float* b, int sourceWidth, int width, float* out) {
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (int x = 0; x < width; ++x) {
+        int x0 = std::min(2 * x, sourceWidth - 1) * 4;
+        int x1 = std::min(2 * x + 1, sourceWidth - 1) * 4;
+        __m128 top = _mm_add_ps(_mm_loadu_ps(a + x0), _mm_loadu_ps(a + x1));
+        __m128 bottom = _mm_add_ps(_mm_loadu_ps(b + x0), _mm_loadu_ps(b + x1));
+        _mm_storeu_ps(out + x * 4, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+    }
+}
+
+void kaiserRowSimd(const float* source, int sourceWidth, int width, float* out) {
+    const float* weights = kaiserWeights().weights;
+    __m128 w[KAISER_TAPS];
+    for (int t = 0; t < KAISER_TAPS; ++t)
+        w[t] = _mm_set1_ps(weights[t]);
+
+    for (int x = 0; x < width; ++x) {
+        int first = 2 * x - 3;
+        __m128 sum = _mm_setzero_ps();
+        if (first >= 0 && first + KAISER_TAPS <= sourceWidth) {
+            const float* texel = source + first * 4;
+            for (int t = 0; t < KAISER_TAPS; ++t)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(texel + t * 4), w[t]));
+        }
+        else {
+            for (int t = 0; t < KAISER_TAPS; ++t)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source + wrap(first + t, sourceWidth) * 4), w[t]));
+        }
+        _mm_storeu_ps(out + x * 4, sum);
+    }
+}
+
+void kaiserColumnSimd(const float* const* rows, int width, float* out) {
+    const float* weights = kaiserWeights().weights;
+    __m128 w[KAISER_TAPS];
+    for (int t = 0; t < KAISER_TAPS; ++t)
+        w[t] = _mm_set1_ps(weights[t]);
+
+    for (int i = 0; i < width * 4; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (int t = 0; t < KAISER_TAPS; ++t)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[t] + i), w[t]));
+        _mm_storeu_ps(out + i, sum);
+    }
+}
+
+void storeRowSimd(const float* in, int width, int channels, bool srgb, unsigned char* row) {
+    const ColorTables& tables = colorTables();
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 byteScale = _mm_set1_ps(255.0f);
+    const __m128 tableScale = _mm_set1_ps(65535.0f);
+    bool color = srgb && channels >= 3;
+
+    if (channels == 4 && !color) {
+        for (int x = 0; x < width; ++x) {
+            __m128 value = _mm_min_ps(one, _mm_max_ps(zero, _mm_loadu_ps(in + x * 4)));
+            __m128i words = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(value, byteScale)), _mm_setzero_si128());
+            int packed = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+            std::memcpy(row + x * 4, &packed, sizeof(packed));
+        }
+        return;
+    }
+
+    alignas(16) int bytes[4];
+    alignas(16) int tableIndices[4];
+    for (int x = 0; x < width; ++x) {
+        __m128 value = _mm_min_ps(one, _mm_max_ps(zero, _mm_loadu_ps(in + x * 4)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(bytes), _mm_cvtps_epi32(_mm_mul_ps(value, byteScale)));
+        unsigned char* target = row + x * channels;
+        if (color) {
+            _mm_store_si128(reinterpret_cast<__m128i*>(tableIndices), _mm_cvtps_epi32(_mm_mul_ps(value, tableScale)));
+            target[0] = tables.toSrgb[tableIndices[0]];
+            target[1] = tables.toSrgb[tableIndices[1]];
+            target[2] = tables.toSrgb[tableIndices[2]];
+            if (channels == 4)
+                target[3] = static_cast<unsigned char>(bytes[3]);
+        }
+        else {
+            for (int c = 0; c < channels; ++c)
+                target[c] = static_cast<unsigned char>(bytes[c]);
+        }
+    }
+}
+
+const FilterKernels simdKernels = { loadRowSimd, boxRowSimd, kaiserRowSimd, kaiserColumnSimd, storeRowSimd };
+#else
+const FilterKernels simdKernels = { loadRow, boxRowScalar, kaiserRowScalar, kaiserColumnScalar, storeRowScalar };
+#endif
+
+const FilterKernels scalarKernels = { loadRow, boxRowScalar, kaiserRowScalar, kaiserColumnScalar, storeRowScalar };
+
+void downsampleBox(const TextureMip& source, TextureMip& target, int channels, bool srgb, const FilterKernels& kernels) {
+    std::vector<float> rowA(source.width * 4), rowB(source.width * 4), filtered(target.width * 4);
+    unsigned char* out = const_cast<unsigned char*>(target.data);
+
+    for (int y = 0; y < target.height; ++y) {
+        int y0 = std::min(2 * y, source.height - 1);
+        int y1 = std::min(2 * y + 1, source.height - 1);
+        kernels.loadRow(source.data + static_cast<size_t>(y0) * source.width * channels, source.width, channels, srgb, rowA.data());
+        kernels.loadRow(source.data + static_cast<size_t>(y1) * source.width * channels, source.width, channels, srgb, rowB.data());
+        kernels.boxRow(rowA.data(), rowB.data(), source.width, target.width, filtered.data());
+        kernels.storeRow(filtered.data(), target.width, channels, srgb, out + static_cast<size_t>(y) * target.width * channels);
+    }
+}
+
+void downsampleKaiser(const TextureMip& source, TextureMip& target, int channels, bool srgb, const FilterKernels& kernels) {
+    // Horizontally filtered source rows, cached in a ring since neighbouring output rows share six of eight
+    std::vector<float> ring(KAISER_TAPS * target.width * 4);
+    int ringRows[KAISER_TAPS];
+    std::fill(ringRows, ringRows + KAISER_TAPS, -1);
+
+    std::vector<float> sourceRow(source.width * 4), filtered(target.width * 4);
+    const float* rows[KAISER_TAPS];
+    unsigned char* out = const_cast<unsigned char*>(target.data);
+
+    for (int y = 0; y < target.height; ++y) {
+        for (int t = 0; t < KAISER_TAPS; ++t) {
+            // Slots follow the unwrapped row so the eight taps never collide, even across the wrap
+            int unwrapped = 2 * y - 3 + t;
+            int sy = wrap(unwrapped, source.height);
+            int slot = wrap(unwrapped, KAISER_TAPS);
+            float* cached = ring.data() + slot * target.width * 4;
+            if (ringRows[slot] != sy) {
+                kernels.loadRow(source.data + static_cast<size_t>(sy) * source.width * channels, source.width, channels, srgb, sourceRow.data());
+                kernels.kaiserRow(sourceRow.data(), source.width, target.width, cached);
+                ringRows[slot] = sy;
+            }
+            rows[t] = cached;
+        }
+
+        kernels.kaiserColumn(rows, target.width, filtered.data());
+        kernels.storeRow(filtered.data(), target.width, channels, srgb, out + static_cast<size_t>(y) * target.width * channels);
+    }
+}
+
+size_t alignLevel(size_t offset) {
+    return (offset + 15) & ~static_cast<size_t>(15);
+}
+
+void buildLevels(const unsigned char* pixels, int width, int height, int channels, const MipmapSettings& settings, const FilterKernels& kernels, TextureImage& image) {
+    std::vector<TextureMip> levels;
+    size_t totalSize = 0;
+    for (int w = width, h = height; ; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+        TextureMip mip;
+        mip.width = w;
+        mip.height = h;
+        mip.size = static_cast<size_t>(w) * h * channels;
+        mip.data = nullptr;
+        totalSize = alignLevel(totalSize) + mip.size;
+        levels.push_back(mip);
+        if ((w == 1 && h == 1) || levels.size() == static_cast<size_t>(MAX_MIP_LEVELS))
+            break;
+    }
+
+    image.storage.resize(totalSize);
+    size_t offset = 0;
+    for (TextureMip& mip : levels) {
+        offset = alignLevel(offset);
+        mip.data = image.storage.data() + offset;
+        offset += mip.size;
+    }
+    std::memcpy(image.storage.data(), pixels, levels[0].size);
+
+    for (size_t level = 1; level < levels.size(); ++level) {
+        if (settings.filter == MipFilter::Kaiser)
+            downsampleKaiser(levels[level - 1], levels[level], channels, settings.srgb, kernels);
+        else
+            downsampleBox(levels[level - 1], levels[level], channels, settings.srgb, kernels);
+    }
+
+    image.mips = levels;
+}
+
+} // namespace
+
+bool isColorTextureType(const std::string& type) {
+    return type == "texture_diffuse" || type == "texture_skybox";
+}
+
+void setMipmapSettings(const MipmapSettings& settings) {
+    currentSettings = static_cast<int>(settings.filter) | (settings.srgb ? 1 << 8 : 0);
+}
+
+MipmapSettings mipmapSettings() {
+    int packed = currentSettings;
+    MipmapSettings settings;
+    settings.filter = static_cast<MipFilter>(packed & 0xFF);
+    settings.srgb = (packed & (1 << 8)) != 0;
+    return settings;
+}
+
+std::string mipmapSettingsKey() {
+    MipmapSettings settings = mipmapSettings();
+    std::string key = settings.filter == MipFilter::Kaiser ? "|kaiser" : "|box";
+    return settings.srgb ? key + "-srgb" : key;
+}
+
+void buildMipChain(const unsigned char* pixels, int width, int height, int channels, const MipmapSettings& settings, TextureImage& image) {
+    buildLevels(pixels, width, height, channels, settings, simdKernels, image);
+}
+
+void buildMipChainReference(const unsigned char* pixels, int width, int height, int channels, const MipmapSettings& settings, TextureImage& image) {
+    buildLevels(pixels, width, height, channels, settings, scalarKernels, image);
+}
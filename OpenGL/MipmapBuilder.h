@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef MIPMAP_BUILDER_H
+#define MIPMAP_BUILDER_H
+
+#include <string>
+
+struct TextureImage;
+
+enum class MipFilter {
+    Box,   // 2x2 average
+    Kaiser // 8-tap Kaiser-windowed sinc, sharper distant detail
+};
+
+struct MipmapSettings {
+    MipFilter filter = MipFilter::Box;
+    bool srgb = true; // Filter color channels in linear space (alpha is always linear); color textures only
+};
+
+// Whether textures of a material type ("texture_diffuse", "texture_normal", ...) hold sRGB color.
+// Normal, specular and lightmap textures hold data, which is filtered as stored.
+bool isColorTextureType(const std::string& type);
+
+// Settings used by the texture loader; call before loading. Part of the texture cache key.
+void setMipmapSettings(const MipmapSettings& settings);
+MipmapSettings mipmapSettings();
+std::string mipmapSettingsKey();
+
+// Fills image.storage/image.mips with level 0 (a copy of pixels) and every smaller level down to 1x1.
+// Runs on the calling thread; the texture loader calls it from its worker threads.
+void buildMipChain(const unsigned char* pixels, int width, int height, int channels, const MipmapSettings& settings, TextureImage& image);
+
+// Same filters written as plain scalar loops, the reference for benchmarks
+void buildMipChainReference(const unsigned char* pixels, int width, int height, int channels, const MipmapSettings& settings, TextureImage& image);
+
+#endif // MIPMAP_BUILDER_H
@@ -1,4 +1,8 @@
 #include "ModelLoader.h"
+#include "MeshSimplifier.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
 
 std::string extractFilename(const std::string& path) {
     // Find the last position of '/' or '\'
@@ -11,94 +15,150 @@ std::string extractFilename(const std::string& path) {
     return path.substr(lastSlashPos + 1);
 }
 
-std::vector<LevelGeometry> ModelLoader::loadModel(const std::string& path) {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+std::vector<LevelGeometry> ModelLoader::loadModel(const std::string& path, VertexFormat format, GeometryArena* arena) {
+    PROFILE_SCOPE("ModelLoader::loadModel");
+    ModelData model;
+    if (!loadModelData(path, model))
         throw std::runtime_error("Failed to load model");
-    }
 
-    std::vector<Texture> loadedTextures;
-    std::vector<LevelGeometry> meshes;
+    // One batched upload for every mesh, then the texture references
+    std::vector<GeometryArrays> arrays;
+    arrays.reserve(model.meshes.size());
+    for (const MeshData& mesh : model.meshes) {
+        GeometryArrays meshArrays = { mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount, mesh.lods.data(), mesh.lods.size(),
+                                    mesh.meshlets.data(), mesh.meshlets.size() };
+        arrays.push_back(meshArrays);
+    }
 
-    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[i];
-        meshes.push_back(processMesh(mesh, scene, loadedTextures));
+    std::vector<LevelGeometry> meshes = LevelGeometry::createBatch(arrays, format, arena);
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        acquireTextures(model.meshes[i], meshes[i]);
     }
 
     return meshes;
 }
 
-LevelGeometry ModelLoader::processMesh(aiMesh* mesh, const aiScene* scene, std::vector<Texture>& loadedTextures) {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
+bool ModelLoader::loadModelData(const std::string& path, ModelData& model) {
+    if (loadMeshCache(path, model))
+        return true;
 
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
+    if (!importModel(path, model))
+        return false;
 
-        // Process vertex positions
-        if (mesh->HasPositions()) {
-            vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-        }
+    MeshOptimizationStats stats = optimizeModel(model);
+    std::cout << "Optimized " << path << ": " << stats.verticesBefore << " -> " << stats.verticesAfter << " vertices, ACMR "
+              << stats.before.acmr << " -> " << stats.after.acmr << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << std::endl;
 
-        // Process vertex normals
-        if (mesh->HasNormals()) {
-            vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
-        }
+    writeMeshCache(path, model);
+    return true;
+}
 
-        if (mesh->HasTextureCoords(0)) {
-            vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
-        }
-        else {
-            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-        }
+bool ModelLoader::importModel(const std::string& path, ModelData& model) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 
-        // Process second set of texture coordinates for light mapping
-        if (mesh->HasTextureCoords(1)) { // Assuming the second UV set is in channel 1
-            vertex.LightMapTexCoords = glm::vec2(mesh->mTextureCoords[1][i].x, mesh->mTextureCoords[1][i].y);
-        }
-        else {
-            vertex.LightMapTexCoords = glm::vec2(0.0f, 0.0f);
-        }
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    // Meshes convert independently; the scene is only read
+    model.meshes.clear();
+    model.meshes.resize(scene->mNumMeshes);
+    model.mapping.close();
+    JobSystem::shared().parallelFor(scene->mNumMeshes, [&](unsigned int i) {
+        model.meshes[i] = processMesh(scene->mMeshes[i], scene);
+        model.meshes[i].useStorage();
+    });
 
-        vertices.push_back(vertex);
+    return true;
+}
+
+MeshOptimizationStats ModelLoader::optimizeModel(ModelData& model) {
+    std::vector<MeshOptimizationStats> meshStats(model.meshes.size());
+    JobSystem::shared().parallelFor(static_cast<unsigned int>(model.meshes.size()), [&](unsigned int i) {
+        MeshData& mesh = model.meshes[i];
+        meshStats[i] = optimizeMesh(mesh.vertexStorage, mesh.indexStorage);
+        mesh.lods = buildLodChain(mesh.vertexStorage, mesh.indexStorage);
+        mesh.meshlets = buildMeshlets(mesh.vertexStorage.data(), mesh.vertexStorage.size(), mesh.indexStorage.data(),
+                                      mesh.lods[0].indexOffset, mesh.lods[0].indexCount);
+        mesh.useStorage();
+    });
+
+    // ACMR averages over triangles and ATVR over vertices, so weight them accordingly
+    MeshOptimizationStats total;
+    double missesBefore = 0.0, missesAfter = 0.0;
+    size_t triangles = 0;
+    for (size_t i = 0; i < meshStats.size(); ++i) {
+        const MeshOptimizationStats& stats = meshStats[i];
+        size_t meshTriangles = model.meshes[i].lods[0].indexCount / 3; // LOD 0 only
+        total.verticesBefore += stats.verticesBefore;
+        total.verticesAfter += stats.verticesAfter;
+        missesBefore += static_cast<double>(stats.before.acmr) * meshTriangles;
+        missesAfter += static_cast<double>(stats.after.acmr) * meshTriangles;
+        triangles += meshTriangles;
+    }
+    if (triangles > 0) {
+        total.before.acmr = static_cast<float>(missesBefore / triangles);
+        total.after.acmr = static_cast<float>(missesAfter / triangles);
+    }
+    if (total.verticesBefore > 0 && total.verticesAfter > 0) {
+        total.before.atvr = static_cast<float>(missesBefore / total.verticesBefore);
+        total.after.atvr = static_cast<float>(missesAfter / total.verticesAfter);
+    }
+    return total;
+}
+
+MeshData ModelLoader::processMesh(aiMesh* mesh, const aiScene* scene) {
+    MeshData data;
+    std::vector<Vertex>& vertices = data.vertexStorage;
+    std::vector<unsigned int>& indices = data.indexStorage;
+
+    // Size both arrays up front and fill them in place
+    vertices.resize(mesh->mNumVertices);
+    const bool hasPositions = mesh->HasPositions();
+    const bool hasNormals = mesh->HasNormals();
+    const bool hasTexCoords = mesh->HasTextureCoords(0);
+    const bool hasLightMapTexCoords = mesh->HasTextureCoords(1); // Assuming the second UV set is in channel 1
+
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+        Vertex& vertex = vertices[i];
+        vertex.Position = hasPositions ? glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z) : glm::vec3(0.0f);
+        vertex.Normal = hasNormals ? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f);
+        vertex.TexCoords = hasTexCoords ? glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f);
+        // Second set of texture coordinates for light mapping
+        vertex.LightMapTexCoords = hasLightMapTexCoords ? glm::vec2(mesh->mTextureCoords[1][i].x, mesh->mTextureCoords[1][i].y) : glm::vec2(0.0f);
     }
 
     // Process indices
+    size_t indexCount = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        indexCount += mesh->mFaces[i].mNumIndices;
+
+    indices.resize(indexCount);
+    unsigned int* index = indices.data();
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
+        const aiFace& face = mesh->mFaces[i];
+        index = std::copy(face.mIndices, face.mIndices + face.mNumIndices, index);
     }
 
-    LevelGeometry geometry(vertices, indices);
-
     if (mesh->mMaterialIndex >= 0) {
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
-        // Load diffuse textures
-        std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", loadedTextures);
-        for (auto& texture : diffuseMaps) {
-            geometry.addTexture(texture);
-        }
+        // Diffuse textures
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
 
-        // Load lightmap textures
+        // Lightmap textures
         // Assuming lightmaps are stored as a specific type, e.g., aiTextureType_LIGHTMAP
-        std::vector<Texture> lightMapTextures = loadMaterialTextures(material, aiTextureType_LIGHTMAP, "texture_lightmap", loadedTextures);
-        for (auto& texture : lightMapTextures) {
-            geometry.addTexture(texture);
-        }
+        loadMaterialTextures(material, aiTextureType_LIGHTMAP, "texture_lightmap", data.textures);
 
         // ... repeat for other texture types if needed
     }
 
-    return geometry;
+    return data;
 }
 
-std::vector<Texture> ModelLoader::loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, std::vector<Texture>& loadedTextures) {
-    std::vector<Texture> textures;
+void ModelLoader::loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, std::vector<MeshTextureBinding>& textures) {
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
         aiString str;
         mat->GetTexture(type, i, &str);
@@ -107,32 +167,24 @@ std::vector<Texture> ModelLoader::loadMaterialTextures(aiMaterial* mat, aiTextur
         std::string filename = extractFilename(str.C_Str());
 
         // Construct the new path
-        std::string newPath = "media/textures/" + filename;
-
-        // Check if texture was loaded before to avoid duplicates
-        auto iter = std::find_if(loadedTextures.begin(), loadedTextures.end(),
-            [&newPath](const Texture& texture) {
-                return texture.path == newPath;
-            });
-
-        if (iter != loadedTextures.end()) {
-            textures.push_back(*iter);
-            continue;
-        }
+        MeshTextureBinding binding;
+        binding.type = typeName;
+        binding.path = "media/textures/" + filename;
+        textures.push_back(binding);
+    }
+}
 
-        // Load the texture
-        Texture texture;
-        texture.id = loadTexture(newPath.c_str());
+void ModelLoader::acquireTextures(const MeshData& mesh, LevelGeometry& geometry) {
+    for (const MeshTextureBinding& binding : mesh.textures) {
+        // The registry shares textures between every mesh and model that references them.
+        // New ones show a placeholder until the decoded image is uploaded.
+        Texture texture = TextureRegistry::instance().acquire(binding.path, binding.type);
         if (texture.id == 0) {
-            std::cerr << "Failed to load texture: " << newPath << std::endl;
+            std::cerr << "Failed to load texture: " << binding.path << std::endl;
             continue; // Skip this texture if loading failed
         }
-        std::cout << "Loaded texture: " << newPath << ", ID: " << texture.id << std::endl;
+        std::cout << "Queued texture: " << binding.path << ", ID: " << texture.id << std::endl;
 
-        texture.type = typeName;
-        texture.path = newPath;
-        textures.push_back(texture);
-        loadedTextures.push_back(texture);
+        geometry.addTexture(texture);
     }
-    return textures;
-}
+}
\ No newline at end of file
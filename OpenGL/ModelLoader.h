@@ -9,15 +9,31 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include "LevelGeometry.h" // Your custom geometry class
-#include "TextureLoader.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "TextureRegistry.h"
 
 class ModelLoader {
 public:
-    static std::vector<LevelGeometry> loadModel(const std::string& path);
+    // Loads from the .lgeo mesh cache, running Assimp only when the entry is missing or stale.
+    // VertexFormat::Quantized halves the vertex buffers but needs shaders that decode it. With an
+    // arena the meshes share its buffers and take its format.
+    static std::vector<LevelGeometry> loadModel(const std::string& path, VertexFormat format = VertexFormat::Standard, GeometryArena* arena = nullptr);
+
+    // CPU-side halves of loadModel(), no GL calls. Meshes are converted in parallel on the shared
+    // JobSystem.
+    static bool loadModelData(const std::string& path, ModelData& model);
+    static bool importModel(const std::string& path, ModelData& model); // Always runs Assimp
+
+    // Runs optimizeMesh(), buildLodChain() and buildMeshlets() on every imported mesh in parallel
+    // and returns the LOD 0 totals. loadModelData() does this before writing the cache, so cached meshes are
+    // already optimized.
+    static MeshOptimizationStats optimizeModel(ModelData& model);
 
 private:
-    static LevelGeometry processMesh(aiMesh* mesh, const aiScene* scene, std::vector<Texture>& loadedTextures);
-    static std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, std::vector<Texture>& loadedTextures);
+    static MeshData processMesh(aiMesh* mesh, const aiScene* scene);
+    static void loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, std::vector<MeshTextureBinding>& textures);
+    static void acquireTextures(const MeshData& mesh, LevelGeometry& geometry);
 };
 
 #endif // MODEL_LOADER_H
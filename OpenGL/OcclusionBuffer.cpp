@@ -0,0 +1,300 @@
+#include "OcclusionBuffer.h"
+#include "Simd.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+// Occluders are clipped to the near plane and to a guard band this many times the screen size,
+// which keeps the edge equations precise without clipping at the screen edges
+const float GUARD_BAND = 4.0f;
+const int CLIP_PLANE_COUNT = 5;
+const glm::vec4 CLIP_PLANES[CLIP_PLANE_COUNT] = {
+    glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), // Near: z >= -w
+    glm::vec4(1.0f, 0.0f, 0.0f, GUARD_BAND),
+    glm::vec4(-1.0f, 0.0f, 0.0f, GUARD_BAND),
+    glm::vec4(0.0f, 1.0f, 0.0f, GUARD_BAND),
+    glm::vec4(0.0f, -1.0f, 0.0f, GUARD_BAND)
+};
+
+// Tile rows each rasterization job covers
+const int BAND_TILE_ROWS = 4;
+
+const uint32_t FULL_MASK = 0xFFFFFFFFu;
+
+// Sutherland-Hodgman against CLIP_PLANES. Returns the vertex count of the clipped polygon in out,
+// which needs room for 3 + CLIP_PLANE_COUNT vertices.
+int clipTriangle(const glm::vec4* triangle, glm::vec4* out) {
+    glm::vec4 buffers[2][3 + CLIP_PLANE_COUNT];
+    const glm::vec4* input = triangle;
+    int count = 3;
+    for (int p = 0; p < CLIP_PLANE_COUNT && count > 0; ++p) {
+        glm::vec4* output = p + 1 == CLIP_PLANE_COUNT ? out : buffers[p & 1];
+        int outCount = 0;
+        for (int i = 0; i < count; ++i) {
+            const glm::vec4& a = input[i];
+            const glm::vec4& b = input[(i + 1) % count];
+            float da = glm::dot(CLIP_PLANES[p], a), db = glm::dot(CLIP_PLANES[p], b);
+            if (da >= 0.0f)
+                output[outCount++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+                output[outCount++] = a + (b - a) * (da / (da - db));
+        }
+        input = output;
+        count = outCount;
+    }
+    return count;
+}
+
+bool insideClipPlanes(const glm::vec4& v) {
+    for (const glm::vec4& plane : CLIP_PLANES) {
+        if (glm::dot(plane, v) < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// Pixels of the 8x4 tile at (x, y) whose centers are inside all three edges
+#if USE_SSE2
+template <typename Triangle>
+uint32_t coverageMask(const Triangle& triangle, float x, float y) {
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 steps[3];
+    for (int e = 0; e < 3; ++e)
+        steps[e] = _mm_mul_ps(_mm_set1_ps(triangle.edgeA[e]), offsets);
+
+    uint32_t mask = 0;
+    for (int row = 0; row < OcclusionBuffer::TILE_HEIGHT; ++row) {
+        float centerY = y + row + 0.5f;
+        for (int half = 0; half < 2; ++half) {
+            float left = x + half * 4;
+            __m128 inside = _mm_cmpge_ps(zero, zero);
+            for (int e = 0; e < 3; ++e) {
+                __m128 value = _mm_add_ps(_mm_set1_ps(triangle.edgeA[e] * left + triangle.edgeB[e] * centerY + triangle.edgeC[e]), steps[e]);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(value, zero));
+            }
+            mask |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << (row * OcclusionBuffer::TILE_WIDTH + half * 4);
+        }
+    }
+    return mask;
+}
+#else
+template <typename Triangle>
+uint32_t coverageMask(const Triangle& triangle, float x, float y) {
+    uint32_t mask = 0;
+    for (int row = 0; row < OcclusionBuffer::TILE_HEIGHT; ++row) {
+        float centerY = y + row + 0.5f;
+        for (int column = 0; column < OcclusionBuffer::TILE_WIDTH; ++column) {
+            float left = x + (column & ~3);
+            float offset = (column & 3) + 0.5f;
+            bool inside = true;
+            for (int e = 0; e < 3; ++e)
+                inside = inside && triangle.edgeA[e] * left + triangle.edgeB[e] * centerY + triangle.edgeC[e] + triangle.edgeA[e] * offset >= 0.0f;
+            if (inside)
+                mask |= 1u << (row * OcclusionBuffer::TILE_WIDTH + column);
+        }
+    }
+    return mask;
+}
+#endif
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+    : tilesX(std::max(1, (width + TILE_WIDTH - 1) / TILE_WIDTH)), tilesY(std::max(1, (height + TILE_HEIGHT - 1) / TILE_HEIGHT)),
+      tiles(static_cast<size_t>(tilesX) * tilesY) {
+    clear();
+}
+
+void OcclusionBuffer::clear() {
+    Tile empty = { 1.0f, 0.0f, 0 }; // The far plane
+    std::fill(tiles.begin(), tiles.end(), empty);
+    triangles.clear();
+}
+
+void OcclusionBuffer::addOccluder(const OccluderMesh& mesh, const glm::mat4& modelViewProjection) {
+    transformed.resize(mesh.positions.size());
+    for (size_t i = 0; i < mesh.positions.size(); ++i)
+        transformed[i] = modelViewProjection * glm::vec4(mesh.positions[i], 1.0f);
+
+    glm::vec4 polygon[3 + CLIP_PLANE_COUNT];
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        glm::vec4 triangle[3] = { transformed[mesh.indices[i]], transformed[mesh.indices[i + 1]], transformed[mesh.indices[i + 2]] };
+        if (insideClipPlanes(triangle[0]) && insideClipPlanes(triangle[1]) && insideClipPlanes(triangle[2])) {
+            addTriangle(triangle);
+            continue;
+        }
+
+        int count = clipTriangle(triangle, polygon);
+        for (int v = 2; v < count; ++v) {
+            glm::vec4 fan[3] = { polygon[0], polygon[v - 1], polygon[v] };
+            addTriangle(fan);
+        }
+    }
+}
+
+void OcclusionBuffer::addTriangle(const glm::vec4* clip) {
+    float x[3], y[3], z[3];
+    for (int i = 0; i < 3; ++i) {
+        float inverseW = 1.0f / clip[i].w;
+        x[i] = (clip[i].x * inverseW * 0.5f + 0.5f) * width();
+        y[i] = (clip[i].y * inverseW * 0.5f + 0.5f) * height();
+        z[i] = clip[i].z * inverseW;
+    }
+
+    // Counterclockwise on screen, so the inside of every edge is positive
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area < 0.0f) {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+    if (area < 1e-6f)
+        return; // Degenerate
+
+    ScreenTriangle triangle;
+    triangle.minTileX = std::max(0, static_cast<int>(std::floor(std::min(x[0], std::min(x[1], x[2])) / TILE_WIDTH)));
+    triangle.maxTileX = std::min(tilesX - 1, static_cast<int>(std::floor(std::max(x[0], std::max(x[1], x[2])) / TILE_WIDTH)));
+    triangle.minTileY = std::max(0, static_cast<int>(std::floor(std::min(y[0], std::min(y[1], y[2])) / TILE_HEIGHT)));
+    triangle.maxTileY = std::min(tilesY - 1, static_cast<int>(std::floor(std::max(y[0], std::max(y[1], y[2])) / TILE_HEIGHT)));
+    if (triangle.minTileX > triangle.maxTileX || triangle.minTileY > triangle.maxTileY)
+        return; // Off screen
+
+    for (int i = 0; i < 3; ++i) {
+        int j = (i + 1) % 3;
+        triangle.edgeA[i] = y[i] - y[j];
+        triangle.edgeB[i] = x[j] - x[i];
+        triangle.edgeC[i] = -(triangle.edgeA[i] * x[i] + triangle.edgeB[i] * y[i]);
+    }
+    triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    triangle.depthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+    triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+    triangle.maxDepth = std::max(z[0], std::max(z[1], z[2]));
+    triangles.push_back(triangle);
+}
+
+void OcclusionBuffer::rasterize(OcclusionStats& stats) {
+    PROFILE_SCOPE("OcclusionBuffer::rasterize");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    stats.occluderTriangles += triangles.size();
+    if (!triangles.empty()) {
+        // Bands own disjoint tile rows, so the jobs never write the same tile
+        int bandCount = (tilesY + BAND_TILE_ROWS - 1) / BAND_TILE_ROWS;
+        JobSystem::shared().parallelFor(static_cast<unsigned int>(bandCount), [this](unsigned int band) {
+            int first = static_cast<int>(band) * BAND_TILE_ROWS;
+            rasterizeBand(first, std::min(first + BAND_TILE_ROWS, tilesY));
+        });
+    }
+    stats.rasterizeMilliseconds += millisecondsSince(start);
+}
+
+void OcclusionBuffer::rasterizeBand(int firstTileRow, int endTileRow) {
+    for (const ScreenTriangle& triangle : triangles) {
+        int rowBegin = std::max(triangle.minTileY, firstTileRow);
+        int rowEnd = std::min(triangle.maxTileY + 1, endTileRow);
+        for (int tileY = rowBegin; tileY < rowEnd; ++tileY) {
+            float y = static_cast<float>(tileY * TILE_HEIGHT);
+            for (int tileX = triangle.minTileX; tileX <= triangle.maxTileX; ++tileX) {
+                float x = static_cast<float>(tileX * TILE_WIDTH);
+                // Farthest point of the depth plane over the tile's pixel centers, or of the
+                // triangle itself if that is nearer
+                float depth = triangle.depthC
+                    + triangle.depthA * (triangle.depthA > 0.0f ? x + TILE_WIDTH - 0.5f : x + 0.5f)
+                    + triangle.depthB * (triangle.depthB > 0.0f ? y + TILE_HEIGHT - 0.5f : y + 0.5f);
+                depth = std::min(depth, triangle.maxDepth);
+
+                Tile& tile = tiles[static_cast<size_t>(tileY) * tilesX + tileX];
+                if (depth >= tile.farDepth)
+                    continue; // Behind everything already in the tile
+
+                uint32_t coverage = coverageMask(triangle, x, y);
+                if (coverage == 0)
+                    continue;
+
+                if (tile.mask != 0 && depth - tile.nearDepth > tile.farDepth - depth) {
+                    // Closer to the far layer than to the near one: start a new near layer rather
+                    // than pushing the current one back
+                    tile.nearDepth = depth;
+                    tile.mask = coverage;
+                }
+                else {
+                    tile.nearDepth = tile.mask != 0 ? std::max(tile.nearDepth, depth) : depth;
+                    tile.mask |= coverage;
+                }
+
+                if (tile.mask == FULL_MASK) {
+                    tile.farDepth = tile.nearDepth;
+                    tile.mask = 0;
+                }
+            }
+        }
+    }
+}
+
+bool OcclusionBuffer::isVisible(const AABB& box, const glm::mat4& viewProjection) const {
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX, nearest = 1.0f;
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 position((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+        if (clip.w < 1e-5f)
+            return true; // Reaches behind the camera
+        float inverseW = 1.0f / clip.w;
+        float x = (clip.x * inverseW * 0.5f + 0.5f) * width();
+        float y = (clip.y * inverseW * 0.5f + 0.5f) * height();
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z * inverseW);
+    }
+
+    // Every pixel the box's screen rectangle touches; clamped before converting, as corners near
+    // the camera plane project very far out
+    int left = static_cast<int>(std::floor(std::max(minX, 0.0f)));
+    int right = static_cast<int>(std::floor(std::min(maxX, width() - 1.0f)));
+    int bottom = static_cast<int>(std::floor(std::max(minY, 0.0f)));
+    int top = static_cast<int>(std::floor(std::min(maxY, height() - 1.0f)));
+    if (left > right || bottom > top)
+        return false; // Off screen
+
+    for (int tileY = bottom / TILE_HEIGHT; tileY <= top / TILE_HEIGHT; ++tileY) {
+        int firstRow = std::max(bottom - tileY * TILE_HEIGHT, 0);
+        int lastRow = std::min(top - tileY * TILE_HEIGHT, TILE_HEIGHT - 1);
+        for (int tileX = left / TILE_WIDTH; tileX <= right / TILE_WIDTH; ++tileX) {
+            int firstColumn = std::max(left - tileX * TILE_WIDTH, 0);
+            int lastColumn = std::min(right - tileX * TILE_WIDTH, TILE_WIDTH - 1);
+            uint32_t rowBits = ((2u << lastColumn) - 1) & ~((1u << firstColumn) - 1);
+            uint32_t rectangle = 0;
+            for (int row = firstRow; row <= lastRow; ++row)
+                rectangle |= rowBits << (row * TILE_WIDTH);
+
+            // Only the near layer matters if it covers every pixel of the rectangle
+            const Tile& tile = tiles[static_cast<size_t>(tileY) * tilesX + tileX];
+            float depth = (rectangle & ~tile.mask) != 0 ? tile.farDepth : tile.nearDepth;
+            if (nearest <= depth)
+                return true;
+        }
+    }
+    return false;
+}
+
+void OcclusionBuffer::removeOccluded(const std::vector<AABB>& bounds, const glm::mat4& viewProjection, std::vector<uint32_t>& visible, OcclusionStats& stats) const {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t tested = visible.size();
+    visible.erase(std::remove_if(visible.begin(), visible.end(), [&](uint32_t index) {
+        return !isVisible(bounds[index], viewProjection);
+    }), visible.end());
+    stats.tested += tested;
+    stats.occluded += tested - visible.size();
+    stats.testMilliseconds += millisecondsSince(start);
+}
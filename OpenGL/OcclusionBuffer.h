@@ -0,0 +1,85 @@
+#pragma once
+
+#ifndef OCCLUSION_BUFFER_H
+#define OCCLUSION_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+// Occluder geometry kept on the CPU: a simplified triangle mesh in model space
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+struct OcclusionStats {
+    size_t occluderTriangles = 0; // Rasterized, after clipping
+    size_t tested = 0;
+    size_t occluded = 0;
+    double rasterizeMilliseconds = 0.0;
+    double testMilliseconds = 0.0;
+};
+
+// Low-resolution software depth buffer for occlusion culling, in the style of masked occlusion
+// culling. The screen is split into 8x4 pixel tiles; instead of per-pixel depths each tile keeps a
+// coverage mask and two depths: a far depth bounding every pixel of the tile, and a nearer one
+// bounding the pixels in the mask. Triangles merge into the nearer layer until it covers the whole
+// tile and becomes the new far depth. Every stored depth is an upper bound of what the occluders
+// cover, so a box is only reported hidden when it really is behind them at every pixel center.
+//
+// Depths are clip-space z / w. Occluders are drawn double-sided.
+class OcclusionBuffer {
+public:
+    static const int TILE_WIDTH = 8;
+    static const int TILE_HEIGHT = 4;
+
+    OcclusionBuffer(int width, int height); // Rounded up to whole tiles
+
+    int width() const { return tilesX * TILE_WIDTH; }
+    int height() const { return tilesY * TILE_HEIGHT; }
+
+    // Starts a frame: empties the buffer and the occluder list
+    void clear();
+
+    // Transforms the occluder by modelViewProjection, clips it to the near plane and queues its
+    // triangles for rasterize()
+    void addOccluder(const OccluderMesh& mesh, const glm::mat4& modelViewProjection);
+
+    // Rasterizes the queued triangles, bands of tile rows in parallel on JobSystem::shared()
+    void rasterize(OcclusionStats& stats);
+
+    // False when the world-space box is hidden behind the rasterized occluders. Boxes crossing
+    // the near plane are always visible.
+    bool isVisible(const AABB& box, const glm::mat4& viewProjection) const;
+
+    // Removes the indices whose bounds[index] are hidden from visible, keeping the order
+    void removeOccluded(const std::vector<AABB>& bounds, const glm::mat4& viewProjection, std::vector<uint32_t>& visible, OcclusionStats& stats) const;
+
+private:
+    struct Tile {
+        float farDepth;  // Bounds every pixel of the tile
+        float nearDepth; // Bounds the pixels in mask
+        uint32_t mask;   // Bit y * TILE_WIDTH + x
+    };
+
+    // Triangle in pixel coordinates, set up for rasterization
+    struct ScreenTriangle {
+        float edgeA[3], edgeB[3], edgeC[3]; // Inside where every a * x + b * y + c >= 0
+        float depthA, depthB, depthC;       // Depth plane z = a * x + b * y + c
+        float maxDepth;
+        int minTileX, maxTileX, minTileY, maxTileY;
+    };
+
+    int tilesX, tilesY;
+    std::vector<Tile> tiles;
+    std::vector<ScreenTriangle> triangles;
+    std::vector<glm::vec4> transformed; // addOccluder() scratch
+
+    void addTriangle(const glm::vec4* clip);
+    void rasterizeBand(int firstTileRow, int endTileRow);
+};
+
+#endif // OCCLUSION_BUFFER_H
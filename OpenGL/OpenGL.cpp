@@ -1,12 +1,36 @@
 #include "shader.h"
+#include "AllocationCounter.h"
+#include "CameraUniforms.h"
 #include "Skybox.h"
+#include "EnvironmentBaker.h"
+#include "FramePacer.h"
+#include "GeometryArena.h"
+#include "MaterialTable.h"
+#include "Profiler.h"
 #include "ModelLoader.h"
+#include "StreamBuffer.h"
+#include "JobSystem.h"
+#include "TaskGraph.h"
+#include "RenderQueue.h"
+#include "ShaderCache.h"
+#include "OcclusionBuffer.h"
+#include "SceneBvh.h"
+#include "Benchmark.h"
+#include "TextureCompression.h"
+#include "TextureLoader.h"
+#include "TextureRegistry.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <vector>
 #include <string>
 #include <assimp/Importer.hpp>
@@ -20,8 +44,7 @@ glm::vec3 cameraDirection = glm::normalize(cameraPos - cameraTarget);
 glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
 glm::vec3 cameraFront = -cameraDirection;
 
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+glm::vec3 previousCameraPos = cameraPos; // Before the last simulation step, for interpolation
 float cameraSpeed = 5.0f;
 
 float yaw = -90.0f;   // Yaw is initialized to -90.0 degrees since a yaw of 0.0 results in a direction vector pointing to the right
@@ -67,10 +90,9 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     cameraFront = glm::normalize(front);
 }
 
-void processInput(GLFWwindow* window) {
-    float currentFrame = glfwGetTime();
-    deltaTime = currentFrame - lastFrame;
-    lastFrame = currentFrame;
+// One fixed simulation step of deltaTime seconds
+void processInput(GLFWwindow* window, float deltaTime) {
+    previousCameraPos = cameraPos;
 
     float speed = cameraSpeed * deltaTime;
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
@@ -88,7 +110,39 @@ void processInput(GLFWwindow* window) {
     //    << cameraPos.z << std::endl;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+
+    // Headless CPU benchmarks don't need a window
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        return runBenchmark(std::vector<std::string>(argv + 2, argv + argc));
+    }
+
+    // Frame pacing: --swap vsync|adaptive|uncapped, --frames-in-flight N (0 = up to the driver),
+    // --low-latency for late input and one frame in flight; --compress to block-compress diffuse textures
+    SwapMode swapMode = SwapMode::VSync;
+    int framesInFlight = 2;
+    bool lateInput = false;
+    bool compressTextures = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--swap" && i + 1 < argc) {
+            std::string value = argv[++i];
+            swapMode = value == "uncapped" ? SwapMode::Uncapped : value == "adaptive" ? SwapMode::Adaptive : SwapMode::VSync;
+        }
+        else if (option == "--frames-in-flight" && i + 1 < argc) {
+            framesInFlight = std::max(0, std::min(std::atoi(argv[++i]), static_cast<int>(FramePacer::MAX_FRAMES_IN_FLIGHT)));
+        }
+        else if (option == "--low-latency") {
+            lateInput = true;
+            framesInFlight = 1;
+        }
+        else if (option == "--compress") {
+            compressTextures = true;
+        }
+        else {
+            std::cerr << "Unknown option: " << option << std::endl;
+        }
+    }
 
     // Initialize GLFW
     if (!glfwInit()) {
@@ -125,11 +179,9 @@ int main() {
     float nearPlane = 0.1f; // Near clipping plane
     float farPlane = 100.0f; // Far clipping plane
 
-    // Enable VSync (1 = on, 0 = off)
-    glfwSwapInterval(1);
-
     // Make the window's context current
     glfwMakeContextCurrent(window);
+    PROFILE_THREAD_NAME("Main");
 
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -144,8 +196,25 @@ int main() {
     // Set the key callback
     glfwSetKeyCallback(window, key_callback);
 
+    // The swap interval applies to the current context, so it is set only now
+    FramePacer framePacer;
+    framePacer.setSwapMode(swapMode);
+    framePacer.setMaxFramesInFlight(framesInFlight);
+    framePacer.setLateInput(lateInput);
+    FixedTimestep simulation(1.0 / 120.0);
+
+    // GPU scopes need the context; the trace and per-scope statistics are written on exit
+    PROFILE_INIT_GPU();
+
     // Configure global OpenGL state
     glEnable(GL_DEPTH_TEST);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS); // Filter across cube faces for the mipmapped skybox and environment
+
+    // Opt-in: block-compress diffuse textures as they are loaded (BC1/BC3, cached on disk)
+    setTextureCompression(compressTextures, CompressionQuality::High);
+
+    // Texture memory budget; least recently used textures are evicted or lose mip levels beyond it
+    TextureRegistry::instance().setBudget(512 * 1024 * 1024);
 
     // Create projection matrix
     glm::mat4 projection = glm::perspective(fov, aspectRatio, nearPlane, farPlane);
@@ -154,32 +223,15 @@ int main() {
     // Model matrix
     glm::mat4 model = glm::mat4(1.0f); // Initialize to identity matrix
 
-    // Build and compile our shader program
-    Shader SkyboxShader("shaders/skybox.vert", "shaders/skybox.frag");
-
-    // Build and compile our shader program
-    Shader SimpleDiffuse("shaders/simple_diffuse.vert", "shaders/simple_diffuse.frag");
-
-    // Build and compile our shader program
-    Shader SimpleLightmap("shaders/simple_lightmap.vert", "shaders/simple_lightmap.frag");
-
-    // Check for shader compilation/linking errors
-    if (!SkyboxShader.isSuccessfullyCompiled()) {
-        std::cerr << "Failed to compile/link skybox shader" << std::endl;
-        return -1;
-    }
-
-    // Check for shader compilation/linking errors
-    if (!SimpleDiffuse.isSuccessfullyCompiled()) {
-        std::cerr << "Failed to compile/link simple_diffuse shader" << std::endl;
-        return -1;
-    }
-
-    // Check for shader compilation/linking errors
-    if (!SimpleLightmap.isSuccessfullyCompiled()) {
-        std::cerr << "Failed to compile/link simple_lightmap shader" << std::endl;
-        return -1;
-    }
+    // Build the programs together: linked straight from the program binary cache on a warm start,
+    // otherwise compiled on the driver's threads while the environment and the level load
+    ShaderBatch shaderBatch;
+    size_t skyboxProgram = shaderBatch.add("shaders/skybox.vert", "shaders/skybox.frag");
+    // The level keeps its hand-written pairs: neither source tests the FEATURE_* macros, so
+    // ShaderPermutations would link the same program for every key
+    size_t diffuseProgram = shaderBatch.add("shaders/simple_diffuse.vert", "shaders/simple_diffuse.frag");
+    size_t lightmapProgram = shaderBatch.add("shaders/simple_lightmap.vert", "shaders/simple_lightmap.frag");
+    shaderBatch.start();
 
     GLuint skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
@@ -204,7 +256,42 @@ int main() {
 
     GLuint cubemapTexture = loadCubemap(faces);
 
-    std::vector<LevelGeometry> geometries = ModelLoader::loadModel("media/models/plane.fbx");
+    // Prefiltered radiance and SH irradiance from the same faces, baked once and cached on disk
+    EnvironmentMap environment;
+    GLuint environmentTexture = 0;
+    if (bakeEnvironment(faces, environment))
+        environmentTexture = createEnvironmentCubemap(environment);
+
+    // Every mesh in one shared vertex and index buffer where multi-draw indirect is available, so
+    // the level draws with one vertex array and, with a DrawData-aware shader, one call per material
+    GeometryArena geometryArena;
+    bool useArena = GeometryArena::isSupported();
+    if (useArena)
+        geometryArena.create(VertexFormat::Standard, 1 << 20, 1 << 22);
+    std::vector<LevelGeometry> geometries = ModelLoader::loadModel("media/models/plane.fbx", VertexFormat::Standard, useArena ? &geometryArena : nullptr);
+
+    const ShaderBuildStats& shaderStats = shaderBatch.finish();
+    Shader SkyboxShader = shaderBatch.shader(skyboxProgram);
+    Shader SimpleDiffuse = shaderBatch.shader(diffuseProgram);
+    Shader SimpleLightmap = shaderBatch.shader(lightmapProgram);
+
+    // Check for shader compilation/linking errors
+    if (!SkyboxShader.isSuccessfullyCompiled()) {
+        std::cerr << "Failed to compile/link skybox shader" << std::endl;
+        return -1;
+    }
+
+    // Check for shader compilation/linking errors
+    if (!SimpleDiffuse.isSuccessfullyCompiled()) {
+        std::cerr << "Failed to compile/link simple_diffuse shader" << std::endl;
+        return -1;
+    }
+
+    // Check for shader compilation/linking errors
+    if (!SimpleLightmap.isSuccessfullyCompiled()) {
+        std::cerr << "Failed to compile/link simple_lightmap shader" << std::endl;
+        return -1;
+    }
 
     // Define model matrix for the plane geometry
     glm::mat4 planeModel = glm::mat4(1.0f);
@@ -212,49 +299,322 @@ int main() {
     planeModel = glm::scale(planeModel, glm::vec3(scale, scale, scale)); // Scale the model
     planeModel = glm::rotate(planeModel, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)); // Rotate the model
 
-    // Load the texture and store the ID
-    unsigned int lightmapTextureID = loadTexture("media/textures/Plane001LightingMap.tga");
+    // World-space boxes of the level geometry in a BVH, culled against the view frustum every frame
+    std::vector<AABB> geometryBounds;
+    for (const LevelGeometry& geometry : geometries)
+        geometryBounds.push_back(transformBounds(geometry.bounds(), planeModel));
+    SceneBvh sceneBvh;
+    sceneBvh.build(geometryBounds);
+    std::vector<uint32_t> visibleGeometry;
+
+    // Low-resolution software depth buffer; geometry hidden behind the visible occluders is not drawn
+    OcclusionBuffer occlusionBuffer(320, static_cast<int>(320 / aspectRatio));
+
+    // Occluders are the full LOD 0 meshes, so only the ones worth their triangles are rasterized:
+    // the largest on screen first, down to a minimum size and within a triangle budget per frame.
+    // Leaving an occluder out never hides anything wrongly, it only lets more geometry through.
+    const float MIN_OCCLUDER_SCREEN_SIZE = 0.1f;    // Bounding sphere radius over the half screen height
+    const size_t OCCLUDER_TRIANGLE_BUDGET = 32768;
+    const float screenSizeScale = 1.0f / std::tan(fov * 0.5f);
+    std::vector<std::pair<float, uint32_t>> occluderCandidates; // Screen size, geometry index
+
+    // LODs switch once their error would cover more than a pixel on screen
+    LodView lodView = { cameraPos, mode->height / (2.0f * std::tan(fov * 0.5f)), 1.0f };
+
+    // Load the texture and store the ID (decoded in the background, placeholder until then)
+    unsigned int lightmapTextureID = TextureRegistry::instance().acquire("media/textures/Plane001LightingMap.tga", "texture_lightmap").id;
+
+    // Per-frame data (camera block, indirect draws) written into a persistently mapped ring of
+    // three frames, or uploaded with glBufferSubData where buffer storage is missing
+    StreamBuffer frameStream;
+    frameStream.create(1 << 20);
+
+    // Uniforms set in the render loop, looked up once. Without a Camera block the lightmap shader
+    // takes view and projection as plain uniforms, set once per frame.
+    UniformHandle lightmapView = SimpleLightmap.uniform("view");
+    UniformHandle lightmapProjection = SimpleLightmap.uniform("projection");
+    UniformHandle lightmapModel = SimpleLightmap.uniform("model");
+
+    // Draws are queued, sorted by state and run with only the binds that change
+    RenderQueue renderQueue;
+    size_t textureTotal = 0;
+    for (const LevelGeometry& geometry : geometries)
+        textureTotal += geometry.textureCount();
+    renderQueue.reserve(geometries.size(), textureTotal);
+    RenderQueueStats queueTotals; // Summed over all frames
+
+    // Materials are the distinct texture sets; each is bound once per frame by the indirect path,
+    // through the first geometry that uses it
+    bool useIndirect = useArena && SimpleLightmap.hasStorageBlock("DrawDataBuffer");
+    std::vector<uint32_t> geometryMaterials(geometries.size());
+    std::vector<size_t> materialGeometries;
+    for (size_t i = 0; i < geometries.size(); ++i) {
+        const std::vector<Texture>& textures = geometries[i].textureList();
+        uint32_t material = 0;
+        while (material < materialGeometries.size()) {
+            const std::vector<Texture>& other = geometries[materialGeometries[material]].textureList();
+            bool same = other.size() == textures.size();
+            for (size_t t = 0; same && t < textures.size(); ++t)
+                same = other[t].path == textures[t].path && other[t].type == textures[t].type;
+            if (same)
+                break;
+            ++material;
+        }
+        if (material == materialGeometries.size())
+            materialGeometries.push_back(i);
+        geometryMaterials[i] = material;
+    }
+    std::function<void(uint32_t)> bindMaterial = [&](uint32_t material) {
+        geometries[materialGeometries[material]].bindTextures(SimpleLightmap);
+    };
+    ArenaDrawStats indirectTotals;
+
+    // Once the level's textures have finished loading they are put in a material table; a shader
+    // that reads MaterialBuffer then draws the whole level in one multi-draw without texture binds
+    MaterialTable materialTable;
+    bool useMaterialTable = useIndirect && SimpleLightmap.hasStorageBlock("MaterialBuffer") && materialTable.create() != MaterialTextureMode::None;
+    bool materialsReady = false;
+    std::vector<uint32_t> tableMaterials(materialGeometries.size()); // Index in the table of each material
+    std::function<void(uint32_t)> noMaterialBinds;
+
+    double startupSeconds = 0.0;
+
+    // Heap allocations of queueing and running the draws after the first frame, on the threads
+    // doing it; should stay at zero
+    size_t drawAllocations = 0;
+    size_t frameCount = 0;
 
     // Assuming lightmapTextureID is the correct lightmap for all geometries
     SimpleLightmap.use();
-    SimpleLightmap.setMat4("view", view);
-    SimpleLightmap.setMat4("projection", projection);
     glActiveTexture(GL_TEXTURE1); // Use texture unit 1 for the lightmap
     glBindTexture(GL_TEXTURE_2D, lightmapTextureID); // Bind the lightmap texture
     SimpleLightmap.setInt("lightMapTexture", 1); // Set the lightmap texture uniform
-
-    while (!glfwWindowShouldClose(window)) {
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        processInput(window);
+    if (environmentTexture != 0)
+        setEnvironmentUniforms(SimpleLightmap, environment, environmentTexture, 2); // Texture unit 2
+
+    // The frame as a task graph, built once: culling, LOD selection and queue building run on the
+    // job system while the main thread, which owns the GL context, uploads and draws the skybox.
+    // Tasks off the main thread touch neither GL nor the texture registry.
+    glm::mat4 viewProjection;
+    glm::vec3 viewPosition = cameraPos; // Camera position interpolated between simulation steps
+    std::vector<ClusterCullStats> clusterStats(geometries.size()); // Meshlets tested and culled per geometry this frame
+    size_t queueAllocations = 0; // Heap allocations of the queue task's thread while building the queue
+    RenderQueueStats queueStats; // Draws and state changes this frame
+    TaskGraph frameGraph;
+    TaskGraph::TaskId inputTask = frameGraph.add("input", [&] {
+        // Move the camera in fixed steps and render it between the last two; mouse look is not
+        // simulated, so it shows as soon as it is sampled
+        for (int step = simulation.advance(glfwGetTime()); step > 0; --step)
+            processInput(window, static_cast<float>(simulation.step()));
+        framePacer.inputSampled();
+        viewPosition = glm::mix(previousCameraPos, cameraPos, simulation.alpha());
 
         // Update view matrix
-        view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+        view = glm::lookAt(viewPosition, viewPosition + cameraFront, cameraUp);
+        viewProjection = projection * view;
+        lodView.cameraPosition = viewPosition;
+    }, true);
+    TaskGraph::TaskId uploadTask = frameGraph.add("uploads", [&] {
+        // Upload any textures the loader threads have finished decoding
+        processTextureUploads();
+        TextureRegistry::instance().enforceBudget();
+        frameStream.beginFrame();
 
         // Render the skybox
+        PROFILE_GPU_SCOPE("Skybox");
         drawSkybox(skyboxVAO, cubemapTexture, SkyboxShader, view, projection);
 
-        // Render each geometry
-        for (LevelGeometry& geometry : geometries) {
-            SimpleLightmap.use(); // Use the lightmap shader
-            SimpleLightmap.setMat4("view", view); // Set the view matrix uniform
-            SimpleLightmap.setMat4("projection", projection); // Set the projection matrix uniform
-            SimpleLightmap.setMat4("model", planeModel); // Set the static model matrix uniform
+        // Camera matrices for every shader with a Camera block
+        streamCameraUniforms(frameStream, view, projection, viewPosition);
+    }, true);
+    TaskGraph::TaskId cullTask = frameGraph.add("cull", [&] {
+        // Each geometry inside the view frustum...
+        visibleGeometry.clear();
+        BvhCullStats cullStats; // Geometries visible and culled this frame
+        sceneBvh.cull(extractFrustum(viewProjection), visibleGeometry, cullStats);
+
+        // ...that is not hidden behind the occluders of the geometry in view
+        OcclusionStats occlusionStats; // Occlusion buffer timings and geometries occluded this frame
+        occlusionBuffer.clear();
+        occluderCandidates.clear();
+        for (uint32_t index : visibleGeometry) {
+            const AABB& bounds = geometryBounds[index];
+            float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+            float distance = glm::length((bounds.min + bounds.max) * 0.5f - viewPosition);
+            float screenSize = distance > radius ? radius / distance * screenSizeScale : std::numeric_limits<float>::max();
+            if (screenSize >= MIN_OCCLUDER_SCREEN_SIZE)
+                occluderCandidates.push_back(std::make_pair(screenSize, index));
+        }
+        std::sort(occluderCandidates.begin(), occluderCandidates.end(), std::greater<std::pair<float, uint32_t>>());
+        size_t occluderTriangles = 0;
+        for (const auto& candidate : occluderCandidates) {
+            const OccluderMesh& occluder = geometries[candidate.second].occluder();
+            if (occluderTriangles + occluder.indices.size() / 3 > OCCLUDER_TRIANGLE_BUDGET)
+                continue; // A smaller one may still fit
+            occluderTriangles += occluder.indices.size() / 3;
+            occlusionBuffer.addOccluder(occluder, viewProjection * planeModel);
+        }
+        occlusionBuffer.rasterize(occlusionStats);
+        occlusionBuffer.removeOccluded(geometryBounds, viewProjection, visibleGeometry, occlusionStats);
+    });
+    TaskGraph::TaskId lodTask = frameGraph.add("lod", [&] {
+        // Geometries only change their own LOD and cluster state, so they go in parallel
+        JobSystem::shared().parallelFor(static_cast<uint32_t>(visibleGeometry.size()), [&](uint32_t i) {
+            uint32_t index = visibleGeometry[i];
+            LevelGeometry& geometry = geometries[index];
+            clusterStats[index] = ClusterCullStats();
+            geometry.selectLod(planeModel, lodView);
+            geometry.cullClusters(planeModel, viewProjection, viewPosition, clusterStats[index]);
+        }, 4);
+    });
+    TaskGraph::TaskId texturesTask = frameGraph.add("textures", [&] {
+        // Sampler lookups and the registry's use marks stay on the GL thread, ahead of the queue
+        if (useIndirect)
+            return;
+        for (uint32_t index : visibleGeometry)
+            geometries[index].updateTextureBindings(SimpleLightmap);
+    }, true);
+    TaskGraph::TaskId queueTask = frameGraph.add("queue", [&] {
+        size_t allocationsBefore = threadAllocationCount();
+        renderQueue.clear();
+        geometryArena.clearDraws();
+        for (uint32_t index : visibleGeometry) {
+            LevelGeometry& geometry = geometries[index];
 
             // Assuming that the lightmap texture is already bound outside the loop as you've done
 
-            // Call Draw on each LevelGeometry object
-            geometry.Draw(SimpleLightmap);
+            if (useIndirect) {
+                uint32_t material = geometryMaterials[index];
+                geometry.addIndirectDraws(planeModel, materialsReady ? tableMaterials[material] : material);
+                continue;
+            }
+
+            // Queue each visible LevelGeometry with its static model matrix, plus dequantization for quantized meshes
+            const AABB& bounds = geometryBounds[index];
+            float depth = glm::length((bounds.min + bounds.max) * 0.5f - viewPosition);
+            geometry.submit(renderQueue, SimpleLightmap, lightmapModel, planeModel * geometry.positionTransform(), depth);
+        }
+        renderQueue.sort();
+        queueAllocations = threadAllocationCount() - allocationsBefore;
+    });
+    TaskGraph::TaskId submitTask = frameGraph.add("submit", [&] {
+        SimpleLightmap.use(); // Use the lightmap shader
+        SimpleLightmap.set(lightmapView, view); // Set the view matrix uniform
+        SimpleLightmap.set(lightmapProjection, projection); // Set the projection matrix uniform
+
+        PROFILE_GPU_SCOPE("Level");
+        queueStats = RenderQueueStats();
+        size_t allocationsBefore = threadAllocationCount();
+        renderQueue.execute(queueStats);
+        size_t executeAllocations = threadAllocationCount() - allocationsBefore;
+        if (useMaterialTable && !materialsReady && pendingTextureUploads() == 0) {
+            for (size_t material = 0; material < materialGeometries.size(); ++material) {
+                std::array<GLuint, MATERIAL_TEXTURE_SLOTS> textures = {};
+                textures[MATERIAL_SLOT_LIGHTMAP] = lightmapTextureID;
+                for (const Texture& texture : geometries[materialGeometries[material]].textureList()) {
+                    int slot = materialSlot(texture.type);
+                    if (slot >= 0)
+                        textures[slot] = texture.id;
+                    // Resident handles need the texture to keep its storage
+                    if (materialTable.mode() == MaterialTextureMode::Bindless)
+                        TextureRegistry::instance().setPinned(texture.id, true);
+                }
+                tableMaterials[material] = materialTable.addMaterial(textures);
+            }
+            if (materialTable.mode() == MaterialTextureMode::Bindless)
+                TextureRegistry::instance().setPinned(lightmapTextureID, true);
+            materialsReady = materialTable.upload();
+            useMaterialTable = materialsReady;
+            materialTable.setSamplers(SimpleLightmap);
+            if (materialsReady && materialTable.mode() == MaterialTextureMode::Arrays) {
+                // The pages hold copies: they count against the texture budget, and the sources go
+                TextureRegistry::instance().addExternalBytes(materialTable.pageBytes());
+                for (LevelGeometry& geometry : geometries)
+                    geometry.releaseTextures();
+                TextureRegistry::instance().purgeUnused();
+            }
+        }
+        // The one-off material table build above is setup, not drawing, so it is not counted
+        allocationsBefore = threadAllocationCount();
+        if (useIndirect && materialsReady) {
+            materialTable.bind();
+            geometryArena.flush(frameStream, noMaterialBinds, indirectTotals);
         }
+        else if (useIndirect) {
+            geometryArena.flush(frameStream, bindMaterial, indirectTotals);
+        }
+        executeAllocations += threadAllocationCount() - allocationsBefore;
+        if (frameCount > 0)
+            drawAllocations += queueAllocations + executeAllocations;
+        queueTotals.packets += queueStats.packets;
+        queueTotals.programChanges += queueStats.programChanges;
+        queueTotals.textureChanges += queueStats.textureChanges;
+        queueTotals.samplerChanges += queueStats.samplerChanges;
+        queueTotals.vertexArrayChanges += queueStats.vertexArrayChanges;
+        frameStream.endFrame();
+    }, true);
+    frameGraph.depend(uploadTask, inputTask);
+    frameGraph.depend(cullTask, inputTask);
+    frameGraph.depend(lodTask, cullTask);
+    frameGraph.depend(texturesTask, cullTask);
+    frameGraph.depend(texturesTask, uploadTask); // Texture uploads and evictions land before draws reference them
+    frameGraph.depend(queueTask, lodTask);
+    frameGraph.depend(queueTask, texturesTask);
+    frameGraph.depend(submitTask, queueTask);
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    while (!glfwWindowShouldClose(window)) {
+        framePacer.beginFrame();
+        {
+            PROFILE_GPU_SCOPE("Frame");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            frameGraph.run(JobSystem::shared());
+        }
+        ++frameCount;
+        framePacer.endFrame(window);
+        PROFILE_END_FRAME();
+        if (frameCount == 1)
+            startupSeconds = glfwGetTime(); // Since glfwInit()
     }
 
     // Cleanup
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
     glDeleteTextures(1, &cubemapTexture); // If you created a cubemap texture for the skybox
-    glDeleteTextures(1, &lightmapTextureID);      // If you loaded a texture for the plane
+    glDeleteTextures(1, &environmentTexture);
+    frameStream.release();
+    framePacer.release();
+    TextureRegistry::instance().removeExternalBytes(materialTable.pageBytes());
+    materialTable.release();
+    for (LevelGeometry& geometry : geometries) {
+        geometry.release();
+    }
+    if (useArena)
+        geometryArena.release();
+    TextureRegistry::instance().release(lightmapTextureID);
+    TextureRegistry::instance().printStats();
+    std::cout << "Startup: " << startupSeconds * 1000.0 << " ms to the first frame, " << (shaderStats.cacheHits == shaderStats.programs ? "warm" : "cold")
+              << " shader cache: " << shaderStats.programs << " programs, " << shaderStats.cacheHits << " from the binary cache, " << shaderStats.compiled
+              << " compiled" << (shaderStats.parallel ? " in parallel" : "") << ", " << shaderStats.milliseconds << " ms" << std::endl;
+    std::cout << "Draw calls: " << queueTotals.packets << " draws, " << queueTotals.programChanges << " program, "
+              << queueTotals.textureChanges << " texture, " << queueTotals.samplerChanges << " sampler and " << queueTotals.vertexArrayChanges << " vertex array changes, "
+              << drawAllocations << " heap allocations over " << frameCount << " frames" << std::endl;
+    const StreamBufferStats& streamStats = frameStream.stats();
+    std::cout << "Frame stream: " << streamStats.bytesAllocated << " bytes written, " << streamStats.paddingBytes << " bytes of alignment padding, "
+              << streamStats.stalls << " stalls (" << streamStats.stallMilliseconds << " ms), " << streamStats.grows << " grows"
+              << (frameStream.isPersistent() ? "" : ", glBufferSubData fallback") << std::endl;
+    if (useIndirect)
+        std::cout << "Indirect draws: " << indirectTotals.draws << " draws in " << indirectTotals.drawCalls << " multi-draw calls" << std::endl;
+    const FramePacingStats pacingStats = framePacer.stats();
+    const char* swapModeName = framePacer.swapMode() == SwapMode::Uncapped ? "uncapped" : framePacer.swapMode() == SwapMode::Adaptive ? "adaptive vsync" : "vsync";
+    std::cout << "Frame pacing: " << swapModeName << ", " << framePacer.framesInFlight() << " frames in flight" << (framePacer.isLateInput() ? ", late input" : "")
+              << "; frame time p50 " << pacingStats.frameP50 << ", p90 " << pacingStats.frameP90 << ", p99 " << pacingStats.frameP99 << ", max " << pacingStats.frameMax
+              << " ms; input to GPU done p50 " << pacingStats.latencyP50 << ", p99 " << pacingStats.latencyP99 << ", max " << pacingStats.latencyMax << " ms; "
+              << pacingStats.fenceWaits << " fence waits (" << pacingStats.fenceWaitMilliseconds << " ms), " << simulation.stepCount() << " simulation steps, "
+              << simulation.droppedSeconds() * 1000.0 << " ms dropped" << std::endl;
+    PROFILE_PRINT_STATS();
+    PROFILE_WRITE_TRACE("cache/profile.json");
+    PROFILE_RELEASE_GPU();
+    TextureRegistry::instance().purgeUnused();
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,279 @@
+#include "Profiler.h"
+
+#if ENABLE_PROFILER
+
+#include "CacheFile.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+void writeJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            out << '\\' << *c;
+        else if (static_cast<unsigned char>(*c) < 0x20)
+            out << ' ';
+        else
+            out << *c;
+    }
+    out << '"';
+}
+
+} // namespace
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() : epoch(now()) {}
+
+void Profiler::setThreadName(const char* name) {
+    ThreadBuffer& thread = buffer();
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    thread.name = name;
+}
+
+void Profiler::initGpu() {
+    for (GpuFrame& frame : gpuFrames) {
+        frame.queries.resize(GPU_SCOPES_PER_FRAME * 2);
+        frame.names.resize(GPU_SCOPES_PER_FRAME);
+        frame.used = 0;
+        glGenQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+    }
+    calibrate();
+    gpuReady = true;
+}
+
+void Profiler::releaseGpu() {
+    if (!gpuReady)
+        return;
+    for (GpuFrame& frame : gpuFrames) {
+        glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+        frame.queries.clear();
+        frame.used = 0;
+    }
+    gpuReady = false;
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer& thread = buffer();
+    size_t head = thread.head.load(std::memory_order_relaxed);
+    if (head - thread.tail.load(std::memory_order_acquire) >= THREAD_CAPACITY) {
+        thread.overflow.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Event& event = thread.events[head % THREAD_CAPACITY];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    thread.head.store(head + 1, std::memory_order_release);
+}
+
+int Profiler::beginGpu(const char* name) {
+    if (!gpuReady)
+        return -1;
+    GpuFrame& frame = gpuFrames[gpuFrame];
+    if (frame.used == GPU_SCOPES_PER_FRAME) {
+        ++dropped;
+        return -1;
+    }
+    int scope = static_cast<int>(frame.used++);
+    frame.names[scope] = name;
+    glQueryCounter(frame.queries[scope * 2], GL_TIMESTAMP);
+    return scope;
+}
+
+void Profiler::endGpu(int scope) {
+    if (scope >= 0)
+        glQueryCounter(gpuFrames[gpuFrame].queries[scope * 2 + 1], GL_TIMESTAMP);
+}
+
+void Profiler::endFrame() {
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (std::unique_ptr<ThreadBuffer>& thread : threads) {
+            size_t head = thread->head.load(std::memory_order_acquire);
+            for (size_t i = thread->tail.load(std::memory_order_relaxed); i < head; ++i) {
+                const Event& event = thread->events[i % THREAD_CAPACITY];
+                addEvent(event.name, thread->id, event.start, event.end, false);
+            }
+            thread->tail.store(head, std::memory_order_release);
+            dropped += thread->overflow.exchange(0, std::memory_order_relaxed);
+        }
+    }
+
+    // The oldest pool was filled GPU_LATENCY frames ago, so its results are normally ready
+    if (gpuReady) {
+        gpuFrame = (gpuFrame + 1) % (GPU_LATENCY + 1);
+        readGpuFrame(gpuFrames[gpuFrame]);
+        if (frames % 256 == 0)
+            calibrate(); // The GL clock may drift from the CPU's
+    }
+
+    size_t slot = frames % HISTORY;
+    for (ScopeHistory& scope : scopes) {
+        scope.milliseconds[slot] = static_cast<float>(scope.frameMilliseconds);
+        scope.calls[slot] = scope.frameCalls;
+        scope.frameMilliseconds = 0.0;
+        scope.frameCalls = 0;
+    }
+    ++frames;
+}
+
+std::vector<ProfileScopeStats> Profiler::stats() const {
+    std::vector<ProfileScopeStats> result;
+    std::vector<float> samples;
+    for (const ScopeHistory& scope : scopes) {
+        size_t count = std::min(HISTORY, frames - std::min(frames, scope.firstFrame));
+        if (count == 0)
+            continue;
+        samples.clear();
+        double total = 0.0, calls = 0.0;
+        for (size_t k = 0; k < count; ++k) {
+            size_t slot = (frames - 1 - k) % HISTORY;
+            samples.push_back(scope.milliseconds[slot]);
+            total += scope.milliseconds[slot];
+            calls += scope.calls[slot];
+        }
+        std::sort(samples.begin(), samples.end());
+        auto at = [&samples](double fraction) {
+            return static_cast<double>(samples[static_cast<size_t>(fraction * (samples.size() - 1) + 0.5)]);
+        };
+        ProfileScopeStats stats = { scope.name, scope.gpu, total / count, at(0.5), at(0.95), at(0.99), samples.back(), calls / count };
+        result.push_back(stats);
+    }
+    std::sort(result.begin(), result.end(), [](const ProfileScopeStats& a, const ProfileScopeStats& b) {
+        return a.gpu != b.gpu ? !a.gpu : a.average > b.average;
+    });
+    return result;
+}
+
+void Profiler::printStats() const {
+    std::vector<ProfileScopeStats> scopeStats = stats();
+    std::cout << "Profile, ms per frame over the last " << std::min(frames, HISTORY) << " of " << frames << " frames ("
+              << trace.size() << " trace events, " << dropped << " dropped):" << std::endl
+              << "  scope                          avg      p50      p95      p99      max  calls" << std::endl;
+    std::ios::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    for (const ProfileScopeStats& scope : scopeStats) {
+        std::string name = std::string(scope.gpu ? "GPU " : "") + scope.name;
+        std::cout << "  " << std::left << std::setw(26) << name.substr(0, 26) << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(9) << scope.average << std::setw(9) << scope.p50 << std::setw(9) << scope.p95
+                  << std::setw(9) << scope.p99 << std::setw(9) << scope.max << std::setprecision(1) << std::setw(7) << scope.callsPerFrame << std::endl;
+    }
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+bool Profiler::writeTrace(const std::string& path) const {
+    std::ostringstream json;
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    json << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"OpenGL\"}},\n";
+    json << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (const std::unique_ptr<ThreadBuffer>& thread : threads) {
+            json << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id << ",\"args\":{\"name\":";
+            writeJsonString(json, thread->name.c_str());
+            json << "}}";
+        }
+    }
+    // Complete events, in microseconds from the first; a scope may have started before the
+    // profiler did
+    uint64_t base = epoch;
+    for (const TraceEvent& event : trace)
+        base = std::min(base, event.start);
+    json << std::fixed << std::setprecision(3);
+    for (const TraceEvent& event : trace) {
+        json << ",\n{\"name\":";
+        writeJsonString(json, event.name);
+        json << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << (event.start - base) * 1.0e-3
+             << ",\"dur\":" << (event.end - event.start) * 1.0e-3 << "}";
+    }
+    json << "\n]}\n";
+
+    size_t slash = path.find_last_of('/');
+    if (slash != std::string::npos && !createDirectories(path.substr(0, slash + 1)))
+        return false;
+    std::string text = json.str();
+    FileChunk chunk = { text.data(), text.size() };
+    if (!writeFileAtomically(path, { chunk })) {
+        std::cerr << "Failed to write the profile trace " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+Profiler::ThreadBuffer& Profiler::buffer() {
+    // Registered once per thread; the buffer lives as long as the profiler, so the trace keeps
+    // the events of threads that have exited
+    static thread_local ThreadBuffer* current = nullptr;
+    if (!current) {
+        std::unique_ptr<ThreadBuffer> thread(new ThreadBuffer());
+        thread->head.store(0);
+        thread->tail.store(0);
+        thread->overflow.store(0);
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        thread->id = static_cast<uint32_t>(threads.size() + 1);
+        thread->name = "Thread " + std::to_string(thread->id);
+        current = thread.get();
+        threads.push_back(std::move(thread));
+    }
+    return *current;
+}
+
+size_t Profiler::scopeIndex(const char* name, bool gpu) {
+    std::unordered_map<const char*, size_t>& lookup = gpu ? gpuScopes : cpuScopes;
+    auto found = lookup.find(name);
+    if (found != lookup.end())
+        return found->second;
+
+    // Equal names from different literals share a scope
+    size_t index = 0;
+    while (index < scopes.size() && (scopes[index].gpu != gpu || std::strcmp(scopes[index].name, name) != 0))
+        ++index;
+    if (index == scopes.size()) {
+        ScopeHistory scope = {};
+        scope.name = name;
+        scope.gpu = gpu;
+        scope.firstFrame = frames;
+        scopes.push_back(scope);
+    }
+    lookup[name] = index;
+    return index;
+}
+
+void Profiler::addEvent(const char* name, uint32_t thread, uint64_t start, uint64_t end, bool gpu) {
+    if (trace.size() < MAX_TRACE_EVENTS)
+        trace.push_back({ name, thread, start, end });
+    else
+        ++dropped;
+    ScopeHistory& scope = scopes[scopeIndex(name, gpu)];
+    scope.frameMilliseconds += (end - start) * 1.0e-6;
+    ++scope.frameCalls;
+}
+
+void Profiler::readGpuFrame(GpuFrame& frame) {
+    for (size_t i = 0; i < frame.used; ++i) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+        uint64_t start = static_cast<uint64_t>(static_cast<int64_t>(begin) + gpuClockOffset);
+        addEvent(frame.names[i], 0, start, start + (end > begin ? end - begin : 0), true);
+    }
+    frame.used = 0;
+}
+
+void Profiler::calibrate() {
+    GLint64 timestamp = 0;
+    glGetInteger64v(GL_TIMESTAMP, &timestamp);
+    gpuClockOffset = static_cast<int64_t>(now()) - timestamp;
+}
+
+#endif // ENABLE_PROFILER
@@ -0,0 +1,187 @@
+#pragma once
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// CPU and GPU frame profiler. Build with ENABLE_PROFILER=0 to compile it out: the macros below
+// then expand to nothing and Profiler.cpp is empty.
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 1
+#endif
+
+#if ENABLE_PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// name must be a string literal or otherwise outlive the profiler
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) Profiler::instance().setThreadName(name)
+#define PROFILE_INIT_GPU() Profiler::instance().initGpu()
+#define PROFILE_END_FRAME() Profiler::instance().endFrame()
+#define PROFILE_PRINT_STATS() Profiler::instance().printStats()
+#define PROFILE_WRITE_TRACE(path) Profiler::instance().writeTrace(path)
+#define PROFILE_RELEASE_GPU() Profiler::instance().releaseGpu()
+
+// Rolling statistics of one scope over the last Profiler::HISTORY frames, in milliseconds per
+// frame (calls of the scope in a frame are summed)
+struct ProfileScopeStats {
+    const char* name;
+    bool gpu;
+    double average, p50, p95, p99, max;
+    double callsPerFrame;
+};
+
+// Every thread writes its CPU scopes to its own ring buffer without locks; endFrame(), on the
+// main thread, drains the rings into the rolling statistics and the trace. GPU scopes are pairs
+// of GL_TIMESTAMP queries from a pool per frame, read back GPU_LATENCY frames later so that
+// reading them never stalls, and shown on their own track of the trace.
+class Profiler {
+public:
+    static const size_t THREAD_CAPACITY = 16384;   // Events per thread between endFrame() calls
+    static const size_t GPU_SCOPES_PER_FRAME = 64;
+    static const int GPU_LATENCY = 3;
+    static const size_t HISTORY = 240;
+    static const size_t MAX_TRACE_EVENTS = 1 << 20; // Later events are only counted
+
+    static Profiler& instance();
+
+    void setThreadName(const char* name);
+
+    // Needs a current GL context; GPU scopes are ignored until then
+    void initGpu();
+    void releaseGpu();
+
+    void endFrame();
+
+    std::vector<ProfileScopeStats> stats() const;
+    void printStats() const;
+    // Chrome trace event JSON, for chrome://tracing and ui.perfetto.dev
+    bool writeTrace(const std::string& path) const;
+
+    size_t frameCount() const { return frames; }
+    size_t traceEventCount() const { return trace.size(); }
+    // Lost to full thread rings, GPU scopes beyond GPU_SCOPES_PER_FRAME, or the trace limit
+    size_t droppedEvents() const { return dropped; }
+
+    // For ProfileScope and GpuProfileScope
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    void record(const char* name, uint64_t start, uint64_t end);
+    int beginGpu(const char* name);
+    void endGpu(int scope);
+
+private:
+    struct Event {
+        const char* name;
+        uint64_t start, end; // Nanoseconds, steady clock
+    };
+
+    // Single producer (its thread), single consumer (endFrame())
+    struct ThreadBuffer {
+        Event events[THREAD_CAPACITY];
+        std::atomic<size_t> head; // Written by the thread
+        std::atomic<size_t> tail; // Written by endFrame()
+        std::atomic<size_t> overflow;
+        uint32_t id; // From 1; the trace shows the GPU as thread 0
+        std::string name;
+    };
+
+    struct TraceEvent {
+        const char* name;
+        uint32_t thread;
+        uint64_t start, end;
+    };
+
+    struct GpuFrame {
+        std::vector<GLuint> queries; // Begin and end per scope
+        std::vector<const char*> names;
+        size_t used = 0;
+    };
+
+    struct ScopeHistory {
+        const char* name;
+        bool gpu;
+        float milliseconds[HISTORY];
+        uint32_t calls[HISTORY];
+        double frameMilliseconds; // This frame so far
+        uint32_t frameCalls;
+        size_t firstFrame;
+    };
+
+    Profiler();
+    ThreadBuffer& buffer();
+    size_t scopeIndex(const char* name, bool gpu);
+    void addEvent(const char* name, uint32_t thread, uint64_t start, uint64_t end, bool gpu);
+    void readGpuFrame(GpuFrame& frame);
+    void calibrate();
+
+    mutable std::mutex threadsMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+    std::vector<TraceEvent> trace;
+    std::vector<ScopeHistory> scopes;
+    std::unordered_map<const char*, size_t> cpuScopes, gpuScopes; // Index in scopes by name pointer
+    size_t frames = 0;
+    size_t dropped = 0;
+    uint64_t epoch;
+
+    bool gpuReady = false;
+    GpuFrame gpuFrames[GPU_LATENCY + 1];
+    int gpuFrame = 0;
+    int64_t gpuClockOffset = 0; // CPU steady clock minus GL timestamp, in nanoseconds
+};
+
+// Times the enclosing block on the calling thread
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(name), start(Profiler::now()) {}
+    ~ProfileScope() { Profiler::instance().record(name, start, Profiler::now()); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+// Times the GL commands of the enclosing block; only on the thread that owns the context
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name) : scope(Profiler::instance().beginGpu(name)) {}
+    ~GpuProfileScope() { Profiler::instance().endGpu(scope); }
+
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    int scope;
+};
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#define PROFILE_THREAD_NAME(name)
+#define PROFILE_INIT_GPU()
+#define PROFILE_END_FRAME()
+#define PROFILE_PRINT_STATS()
+#define PROFILE_WRITE_TRACE(path)
+#define PROFILE_RELEASE_GPU()
+
+#endif // ENABLE_PROFILER
+
+#endif // PROFILER_H
@@ -0,0 +1,192 @@
+#include "QuantizedVertex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const char* const OCTAHEDRAL_DECODE_GLSL =
+    "vec3 octahedralDecode(vec2 e) {\n"
+    "    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));\n"
+    "    float t = max(-n.z, 0.0);\n"
+    "    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);\n"
+    "    return normalize(n);\n"
+    "}\n";
+
+namespace {
+
+uint16_t toUnorm16(float value) {
+    return static_cast<uint16_t>(std::floor(std::min(1.0f, std::max(0.0f, value)) * 65535.0f + 0.5f));
+}
+
+float fromUnorm16(uint16_t value) {
+    return value / 65535.0f;
+}
+
+float fromSnorm16(int16_t value) {
+    return std::max(-1.0f, value / 32767.0f); // GL maps -32768 to -1 as well
+}
+
+float signNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+glm::vec3 octahedralDecode(float x, float y) {
+    glm::vec3 n(x, y, 1.0f - std::fabs(x) - std::fabs(y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+// Octahedral projection, then the best of the four snorm16 roundings around it
+void octahedralEncode(const glm::vec3& normal, int16_t out[2]) {
+    float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (length == 0.0f) {
+        out[0] = out[1] = 0;
+        return;
+    }
+
+    float x = normal.x / length, y = normal.y / length;
+    if (normal.z < 0.0f) {
+        float folded = (1.0f - std::fabs(y)) * signNotZero(x);
+        y = (1.0f - std::fabs(x)) * signNotZero(y);
+        x = folded;
+    }
+
+    float baseX = std::floor(std::min(1.0f, std::max(-1.0f, x)) * 32767.0f);
+    float baseY = std::floor(std::min(1.0f, std::max(-1.0f, y)) * 32767.0f);
+    double bestError = 4.0;
+    for (int i = 0; i < 4; ++i) {
+        float cx = std::min(32767.0f, std::max(-32767.0f, baseX + (i & 1)));
+        float cy = std::min(32767.0f, std::max(-32767.0f, baseY + (i >> 1)));
+        double error = angleBetweenNormals(octahedralDecode(cx / 32767.0f, cy / 32767.0f), normal);
+        if (error < bestError) {
+            bestError = error;
+            out[0] = static_cast<int16_t>(cx);
+            out[1] = static_cast<int16_t>(cy);
+        }
+    }
+}
+
+} // namespace
+
+// atan2 of the cross and dot products stays accurate for tiny angles, where acos(dot) does not
+double angleBetweenNormals(const glm::vec3& a, const glm::vec3& b) {
+    double cx = static_cast<double>(a.y) * b.z - static_cast<double>(a.z) * b.y;
+    double cy = static_cast<double>(a.z) * b.x - static_cast<double>(a.x) * b.z;
+    double cz = static_cast<double>(a.x) * b.y - static_cast<double>(a.y) * b.x;
+    double dot = static_cast<double>(a.x) * b.x + static_cast<double>(a.y) * b.y + static_cast<double>(a.z) * b.z;
+    return std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot);
+}
+
+QuantizationBounds computeQuantizationBounds(const Vertex* vertices, size_t count) {
+    QuantizationBounds bounds;
+    if (count == 0) {
+        bounds.min = glm::vec3(0.0f);
+        bounds.extent = glm::vec3(1.0f);
+        return bounds;
+    }
+
+    glm::vec3 lo = vertices[0].Position, hi = vertices[0].Position;
+    for (size_t i = 1; i < count; ++i) {
+        lo = glm::min(lo, vertices[i].Position);
+        hi = glm::max(hi, vertices[i].Position);
+    }
+
+    bounds.min = lo;
+    bounds.extent = hi - lo;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (bounds.extent[axis] <= 0.0f)
+            bounds.extent[axis] = 1.0f;
+    }
+    return bounds;
+}
+
+glm::mat4 positionDecodeMatrix(const QuantizationBounds& bounds) {
+    glm::mat4 decode(1.0f);
+    decode[0][0] = bounds.extent.x;
+    decode[1][1] = bounds.extent.y;
+    decode[2][2] = bounds.extent.z;
+    decode[3] = glm::vec4(bounds.min, 1.0f);
+    return decode;
+}
+
+void quantizeVertices(const Vertex* vertices, size_t count, const QuantizationBounds& bounds, QuantizedVertex* out) {
+    for (size_t i = 0; i < count; ++i) {
+        const Vertex& vertex = vertices[i];
+        QuantizedVertex& quantized = out[i];
+        for (int axis = 0; axis < 3; ++axis)
+            quantized.position[axis] = toUnorm16((vertex.Position[axis] - bounds.min[axis]) / bounds.extent[axis]);
+        quantized.position[3] = 0;
+
+        octahedralEncode(vertex.Normal, quantized.normal);
+
+        quantized.texCoords[0] = floatToHalf(vertex.TexCoords.x);
+        quantized.texCoords[1] = floatToHalf(vertex.TexCoords.y);
+        quantized.lightMapTexCoords[0] = toUnorm16(vertex.LightMapTexCoords.x);
+        quantized.lightMapTexCoords[1] = toUnorm16(vertex.LightMapTexCoords.y);
+    }
+}
+
+Vertex dequantizeVertex(const QuantizedVertex& vertex, const QuantizationBounds& bounds) {
+    Vertex result;
+    for (int axis = 0; axis < 3; ++axis)
+        result.Position[axis] = bounds.min[axis] + fromUnorm16(vertex.position[axis]) * bounds.extent[axis];
+    result.Normal = octahedralDecode(fromSnorm16(vertex.normal[0]), fromSnorm16(vertex.normal[1]));
+    result.TexCoords = glm::vec2(halfToFloat(vertex.texCoords[0]), halfToFloat(vertex.texCoords[1]));
+    result.LightMapTexCoords = glm::vec2(fromUnorm16(vertex.lightMapTexCoords[0]), fromUnorm16(vertex.lightMapTexCoords[1]));
+    return result;
+}
+
+// Round to nearest even, with overflow to infinity and gradual underflow
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+    if (magnitude >= 0x7F800000u) // Inf or NaN
+        return static_cast<uint16_t>(sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u));
+    if (magnitude >= 0x477FF000u) // Rounds past the largest half
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    if (magnitude < 0x38800000u) { // Subnormal half (or zero)
+        if (magnitude < 0x33000000u)
+            return static_cast<uint16_t>(sign);
+        uint32_t mantissa = (magnitude & 0x007FFFFFu) | 0x00800000u;
+        int shift = 126 - static_cast<int>(magnitude >> 23); // 14 to 24
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (remainder > midpoint || (remainder == midpoint && (half & 1u)))
+            ++half;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = ((magnitude - 0x38000000u) >> 13);
+    uint32_t remainder = magnitude & 0x1FFFu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+        ++half;
+    return static_cast<uint16_t>(sign | half);
+}
+
+float halfToFloat(uint16_t value) {
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+
+    uint32_t bits;
+    if (exponent == 0x1Fu) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    }
+    else if (exponent == 0) {
+        // Zero or subnormal: mantissa * 2^-24
+        float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+    else {
+        bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef QUANTIZED_VERTEX_H
+#define QUANTIZED_VERTEX_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "LevelGeometry.h"
+#include "VertexLayout.h"
+
+// 20-byte vertex, half the size of Vertex. Worst-case errors against the float vertex:
+//   position           extent / 131070 per axis (16-bit unorm within the mesh bounds)
+//   normal             under 0.01 degrees (octahedral, 16-bit snorm per component)
+//   texCoords          |uv| * 2^-11 (half float; tiling UVs lose precision as they grow)
+//   lightMapTexCoords  1 / 131070 (16-bit unorm; lightmap UVs are clamped to [0, 1])
+struct QuantizedVertex {
+    uint16_t position[4]; // [3] is padding so the next attribute is 4-byte aligned
+    int16_t normal[2];
+    uint16_t texCoords[2];
+    uint16_t lightMapTexCoords[2];
+};
+
+static_assert(sizeof(QuantizedVertex) == 20, "QuantizedVertex must stay tightly packed");
+
+typedef VertexLayout<QuantizedVertex,
+    VertexAttribute<0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(QuantizedVertex, position)>,
+    VertexAttribute<1, 2, GL_SHORT, GL_TRUE, offsetof(QuantizedVertex, normal)>,
+    VertexAttribute<2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(QuantizedVertex, texCoords)>,
+    VertexAttribute<3, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(QuantizedVertex, lightMapTexCoords)>> QuantizedVertexLayout;
+
+// Shaders reading QuantizedVertex receive the normal as an octahedral vec2 at location 1 and must
+// decode it with this function. Positions need no shader change; see positionDecodeMatrix().
+extern const char* const OCTAHEDRAL_DECODE_GLSL;
+
+struct QuantizationBounds {
+    glm::vec3 min;
+    glm::vec3 extent; // Never zero; flat axes get an extent of 1
+};
+
+QuantizationBounds computeQuantizationBounds(const Vertex* vertices, size_t count);
+
+// Maps quantized [0, 1] positions back to model space. Multiply it into the model matrix
+// (model * decode) so the vertex shader stays unchanged. It scales non-uniformly, so normals must
+// still be transformed with the original model matrix.
+glm::mat4 positionDecodeMatrix(const QuantizationBounds& bounds);
+
+void quantizeVertices(const Vertex* vertices, size_t count, const QuantizationBounds& bounds, QuantizedVertex* out);
+
+// CPU decode, matching what the GPU reconstructs; used to measure the quantization error
+Vertex dequantizeVertex(const QuantizedVertex& vertex, const QuantizationBounds& bounds);
+
+// Angle between two unit normals in radians, computed in double precision
+double angleBetweenNormals(const glm::vec3& a, const glm::vec3& b);
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+#endif // QUANTIZED_VERTEX_H
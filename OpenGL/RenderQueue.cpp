@@ -0,0 +1,179 @@
+#include "RenderQueue.h"
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace {
+
+// Texture units the queue tracks; packets with more textures bind the rest every time
+const int TRACKED_TEXTURE_UNITS = 16;
+const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+// Top 20 bits of a non-negative float, which order the same way as the float
+uint64_t depthBits(float depth) {
+    if (!(depth > 0.0f))
+        return 0; // Negative or NaN
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits >> 11;
+}
+
+// FNV-1a over the texture names, folded to 20 bits; 0 for no textures
+uint64_t textureSetHash(const TextureBinding* textures, size_t count) {
+    if (count == 0)
+        return 0;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < count; ++i) {
+        hash ^= textures[i].texture;
+        hash *= 16777619u;
+    }
+    return (hash ^ (hash >> 20)) & 0xFFFFF;
+}
+
+// Issues the GL calls
+struct GlDevice {
+    void useProgram(GLuint program) { glUseProgram(program); }
+    void bindTexture(int unit, GLuint texture) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+    void setSampler(UniformHandle sampler, int unit) { glUniform1i(sampler.location, unit); }
+    void bindVertexArray(GLuint vertexArray) { glBindVertexArray(vertexArray); }
+    void setModel(UniformHandle uniform, const glm::mat4& model) { glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(model)); }
+    void draw(const DrawPacket& packet) {
+        if (packet.counts && packet.baseVertices)
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, packet.counts, packet.indexType, packet.offsets, packet.drawCount, packet.baseVertices);
+        else if (packet.counts)
+            glMultiDrawElements(GL_TRIANGLES, packet.counts, packet.indexType, packet.offsets, packet.drawCount);
+        else if (packet.baseVertex != 0)
+            glDrawElementsBaseVertex(GL_TRIANGLES, packet.count, packet.indexType, packet.offset, packet.baseVertex);
+        else
+            glDrawElements(GL_TRIANGLES, packet.count, packet.indexType, packet.offset);
+    }
+};
+
+// Only counts
+struct CountingDevice {
+    void useProgram(GLuint) {}
+    void bindTexture(int, GLuint) {}
+    void setSampler(UniformHandle, int) {}
+    void bindVertexArray(GLuint) {}
+    void setModel(UniformHandle, const glm::mat4&) {}
+    void draw(const DrawPacket&) {}
+};
+
+} // namespace
+
+void RenderQueue::clear() {
+    packets.clear();
+    textures.clear();
+    order.clear();
+}
+
+void RenderQueue::reserve(size_t packetCount, size_t textureCount) {
+    packets.reserve(packetCount);
+    order.reserve(packetCount);
+    scratch.reserve(packetCount);
+    textures.reserve(textureCount);
+}
+
+void RenderQueue::submit(const DrawPacket& packet, const TextureBinding* packetTextures, size_t textureCount, float viewDepth) {
+    QueuedPacket queued = { packet, static_cast<uint32_t>(textures.size()), static_cast<uint32_t>(textureCount) };
+    textures.insert(textures.end(), packetTextures, packetTextures + textureCount);
+
+    SortEntry entry;
+    entry.key = (static_cast<uint64_t>(packet.program & 0xFF) << 56)
+        | (textureSetHash(packetTextures, textureCount) << 36)
+        | (static_cast<uint64_t>(packet.vertexArray & 0xFFFF) << 20)
+        | depthBits(viewDepth);
+    entry.packet = static_cast<uint32_t>(packets.size());
+    order.push_back(entry);
+    packets.push_back(queued);
+}
+
+void RenderQueue::sort() {
+    // LSD radix sort, one byte per pass; passes where every key has the same byte are skipped
+    scratch.resize(order.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (const SortEntry& entry : order)
+            ++offsets[(entry.key >> shift) & 0xFF];
+        if (offsets[order.empty() ? 0 : (order[0].key >> shift) & 0xFF] == order.size())
+            continue;
+
+        size_t sum = 0;
+        for (size_t& offset : offsets) {
+            size_t count = offset;
+            offset = sum;
+            sum += count;
+        }
+        for (const SortEntry& entry : order)
+            scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+        order.swap(scratch);
+    }
+}
+
+template <typename Device>
+void RenderQueue::run(Device& device, RenderQueueStats& stats) const {
+    GLuint program = UNKNOWN, vertexArray = UNKNOWN;
+    GLuint bound[TRACKED_TEXTURE_UNITS];
+    for (GLuint& texture : bound)
+        texture = UNKNOWN;
+    const QueuedPacket* previous = nullptr;
+
+    for (const SortEntry& entry : order) {
+        const QueuedPacket& queued = packets[entry.packet];
+        const DrawPacket& packet = queued.packet;
+        const TextureBinding* packetTextures = textures.data() + queued.firstTexture;
+
+        bool programChanged = packet.program != program;
+        if (programChanged) {
+            device.useProgram(packet.program);
+            program = packet.program;
+            ++stats.programChanges;
+        }
+
+        // Samplers are program state pointing at units, not textures: set them only when the
+        // program, the texture count or a sampler location differs from the previous packet's
+        bool samplersChanged = programChanged || !previous || previous->textureCount != queued.textureCount;
+        for (uint32_t unit = 0; unit < queued.textureCount; ++unit) {
+            const TextureBinding& binding = packetTextures[unit];
+            if (unit >= static_cast<uint32_t>(TRACKED_TEXTURE_UNITS) || bound[unit] != binding.texture) {
+                device.bindTexture(static_cast<int>(unit), binding.texture);
+                if (unit < static_cast<uint32_t>(TRACKED_TEXTURE_UNITS))
+                    bound[unit] = binding.texture;
+                ++stats.textureChanges;
+            }
+            if (!samplersChanged && textures[previous->firstTexture + unit].sampler.location != binding.sampler.location)
+                samplersChanged = true;
+        }
+        if (samplersChanged) {
+            for (uint32_t unit = 0; unit < queued.textureCount; ++unit)
+                device.setSampler(packetTextures[unit].sampler, static_cast<int>(unit));
+            stats.samplerChanges += queued.textureCount;
+        }
+
+        if (packet.vertexArray != vertexArray) {
+            device.bindVertexArray(packet.vertexArray);
+            vertexArray = packet.vertexArray;
+            ++stats.vertexArrayChanges;
+        }
+
+        device.setModel(packet.modelUniform, packet.model);
+        device.draw(packet);
+        ++stats.drawCalls;
+        previous = &queued;
+    }
+    stats.packets += order.size();
+}
+
+void RenderQueue::execute(RenderQueueStats& stats) const {
+    GlDevice device;
+    run(device, stats);
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void RenderQueue::simulate(RenderQueueStats& stats) const {
+    CountingDevice device;
+    run(device, stats);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+
+// A texture of a draw packet; packets bind their textures to units 0, 1, ... in order
+struct TextureBinding {
+    GLuint texture;          // GL_TEXTURE_2D
+    UniformHandle sampler;   // Set to the unit
+};
+
+// Everything one draw needs, so the queue can run it without going back to the geometry. The
+// multi-draw arrays must stay valid until execute().
+struct DrawPacket {
+    GLuint program;
+    GLuint vertexArray;
+    GLenum indexType;
+    GLsizei count;                 // glDrawElements when counts is null
+    const void* offset;
+    GLint baseVertex;              // Added to every index; non-zero for meshes in a GeometryArena
+    const GLsizei* counts;         // Otherwise glMultiDrawElements over drawCount ranges
+    const void* const* offsets;
+    const GLint* baseVertices;     // Optional, one per range
+    GLsizei drawCount;
+    UniformHandle modelUniform;
+    glm::mat4 model;
+};
+
+// State changes and draws of one execute(), or what they would be for simulate()
+struct RenderQueueStats {
+    size_t packets = 0;
+    size_t drawCalls = 0;
+    size_t programChanges = 0;
+    size_t textureChanges = 0;     // glBindTexture calls
+    size_t samplerChanges = 0;     // Sampler glUniform1i calls
+    size_t vertexArrayChanges = 0;
+};
+
+// Draws submitted during a frame, sorted so that packets sharing a program, then textures, then
+// vertex array run together, nearest first within each. The 64-bit sort key packs
+//   program (8 bits) | texture set hash (20 bits) | vertex array (16 bits) | view depth (20 bits)
+// from the high bits down. GL names are truncated into their fields, which only costs sort
+// quality: execute() compares the real state and skips only binds that would change nothing.
+class RenderQueue {
+public:
+    // Empties the queue for a new frame; the arrays keep their capacity
+    void clear();
+    void reserve(size_t packetCount, size_t textureCount); // So that submit() never allocates
+
+    // Queues the packet with textures bound to units 0 .. textureCount - 1. viewDepth is the
+    // distance from the camera, for front-to-back order among packets with the same state.
+    void submit(const DrawPacket& packet, const TextureBinding* textures, size_t textureCount, float viewDepth);
+
+    // Radix-sorts the packets by key
+    void sort();
+
+    // Issues the packets in their current order, skipping redundant program, texture and vertex
+    // array binds. Leaves the default vertex array bound and texture unit 0 active.
+    void execute(RenderQueueStats& stats) const;
+
+    // Counts the state changes and draws execute() would make, without GL
+    void simulate(RenderQueueStats& stats) const;
+
+    size_t size() const { return packets.size(); }
+    uint64_t key(size_t position) const { return order[position].key; } // In execution order
+
+private:
+    struct QueuedPacket {
+        DrawPacket packet;
+        uint32_t firstTexture;
+        uint32_t textureCount;
+    };
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    std::vector<QueuedPacket> packets;
+    std::vector<TextureBinding> textures;
+    std::vector<SortEntry> order;
+    std::vector<SortEntry> scratch; // Radix sort ping-pong buffer
+
+    template <typename Device>
+    void run(Device& device, RenderQueueStats& stats) const;
+};
+
+#endif // RENDER_QUEUE_H
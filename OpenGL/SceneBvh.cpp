@@ -0,0 +1,211 @@
+#include "SceneBvh.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace {
+
+// Which of four boxes (given as coordinate arrays) are outside the frustum, and which are not
+// entirely inside it. Bit i of each mask is box i.
+struct BoxClassification {
+    int outside;
+    int straddling;
+};
+
+#if USE_SSE2
+// The frustum planes broadcast once per cull
+struct FrustumPlanes {
+    __m128 x[6], y[6], z[6], w[6];
+    bool positiveX[6], positiveY[6], positiveZ[6];
+
+    explicit FrustumPlanes(const Frustum& frustum) {
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4& plane = frustum.planes[p];
+            x[p] = _mm_set1_ps(plane.x);
+            y[p] = _mm_set1_ps(plane.y);
+            z[p] = _mm_set1_ps(plane.z);
+            w[p] = _mm_set1_ps(plane.w);
+            positiveX[p] = plane.x >= 0.0f;
+            positiveY[p] = plane.y >= 0.0f;
+            positiveZ[p] = plane.z >= 0.0f;
+        }
+    }
+};
+
+BoxClassification classifyBoxes(const float* minX, const float* minY, const float* minZ,
+                                 const float* maxX, const float* maxY, const float* maxZ, const FrustumPlanes& planes) {
+    __m128 lowX = _mm_loadu_ps(minX), lowY = _mm_loadu_ps(minY), lowZ = _mm_loadu_ps(minZ);
+    __m128 highX = _mm_loadu_ps(maxX), highY = _mm_loadu_ps(maxY), highZ = _mm_loadu_ps(maxZ);
+    __m128 zero = _mm_setzero_ps();
+    __m128 outside = zero, straddling = zero;
+    for (int p = 0; p < 6; ++p) {
+        // The corner furthest along the normal decides outside, the nearest one inside
+        __m128 farX = planes.positiveX[p] ? highX : lowX, nearX = planes.positiveX[p] ? lowX : highX;
+        __m128 farY = planes.positiveY[p] ? highY : lowY, nearY = planes.positiveY[p] ? lowY : highY;
+        __m128 farZ = planes.positiveZ[p] ? highZ : lowZ, nearZ = planes.positiveZ[p] ? lowZ : highZ;
+        __m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.x[p], farX), _mm_mul_ps(planes.y[p], farY)),
+                                        _mm_add_ps(_mm_mul_ps(planes.z[p], farZ), planes.w[p]));
+        __m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.x[p], nearX), _mm_mul_ps(planes.y[p], nearY)),
+                                         _mm_add_ps(_mm_mul_ps(planes.z[p], nearZ), planes.w[p]));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(farDistance, zero));
+        straddling = _mm_or_ps(straddling, _mm_cmplt_ps(nearDistance, zero));
+    }
+    BoxClassification result = { _mm_movemask_ps(outside), _mm_movemask_ps(straddling) };
+    return result;
+}
+#else
+struct FrustumPlanes {
+    const Frustum& frustum;
+    explicit FrustumPlanes(const Frustum& frustum) : frustum(frustum) {}
+};
+
+BoxClassification classifyBoxes(const float* minX, const float* minY, const float* minZ,
+                                const float* maxX, const float* maxY, const float* maxZ, const FrustumPlanes& planes) {
+    BoxClassification result = { 0, 0 };
+    for (int i = 0; i < 4; ++i) {
+        for (const glm::vec4& plane : planes.frustum.planes) {
+            float farDistance = plane.x * (plane.x >= 0.0f ? maxX[i] : minX[i]) + plane.y * (plane.y >= 0.0f ? maxY[i] : minY[i])
+                + plane.z * (plane.z >= 0.0f ? maxZ[i] : minZ[i]) + plane.w;
+            float nearDistance = plane.x * (plane.x >= 0.0f ? minX[i] : maxX[i]) + plane.y * (plane.y >= 0.0f ? minY[i] : maxY[i])
+                + plane.z * (plane.z >= 0.0f ? minZ[i] : maxZ[i]) + plane.w;
+            if (farDistance < 0.0f)
+                result.outside |= 1 << i;
+            if (nearDistance < 0.0f)
+                result.straddling |= 1 << i;
+        }
+    }
+    return result;
+}
+#endif
+
+AABB unionOf(const std::vector<AABB>& bounds, const std::vector<uint32_t>& order, size_t begin, size_t end) {
+    AABB box = bounds[order[begin]];
+    for (size_t i = begin + 1; i < end; ++i) {
+        box.min = glm::min(box.min, bounds[order[i]].min);
+        box.max = glm::max(box.max, bounds[order[i]].max);
+    }
+    return box;
+}
+
+// Splits order[begin, end) at its middle along the axis where the centroids spread the most
+size_t splitAtMedian(std::vector<uint32_t>& order, size_t begin, size_t end, const std::vector<glm::vec3>& centroids) {
+    glm::vec3 lo = centroids[order[begin]], hi = lo;
+    for (size_t i = begin + 1; i < end; ++i) {
+        lo = glm::min(lo, centroids[order[i]]);
+        hi = glm::max(hi, centroids[order[i]]);
+    }
+    glm::vec3 spread = hi - lo;
+    int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+
+    size_t middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&centroids, axis](uint32_t a, uint32_t b) {
+        return centroids[a][axis] < centroids[b][axis];
+    });
+    return middle;
+}
+
+} // namespace
+
+void SceneBvh::build(const std::vector<AABB>& bounds) {
+    nodes.clear();
+    objects = bounds.size();
+    if (bounds.empty())
+        return;
+
+    std::vector<uint32_t> order(bounds.size());
+    std::vector<glm::vec3> centroids(bounds.size());
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        order[i] = static_cast<uint32_t>(i);
+        centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+    }
+    nodes.reserve(bounds.size() / 3 + 1);
+    buildNode(order, 0, order.size(), bounds, centroids);
+}
+
+uint32_t SceneBvh::buildNode(std::vector<uint32_t>& order, size_t begin, size_t end, const std::vector<AABB>& bounds, const std::vector<glm::vec3>& centroids) {
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(Node());
+
+    // Up to four objects become direct children; more are split twice into four groups
+    size_t parts[5] = { begin, end, end, end, end };
+    size_t partCount = end - begin;
+    if (partCount <= 4) {
+        for (size_t i = 0; i <= partCount; ++i)
+            parts[i] = begin + i;
+    }
+    else {
+        size_t middle = splitAtMedian(order, begin, end, centroids);
+        parts[0] = begin;
+        parts[1] = splitAtMedian(order, begin, middle, centroids);
+        parts[2] = middle;
+        parts[3] = splitAtMedian(order, middle, end, centroids);
+        parts[4] = end;
+        partCount = 4;
+    }
+
+    Node node;
+    for (int slot = 0; slot < 4; ++slot) {
+        if (static_cast<size_t>(slot) >= partCount) {
+            // Inverted box: every plane test puts it outside
+            node.minX[slot] = node.minY[slot] = node.minZ[slot] = FLT_MAX;
+            node.maxX[slot] = node.maxY[slot] = node.maxZ[slot] = -FLT_MAX;
+            node.children[slot] = EMPTY;
+            continue;
+        }
+
+        size_t partBegin = parts[slot], partEnd = parts[slot + 1];
+        AABB box = unionOf(bounds, order, partBegin, partEnd);
+        node.minX[slot] = box.min.x;
+        node.minY[slot] = box.min.y;
+        node.minZ[slot] = box.min.z;
+        node.maxX[slot] = box.max.x;
+        node.maxY[slot] = box.max.y;
+        node.maxZ[slot] = box.max.z;
+        node.children[slot] = partEnd - partBegin == 1 ? order[partBegin] | OBJECT_BIT : buildNode(order, partBegin, partEnd, bounds, centroids);
+    }
+    nodes[index] = node; // After the recursion, which may have reallocated nodes
+    return index;
+}
+
+void SceneBvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible, BvhCullStats& stats) const {
+    size_t firstVisible = visible.size();
+    if (!nodes.empty()) {
+        FrustumPlanes planes(frustum);
+        uint32_t stack[64];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            const Node& node = nodes[stack[--stackSize]];
+            ++stats.nodesTested;
+            BoxClassification classification = classifyBoxes(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, planes);
+
+            for (int slot = 0; slot < 4; ++slot) {
+                uint32_t child = node.children[slot];
+                if (child == EMPTY || (classification.outside & (1 << slot)))
+                    continue;
+                if (!(classification.straddling & (1 << slot)))
+                    appendSubtree(child, visible); // Entirely inside
+                else if (child & OBJECT_BIT)
+                    visible.push_back(child & ~OBJECT_BIT);
+                else
+                    stack[stackSize++] = child;
+            }
+        }
+    }
+
+    size_t found = visible.size() - firstVisible;
+    stats.visible += found;
+    stats.culled += objects - found;
+}
+
+void SceneBvh::appendSubtree(uint32_t child, std::vector<uint32_t>& visible) const {
+    if (child & OBJECT_BIT) {
+        visible.push_back(child & ~OBJECT_BIT);
+        return;
+    }
+    const Node& node = nodes[child];
+    for (uint32_t grandchild : node.children) {
+        if (grandchild != EMPTY)
+            appendSubtree(grandchild, visible);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef SCENE_BVH_H
+#define SCENE_BVH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Frustum.h"
+
+struct BvhCullStats {
+    size_t visible = 0;
+    size_t culled = 0;
+    size_t nodesTested = 0; // Each test checks four child boxes against the frustum at once
+};
+
+// Four-wide bounding volume hierarchy over static world-space boxes, for frustum culling. Every
+// node holds its four children's boxes as a structure of arrays, so one SSE plane test covers all
+// four; subtrees entirely inside the frustum are accepted without testing further.
+class SceneBvh {
+public:
+    // Rebuilds the tree over bounds; object i is reported as index i
+    void build(const std::vector<AABB>& bounds);
+
+    // Appends the indices of the objects whose boxes intersect the frustum to visible, in no
+    // particular order
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible, BvhCullStats& stats) const;
+
+    size_t objectCount() const { return objects; }
+    size_t nodeCount() const { return nodes.size(); }
+
+private:
+    static const uint32_t OBJECT_BIT = 0x80000000u; // Set on children that are objects, not nodes
+    static const uint32_t EMPTY = 0xFFFFFFFFu;
+
+    struct Node {
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        uint32_t children[4];
+    };
+
+    std::vector<Node> nodes;
+    size_t objects = 0;
+
+    uint32_t buildNode(std::vector<uint32_t>& order, size_t begin, size_t end, const std::vector<AABB>& bounds, const std::vector<glm::vec3>& centroids);
+    void appendSubtree(uint32_t child, std::vector<uint32_t>& visible) const;
+};
+
+#endif // SCENE_BVH_H
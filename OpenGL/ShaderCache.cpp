@@ -0,0 +1,256 @@
+#include "ShaderCache.h"
+#include "CacheFile.h"
+#include "Profiler.h"
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+const char* const SHADER_CACHE_DIRECTORY = "cache/shaders/";
+
+namespace {
+
+const char SHADER_CACHE_MAGIC[4] = { 'G', 'L', 'P', 'B' };
+const uint32_t SHADER_CACHE_VERSION = 1;
+
+// On-disk layout: header, then the binary as glGetProgramBinary returned it
+struct ShaderCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key; // Hash of the sources and the driver strings
+    uint32_t binaryFormat;
+    uint32_t binarySize;
+};
+
+uint64_t hashGlString(GLenum name, uint64_t seed) {
+    const GLubyte* text = glGetString(name);
+    return text ? hashString(reinterpret_cast<const char*>(text), seed) : seed;
+}
+
+void printCompileErrors(GLuint shader, const char* stage, const std::string& name) {
+    GLint success = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (success)
+        return;
+    GLchar infoLog[512];
+    glGetShaderInfoLog(shader, 512, NULL, infoLog);
+    std::cerr << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED (" << name << ")\n" << infoLog << std::endl;
+}
+
+} // namespace
+
+ShaderBatch::ShaderBatch(const std::string& cacheDirectory, bool allowParallel)
+    : directory(cacheDirectory), useCache(!cacheDirectory.empty() && isBinaryCacheSupported()),
+      useParallel(allowParallel && isParallelSupported()) {
+    driverHash = hashGlString(GL_VERSION, hashGlString(GL_RENDERER, hashGlString(GL_VENDOR, HASH_SEED)));
+}
+
+bool ShaderBatch::isBinaryCacheSupported() {
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+        return false;
+    // Some drivers expose the extension with no binary formats to save
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+bool ShaderBatch::isParallelSupported() {
+    return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
+
+size_t ShaderBatch::add(const std::string& vertexPath, const std::string& fragmentPath) {
+    std::vector<unsigned char> vertexFile, fragmentFile;
+    if (!readFile(vertexPath, vertexFile) || !readFile(fragmentPath, fragmentFile))
+        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ (" << vertexPath << ", " << fragmentPath << ")" << std::endl;
+    size_t index = addSource(std::string(vertexFile.begin(), vertexFile.end()), std::string(fragmentFile.begin(), fragmentFile.end()));
+    programs[index].name = vertexPath + ", " + fragmentPath;
+    return index;
+}
+
+size_t ShaderBatch::addSource(const std::string& vertexCode, const std::string& fragmentCode) {
+    PendingProgram entry;
+    entry.name = "program " + std::to_string(programs.size());
+    entry.vertexCode = vertexCode;
+    entry.fragmentCode = fragmentCode;
+    // The length keeps "a" + "bc" and "ab" + "c" apart
+    uint64_t vertexLength = vertexCode.size();
+    entry.key = hashString(fragmentCode, hashString(vertexCode, hashBytes(&vertexLength, sizeof(vertexLength), driverHash)));
+    programs.push_back(entry);
+    return programs.size() - 1;
+}
+
+void ShaderBatch::start() {
+    startTime = std::chrono::steady_clock::now();
+    totals = ShaderBuildStats();
+    totals.programs = programs.size();
+    totals.parallel = useParallel;
+    remaining = 0;
+    if (useParallel) {
+        if (GLEW_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        else
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+    }
+
+    // Every compile and link is issued before any status query, which would wait for it
+    for (PendingProgram& entry : programs) {
+        if (entry.state != ProgramState::Added)
+            continue;
+        if (loadBinary(entry)) {
+            entry.state = ProgramState::Done;
+            ++totals.cacheHits;
+            continue;
+        }
+        compile(entry);
+        entry.state = ProgramState::Compiling;
+        ++totals.compiled;
+        ++remaining;
+    }
+    if (remaining == 0)
+        totals.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool ShaderBatch::poll() {
+    for (PendingProgram& entry : programs) {
+        if (entry.state != ProgramState::Compiling)
+            continue;
+        if (useParallel) {
+            GLint done = GL_FALSE;
+            glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+                continue;
+        }
+        markDone(entry);
+    }
+    return remaining == 0;
+}
+
+const ShaderBuildStats& ShaderBatch::finish() {
+    PROFILE_SCOPE("ShaderBatch::finish");
+    while (!poll())
+        std::this_thread::yield();
+    return totals;
+}
+
+void ShaderBatch::wait(size_t index) {
+    // The link status query blocks until the program is ready
+    if (programs[index].state == ProgramState::Compiling)
+        markDone(programs[index]);
+}
+
+Shader ShaderBatch::shader(size_t index) const {
+    Shader result;
+    result.adopt(programs[index].program);
+    return result;
+}
+
+std::string ShaderBatch::cacheEntry(size_t index) const {
+    return useCache ? entryPath(programs[index].key) : std::string();
+}
+
+std::string ShaderBatch::entryPath(uint64_t key) const {
+    return directory + hashToHex(key) + ".glprog";
+}
+
+bool ShaderBatch::loadBinary(PendingProgram& entry) {
+    if (!useCache)
+        return false;
+    MappedFile mapping;
+    if (!mapping.open(entryPath(entry.key)) || mapping.size() < sizeof(ShaderCacheHeader))
+        return false;
+    ShaderCacheHeader header;
+    std::memcpy(&header, mapping.data(), sizeof(header));
+    if (std::memcmp(header.magic, SHADER_CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != SHADER_CACHE_VERSION
+        || header.key != entry.key
+        || sizeof(header) + static_cast<size_t>(header.binarySize) > mapping.size())
+        return false;
+
+    // The driver may still reject a binary, e.g. after an update that kept its version string
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, mapping.data() + sizeof(header), static_cast<GLsizei>(header.binarySize));
+    GLint success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glDeleteProgram(program);
+        return false;
+    }
+    entry.program = program;
+    return true;
+}
+
+void ShaderBatch::compile(PendingProgram& entry) {
+    const GLchar* vertexCode = entry.vertexCode.c_str();
+    const GLchar* fragmentCode = entry.fragmentCode.c_str();
+    entry.vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(entry.vertex, 1, &vertexCode, NULL);
+    glCompileShader(entry.vertex);
+    entry.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(entry.fragment, 1, &fragmentCode, NULL);
+    glCompileShader(entry.fragment);
+
+    entry.program = glCreateProgram();
+    if (useCache)
+        glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(entry.program, entry.vertex);
+    glAttachShader(entry.program, entry.fragment);
+    glLinkProgram(entry.program);
+}
+
+void ShaderBatch::complete(PendingProgram& entry) {
+    GLint success = GL_FALSE;
+    glGetProgramiv(entry.program, GL_LINK_STATUS, &success);
+    if (success) {
+        storeBinary(entry);
+    }
+    else {
+        printCompileErrors(entry.vertex, "VERTEX", entry.name);
+        printCompileErrors(entry.fragment, "FRAGMENT", entry.name);
+        ++totals.failed;
+    }
+    glDetachShader(entry.program, entry.vertex);
+    glDetachShader(entry.program, entry.fragment);
+    glDeleteShader(entry.vertex);
+    glDeleteShader(entry.fragment);
+    entry.vertex = entry.fragment = 0;
+    // The sources are no longer needed
+    std::string().swap(entry.vertexCode);
+    std::string().swap(entry.fragmentCode);
+}
+
+void ShaderBatch::markDone(PendingProgram& entry) {
+    complete(entry);
+    entry.state = ProgramState::Done;
+    if (--remaining == 0)
+        totals.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void ShaderBatch::storeBinary(const PendingProgram& entry) {
+    if (!useCache)
+        return;
+    GLint length = 0;
+    glGetProgramiv(entry.program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<unsigned char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(entry.program, length, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+
+    ShaderCacheHeader header = {};
+    std::memcpy(header.magic, SHADER_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SHADER_CACHE_VERSION;
+    header.key = entry.key;
+    header.binaryFormat = format;
+    header.binarySize = static_cast<uint32_t>(written);
+    std::vector<FileChunk> chunks;
+    chunks.push_back({ &header, sizeof(header) });
+    chunks.push_back({ binary.data(), static_cast<size_t>(written) });
+    std::string path = entryPath(entry.key);
+    if (!writeFileAtomically(path, chunks)) {
+        std::cerr << "Failed to write shader cache entry: " << path << std::endl;
+        return;
+    }
+    totals.binaryBytes += static_cast<size_t>(written);
+}
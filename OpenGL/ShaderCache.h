@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include "shader.h"
+
+extern const char* const SHADER_CACHE_DIRECTORY;
+
+struct ShaderBuildStats {
+    size_t programs = 0;
+    size_t cacheHits = 0;      // Linked straight from a cached program binary
+    size_t compiled = 0;       // Compiled from source, cache misses and rejected binaries
+    size_t failed = 0;         // Did not compile or link
+    size_t binaryBytes = 0;    // Program binaries written to the cache
+    bool parallel = false;     // The driver compiled on its own threads
+    double milliseconds = 0.0; // From start() until the last program was ready
+};
+
+// Builds a set of programs together. Each is first looked up in an on-disk cache of program
+// binaries (ARB_get_program_binary), keyed by a hash of its sources and the GL vendor, renderer
+// and version strings, so a driver update misses the cache instead of loading a stale binary.
+// The misses are all submitted before any status is read, so with KHR_parallel_shader_compile
+// (or the ARB version) the driver compiles them on its own threads while the caller keeps
+// working and poll()s. New binaries are written back as each program finishes linking.
+class ShaderBatch {
+public:
+    // Needs a GL context, to key the cache on the driver. An empty cacheDirectory disables the
+    // binary cache.
+    explicit ShaderBatch(const std::string& cacheDirectory = SHADER_CACHE_DIRECTORY, bool allowParallel = true);
+
+    static bool isBinaryCacheSupported();
+    static bool isParallelSupported();
+
+    // Index of the program for shader()
+    size_t add(const std::string& vertexPath, const std::string& fragmentPath);
+    size_t addSource(const std::string& vertexCode, const std::string& fragmentCode);
+
+    // Links the cache hits and submits every miss for compiling
+    void start();
+    // Finishes the programs whose links have completed without waiting on the rest; true once
+    // all are done
+    bool poll();
+    // Waits for every program
+    const ShaderBuildStats& finish();
+    // Waits for one program only
+    void wait(size_t index);
+    bool isDone(size_t index) const { return programs[index].state == ProgramState::Done; }
+
+    // The finished program; a failed one reports its errors from isSuccessfullyCompiled(). The
+    // Shader owns the program object.
+    Shader shader(size_t index) const;
+    // Path of the program's cache entry, empty without a cache
+    std::string cacheEntry(size_t index) const;
+    const ShaderBuildStats& stats() const { return totals; }
+
+private:
+    enum class ProgramState { Added, Compiling, Done };
+
+    struct PendingProgram {
+        std::string name; // Source paths, for errors
+        std::string vertexCode, fragmentCode;
+        uint64_t key = 0;
+        GLuint program = 0, vertex = 0, fragment = 0;
+        ProgramState state = ProgramState::Added;
+    };
+
+    std::string directory;
+    bool useCache;
+    bool useParallel;
+    uint64_t driverHash;
+    std::vector<PendingProgram> programs;
+    size_t remaining = 0;
+    std::chrono::steady_clock::time_point startTime;
+    ShaderBuildStats totals;
+
+    std::string entryPath(uint64_t key) const;
+    bool loadBinary(PendingProgram& entry);
+    void compile(PendingProgram& entry);
+    void complete(PendingProgram& entry);
+    void markDone(PendingProgram& entry);
+    void storeBinary(const PendingProgram& entry);
+};
+
+#endif // SHADER_CACHE_H
@@ -0,0 +1,141 @@
+#include "ShaderPermutations.h"
+#include "CacheFile.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+const char* const FEATURE_NAMES[SHADER_FEATURE_COUNT] = { "DIFFUSE", "LIGHTMAP", "ALPHA_TEST", "INSTANCING", "QUANTIZED" };
+
+} // namespace
+
+std::string shaderFeatureDefines(uint32_t key) {
+    std::string defines;
+    for (int bit = 0; bit < SHADER_FEATURE_COUNT; ++bit) {
+        if (key & (1u << bit))
+            defines += std::string("#define FEATURE_") + FEATURE_NAMES[bit] + "\n";
+    }
+    return defines;
+}
+
+std::string shaderFeatureNames(uint32_t key) {
+    std::string names;
+    for (int bit = 0; bit < SHADER_FEATURE_COUNT; ++bit) {
+        if (!(key & (1u << bit)))
+            continue;
+        if (!names.empty())
+            names += '+';
+        for (const char* c = FEATURE_NAMES[bit]; *c; ++c)
+            names += *c == '_' ? '-' : static_cast<char>(*c - 'A' + 'a');
+    }
+    return names.empty() ? "none" : names;
+}
+
+bool ShaderPermutations::load(const std::string& vertexPath, const std::string& fragmentPath) {
+    std::vector<unsigned char> vertexFile, fragmentFile;
+    if (!readFile(vertexPath, vertexFile) || !readFile(fragmentPath, fragmentFile)) {
+        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ (" << vertexPath << ", " << fragmentPath << ")" << std::endl;
+        return false;
+    }
+    loadSource(std::string(vertexFile.begin(), vertexFile.end()), std::string(fragmentFile.begin(), fragmentFile.end()));
+    name = vertexPath + ", " + fragmentPath;
+    return true;
+}
+
+void ShaderPermutations::loadSource(const std::string& vertexCode, const std::string& fragmentCode) {
+    release();
+    vertexSource = vertexCode;
+    fragmentSource = fragmentCode;
+    name = "shared source";
+}
+
+void ShaderPermutations::release() {
+    // Precompiles still in flight finish first so that their programs can be deleted
+    for (ShaderBatch& batch : batches)
+        batch.finish();
+    for (const PendingPermutation& permutation : pending)
+        glDeleteProgram(batches[permutation.batch].shader(permutation.program).Program);
+    for (auto& permutation : ready)
+        glDeleteProgram(permutation.second.Program);
+    ready.clear();
+    batches.clear();
+    pending.clear();
+    hitchList.clear();
+    totals = PermutationStats();
+    frame = 0;
+}
+
+void ShaderPermutations::precompile(const std::vector<uint32_t>& keys) {
+    ShaderBatch batch;
+    std::vector<PendingPermutation> added;
+    for (uint32_t key : keys) {
+        bool known = ready.count(key) != 0;
+        for (const PendingPermutation& permutation : pending)
+            known = known || permutation.key == key;
+        for (const PendingPermutation& permutation : added)
+            known = known || permutation.key == key;
+        if (known)
+            continue;
+        std::string defines = shaderFeatureDefines(key);
+        size_t program = batch.addSource(Shader::specialize(vertexSource, defines), Shader::specialize(fragmentSource, defines));
+        added.push_back({ key, batches.size(), program });
+    }
+    if (added.empty())
+        return;
+    batch.start();
+    batches.push_back(std::move(batch));
+    pending.insert(pending.end(), added.begin(), added.end());
+}
+
+void ShaderPermutations::update() {
+    for (ShaderBatch& batch : batches)
+        batch.poll();
+    for (size_t i = 0; i < pending.size();) {
+        const PendingPermutation& permutation = pending[i];
+        if (!batches[permutation.batch].isDone(permutation.program)) {
+            ++i;
+            continue;
+        }
+        ready.insert(std::make_pair(permutation.key, batches[permutation.batch].shader(permutation.program)));
+        ++totals.precompiled;
+        pending.erase(pending.begin() + i);
+    }
+    if (pending.empty())
+        batches.clear();
+    ++frame;
+}
+
+Shader& ShaderPermutations::build(uint32_t key) {
+    PROFILE_SCOPE("ShaderPermutations::build");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    auto found = std::find_if(pending.begin(), pending.end(), [key](const PendingPermutation& permutation) { return permutation.key == key; });
+    auto inserted = ready.end();
+    if (found != pending.end()) {
+        // Still compiling in the background: wait for this program only
+        ShaderBatch& batch = batches[found->batch];
+        batch.wait(found->program);
+        inserted = ready.insert(std::make_pair(key, batch.shader(found->program))).first;
+        pending.erase(found);
+    }
+    else {
+        ShaderBatch batch;
+        std::string defines = shaderFeatureDefines(key);
+        batch.addSource(Shader::specialize(vertexSource, defines), Shader::specialize(fragmentSource, defines));
+        batch.start();
+        batch.finish();
+        inserted = ready.insert(std::make_pair(key, batch.shader(0))).first;
+    }
+    ++totals.compiledOnDemand;
+
+    // Before the first frame this is loading time, not a hitch
+    if (frame > 0) {
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        hitchList.push_back({ key, frame, milliseconds });
+        totals.hitchMilliseconds += milliseconds;
+        std::cerr << "Shader permutation " << shaderFeatureNames(key) << " of " << name << " compiled mid-frame (frame " << frame << "): "
+                  << milliseconds << " ms" << std::endl;
+    }
+    return inserted->second;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "shader.h"
+#include "ShaderCache.h"
+
+// Feature bits of a permutation key. Each set bit is defined as FEATURE_<NAME> in both stages.
+const uint32_t SHADER_FEATURE_DIFFUSE = 1u << 0;    // FEATURE_DIFFUSE: sample texture_diffuse1
+const uint32_t SHADER_FEATURE_LIGHTMAP = 1u << 1;   // FEATURE_LIGHTMAP: sample lightMapTexture
+const uint32_t SHADER_FEATURE_ALPHA_TEST = 1u << 2; // FEATURE_ALPHA_TEST: discard below the cutoff
+const uint32_t SHADER_FEATURE_INSTANCING = 1u << 3; // FEATURE_INSTANCING: model from the InstanceBatch attributes
+const uint32_t SHADER_FEATURE_QUANTIZED = 1u << 4;  // FEATURE_QUANTIZED: QuantizedVertex positions, decoded by positionTransform()
+const int SHADER_FEATURE_COUNT = 5;
+
+// "#define FEATURE_..." lines for the key, for Shader::specialize()
+std::string shaderFeatureDefines(uint32_t key);
+// Readable key, e.g. "diffuse+lightmap"
+std::string shaderFeatureNames(uint32_t key);
+
+// A permutation that was not ready when a frame asked for it, so the frame waited for it to compile
+struct PermutationHitch {
+    uint32_t key;
+    size_t frame;
+    double milliseconds;
+};
+
+struct PermutationStats {
+    size_t precompiled = 0;        // Ready before anything asked for them
+    size_t compiledOnDemand = 0;   // Built or waited for inside get()
+    double hitchMilliseconds = 0.0;
+};
+
+// Programs specialized from one shared vertex/fragment source by feature bits instead of a
+// hand-written pair per variant, so shaders test the features with #ifdef rather than branching
+// at run time. Permutations a renderer will use are precompiled in the background through a
+// ShaderBatch (binary cache and parallel compile); one that is not ready when get() needs it is
+// built on the spot and, once frames have started, recorded as a hitch. Only the permutations
+// benchmark uses it so far: the level's shader files have no FEATURE_* branches yet.
+class ShaderPermutations {
+public:
+    // Reads the shared source; false if either file is missing
+    bool load(const std::string& vertexPath, const std::string& fragmentPath);
+    void loadSource(const std::string& vertexCode, const std::string& fragmentCode);
+    void release();
+
+    // Starts compiling the keys that are neither ready nor already compiling. Needs a GL context.
+    void precompile(const std::vector<uint32_t>& keys);
+
+    // Once per frame: collects finished precompiles and advances the frame count
+    void update();
+
+    // The program for key, compiled now if it has to be. The reference stays valid until release().
+    Shader& get(uint32_t key) {
+        auto found = ready.find(key);
+        if (found != ready.end())
+            return found->second;
+        return build(key);
+    }
+
+    bool isReady(uint32_t key) const { return ready.count(key) != 0; }
+    bool isPending() const { return !pending.empty(); }
+    size_t permutationCount() const { return ready.size(); }
+    const std::vector<PermutationHitch>& hitches() const { return hitchList; }
+    const PermutationStats& stats() const { return totals; }
+
+private:
+    struct PendingPermutation {
+        uint32_t key;
+        size_t batch;   // Index in batches
+        size_t program; // Index in that batch
+    };
+
+    std::string name; // Source paths, for reports
+    std::string vertexSource, fragmentSource;
+    std::map<uint32_t, Shader> ready;
+    std::vector<ShaderBatch> batches;
+    std::vector<PendingPermutation> pending;
+    size_t frame = 0;
+    std::vector<PermutationHitch> hitchList;
+    PermutationStats totals;
+
+    Shader& build(uint32_t key);
+};
+
+#endif // SHADER_PERMUTATIONS_H
@@ -0,0 +1,15 @@
+#pragma once
+
+#ifndef SIMD_H
+#define SIMD_H
+
+// SSE2 is part of every x64 target and the default for 32-bit MSVC builds.
+// Kernels that use it keep a scalar path for other targets.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define USE_SSE2 0
+#endif
+
+#endif // SIMD_H
@@ -1,5 +1,10 @@
 #include "Skybox.h"
-#include "stb_image.h"
+#include "EnvironmentBaker.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -56,32 +61,78 @@ const int skyboxVerticesSize = sizeof(skyboxVertices);
 
 // Function implementations
 GLuint loadCubemap(std::vector<std::string> faces) {
+    PROFILE_SCOPE("loadCubemap");
     GLuint textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-    int width, height, nrChannels;
+    // Decode (or map from the texture cache) all faces at once, mip chains included
+    std::vector<TextureImage> images(faces.size());
+    std::vector<char> loaded(faces.size(), 0);
+    JobSystem::shared().parallelFor(static_cast<unsigned int>(faces.size()), [&](unsigned int i) {
+        loaded[i] = loadTextureImage(faces[i], "texture_skybox", images[i]);
+    });
+
+    size_t mipCount = 0;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     for (GLuint i = 0; i < faces.size(); i++) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
+        if (loaded[i]) {
+            const TextureImage& face = images[i];
+            for (size_t level = 0; level < face.mips.size(); ++level) {
+                uploadTextureLevel(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, static_cast<int>(level), face, face.mips[level], face.mips[level].data);
+            }
+            mipCount = mipCount == 0 ? face.mips.size() : std::min(mipCount, face.mips.size());
         }
         else {
             std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(std::max<size_t>(mipCount, 1)) - 1);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    return textureID;
+}
+
+GLuint createEnvironmentCubemap(const EnvironmentMap& environment) {
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+    for (int level = 0; level < environment.mipCount; ++level) {
+        int size = environment.faceSize >> level;
+        for (int face = 0; face < 6; ++face) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB16F, size, size, 0, GL_RGB, GL_FLOAT, environment.face(level, face));
         }
     }
 
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, environment.mipCount - 1);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
     return textureID;
 }
 
+void setEnvironmentUniforms(Shader& shader, const EnvironmentMap& environment, GLuint environmentTexture, int textureUnit) {
+    shader.use();
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, environmentTexture);
+    shader.setInt("environmentMap", textureUnit);
+    shader.setInt("environmentMipCount", environment.mipCount);
+    shader.set(shader.uniform("irradianceSH"), environment.irradianceSH, 9);
+}
+
 void drawSkybox(GLuint skyboxVAO, GLuint skyboxTexture, Shader& skyboxShader, const glm::mat4& view, const glm::mat4& projection) {
     // Change depth function so depth test passes when values are equal to depth buffer's content
     glDepthFunc(GL_LEQUAL);
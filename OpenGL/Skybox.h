@@ -12,8 +12,17 @@
 extern const int skyboxVerticesSize;
 extern GLfloat skyboxVertices[];
 
+struct EnvironmentMap;
+
 // Function declarations
 GLuint loadCubemap(std::vector<std::string> faces);
+
+// Radiance cubemap for image-based lighting (RGB16F, one roughness per mip level)
+GLuint createEnvironmentCubemap(const EnvironmentMap& environment);
+
+// Binds the radiance cubemap to textureUnit and sets environmentMap, environmentMipCount and
+// irradianceSH[9] on shader. Shaders that do not declare them are unaffected.
+void setEnvironmentUniforms(Shader& shader, const EnvironmentMap& environment, GLuint environmentTexture, int textureUnit);
 void drawSkybox(GLuint skyboxVAO, GLuint skyboxTexture, Shader& skyboxShader, const glm::mat4& view, const glm::mat4& projection);
 
 #endif // SKYBOX_H
\ No newline at end of file
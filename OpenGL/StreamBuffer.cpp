@@ -0,0 +1,150 @@
+#include "StreamBuffer.h"
+#include <algorithm>
+#include <chrono>
+
+bool StreamBuffer::isPersistentSupported() {
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+void StreamBuffer::create(size_t frameSize, int frameCount, bool allowPersistent) {
+    persistent = allowPersistent && isPersistentSupported();
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformOffsetAlignment = std::max(1, alignment);
+    if (GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object) {
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        storageOffsetAlignment = std::max(1, alignment);
+    }
+    totals = StreamBufferStats();
+    allocateStorage(frameSize, frameCount);
+}
+
+void StreamBuffer::allocateStorage(size_t frameSize, int frameCount) {
+    // Regions start aligned for any binding
+    size_t alignment = std::max(uniformOffsetAlignment, storageOffsetAlignment);
+    regionSize = (frameSize + alignment - 1) / alignment * alignment;
+    GLsizeiptr size = static_cast<GLsizeiptr>(regionSize * frameCount);
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+    }
+    else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        staging.assign(static_cast<size_t>(size), 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    fences.assign(frameCount, nullptr);
+}
+
+void StreamBuffer::release() {
+    for (GLsync& fence : fences) {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    // Deleting the buffer also unmaps it
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    for (RetiredStorage& storage : retired) {
+        if (storage.fence)
+            glDeleteSync(storage.fence);
+        glDeleteBuffers(1, &storage.buffer);
+    }
+    retired.clear();
+    mapped = nullptr;
+    staging.clear();
+    staging.shrink_to_fit();
+    region = -1;
+    head = 0;
+}
+
+void StreamBuffer::beginFrame() {
+    // Outgrown buffers go once the GPU has finished the frames that used them
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [](RetiredStorage& storage) {
+        if (!storage.fence || glClientWaitSync(storage.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(storage.fence);
+        glDeleteBuffers(1, &storage.buffer);
+        return true;
+    }), retired.end());
+
+    region = (region + 1) % static_cast<int>(fences.size());
+    head = 0;
+    GLsync& fence = fences[region];
+    if (!fence)
+        return;
+
+    // Usually signalled long ago; only time the wait when it is not
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        do {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        } while (result == GL_TIMEOUT_EXPIRED);
+        ++totals.stalls;
+        totals.stallMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void StreamBuffer::endFrame() {
+    if (region < 0)
+        return;
+    if (persistent)
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    for (RetiredStorage& storage : retired) {
+        if (!storage.fence)
+            storage.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    ++totals.frames;
+    totals.unusedBytes += regionSize - head;
+}
+
+StreamAllocation StreamBuffer::allocate(size_t size, size_t alignment) {
+    if (region < 0)
+        beginFrame();
+    size_t start = (head + alignment - 1) / alignment * alignment;
+    if (start + size > regionSize) {
+        // Switch to a buffer twice the size for the rest of the frame. The old one stays mapped
+        // for the allocations already made in it, until the frame's fence signals; that fence
+        // follows every earlier use, so the region fences are no longer needed.
+        int frameCount = static_cast<int>(fences.size());
+        size_t frameSize = std::max(regionSize * 2, size + alignment);
+        totals.unusedBytes += regionSize - head;
+        for (GLsync& fence : fences) {
+            if (fence)
+                glDeleteSync(fence);
+        }
+        RetiredStorage storage = { buffer, std::move(staging), nullptr };
+        retired.push_back(std::move(storage));
+        allocateStorage(frameSize, frameCount);
+        region = 0;
+        head = 0;
+        start = 0;
+        ++totals.grows;
+    }
+    totals.paddingBytes += start - head;
+    totals.bytesAllocated += size;
+    head = start + size;
+
+    StreamAllocation allocation;
+    allocation.buffer = buffer;
+    allocation.offset = static_cast<GLintptr>(region * regionSize + start);
+    allocation.size = static_cast<GLsizeiptr>(size);
+    allocation.data = (persistent ? mapped : staging.data()) + allocation.offset;
+    return allocation;
+}
+
+void StreamBuffer::commit(const StreamAllocation& allocation) {
+    // Coherent mappings need no flush: later commands see the writes
+    if (persistent || allocation.size == 0)
+        return;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, allocation.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, allocation.size, allocation.data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+
+// A range of the current frame's region, written through data and then passed to commit()
+struct StreamAllocation {
+    void* data = nullptr;
+    GLuint buffer = 0;     // The stream's buffer when the range was allocated
+    GLintptr offset = 0;   // In that buffer, for glBindBufferRange and indirect draw offsets
+    GLsizeiptr size = 0;
+};
+
+// Summed over all frames since create()
+struct StreamBufferStats {
+    size_t frames = 0;
+    size_t bytesAllocated = 0;
+    size_t paddingBytes = 0;   // Lost to offset alignment
+    size_t unusedBytes = 0;    // Left over at the end of each frame's region
+    size_t stalls = 0;         // Frames that waited for the GPU to release their region
+    double stallMilliseconds = 0.0;
+    size_t grows = 0;          // Frames that outgrew the region and reallocated the buffer
+};
+
+// Ring of frameCount regions in one buffer for data written once per frame: transforms, draw
+// commands, camera blocks. With GL 4.4 or ARB_buffer_storage the buffer is mapped persistently
+// and coherently, so allocations are written straight into GPU-visible memory; a fence per region
+// keeps the CPU from overwriting a region the GPU may still read. Without it, allocations point
+// into a CPU copy that commit() uploads with glBufferSubData.
+//   beginFrame(); allocate(); write; commit(); bind or draw; ... endFrame();
+class StreamBuffer {
+public:
+    static bool isPersistentSupported();
+
+    // Needs a GL context. allowPersistent false forces the glBufferSubData path.
+    void create(size_t frameSize, int frameCount = 3, bool allowPersistent = true);
+    void release(); // Waits for nothing; GL keeps the storage alive until pending draws finish
+
+    // Moves to the next region, waiting for its fence if the GPU is still reading it
+    void beginFrame();
+    // Fences the region's commands
+    void endFrame();
+
+    // Aligned space in the current region; grows the buffer when the region is full, so
+    // allocations never fail. Earlier allocations of the frame stay valid: they keep the old
+    // buffer, which lives until the GPU is done with it, so bind and draw from allocation.buffer
+    // rather than name().
+    StreamAllocation allocate(size_t size, size_t alignment);
+    void commit(const StreamAllocation& allocation); // Uploads it on the glBufferSubData path
+
+    void bindRange(GLenum target, GLuint index, const StreamAllocation& allocation) const {
+        glBindBufferRange(target, index, allocation.buffer, allocation.offset, allocation.size);
+    }
+
+    GLuint name() const { return buffer; } // Changes when the buffer grows
+    bool isPersistent() const { return persistent; }
+    size_t uniformAlignment() const { return uniformOffsetAlignment; }
+    size_t storageAlignment() const { return storageOffsetAlignment; }
+    const StreamBufferStats& stats() const { return totals; }
+
+private:
+    // Storage outgrown mid-frame, kept for the allocations made in it until its fence signals
+    struct RetiredStorage {
+        GLuint buffer;
+        std::vector<unsigned char> staging;
+        GLsync fence; // Null until the frame ends
+    };
+
+    GLuint buffer = 0;
+    bool persistent = false;
+    unsigned char* mapped = nullptr;    // Persistent mapping of the whole buffer
+    std::vector<unsigned char> staging; // Otherwise the CPU copy
+    std::vector<GLsync> fences;         // One per region; null when not in use
+    size_t regionSize = 0;
+    int region = -1;
+    size_t head = 0;                    // Bytes used in the current region
+    size_t uniformOffsetAlignment = 256, storageOffsetAlignment = 256;
+    StreamBufferStats totals;
+    std::vector<RetiredStorage> retired;
+
+    void allocateStorage(size_t frameSize, int frameCount);
+};
+
+#endif // STREAM_BUFFER_H
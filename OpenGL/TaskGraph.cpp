@@ -0,0 +1,84 @@
+#include "TaskGraph.h"
+#include "Profiler.h"
+#include <chrono>
+
+namespace {
+
+double secondsNow() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+TaskGraph::TaskId TaskGraph::add(const char* name, std::function<void()> work, bool mainThread) {
+    std::unique_ptr<Task> task(new Task());
+    task->graph = this;
+    task->id = static_cast<TaskId>(tasks.size());
+    task->name = name;
+    task->work = std::move(work);
+    task->mainThread = mainThread;
+    task->waiting = 0;
+    tasks.push_back(std::move(task));
+    mainReady.reserve(tasks.size());
+    return tasks.back()->id;
+}
+
+void TaskGraph::depend(TaskId task, TaskId prerequisite) {
+    tasks[prerequisite]->dependents.push_back(task);
+    ++tasks[task]->prerequisites;
+}
+
+void TaskGraph::run(JobSystem& jobs) {
+    system = &jobs;
+    runStart = secondsNow();
+    unfinished.store(static_cast<uint32_t>(tasks.size()));
+    for (std::unique_ptr<Task>& task : tasks)
+        task->waiting.store(task->prerequisites, std::memory_order_relaxed);
+    for (std::unique_ptr<Task>& task : tasks) {
+        if (task->prerequisites == 0)
+            schedule(*task);
+    }
+
+    while (unfinished.load(std::memory_order_acquire) > 0) {
+        Task* mainTask = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            if (!mainReady.empty()) {
+                mainTask = tasks[mainReady.back()].get();
+                mainReady.pop_back();
+            }
+        }
+        if (mainTask)
+            execute(*mainTask);
+        else if (!jobs.runOne())
+            std::this_thread::yield();
+    }
+}
+
+void TaskGraph::schedule(Task& task) {
+    if (task.mainThread) {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        mainReady.push_back(task.id);
+        return;
+    }
+    Job job = { &TaskGraph::runTask, &task, 0, 1, nullptr };
+    system->run(job);
+}
+
+void TaskGraph::execute(Task& task) {
+    PROFILE_SCOPE(task.name);
+    task.start = secondsNow() - runStart;
+    task.work();
+    task.end = secondsNow() - runStart;
+    for (TaskId dependent : task.dependents) {
+        Task& next = *tasks[dependent];
+        if (next.waiting.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            schedule(next);
+    }
+    unfinished.fetch_sub(1, std::memory_order_release);
+}
+
+void TaskGraph::runTask(void* data, uint32_t, uint32_t) {
+    Task& task = *static_cast<Task*>(data);
+    task.graph->execute(task);
+}
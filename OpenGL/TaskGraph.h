@@ -0,0 +1,61 @@
+#pragma once
+
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "JobSystem.h"
+
+// Tasks and the order between them, built once and run every frame without allocating. Tasks
+// start as jobs as soon as their prerequisites finish; tasks pinned to the main thread (GL
+// calls, window input) run only on the thread that calls run(), which runs other jobs while it
+// has none of its own.
+class TaskGraph {
+public:
+    typedef uint32_t TaskId;
+
+    TaskId add(const char* name, std::function<void()> work, bool mainThread = false);
+    // task starts after prerequisite has finished
+    void depend(TaskId task, TaskId prerequisite);
+
+    // Runs every task once and returns when all have finished
+    void run(JobSystem& jobs);
+
+    size_t taskCount() const { return tasks.size(); }
+    const char* name(TaskId task) const { return tasks[task]->name; }
+    // Seconds from the start of the last run() to the task's start and end
+    double startTime(TaskId task) const { return tasks[task]->start; }
+    double endTime(TaskId task) const { return tasks[task]->end; }
+
+private:
+    struct Task {
+        TaskGraph* graph;
+        TaskId id;
+        const char* name;
+        std::function<void()> work;
+        bool mainThread;
+        std::vector<TaskId> dependents;
+        uint32_t prerequisites = 0;
+        std::atomic<uint32_t> waiting; // Prerequisites not finished this run
+        double start = 0.0, end = 0.0;
+    };
+
+    std::vector<std::unique_ptr<Task>> tasks;
+    JobSystem* system = nullptr;
+    std::atomic<uint32_t> unfinished;
+    std::mutex mainMutex;
+    std::vector<TaskId> mainReady; // Capacity of every task, so pushing never allocates
+    double runStart = 0.0;
+
+    void schedule(Task& task);
+    void execute(Task& task);
+    static void runTask(void* data, uint32_t, uint32_t);
+};
+
+#endif // TASK_GRAPH_H
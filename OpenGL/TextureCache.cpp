@@ -0,0 +1,211 @@
+#include "TextureCache.h"
+#include <GL/glew.h>
+#include "MipmapBuilder.h"
+#include "stb_image.h"
+#include "TextureCompression.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char TEXTURE_CACHE_MAGIC[4] = { 'T', 'X', 'C', '1' };
+const uint32_t TEXTURE_CACHE_VERSION = 2;
+const char* TEXTURE_CACHE_DIRECTORY = "cache/textures/";
+const int MAX_TEXTURE_MIPS = 16;
+const uint32_t MAX_TEXTURE_DIMENSION = 1u << (MAX_TEXTURE_MIPS - 1);
+
+// On-disk layout: this header followed by the mip levels, largest first
+struct TextureCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash; // Hash of the source image file's bytes
+    uint32_t internalFormat;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t mipCount;
+    uint64_t mipOffsets[MAX_TEXTURE_MIPS]; // From the start of the file
+    uint64_t mipSizes[MAX_TEXTURE_MIPS];
+};
+
+size_t alignLevel(size_t offset) {
+    return (offset + 15) & ~static_cast<size_t>(15);
+}
+
+// Only albedo maps are block-compressed; BC1's 5:6:5 endpoints band on the smooth gradients
+// of lightmaps and skybox faces, and normal or specular data would lose too much precision
+bool compressesTextureType(const std::string& type) {
+    return textureCompressionEnabled() && type == "texture_diffuse";
+}
+
+std::string cachePathFor(const std::string& path, const std::string& type) {
+    // Builds with different types, mip filters or compression settings live side by side
+    std::string compression = compressesTextureType(type) ? textureCompressionKey() : std::string();
+    return TEXTURE_CACHE_DIRECTORY + hashToHex(hashString(path + "|" + type + mipmapSettingsKey() + compression)) + ".tcache";
+}
+
+GLenum formatForChannels(int channels) {
+    if (channels == 1)
+        return GL_RED;
+    else if (channels == 2)
+        return GL_RG;
+    else if (channels == 3)
+        return GL_RGB;
+    return GL_RGBA;
+}
+
+// Sized internal formats, which glTexStorage and glCopyImageSubData require of their textures
+GLenum sizedFormatForChannels(int channels) {
+    if (channels == 1)
+        return GL_R8;
+    else if (channels == 2)
+        return GL_RG8;
+    else if (channels == 3)
+        return GL_RGB8;
+    return GL_RGBA8;
+}
+
+// Byte size of one level as the header describes it, or 0 if the format, internal format and
+// channel count don't belong together
+size_t expectedLevelSize(const TextureCacheHeader& header, int width, int height) {
+    size_t texels = static_cast<size_t>(width) * height;
+    if (header.format != 0) {
+        if (header.channels < 1 || header.channels > 4
+            || header.format != formatForChannels(static_cast<int>(header.channels))
+            || header.internalFormat != sizedFormatForChannels(static_cast<int>(header.channels)))
+            return 0;
+        return texels * header.channels;
+    }
+
+    // Block-compressed: the formats compressMipChain produces for each channel count
+    size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+    if (header.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT && (header.channels == 3 || header.channels == 4))
+        return blocks * 8;
+    if (header.internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT && header.channels == 4)
+        return blocks * 16;
+    if (header.internalFormat == GL_COMPRESSED_RG_RGTC2 && header.channels == 2)
+        return blocks * 16;
+    return 0;
+}
+
+// Levels in a full chain down to 1x1
+uint32_t fullMipCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+        ++levels;
+    return levels;
+}
+
+bool openCacheEntry(const std::string& cachePath, uint64_t sourceHash, TextureImage& image) {
+    MappedFile mapping;
+    if (!mapping.open(cachePath) || mapping.size() < sizeof(TextureCacheHeader))
+        return false;
+
+    TextureCacheHeader header;
+    std::memcpy(&header, mapping.data(), sizeof(header));
+    if (std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != TEXTURE_CACHE_VERSION
+        || header.sourceHash != sourceHash
+        || header.width == 0 || header.width > MAX_TEXTURE_DIMENSION
+        || header.height == 0 || header.height > MAX_TEXTURE_DIMENSION
+        || header.mipCount == 0 || header.mipCount > fullMipCount(header.width, header.height))
+        return false;
+
+    image.mips.clear();
+    int width = static_cast<int>(header.width);
+    int height = static_cast<int>(header.height);
+    for (uint32_t level = 0; level < header.mipCount; ++level) {
+        if (header.mipOffsets[level] > mapping.size() || header.mipSizes[level] > mapping.size() - header.mipOffsets[level])
+            return false; // Truncated entry
+        if (header.mipSizes[level] != expectedLevelSize(header, width, height))
+            return false; // Corrupt or inconsistent header
+
+        TextureMip mip;
+        mip.width = width;
+        mip.height = height;
+        mip.size = static_cast<size_t>(header.mipSizes[level]);
+        mip.data = mapping.data() + header.mipOffsets[level];
+        image.mips.push_back(mip);
+
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+
+    image.internalFormat = header.internalFormat;
+    image.format = header.format;
+    image.channels = static_cast<int>(header.channels);
+    image.storage.clear();
+    image.mapping = std::move(mapping);
+    return true;
+}
+
+void writeCacheEntry(const std::string& cachePath, uint64_t sourceHash, const TextureImage& image) {
+    TextureCacheHeader header = {};
+    std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = TEXTURE_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.internalFormat = image.internalFormat;
+    header.format = image.format;
+    header.width = static_cast<uint32_t>(image.mips[0].width);
+    header.height = static_cast<uint32_t>(image.mips[0].height);
+    header.channels = static_cast<uint32_t>(image.channels);
+    header.mipCount = static_cast<uint32_t>(image.mips.size());
+
+    std::vector<FileChunk> chunks;
+    static const unsigned char padding[16] = {};
+    chunks.push_back({ &header, sizeof(header) });
+
+    size_t offset = sizeof(header);
+    for (size_t level = 0; level < image.mips.size(); ++level) {
+        size_t aligned = alignLevel(offset);
+        if (aligned != offset)
+            chunks.push_back({ padding, aligned - offset });
+
+        header.mipOffsets[level] = aligned;
+        header.mipSizes[level] = image.mips[level].size;
+        chunks.push_back({ image.mips[level].data, image.mips[level].size });
+        offset = aligned + image.mips[level].size;
+    }
+
+    if (!writeFileAtomically(cachePath, chunks))
+        std::cerr << "Failed to write texture cache entry: " << cachePath << std::endl;
+}
+
+} // namespace
+
+bool loadTextureImage(const std::string& path, const std::string& type, TextureImage& image) {
+    PROFILE_SCOPE("loadTextureImage");
+    std::vector<unsigned char> source;
+    if (!readFile(path, source))
+        return false;
+
+    uint64_t sourceHash = hashBytes(source.data(), source.size());
+    std::string cachePath = cachePathFor(path, type);
+    if (openCacheEntry(cachePath, sourceHash, image))
+        return true;
+
+    // Missing or stale entry: decode the source we already have in memory and rebuild it
+    int width, height, channels;
+    unsigned char* pixels = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &width, &height, &channels, 0);
+    if (!pixels)
+        return false;
+
+    image.channels = channels;
+    image.format = formatForChannels(channels);
+    image.internalFormat = sizedFormatForChannels(channels);
+    image.mapping.close();
+    MipmapSettings settings = mipmapSettings();
+    settings.srgb = settings.srgb && isColorTextureType(type);
+    buildMipChain(pixels, width, height, channels, settings, image);
+    stbi_image_free(pixels);
+
+    if (compressesTextureType(type))
+        compressMipChain(image, textureCompressionQuality());
+
+    writeCacheEntry(cachePath, sourceHash, image);
+    return true;
+}
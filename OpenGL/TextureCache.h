@@ -0,0 +1,38 @@
+#pragma once
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <string>
+#include <vector>
+#include "CacheFile.h"
+
+// One level of a texture's mip chain
+struct TextureMip {
+    int width;
+    int height;
+    size_t size;
+    const unsigned char* data;
+};
+
+// CPU-side texture with its full mip chain, either freshly decoded or mapped from the cache
+struct TextureImage {
+    unsigned int internalFormat = 0; // GL internal format
+    unsigned int format = 0;         // GL pixel format of the level data, 0 when block-compressed
+    int channels = 0;
+    std::vector<TextureMip> mips;
+
+    std::vector<unsigned char> storage; // Owns the levels after a decode
+    MappedFile mapping;                 // Owns the levels on a cache hit
+
+    bool compressed() const { return format == 0; }
+};
+
+// Fills image with the mip chain of the texture at path. On a warm start the levels point
+// straight into the mapped cache entry; a missing or stale entry falls back to stb_image,
+// builds the mips on the calling thread and rewrites the entry. Safe to call from loader threads.
+// type is the material texture type; only color types are filtered in sRGB space, and it is part
+// of the cache key.
+bool loadTextureImage(const std::string& path, const std::string& type, TextureImage& image);
+
+#endif // TEXTURE_CACHE_H
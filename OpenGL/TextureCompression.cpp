@@ -0,0 +1,587 @@
+#include "TextureCompression.h"
+#include <GL/glew.h>
+#include "Simd.h"
+#include "TextureCache.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> compressionEnabled(false);
+std::atomic<int> compressionQuality(static_cast<int>(CompressionQuality::High));
+
+struct Color {
+    int r, g, b;
+};
+
+uint16_t packColor565(const Color& c) {
+    return static_cast<uint16_t>((((c.r * 31 + 127) / 255) << 11) | (((c.g * 63 + 127) / 255) << 5) | ((c.b * 31 + 127) / 255));
+}
+
+Color unpackColor565(uint16_t c) {
+    int r = (c >> 11) & 31;
+    int g = (c >> 5) & 63;
+    int b = c & 31;
+    return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+}
+
+// Copies a 4x4 block of RGBA texels; blocks on the right/bottom edge repeat the last column/row
+void loadBlock(const unsigned char* rgba, int width, int height, int bx, int by, unsigned char* block) {
+    if (bx + 4 <= width && by + 4 <= height) {
+        for (int y = 0; y < 4; ++y) {
+            std::memcpy(block + y * 16, rgba + (static_cast<size_t>(by + y) * width + bx) * 4, 16);
+        }
+        return;
+    }
+
+    for (int y = 0; y < 4; ++y) {
+        int sy = std::min(by + y, height - 1);
+        for (int x = 0; x < 4; ++x) {
+            int sx = std::min(bx + x, width - 1);
+            std::memcpy(block + (y * 4 + x) * 4, rgba + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+        }
+    }
+}
+
+// Four-color palette in index order: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+void buildPalette(uint16_t c0, uint16_t c1, Color palette[4]) {
+    palette[0] = unpackColor565(c0);
+    palette[1] = unpackColor565(c1);
+    palette[2] = { (2 * palette[0].r + palette[1].r) / 3, (2 * palette[0].g + palette[1].g) / 3, (2 * palette[0].b + palette[1].b) / 3 };
+    palette[3] = { (palette[0].r + 2 * palette[1].r) / 3, (palette[0].g + 2 * palette[1].g) / 3, (palette[0].b + 2 * palette[1].b) / 3 };
+}
+
+// Picks the nearest palette entry for every texel. Returns the packed 2-bit indices; error receives the summed squared RGB error.
+uint32_t selectColorIndices(const unsigned char* block, const Color palette[4], int& error) {
+    uint32_t indices = 0;
+#if USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+    __m128i entries[4];
+    for (int k = 0; k < 4; ++k) {
+        entries[k] = _mm_setr_epi16(static_cast<short>(palette[k].r), static_cast<short>(palette[k].g), static_cast<short>(palette[k].b), 0,
+                                    static_cast<short>(palette[k].r), static_cast<short>(palette[k].g), static_cast<short>(palette[k].b), 0);
+    }
+
+    __m128i errorSum = zero;
+    for (int row = 0; row < 4; ++row) {
+        __m128i texels = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + row * 16)), rgbMask);
+        __m128i lo = _mm_unpacklo_epi8(texels, zero); // Texels 0-1 as 16-bit RGBA
+        __m128i hi = _mm_unpackhi_epi8(texels, zero); // Texels 2-3
+
+        __m128i best = _mm_set1_epi32(INT_MAX);
+        __m128i bestIndex = zero;
+        for (int k = 0; k < 4; ++k) {
+            __m128i dlo = _mm_sub_epi16(lo, entries[k]);
+            __m128i dhi = _mm_sub_epi16(hi, entries[k]);
+            __m128i slo = _mm_madd_epi16(dlo, dlo); // [r2+g2, b2] per texel
+            __m128i shi = _mm_madd_epi16(dhi, dhi);
+            slo = _mm_add_epi32(slo, _mm_shuffle_epi32(slo, _MM_SHUFFLE(2, 3, 0, 1)));
+            shi = _mm_add_epi32(shi, _mm_shuffle_epi32(shi, _MM_SHUFFLE(2, 3, 0, 1)));
+            __m128i distance = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(slo), _mm_castsi128_ps(shi), _MM_SHUFFLE(2, 0, 2, 0)));
+
+            __m128i closer = _mm_cmplt_epi32(distance, best);
+            best = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, best));
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestIndex));
+        }
+        errorSum = _mm_add_epi32(errorSum, best);
+
+        // Gather the four 2-bit indices of this row
+        __m128i shifted = _mm_or_si128(bestIndex, _mm_srli_epi64(bestIndex, 30));
+        int packed = _mm_cvtsi128_si32(shifted) | (_mm_cvtsi128_si32(_mm_srli_si128(shifted, 8)) << 4);
+        indices |= static_cast<uint32_t>(packed & 0xFF) << (row * 8);
+    }
+
+    errorSum = _mm_add_epi32(errorSum, _mm_shuffle_epi32(errorSum, _MM_SHUFFLE(1, 0, 3, 2)));
+    errorSum = _mm_add_epi32(errorSum, _mm_shuffle_epi32(errorSum, _MM_SHUFFLE(2, 3, 0, 1)));
+    error = _mm_cvtsi128_si32(errorSum);
+#else
+    error = 0;
+    for (int i = 0; i < 16; ++i) {
+        const unsigned char* texel = block + i * 4;
+        int best = INT_MAX;
+        int bestIndex = 0;
+        for (int k = 0; k < 4; ++k) {
+            int dr = texel[0] - palette[k].r;
+            int dg = texel[1] - palette[k].g;
+            int db = texel[2] - palette[k].b;
+            int distance = dr * dr + dg * dg + db * db;
+            if (distance < best) {
+                best = distance;
+                bestIndex = k;
+            }
+        }
+        error += best;
+        indices |= static_cast<uint32_t>(bestIndex) << (i * 2);
+    }
+#endif
+    return indices;
+}
+
+void boundingBox(const unsigned char* block, unsigned char minColor[4], unsigned char maxColor[4]) {
+#if USE_SSE2
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    __m128i hi = lo;
+    for (int row = 1; row < 4; ++row) {
+        __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + row * 16));
+        lo = _mm_min_epu8(lo, texels);
+        hi = _mm_max_epu8(hi, texels);
+    }
+    lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+    lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+    hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+    hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+
+    int packedMin = _mm_cvtsi128_si32(lo);
+    int packedMax = _mm_cvtsi128_si32(hi);
+    std::memcpy(minColor, &packedMin, 4);
+    std::memcpy(maxColor, &packedMax, 4);
+#else
+    for (int c = 0; c < 4; ++c) {
+        minColor[c] = 255;
+        maxColor[c] = 0;
+    }
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            minColor[c] = std::min(minColor[c], block[i * 4 + c]);
+            maxColor[c] = std::max(maxColor[c], block[i * 4 + c]);
+        }
+    }
+#endif
+}
+
+// Fast endpoints: the inset bounding box, with the diagonal flipped for channels that run against green
+void boundingBoxEndpoints(const unsigned char* block, Color& c0, Color& c1) {
+    unsigned char minColor[4], maxColor[4];
+    boundingBox(block, minColor, maxColor);
+
+    int lo[3], hi[3];
+    for (int c = 0; c < 3; ++c) {
+        int inset = (maxColor[c] - minColor[c]) >> 4;
+        lo[c] = minColor[c] + inset;
+        hi[c] = maxColor[c] - inset;
+    }
+
+    int center[3] = { (lo[0] + hi[0]) / 2, (lo[1] + hi[1]) / 2, (lo[2] + hi[2]) / 2 };
+    int covarianceRG = 0, covarianceBG = 0;
+    for (int i = 0; i < 16; ++i) {
+        int g = block[i * 4 + 1] - center[1];
+        covarianceRG += (block[i * 4 + 0] - center[0]) * g;
+        covarianceBG += (block[i * 4 + 2] - center[2]) * g;
+    }
+    if (covarianceRG < 0)
+        std::swap(lo[0], hi[0]);
+    if (covarianceBG < 0)
+        std::swap(lo[2], hi[2]);
+
+    c0 = { hi[0], hi[1], hi[2] };
+    c1 = { lo[0], lo[1], lo[2] };
+}
+
+// High-quality endpoints: the texels at both ends of the principal axis of the block's colors
+void principalAxisEndpoints(const unsigned char* block, Color& c0, Color& c1) {
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c)
+            mean[c] += block[i * 4 + c];
+    }
+    for (int c = 0; c < 3; ++c)
+        mean[c] /= 16.0f;
+
+    float covariance[6] = {}; // rr, rg, rb, gg, gb, bb
+    for (int i = 0; i < 16; ++i) {
+        float r = block[i * 4 + 0] - mean[0];
+        float g = block[i * 4 + 1] - mean[1];
+        float b = block[i * 4 + 2] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+
+    // Power iteration converges quickly for the dominant eigenvector of a 3x3 matrix
+    float axis[3] = { 0.9f, 1.0f, 0.7f };
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+        float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+        float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+        float length = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+        if (length < 1e-4f) {
+            boundingBoxEndpoints(block, c0, c1);
+            return;
+        }
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    int minIndex = 0, maxIndex = 0;
+    float minProjection = 1e30f, maxProjection = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float projection = block[i * 4 + 0] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+        if (projection < minProjection) {
+            minProjection = projection;
+            minIndex = i;
+        }
+        if (projection > maxProjection) {
+            maxProjection = projection;
+            maxIndex = i;
+        }
+    }
+
+    c0 = { block[maxIndex * 4 + 0], block[maxIndex * 4 + 1], block[maxIndex * 4 + 2] };
+    c1 = { block[minIndex * 4 + 0], block[minIndex * 4 + 1], block[minIndex * 4 + 2] };
+}
+
+// Solves for the endpoints that best reproduce the block given a fixed index assignment
+bool refineEndpoints(const unsigned char* block, uint32_t indices, Color& c0, Color& c1) {
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[3] = {}, bx[3] = {};
+    for (int i = 0; i < 16; ++i) {
+        float a = weights[(indices >> (i * 2)) & 3];
+        float b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < 3; ++c) {
+            ax[c] += a * block[i * 4 + c];
+            bx[c] += b * block[i * 4 + c];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f)
+        return false;
+
+    int refined0[3], refined1[3];
+    for (int c = 0; c < 3; ++c) {
+        refined0[c] = std::min(255, std::max(0, static_cast<int>((ax[c] * bb - bx[c] * ab) / determinant + 0.5f)));
+        refined1[c] = std::min(255, std::max(0, static_cast<int>((bx[c] * aa - ax[c] * ab) / determinant + 0.5f)));
+    }
+    c0 = { refined0[0], refined0[1], refined0[2] };
+    c1 = { refined1[0], refined1[1], refined1[2] };
+    return true;
+}
+
+// Quantizes a candidate endpoint pair and selects indices. Always produces a four-color block.
+int evaluateEndpoints(const unsigned char* block, const Color& a, const Color& b, uint16_t& c0, uint16_t& c1, uint32_t& indices) {
+    c0 = packColor565(a);
+    c1 = packColor565(b);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    Color palette[4];
+    buildPalette(c0, c1, palette);
+    int error;
+    indices = selectColorIndices(block, palette, error);
+    if (c0 == c1)
+        indices = 0; // Solid block, every index decodes to c0
+    return error;
+}
+
+void encodeColorBlock(const unsigned char* block, CompressionQuality quality, unsigned char* out) {
+    Color a, b;
+    uint16_t c0, c1;
+    uint32_t indices;
+
+    boundingBoxEndpoints(block, a, b);
+    int error = evaluateEndpoints(block, a, b, c0, c1, indices);
+
+    if (quality == CompressionQuality::High && error > 0) {
+        principalAxisEndpoints(block, a, b);
+        uint16_t candidate0, candidate1;
+        uint32_t candidateIndices;
+        int candidateError = evaluateEndpoints(block, a, b, candidate0, candidate1, candidateIndices);
+
+        for (int iteration = 0; iteration < 2; ++iteration) {
+            if (candidateError < error) {
+                error = candidateError;
+                c0 = candidate0;
+                c1 = candidate1;
+                indices = candidateIndices;
+            }
+            if (error == 0 || !refineEndpoints(block, indices, a, b))
+                break;
+            candidateError = evaluateEndpoints(block, a, b, candidate0, candidate1, candidateIndices);
+        }
+        if (candidateError < error) {
+            c0 = candidate0;
+            c1 = candidate1;
+            indices = candidateIndices;
+        }
+    }
+
+    out[0] = static_cast<unsigned char>(c0 & 0xFF);
+    out[1] = static_cast<unsigned char>(c0 >> 8);
+    out[2] = static_cast<unsigned char>(c1 & 0xFF);
+    out[3] = static_cast<unsigned char>(c1 >> 8);
+    std::memcpy(out + 4, &indices, 4); // Little-endian, texel 0 in the low bits
+}
+
+// BC4-style block for one channel: two 8-bit endpoints and sixteen 3-bit indices
+void encodeChannelBlock(const unsigned char* block, int channel, unsigned char* out) {
+    unsigned char values[16];
+    unsigned char lo = 255, hi = 0;
+    for (int i = 0; i < 16; ++i) {
+        values[i] = block[i * 4 + channel];
+        lo = std::min(lo, values[i]);
+        hi = std::max(hi, values[i]);
+    }
+
+    out[0] = hi;
+    out[1] = lo;
+    uint64_t bits = 0;
+    if (hi > lo) {
+        // Position of each value between the endpoints in sevenths; 7 is the first endpoint
+        static const int indexForStep[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+        int steps[16];
+#if USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 offset = _mm_set1_ps(static_cast<float>(lo));
+        const __m128 scale = _mm_set1_ps(7.0f / (hi - lo));
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+        __m128i words[2] = { _mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero) };
+        for (int half = 0; half < 2; ++half) {
+            __m128i dwords[2] = { _mm_unpacklo_epi16(words[half], zero), _mm_unpackhi_epi16(words[half], zero) };
+            for (int quarter = 0; quarter < 2; ++quarter) {
+                __m128 position = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(dwords[quarter]), offset), scale);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(steps + half * 8 + quarter * 4), _mm_cvtps_epi32(position));
+            }
+        }
+#else
+        float scale = 7.0f / (hi - lo);
+        for (int i = 0; i < 16; ++i)
+            steps[i] = static_cast<int>((values[i] - lo) * scale + 0.5f);
+#endif
+        for (int i = 0; i < 16; ++i)
+            bits |= static_cast<uint64_t>(indexForStep[std::min(7, std::max(0, steps[i]))]) << (i * 3);
+    }
+
+    for (int i = 0; i < 6; ++i)
+        out[2 + i] = static_cast<unsigned char>(bits >> (i * 8));
+}
+
+void decodeColorBlock(const unsigned char* in, bool allowThreeColor, unsigned char* block) {
+    uint16_t c0 = static_cast<uint16_t>(in[0] | (in[1] << 8));
+    uint16_t c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+    uint32_t indices;
+    std::memcpy(&indices, in + 4, 4);
+
+    Color palette[4];
+    unsigned char alpha[4] = { 255, 255, 255, 255 };
+    buildPalette(c0, c1, palette);
+    if (allowThreeColor && c0 <= c1) {
+        palette[2] = { (palette[0].r + palette[1].r) / 2, (palette[0].g + palette[1].g) / 2, (palette[0].b + palette[1].b) / 2 };
+        palette[3] = { 0, 0, 0 };
+        alpha[3] = 0;
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        int index = (indices >> (i * 2)) & 3;
+        block[i * 4 + 0] = static_cast<unsigned char>(palette[index].r);
+        block[i * 4 + 1] = static_cast<unsigned char>(palette[index].g);
+        block[i * 4 + 2] = static_cast<unsigned char>(palette[index].b);
+        block[i * 4 + 3] = alpha[index];
+    }
+}
+
+void decodeChannelBlock(const unsigned char* in, int channel, unsigned char* block) {
+    int values[8];
+    values[0] = in[0];
+    values[1] = in[1];
+    if (values[0] > values[1]) {
+        for (int i = 2; i < 8; ++i)
+            values[i] = ((8 - i) * values[0] + (i - 1) * values[1]) / 7;
+    }
+    else {
+        for (int i = 2; i < 6; ++i)
+            values[i] = ((6 - i) * values[0] + (i - 1) * values[1]) / 5;
+        values[6] = 0;
+        values[7] = 255;
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; ++i)
+        bits |= static_cast<uint64_t>(in[2 + i]) << (i * 8);
+    for (int i = 0; i < 16; ++i)
+        block[i * 4 + channel] = static_cast<unsigned char>(values[(bits >> (i * 3)) & 7]);
+}
+
+size_t bytesPerBlock(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+} // namespace
+
+void setTextureCompression(bool enabled, CompressionQuality quality) {
+    if (enabled && !GLEW_EXT_texture_compression_s3tc) {
+        std::cerr << "S3TC texture compression is not supported, textures stay uncompressed" << std::endl;
+        enabled = false;
+    }
+    compressionQuality = static_cast<int>(quality);
+    compressionEnabled = enabled;
+}
+
+bool textureCompressionEnabled() {
+    return compressionEnabled;
+}
+
+CompressionQuality textureCompressionQuality() {
+    return static_cast<CompressionQuality>(compressionQuality.load());
+}
+
+std::string textureCompressionKey() {
+    if (!compressionEnabled)
+        return "";
+    return textureCompressionQuality() == CompressionQuality::Fast ? "|bc-fast" : "|bc-high";
+}
+
+size_t compressedImageSize(BlockFormat format, int width, int height) {
+    size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * bytesPerBlock(format);
+}
+
+unsigned int glFormatForBlockFormat(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockFormat::BC3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default:
+        return GL_COMPRESSED_RG_RGTC2;
+    }
+}
+
+void compressImage(BlockFormat format, CompressionQuality quality, const unsigned char* rgba, int width, int height, unsigned char* blocks) {
+    alignas(16) unsigned char block[64];
+    unsigned char* out = blocks;
+
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            loadBlock(rgba, width, height, bx, by, block);
+            switch (format) {
+            case BlockFormat::BC1:
+                encodeColorBlock(block, quality, out);
+                break;
+            case BlockFormat::BC3:
+                encodeChannelBlock(block, 3, out);
+                encodeColorBlock(block, quality, out + 8);
+                break;
+            case BlockFormat::BC5:
+                encodeChannelBlock(block, 0, out);
+                encodeChannelBlock(block, 1, out + 8);
+                break;
+            }
+            out += bytesPerBlock(format);
+        }
+    }
+}
+
+void decompressImage(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* rgba) {
+    unsigned char block[64];
+    const unsigned char* in = blocks;
+
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            switch (format) {
+            case BlockFormat::BC1:
+                decodeColorBlock(in, true, block);
+                break;
+            case BlockFormat::BC3:
+                decodeColorBlock(in + 8, false, block);
+                decodeChannelBlock(in, 3, block);
+                break;
+            case BlockFormat::BC5:
+                std::memset(block, 0, sizeof(block));
+                decodeChannelBlock(in, 0, block);
+                decodeChannelBlock(in + 8, 1, block);
+                for (int i = 0; i < 16; ++i)
+                    block[i * 4 + 3] = 255;
+                break;
+            }
+            in += bytesPerBlock(format);
+
+            for (int y = 0; y < 4 && by + y < height; ++y) {
+                for (int x = 0; x < 4 && bx + x < width; ++x)
+                    std::memcpy(rgba + (static_cast<size_t>(by + y) * width + bx + x) * 4, block + (y * 4 + x) * 4, 4);
+            }
+        }
+    }
+}
+
+double computePSNR(BlockFormat format, const unsigned char* original, const unsigned char* decoded, int width, int height) {
+    int channels = format == BlockFormat::BC1 ? 3 : (format == BlockFormat::BC3 ? 4 : 2);
+    double squaredError = 0.0;
+    size_t texels = static_cast<size_t>(width) * height;
+    for (size_t i = 0; i < texels; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            double difference = static_cast<double>(original[i * 4 + c]) - decoded[i * 4 + c];
+            squaredError += difference * difference;
+        }
+    }
+
+    double meanSquaredError = squaredError / (static_cast<double>(texels) * channels);
+    if (meanSquaredError == 0.0)
+        return 99.0; // Lossless, report a finite ceiling
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+void compressMipChain(TextureImage& image, CompressionQuality quality) {
+    if (image.channels < 2 || image.mips.empty() || image.format == 0)
+        return;
+
+    BlockFormat format = BlockFormat::BC1;
+    if (image.channels == 2) {
+        format = BlockFormat::BC5;
+    }
+    else if (image.channels == 4) {
+        const TextureMip& base = image.mips[0];
+        for (size_t i = 3; i < base.size; i += 4) {
+            if (base.data[i] != 255) {
+                format = BlockFormat::BC3;
+                break;
+            }
+        }
+    }
+
+    size_t totalSize = 0;
+    for (const TextureMip& mip : image.mips)
+        totalSize += compressedImageSize(format, mip.width, mip.height);
+
+    std::vector<unsigned char> storage(totalSize);
+    std::vector<unsigned char> rgba;
+    size_t offset = 0;
+    for (TextureMip& mip : image.mips) {
+        // Expand the level to RGBA, which is what the block encoders read
+        size_t texels = static_cast<size_t>(mip.width) * mip.height;
+        rgba.resize(texels * 4);
+        for (size_t i = 0; i < texels; ++i) {
+            const unsigned char* source = mip.data + i * image.channels;
+            unsigned char* target = rgba.data() + i * 4;
+            target[0] = source[0];
+            target[1] = source[1];
+            target[2] = image.channels >= 3 ? source[2] : 0;
+            target[3] = image.channels == 4 ? source[3] : 255;
+        }
+
+        compressImage(format, quality, rgba.data(), mip.width, mip.height, storage.data() + offset);
+        mip.size = compressedImageSize(format, mip.width, mip.height);
+        mip.data = storage.data() + offset;
+        offset += mip.size;
+    }
+
+    image.storage.swap(storage);
+    image.mapping.close();
+    image.internalFormat = glFormatForBlockFormat(format);
+    image.format = 0; // Marks block-compressed level data
+}
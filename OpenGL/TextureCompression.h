@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <cstddef>
+#include <string>
+
+struct TextureImage;
+
+enum class BlockFormat {
+    BC1, // RGB, 4 bits per texel
+    BC3, // RGBA, 8 bits per texel
+    BC5  // Two channels (RG), 8 bits per texel
+};
+
+enum class CompressionQuality {
+    Fast, // Bounding-box endpoints
+    High  // Principal-axis endpoints with a least-squares refinement
+};
+
+// Turns the optional compression stage of the texture loader on or off. Call on the GL thread
+// before loading; it stays off if the driver lacks S3TC support. Only diffuse textures are compressed.
+void setTextureCompression(bool enabled, CompressionQuality quality = CompressionQuality::High);
+bool textureCompressionEnabled();
+CompressionQuality textureCompressionQuality();
+
+// Suffix that keeps cache entries of different compression settings apart
+std::string textureCompressionKey();
+
+size_t compressedImageSize(BlockFormat format, int width, int height);
+unsigned int glFormatForBlockFormat(BlockFormat format);
+
+// Encodes a tightly packed RGBA8 image into 4x4 blocks. Edge blocks repeat the last row/column.
+void compressImage(BlockFormat format, CompressionQuality quality, const unsigned char* rgba, int width, int height, unsigned char* blocks);
+
+// Decodes blocks back to RGBA8, used to measure the encoder's error
+void decompressImage(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* rgba);
+
+// Peak signal-to-noise ratio over the channels the format stores
+double computePSNR(BlockFormat format, const unsigned char* original, const unsigned char* decoded, int width, int height);
+
+// Replaces the uncompressed mip chain of image with block-compressed levels.
+// RGB uses BC1, RGBA uses BC3 (or BC1 when fully opaque), two-channel data uses BC5.
+// Single-channel images are left untouched.
+void compressMipChain(TextureImage& image, CompressionQuality quality);
+
+#endif // TEXTURE_COMPRESSION_H
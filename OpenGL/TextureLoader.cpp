@@ -1,38 +1,278 @@
 #include "TextureLoader.h"
 #include <GL/glew.h>
-#include "stb_image.h"
+#include "TextureCache.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
 
-unsigned int loadTexture(const char* path) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+namespace {
 
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format;
-        if (nrChannels == 1)
-            format = GL_RED;
-        else if (nrChannels == 3)
-            format = GL_RGB;
-        else if (nrChannels == 4)
-            format = GL_RGBA;
+// Image prepared on a worker thread, waiting for the GL thread to upload it
+struct DecodedTexture {
+    GLuint id;
+    std::string path;
+    std::unique_ptr<TextureImage> image; // Null if the load failed
+};
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+// Texture whose mip chain is being uploaded smallest level first, one level at a time
+struct StreamingTexture {
+    GLuint id;
+    std::unique_ptr<TextureImage> image;
+    int nextLevel; // Next (larger) level to upload
+};
+
+// Levels at the small end of the chain are uploaded together as soon as a texture arrives
+const size_t STREAMING_TAIL_BYTES = 16 * 1024;
+
+std::mutex decodedMutex;
+std::condition_variable decodedReady;
+std::deque<DecodedTexture> decodedTextures;
+unsigned int texturesInFlight = 0; // Guarded by decodedMutex
+
+std::vector<StreamingTexture> streamingTextures; // GL thread only
+size_t streamingCursor = 0;
+
+GLuint uploadPBO = 0;
+TextureUploadCallback uploadCallback = nullptr;
+
+void setTextureParameters(int mipCount) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// Uploads levels [first, end) of the prebuilt mip chain to the bound texture. The levels are copied
+// into a pixel unpack buffer so the driver can transfer them asynchronously; no glGenerateMipmap needed.
+void uploadMipLevels(const TextureImage& image, size_t first, size_t end) {
+    size_t totalSize = 0;
+    for (size_t level = first; level < end; ++level) {
+        totalSize += image.mips[level].size;
+    }
+
+    if (uploadPBO == 0)
+        glGenBuffers(1, &uploadPBO);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB rows are not 4-byte aligned
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+    // Orphan the previous storage so we never wait on an upload that is still in flight
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, totalSize, NULL, GL_STREAM_DRAW);
+    unsigned char* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, totalSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+
+    if (mapped) {
+        size_t offset = 0;
+        for (size_t level = first; level < end; ++level) {
+            std::memcpy(mapped + offset, image.mips[level].data, image.mips[level].size);
+            offset += image.mips[level].size;
+        }
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        offset = 0;
+        for (size_t level = first; level < end; ++level) {
+            const TextureMip& mip = image.mips[level];
+            uploadTextureLevel(GL_TEXTURE_2D, static_cast<int>(level), image, mip, (void*)offset);
+            offset += mip.size;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        for (size_t level = first; level < end; ++level) {
+            const TextureMip& mip = image.mips[level];
+            uploadTextureLevel(GL_TEXTURE_2D, static_cast<int>(level), image, mip, mip.data);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void uploadMipChain(const TextureImage& image) {
+    uploadMipLevels(image, 0, image.mips.size());
+}
+
+void finishStreaming(const StreamingTexture& texture) {
+    if (uploadCallback) {
+        size_t bytes = 0;
+        for (const TextureMip& mip : texture.image->mips)
+            bytes += mip.size;
+        uploadCallback(texture.id, bytes, static_cast<int>(texture.image->mips.size()));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        --texturesInFlight;
+    }
+    decodedReady.notify_all();
+}
+
+// Uploads the small tail of the mip chain right away and queues the larger levels for streaming
+void beginStreaming(DecodedTexture& decoded) {
+    if (!decoded.image) {
+        std::cerr << "Texture failed to load at path: " << decoded.path << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(decodedMutex);
+            --texturesInFlight;
+        }
+        decodedReady.notify_all();
+        return; // Keep the placeholder
+    }
+
+    const TextureImage& image = *decoded.image;
+    size_t first = image.mips.size() - 1;
+    size_t tailBytes = image.mips[first].size;
+    while (first > 0 && tailBytes + image.mips[first - 1].size <= STREAMING_TAIL_BYTES) {
+        --first;
+        tailBytes += image.mips[first].size;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, decoded.id);
+    uploadMipLevels(image, first, image.mips.size());
+    setTextureParameters(static_cast<int>(image.mips.size()));
+    // Sample only the levels that exist so far; lowered as larger levels arrive
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(first));
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    StreamingTexture texture;
+    texture.id = decoded.id;
+    texture.image = std::move(decoded.image);
+    texture.nextLevel = static_cast<int>(first) - 1;
+    if (texture.nextLevel < 0)
+        finishStreaming(texture);
+    else
+        streamingTextures.push_back(std::move(texture));
+}
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// Uploads the next larger level of a streaming texture and returns its size in bytes
+size_t streamNextLevel(StreamingTexture& texture) {
+    size_t level = static_cast<size_t>(texture.nextLevel);
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    uploadMipLevels(*texture.image, level, level + 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(level));
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-        stbi_image_free(data);
+    --texture.nextLevel;
+    return texture.image->mips[level].size;
+}
+
+// Moves every texture the workers have finished onto the streaming list
+void acceptDecodedTextures() {
+    std::deque<DecodedTexture> decoded;
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        decoded.swap(decodedTextures);
+    }
+    for (DecodedTexture& texture : decoded)
+        beginStreaming(texture);
+}
+
+} // namespace
+
+void uploadTextureLevel(unsigned int target, int level, const TextureImage& image, const TextureMip& mip, const void* pixels) {
+    if (image.compressed())
+        glCompressedTexImage2D(target, level, image.internalFormat, mip.width, mip.height, 0, static_cast<GLsizei>(mip.size), pixels);
+    else
+        glTexImage2D(target, level, image.internalFormat, mip.width, mip.height, 0, image.format, GL_UNSIGNED_BYTE, pixels);
+}
+
+unsigned int loadTexture(const char* path, const std::string& type) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    TextureImage image;
+    if (loadTextureImage(path, type, image)) {
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        uploadMipChain(image);
+        setTextureParameters(static_cast<int>(image.mips.size()));
     }
     else {
         std::cerr << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
 
     return textureID;
-}
\ No newline at end of file
+}
+
+unsigned int loadTextureAsync(const char* path, const std::string& type) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    // Neutral grey placeholder until the real image arrives
+    static const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        ++texturesInFlight;
+    }
+
+    std::string texturePath = path;
+    JobSystem::shared().enqueue([textureID, texturePath, type]() {
+        DecodedTexture decoded;
+        decoded.id = textureID;
+        decoded.path = texturePath;
+        decoded.image.reset(new TextureImage());
+        if (!loadTextureImage(texturePath, type, *decoded.image))
+            decoded.image.reset();
+
+        {
+            std::lock_guard<std::mutex> lock(decodedMutex);
+            decodedTextures.push_back(std::move(decoded));
+        }
+        decodedReady.notify_one();
+    });
+
+    return textureID;
+}
+
+void processTextureUploads(size_t byteBudget) {
+    PROFILE_SCOPE("processTextureUploads");
+    acceptDecodedTextures();
+
+    // Round robin over the streaming textures so every one of them sharpens at the same pace
+    size_t uploaded = 0;
+    while (!streamingTextures.empty() && uploaded < byteBudget) {
+        if (streamingCursor >= streamingTextures.size())
+            streamingCursor = 0;
+
+        StreamingTexture& texture = streamingTextures[streamingCursor];
+        uploaded += streamNextLevel(texture);
+        if (texture.nextLevel < 0) {
+            finishStreaming(texture);
+            streamingTextures.erase(streamingTextures.begin() + streamingCursor);
+        }
+        else {
+            ++streamingCursor;
+        }
+    }
+}
+
+void finishTextureUploads() {
+    for (;;) {
+        processTextureUploads(SIZE_MAX);
+
+        std::unique_lock<std::mutex> lock(decodedMutex);
+        decodedReady.wait(lock, [] { return !decodedTextures.empty() || texturesInFlight == 0; });
+        if (decodedTextures.empty())
+            return;
+    }
+}
+
+void setTextureUploadCallback(TextureUploadCallback callback) {
+    uploadCallback = callback;
+}
+
+unsigned int pendingTextureUploads() {
+    std::lock_guard<std::mutex> lock(decodedMutex);
+    return texturesInFlight;
+}
@@ -3,8 +3,37 @@
 #ifndef TEXTURE_LOADER_H
 #define TEXTURE_LOADER_H
 
+#include <cstddef>
 #include <string>
 
-unsigned int loadTexture(const char* path);
+struct TextureImage;
+struct TextureMip;
 
-#endif // TEXTURE_LOADER_H
\ No newline at end of file
+// Blocking load: decodes and uploads on the calling (GL) thread. type is the material texture
+// type, see loadTextureImage().
+unsigned int loadTexture(const char* path, const std::string& type);
+
+// Specifies one level of the texture bound to target from image's level data. pixels is either
+// mip.data or an offset into the bound pixel unpack buffer. Handles block-compressed images.
+void uploadTextureLevel(unsigned int target, int level, const TextureImage& image, const TextureMip& mip, const void* pixels);
+
+// Non-blocking load: returns a texture ID right away that holds a 1x1 placeholder.
+// The image is decoded and mipmapped on the shared JobSystem and streamed in by processTextureUploads().
+unsigned int loadTextureAsync(const char* path, const std::string& type);
+
+// Streams decoded textures in smallest mip first: the levels below 16 KB are uploaded as soon as a
+// texture arrives, then one larger level per texture in turn until byteBudget is spent.
+// GL_TEXTURE_BASE_LEVEL follows the largest level uploaded. Call once per frame on the GL thread.
+void processTextureUploads(size_t byteBudget = 4 * 1024 * 1024);
+
+// Blocks until every texture requested through loadTextureAsync() has been uploaded
+void finishTextureUploads();
+
+// Called on the GL thread once an async texture's full mip chain has been uploaded
+typedef void (*TextureUploadCallback)(unsigned int textureID, size_t bytes, int mipCount);
+void setTextureUploadCallback(TextureUploadCallback callback);
+
+// Number of async textures that are still decoding or streaming
+unsigned int pendingTextureUploads();
+
+#endif // TEXTURE_LOADER_H
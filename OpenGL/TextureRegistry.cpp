@@ -0,0 +1,261 @@
+#include "TextureRegistry.h"
+#include <GL/glew.h>
+#include "CacheFile.h"
+#include "JobSystem.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+const size_t PLACEHOLDER_BYTES = 4; // The 1x1 RGBA texel loadTextureAsync() starts with
+
+} // namespace
+
+TextureRegistry& TextureRegistry::instance() {
+    static TextureRegistry registry;
+    return registry;
+}
+
+TextureRegistry::TextureRegistry() {
+    setTextureUploadCallback(&TextureRegistry::onTextureUploaded);
+}
+
+Texture TextureRegistry::acquire(const std::string& path, const std::string& type) {
+    ++requests;
+    uint64_t key = hashString(path);
+
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+        ++hits;
+        Entry& entry = found->second;
+        ++entry.refCount;
+        lru.splice(lru.begin(), lru, entry.lruPosition);
+
+        Texture texture;
+        texture.id = entry.id;
+        texture.type = type;
+        texture.path = path;
+        return texture;
+    }
+
+    Entry entry;
+    entry.id = loadTextureAsync(path.c_str(), type);
+    entry.generation = ++nextGeneration;
+    entry.path = path;
+    entry.type = type;
+    entry.refCount = 1;
+    entry.bytes = PLACEHOLDER_BYTES;
+    entry.mipCount = 1;
+    entry.droppedMips = 0;
+    entry.dropSavings = 0;
+    entry.uploaded = false;
+    entry.pinned = false;
+    lru.push_front(key);
+    entry.lruPosition = lru.begin();
+
+    residentBytes += entry.bytes;
+    keysByID[entry.id] = key;
+    entries[key] = entry;
+
+    Texture texture;
+    texture.id = entry.id;
+    texture.type = type;
+    texture.path = path;
+    return texture;
+}
+
+void TextureRegistry::release(unsigned int textureID) {
+    Entry* entry = find(textureID);
+    if (entry && entry->refCount > 0)
+        --entry->refCount;
+}
+
+void TextureRegistry::touch(unsigned int textureID) {
+    Entry* entry = find(textureID);
+    if (entry)
+        lru.splice(lru.begin(), lru, entry->lruPosition);
+}
+
+void TextureRegistry::setPinned(unsigned int textureID, bool pinned) {
+    Entry* entry = find(textureID);
+    if (entry)
+        entry->pinned = pinned;
+}
+
+void TextureRegistry::addExternalBytes(size_t bytes) {
+    externalBytes += bytes;
+    residentBytes += bytes;
+}
+
+void TextureRegistry::removeExternalBytes(size_t bytes) {
+    bytes = std::min(bytes, externalBytes);
+    externalBytes -= bytes;
+    residentBytes -= bytes;
+}
+
+void TextureRegistry::enforceBudget() {
+    applyMipDrops();
+    if (budgetBytes == 0 || residentBytes <= budgetBytes)
+        return;
+
+    // First pass: delete unreferenced textures, least recently used first
+    std::vector<uint64_t> unreferenced;
+    for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+        const Entry& entry = entries[*it];
+        if (entry.refCount == 0 && entry.uploaded)
+            unreferenced.push_back(*it);
+    }
+    for (size_t i = 0; i < unreferenced.size() && residentBytes > budgetBytes; ++i)
+        evict(unreferenced[i]);
+
+    // Second pass: shrink textures that are still referenced, one mip level per texture at a time,
+    // counting the drops already under way
+    for (auto it = lru.rbegin(); it != lru.rend() && residentBytes - pendingSavings > budgetBytes; ++it)
+        dropTopMip(*it, entries[*it]);
+}
+
+void TextureRegistry::purgeUnused() {
+    for (auto it = lru.begin(); it != lru.end(); ) {
+        uint64_t key = *it;
+        ++it;
+        const Entry& entry = entries[key];
+        if (entry.refCount == 0 && entry.uploaded)
+            evict(key);
+    }
+}
+
+TextureRegistryStats TextureRegistry::stats() const {
+    TextureRegistryStats result;
+    result.requests = requests;
+    result.hits = hits;
+    result.hitRate = requests > 0 ? static_cast<double>(hits) / requests : 0.0;
+    result.residentBytes = residentBytes;
+    result.externalBytes = externalBytes;
+    result.budgetBytes = budgetBytes;
+    result.textureCount = entries.size();
+    result.evictions = evictions;
+    result.mipDrops = mipDrops;
+    return result;
+}
+
+void TextureRegistry::printStats() const {
+    TextureRegistryStats current = stats();
+    std::cout << "Textures: " << current.textureCount
+              << ", hit rate " << current.hitRate * 100.0 << "% (" << current.hits << "/" << current.requests << ")"
+              << ", resident " << current.residentBytes / 1024 << " KB";
+    if (current.externalBytes > 0)
+        std::cout << " (" << current.externalBytes / 1024 << " KB external)";
+    if (current.budgetBytes > 0)
+        std::cout << " of " << current.budgetBytes / 1024 << " KB";
+    std::cout << ", evictions " << current.evictions
+              << ", mip drops " << current.mipDrops << std::endl;
+}
+
+void TextureRegistry::onTextureUploaded(unsigned int textureID, size_t bytes, int mipCount) {
+    TextureRegistry& registry = instance();
+    Entry* entry = registry.find(textureID);
+    if (!entry)
+        return; // Loaded outside the registry
+
+    registry.residentBytes = registry.residentBytes - entry->bytes + bytes;
+    entry->bytes = bytes;
+    entry->mipCount = mipCount;
+    entry->droppedMips = 0;
+    entry->uploaded = true;
+}
+
+TextureRegistry::Entry* TextureRegistry::find(unsigned int textureID) {
+    auto key = keysByID.find(textureID);
+    if (key == keysByID.end())
+        return nullptr;
+    return &entries[key->second];
+}
+
+void TextureRegistry::evict(uint64_t key) {
+    auto found = entries.find(key);
+    if (found == entries.end())
+        return;
+
+    Entry& entry = found->second;
+    glDeleteTextures(1, &entry.id);
+    residentBytes -= entry.bytes;
+    pendingSavings -= entry.dropSavings; // A reload still under way is discarded when it arrives
+    lru.erase(entry.lruPosition);
+    keysByID.erase(entry.id);
+    entries.erase(found);
+    ++evictions;
+}
+
+// Reloads the image on the shared JobSystem to re-specify the texture without its largest
+// remaining level. The smaller levels come straight from the texture cache, so the job costs a
+// mapping rather than a decode.
+bool TextureRegistry::dropTopMip(uint64_t key, Entry& entry) {
+    if (!entry.uploaded || entry.pinned || entry.dropSavings > 0 || entry.mipCount - entry.droppedMips <= 1)
+        return false;
+
+    // A level holds about three quarters of the chain below and including it
+    entry.dropSavings = std::max<size_t>(1, entry.bytes / 4 * 3);
+    pendingSavings += entry.dropSavings;
+
+    MipReload reload;
+    reload.key = key;
+    reload.generation = entry.generation;
+    reload.droppedMips = entry.droppedMips + 1;
+    std::string path = entry.path, type = entry.type;
+    std::shared_ptr<MipReload> job = std::make_shared<MipReload>(std::move(reload));
+    JobSystem::shared().enqueue([this, job, path, type]() {
+        job->image.reset(new TextureImage());
+        if (!loadTextureImage(path, type, *job->image))
+            job->image.reset();
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        reloaded.push_back(std::move(*job));
+    });
+    return true;
+}
+
+// Re-specifies the reloaded textures with exactly the remaining levels, so the dropped level's
+// storage is freed rather than left allocated past GL_TEXTURE_MAX_LEVEL
+void TextureRegistry::applyMipDrops() {
+    std::vector<MipReload> finished;
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        finished.swap(reloaded);
+    }
+    for (MipReload& reload : finished) {
+        auto found = entries.find(reload.key);
+        if (found == entries.end() || found->second.generation != reload.generation)
+            continue; // Evicted meanwhile, possibly reloaded under the same key
+        Entry& entry = found->second;
+        pendingSavings -= entry.dropSavings;
+        entry.dropSavings = 0;
+
+        size_t first = static_cast<size_t>(reload.droppedMips);
+        if (!reload.image || entry.pinned || first >= reload.image->mips.size())
+            continue;
+        const TextureImage& image = *reload.image;
+        int levelCount = static_cast<int>(image.mips.size() - first);
+        int previousCount = entry.mipCount - entry.droppedMips;
+
+        size_t bytes = 0;
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (size_t level = first; level < image.mips.size(); ++level) {
+            uploadTextureLevel(GL_TEXTURE_2D, static_cast<int>(level - first), image, image.mips[level], image.mips[level].data);
+            bytes += image.mips[level].size;
+        }
+        // Empty images release the levels past the new chain
+        for (int level = levelCount; level < previousCount; ++level)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        residentBytes = residentBytes - entry.bytes + bytes;
+        entry.bytes = bytes;
+        entry.droppedMips = static_cast<int>(first);
+        ++mipDrops;
+    }
+}
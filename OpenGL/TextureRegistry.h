@@ -0,0 +1,117 @@
+#pragma once
+
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Texture.h"
+
+struct TextureImage;
+
+struct TextureRegistryStats {
+    uint64_t requests;
+    uint64_t hits;
+    double hitRate;
+    size_t residentBytes; // Including external bytes
+    size_t externalBytes;
+    size_t budgetBytes;
+    size_t textureCount;
+    uint64_t evictions; // Unreferenced textures deleted to meet the budget
+    uint64_t mipDrops;  // Top mip levels dropped from referenced textures
+};
+
+// Process-wide texture registry. Textures are keyed by a hash of their path, shared between every
+// model that references them and reference counted. Resident bytes are tracked per texture and a
+// memory budget is enforced by deleting unreferenced textures and then dropping the top mip levels
+// of the least recently used ones. Dropping a level reloads the image on the shared JobSystem and
+// re-specifies the texture a frame or more later. Must only be used from the GL thread.
+class TextureRegistry {
+public:
+    static TextureRegistry& instance();
+
+    // Returns the shared texture for path (loading it asynchronously on first use) and adds a reference
+    Texture acquire(const std::string& path, const std::string& type);
+    void release(unsigned int textureID);
+
+    // Marks a texture as used this frame for the LRU order
+    void touch(unsigned int textureID);
+
+    // Pinned textures keep their storage: the budget never drops their mips. Needed while a
+    // bindless handle of the texture is resident.
+    void setPinned(unsigned int textureID, bool pinned);
+
+    // 0 disables the budget
+    void setBudget(size_t bytes) { budgetBytes = bytes; }
+
+    // Texture memory the registry does not own, such as copies in material table pages; it counts
+    // against the budget, so registry textures give way to it
+    void addExternalBytes(size_t bytes);
+    void removeExternalBytes(size_t bytes);
+
+    // Applies the mip drops whose images have been reloaded, then evicts or schedules mip drops of
+    // least recently used textures until the budget is met; call once per frame
+    void enforceBudget();
+
+    // Deletes every uploaded texture that no longer has references
+    void purgeUnused();
+
+    TextureRegistryStats stats() const;
+    void printStats() const;
+
+private:
+    struct Entry {
+        unsigned int id;
+        uint64_t generation; // Unique per load; GL names and keys are both reused after an eviction
+        std::string path;
+        std::string type; // Of the first acquire; decides how the mips are filtered
+        unsigned int refCount;
+        size_t bytes;
+        int mipCount;
+        int droppedMips;
+        size_t dropSavings; // Estimated bytes the pending mip drop frees; 0 when none is pending
+        bool uploaded; // False while the placeholder is still showing
+        bool pinned;
+        std::list<uint64_t>::iterator lruPosition;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+    std::unordered_map<unsigned int, uint64_t> keysByID;
+    std::list<uint64_t> lru; // Most recently used at the front
+
+    // Image reloaded by a job for a mip drop, waiting for the GL thread
+    struct MipReload {
+        uint64_t key;
+        uint64_t generation; // Of the entry the reload was started for
+        int droppedMips; // Levels to drop from the top of the full chain
+        std::unique_ptr<TextureImage> image; // Null if the load failed
+    };
+    std::mutex reloadMutex;
+    std::vector<MipReload> reloaded; // Guarded by reloadMutex
+
+    size_t budgetBytes = 0;
+    size_t residentBytes = 0;
+    size_t externalBytes = 0;
+    size_t pendingSavings = 0; // Sum of dropSavings
+    uint64_t requests = 0;
+    uint64_t hits = 0;
+    uint64_t evictions = 0;
+    uint64_t mipDrops = 0;
+    uint64_t nextGeneration = 0;
+
+    TextureRegistry();
+    static void onTextureUploaded(unsigned int textureID, size_t bytes, int mipCount);
+
+    Entry* find(unsigned int textureID);
+    void evict(uint64_t key);
+    bool dropTopMip(uint64_t key, Entry& entry);
+    void applyMipDrops();
+};
+
+#endif // TEXTURE_REGISTRY_H
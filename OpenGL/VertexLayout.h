@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <initializer_list>
+
+// Size in bytes of one component of a GL vertex attribute type
+constexpr size_t vertexComponentSize(GLenum type) {
+    return type == GL_FLOAT || type == GL_INT || type == GL_UNSIGNED_INT ? 4
+         : type == GL_HALF_FLOAT || type == GL_SHORT || type == GL_UNSIGNED_SHORT ? 2
+         : 1;
+}
+
+constexpr size_t largestOf(std::initializer_list<size_t> values) {
+    size_t largest = 0;
+    for (size_t value : values)
+        largest = value > largest ? value : largest;
+    return largest;
+}
+
+// One vertex attribute: shader location, component count and type, whether integer components
+// are normalized to [0, 1] or [-1, 1], and its byte offset in the vertex
+template <GLuint Location, GLint Components, GLenum Type, GLboolean Normalized, size_t Offset>
+struct VertexAttribute {
+    static const size_t end = Offset + Components * vertexComponentSize(Type);
+
+    static void enable(GLsizei stride) {
+        glEnableVertexAttribArray(Location);
+        glVertexAttribPointer(Location, Components, Type, Normalized, stride, reinterpret_cast<const void*>(Offset));
+    }
+};
+
+// A vertex struct and its attributes. setup() expands to one glVertexAttribPointer call per
+// attribute for the bound VAO and array buffer; nothing is looked up at run time.
+template <typename VertexType, typename... Attributes>
+struct VertexLayout {
+    typedef VertexType VertexStruct;
+    static const GLsizei stride = static_cast<GLsizei>(sizeof(VertexType));
+
+    static_assert(largestOf({ Attributes::end... }) <= sizeof(VertexType), "Vertex attribute reads past the end of the vertex");
+
+    static void setup() {
+        int expand[] = { 0, (Attributes::enable(stride), 0)... };
+        (void)expand;
+    }
+};
+
+#endif // VERTEX_LAYOUT_H
@@ -5,23 +5,87 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <GL/glew.h>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// Binding points of the uniform blocks shared by all programs. Shader binds blocks with these
+// names when it links; see streamCameraUniforms() for the Camera block.
+const GLuint CAMERA_BLOCK_BINDING = 0;
+
+// Location of an active uniform in one program, from Shader::uniform(). Look it up once and keep
+// it; the setters taking a handle are a single glUniform* call.
+struct UniformHandle {
+    GLint location = -1; // -1 if the program has no such active uniform, which GL ignores
+};
+
 class Shader {
 public:
     GLuint Program;
 
-    // Method to set a 4x4 matrix uniform
-    void setMat4(const std::string& name, const glm::mat4& mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(this->Program, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+    // Handle of the active uniform name (without "[0]" for arrays), found in the table built at
+    // link time
+    UniformHandle uniform(const char* name) const {
+        UniformHandle handle;
+        for (int i = 0; i < uniformCount; ++i) {
+            if (std::strcmp(uniforms[i].name, name) == 0) {
+                handle.location = uniforms[i].location;
+                return handle;
+            }
+        }
+        if (uniformsTruncated)
+            handle.location = glGetUniformLocation(this->Program, name); // Not in the table
+        return handle;
     }
 
-    // Method to set an integer uniform
-    void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(this->Program, name.c_str()), value);
+    bool hasUniformBlock(const char* name) const {
+        for (int i = 0; i < blockCount; ++i) {
+            if (std::strcmp(blocks[i].name, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Shader storage blocks are only reflected with GL 4.3
+    bool hasStorageBlock(const char* name) const {
+        for (int i = 0; i < storageBlockCount; ++i) {
+            if (std::strcmp(storageBlocks[i].name, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Setters for uniforms of the program in use
+    void set(UniformHandle handle, const glm::mat4& mat) const {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+
+    void set(UniformHandle handle, int value) const {
+        glUniform1i(handle.location, value);
+    }
+
+    void set(UniformHandle handle, float value) const {
+        glUniform1f(handle.location, value);
+    }
+
+    void set(UniformHandle handle, const glm::vec4& value) const {
+        glUniform4fv(handle.location, 1, glm::value_ptr(value));
+    }
+
+    void set(UniformHandle handle, const float (*values)[3], GLsizei count) const {
+        glUniform3fv(handle.location, count, values[0]);
+    }
+
+    // Method to set a 4x4 matrix uniform; looks the name up, so prefer a handle in loops
+    void setMat4(const char* name, const glm::mat4& mat) const {
+        set(uniform(name), mat);
+    }
+
+    // Method to set an integer uniform; looks the name up, so prefer a handle in loops
+    void setInt(const char* name, int value) const {
+        set(uniform(name), value);
     }
 
     bool isSuccessfullyCompiled() const {
@@ -70,9 +134,70 @@ public:
             std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
 
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
+        build(vertexCode.c_str(), fragmentCode.c_str());
+    }
+
+    // Builds the shader from source held in memory rather than files
+    static Shader fromSource(const GLchar* vShaderCode, const GLchar* fShaderCode) {
+        Shader shader;
+        shader.build(vShaderCode, fShaderCode);
+        return shader;
+    }
+
+    // Source with the defines (whole "#define NAME\n" lines) inserted after its #version line. A
+    // #line directive keeps the compiler's line numbers matching the file.
+    static std::string specialize(const std::string& source, const std::string& defines) {
+        if (defines.empty())
+            return source;
+        size_t versionEnd = 0;
+        int versionLines = 0;
+        if (source.compare(0, 8, "#version") == 0) {
+            versionEnd = source.find('\n');
+            versionEnd = versionEnd == std::string::npos ? source.size() : versionEnd + 1;
+            versionLines = 1;
+        }
+        std::string result = source.substr(0, versionEnd);
+        if (!result.empty() && result.back() != '\n')
+            result += '\n';
+        result += defines;
+        result += "#line " + std::to_string(versionLines + 1) + "\n";
+        result.append(source, versionEnd, std::string::npos);
+        return result;
+    }
+
+    // Use the current shader
+    void use() {
+        glUseProgram(this->Program);
+    }
+
+private:
+    friend class ShaderBatch; // Builds programs in batches through the binary cache
+
+    static const int MAX_UNIFORMS = 64;
+    static const int MAX_UNIFORM_BLOCKS = 8;
+    static const int MAX_NAME_LENGTH = 64;
+
+    struct ReflectedUniform {
+        char name[MAX_NAME_LENGTH];
+        GLint location;
+    };
+
+    struct ReflectedBlock {
+        char name[MAX_NAME_LENGTH];
+        GLuint index;
+    };
+
+    ReflectedUniform uniforms[MAX_UNIFORMS];
+    int uniformCount = 0;
+    bool uniformsTruncated = false; // More active uniforms than the table holds
+    ReflectedBlock blocks[MAX_UNIFORM_BLOCKS];
+    int blockCount = 0;
+    ReflectedBlock storageBlocks[MAX_UNIFORM_BLOCKS];
+    int storageBlockCount = 0;
 
+    Shader() : Program(0) {}
+
+    void build(const GLchar* vShaderCode, const GLchar* fShaderCode) {
         // 2. Compile shaders
         GLuint vertex, fragment;
         GLint success;
@@ -111,15 +236,67 @@ public:
             glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
             std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
         }
+        else {
+            reflect();
+        }
 
         // Delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
     }
 
-    // Use the current shader
-    void use() {
-        glUseProgram(this->Program);
+    // Takes a program linked elsewhere
+    void adopt(GLuint program) {
+        this->Program = program;
+        GLint success = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (success)
+            reflect();
+    }
+
+    // Fills the uniform and block tables from the linked program and binds the shared blocks
+    void reflect() {
+        GLint activeUniforms = 0;
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORMS, &activeUniforms);
+        for (GLint i = 0; i < activeUniforms; ++i) {
+            char name[MAX_NAME_LENGTH];
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(this->Program, static_cast<GLuint>(i), MAX_NAME_LENGTH, &length, &size, &type, name);
+            GLint location = glGetUniformLocation(this->Program, name);
+            if (location < 0)
+                continue; // Block member
+            if (uniformCount == MAX_UNIFORMS || length == MAX_NAME_LENGTH - 1) {
+                uniformsTruncated = true;
+                continue;
+            }
+            if (length > 3 && std::strcmp(name + length - 3, "[0]") == 0)
+                name[length - 3] = '\0';
+            ReflectedUniform& uniform = uniforms[uniformCount++];
+            std::memcpy(uniform.name, name, sizeof(name));
+            uniform.location = location;
+        }
+
+        GLint activeBlocks = 0;
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_BLOCKS, &activeBlocks);
+        for (GLint i = 0; i < activeBlocks && blockCount < MAX_UNIFORM_BLOCKS; ++i) {
+            ReflectedBlock& block = blocks[blockCount++];
+            glGetActiveUniformBlockName(this->Program, static_cast<GLuint>(i), MAX_NAME_LENGTH, NULL, block.name);
+            block.index = static_cast<GLuint>(i);
+            if (std::strcmp(block.name, "Camera") == 0)
+                glUniformBlockBinding(this->Program, block.index, CAMERA_BLOCK_BINDING);
+        }
+
+        if (!GLEW_VERSION_4_3)
+            return;
+        GLint activeStorageBlocks = 0;
+        glGetProgramInterfaceiv(this->Program, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &activeStorageBlocks);
+        for (GLint i = 0; i < activeStorageBlocks && storageBlockCount < MAX_UNIFORM_BLOCKS; ++i) {
+            ReflectedBlock& block = storageBlocks[storageBlockCount++];
+            glGetProgramResourceName(this->Program, GL_SHADER_STORAGE_BLOCK, static_cast<GLuint>(i), MAX_NAME_LENGTH, NULL, block.name);
+            block.index = static_cast<GLuint>(i);
+        }
     }
 };
 